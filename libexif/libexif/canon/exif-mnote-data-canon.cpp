@@ -37,7 +37,7 @@ void ExifMnoteDataCanon::exif_mnote_data_canon_clear ()
 {
 	if (entries) 
 	{
-		delete entries;
+		delete [] entries;
 		entries = NULL;
 		count = 0;
 	}
@@ -74,16 +74,7 @@ char * ExifMnoteDataCanon::get_value (unsigned int n, char *val, unsigned int ma
 
 void ExifMnoteDataCanon::set_byte_order (ExifByteOrder o)
 {
-	ExifByteOrder o_orig;
-	unsigned int i;
-
-	o_orig = order;
 	order = o;
-	for (i = 0; i < count; i++) {
-		entries[i].order = o;
-		exif_array_set_byte_order (entries[i].format, entries[i].data,
-				entries[i].components, o_orig, o);
-	}
 }
 
 void ExifMnoteDataCanon::set_offset (unsigned int o)
@@ -91,30 +82,33 @@ void ExifMnoteDataCanon::set_offset (unsigned int o)
 	offset = o;
 }
 
+/* The Canon directory starts the MakerNote and its offsets are relative
+ * to the EXIF data */
+int ExifMnoteDataCanon::relocate (unsigned char *buf, unsigned int buf_size,
+				  unsigned int o)
+{
+	return exif_mnote_data_relocate_ifd (buf, buf_size, 0, order, offset, o);
+}
+
 void ExifMnoteDataCanon::save(unsigned char **buf, unsigned int *buf_size)
 {
-	size_t i, o, s, doff;
-	unsigned char *t;
-	size_t ts;
+	size_t i, o, s, doff, dnext;
 
 	if (!buf || !buf_size) return;
 
 	/*
-	 * Allocate enough memory for all entries and the number
-	 * of entries.
+	 * Allocate enough memory for all entries, the number of entries
+	 * and all values at once. The values follow the directory.
 	 */
-	*buf_size = 2 + count * 12 + 4;
-	if (*buf)
-	{
-		delete [] *buf;
-		*buf=NULL;
-	}
-
-	*buf=new unsigned char[*buf_size];
+	dnext = 2 + count * 12 + 4;
+	*buf_size = (unsigned int) (dnext +
+		exif_mnote_data_values_size (entries, count, 1));
+	mem->exif_mem_alloc (buf, *buf_size);
 	if (!*buf) {
 		EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteCanon", *buf_size);
 		return;
 	}
+	memset (*buf, 0, *buf_size);
 
 	/* Save the number of entries */
 	exif_set_short (*buf, order, (ExifShort) count);
@@ -136,19 +130,9 @@ void ExifMnoteDataCanon::save(unsigned char **buf, unsigned int *buf_size)
 			continue;
 		}
 		if (s > 4) {
-			ts = *buf_size + s;
-
-			/* Ensure even offsets. Set padding bytes to 0. */
-			if (s & 1) ts += 1;
-			t= new unsigned char[ts];
-			if (!t) {
-				EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteCanon", ts);
-				return;
-			}
-			*buf = t;
-			*buf_size = ts;
-			doff = *buf_size - s;
-			if (s & 1) { doff--; *(*buf + *buf_size - 1) = '\0'; }
+			/* Ensure even offsets. The padding bytes are 0. */
+			doff = dnext;
+			dnext += s + (s & 1);
 			exif_set_long (*buf + o, order, offset + doff);
 		} else
 			doff = o;
@@ -158,7 +142,11 @@ void ExifMnoteDataCanon::save(unsigned char **buf, unsigned int *buf_size)
 		 * crash if data is NULL.
 		 */
 		if (!entries[i].data) memset (*buf + doff, 0, s);
-		else memcpy (*buf + doff, entries[i].data, s);
+		else {
+			memcpy (*buf + doff, entries[i].data, s);
+			exif_array_set_byte_order (entries[i].format, *buf + doff,
+				(unsigned int) entries[i].components, entries[i].order, order);
+		}
 		if (s < 4) memset (*buf + doff + s, 0, (4 - s));
 	}
 }
@@ -175,26 +163,119 @@ void ExifMnoteDataCanon::save(unsigned char **buf, unsigned int *buf_size)
  *        return, and what is a reaction to an error condition.
  */
 
-void ExifMnoteDataCanon::load (const unsigned char *buf, unsigned int buf_size)
+/*! Pass the \c c entries starting at \c start, which are stored in
+ * byte order O, to func.
+ */
+template <ExifByteOrder O>
+int ExifMnoteDataCanon::walk_entries (const unsigned char *buf, unsigned int buf_size,
+				size_t start, ExifShort c, ExifMnoteWalkFunc func, void *user_data)
 {
-	ExifShort c;
-	size_t i, tcount, o, datao;
+	ExifBufferReader<O> r (buf, buf_size);
+	ExifMnoteRawEntry e;
+	size_t i, n, o, s, dataofs;
+
+	/* Only parse the entries that lie within the buffer */
+	n = r.contains (start, 12 * (size_t) c) ? c : r.count (start, 12);
+
+	for (i = n, o = start; i; --i, o += 12) {
+		e.tag        = r.get_short (o);
+		e.format     = static_cast<ExifFormat>(r.get_short (o + 2));
+		e.components = r.get_long (o + 4);
+		e.order      = O;
+
+		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteCanon",
+			"Loading entry 0x%x ('%s')...", e.tag,
+			 mnote_canon_tag_get_name (static_cast<MnoteCanonTag>(e.tag)));
+
+		/*
+		 * Size? If bigger than 4 bytes, the actual data is not
+		 * in the entry but somewhere else (offset).
+		 */
+		s = exif_format_get_size (e.format) * e.components;
+		if (!s) {
+			log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
+				  "ExifMnoteCanon",
+				  "Invalid zero-length tag size");
+			continue;
+		}
+		dataofs = o + 8;
+		if (s > 4) dataofs = r.get_long (dataofs) + 6;
+		if (!r.contains (dataofs, s)) {
+			log->exif_log(EXIF_LOG_CODE_DEBUG,
+				"ExifMnoteCanon",
+				"Tag data past end of buffer (%u > %u)",
+				dataofs + s, buf_size);
+			continue;
+		}
+		e.data = r.ptr (dataofs);
+		e.size = (unsigned int) s;
+		if (!func (&e, user_data))
+			return 0;
+	}
+	if (n < c)
+		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
+			  "ExifMnoteCanon", "Short MakerNote");
+	return 1;
+}
+
+/* Find the directory: its first entry and the number of entries */
+int ExifMnoteDataCanon::find_directory (const unsigned char *buf,
+				unsigned int buf_size, size_t *start, ExifShort *c)
+{
+	size_t datao;
 
 	if (!buf || !buf_size) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteCanon", "Short MakerNote");
-		return;
+		return 0;
 	}
 	datao = 6 + offset;
 	if ((datao + 2 < datao) || (datao + 2 < 2) || (datao + 2 > buf_size)) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteCanon", "Short MakerNote");
-		return;
+		return 0;
 	}
 
 	/* Read the number of tags */
-	c = exif_get_short (buf + datao, order);
-	datao += 2;
+	*c = exif_get_short (buf + datao, order);
+	*start = datao + 2;
+	return 1;
+}
+
+/* Store a walked entry as the next loaded entry */
+static int
+canon_load_entry (const ExifMnoteRawEntry *e, void *user_data)
+{
+	ExifMnoteDataCanon *n = (ExifMnoteDataCanon *) user_data;
+	MnoteCanonEntry *entry = &n->entries[n->count];
+
+	entry->mem = n->mem;
+	if (e->size) {
+		entry->data_new(e->size);
+		if (!entry->data) {
+			EXIF_LOG_NO_MEMORY_PTR(n->log, "ExifMnoteCanon", e->size);
+			return 1;
+		}
+		memcpy (entry->data, e->data, e->size);
+	}
+	entry->tag        = static_cast<MnoteCanonTag>(e->tag);
+	entry->format     = e->format;
+	entry->components = e->components;
+	entry->order      = e->order;
+	entry->size       = e->size;
+
+	/* Tag was successfully parsed */
+	n->count++;
+	return 1;
+}
+
+void ExifMnoteDataCanon::load (const unsigned char *buf, unsigned int buf_size)
+{
+	ExifShort c;
+	size_t datao;
+
+	if (!find_directory (buf, buf_size, &datao, &c))
+		return;
 
 	/* Remove any old entries */
 	exif_mnote_data_canon_clear ();
@@ -202,71 +283,48 @@ void ExifMnoteDataCanon::load (const unsigned char *buf, unsigned int buf_size)
 	/* Reserve enough space for all the possible MakerNote tags */
 	if (entries)
 	{
-		delete entries;
+		delete [] entries;
 		entries=NULL;
 	}
-	entries=new MnoteCanonEntry;
+	entries=new MnoteCanonEntry[c];
 	if (!entries) {
 		EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteCanon", sizeof (MnoteCanonEntry) * c);
 		return;
 	}
 
-	/* Parse the entries */
-	tcount = 0;
-	for (i = c, o = datao; i; --i, o += 12) {
-		size_t s;
-		if ((o + 12 < o) || (o + 12 < 12) || (o + 12 > buf_size)) {
-			log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
-				"ExifMnoteCanon", "Short MakerNote");
-			break;
-	        }
-
-		entries[tcount].tag        = static_cast<MnoteCanonTag>(exif_get_short (buf + o, order));
-		entries[tcount].format     = static_cast<ExifFormat>(exif_get_short (buf + o + 2, order));
-		entries[tcount].components = exif_get_long (buf + o + 4, order);
-		entries[tcount].order      = order;
-
-		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteCanon",
-			"Loading entry 0x%x ('%s')...", entries[tcount].tag,
-			 mnote_canon_tag_get_name (entries[tcount].tag));
+	/* Parse the entries, storing the ones that are successfully parsed */
+	count = 0;
+	if (order == EXIF_BYTE_ORDER_INTEL)
+		walk_entries<EXIF_BYTE_ORDER_INTEL> (buf, buf_size, datao, c,
+						     canon_load_entry, this);
+	else
+		walk_entries<EXIF_BYTE_ORDER_MOTOROLA> (buf, buf_size, datao, c,
+							canon_load_entry, this);
+}
 
-		/*
-		 * Size? If bigger than 4 bytes, the actual data is not
-		 * in the entry but somewhere else (offset).
-		 */
-		s = exif_format_get_size (entries[tcount].format) * 
-								  entries[tcount].components;
-		entries[tcount].size = s;
-		if (!s) {
-			log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
-				  "ExifMnoteCanon",
-				  "Invalid zero-length tag size");
-			continue;
+int ExifMnoteDataCanon::walk (const unsigned char *buf, unsigned int buf_size,
+			      ExifMnoteWalkFunc func, void *user_data)
+{
+	ExifShort c;
+	size_t datao;
+
+	if (!find_directory (buf, buf_size, &datao, &c))
+		return 1;
+	if (order == EXIF_BYTE_ORDER_INTEL)
+		return walk_entries<EXIF_BYTE_ORDER_INTEL> (buf, buf_size, datao, c,
+							    func, user_data);
+	return walk_entries<EXIF_BYTE_ORDER_MOTOROLA> (buf, buf_size, datao, c,
+						       func, user_data);
+}
 
-		} else {
-			size_t dataofs = o + 8;
-			if (s > 4) dataofs = exif_get_long (buf + dataofs, order) + 6;
-			if ((dataofs + s < s) || (dataofs + s < dataofs) || (dataofs + s > buf_size)) {
-				log->exif_log(EXIF_LOG_CODE_DEBUG,
-					"ExifMnoteCanon",
-					"Tag data past end of buffer (%u > %u)",
-					dataofs + s, buf_size);
-				continue;
-			}
-
-			entries[tcount].data_new(s);
-			if (!entries[tcount].data) {
-				EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteCanon", s);
-				continue;
-			}
-			memcpy (entries[tcount].data, buf + dataofs, s);
-		}
+ExifMnoteVendor ExifMnoteDataCanon::get_vendor ()
+{
+	return EXIF_MNOTE_VENDOR_CANON;
+}
 
-		/* Tag was successfully parsed */
-		++tcount;
-	}
-	/* Store the count of successfully parsed tags */
-	count = tcount;
+unsigned long ExifMnoteDataCanon::memory_usage ()
+{
+	return sizeof (*this) + exif_mnote_data_entries_memory (entries, count);
 }
 
 unsigned int ExifMnoteDataCanon::get_count ()
@@ -54,14 +54,24 @@ public:
 	void free();
 	void set_byte_order(ExifByteOrder o);
 	void set_offset (unsigned int o);
+	int relocate (unsigned char *buf, unsigned int buf_size, unsigned int o);
 	void save(unsigned char **buf, unsigned int *buf_size);
 	void load (const unsigned char *buf, unsigned int buf_size);
+	int walk (const unsigned char *buf, unsigned int buf_size,
+		  ExifMnoteWalkFunc func, void *user_data);
+	int find_directory (const unsigned char *buf, unsigned int buf_size,
+		size_t *start, ExifShort *c);
+	template <ExifByteOrder O> int walk_entries (const unsigned char *buf,
+		unsigned int buf_size, size_t start, ExifShort c,
+		ExifMnoteWalkFunc func, void *user_data);
 	unsigned int get_count ();
 	unsigned int get_id (unsigned int i);
 	const char * get_name (unsigned int i);
 	const char * get_title (unsigned int i);
 	const char * get_description (unsigned int i);
 	char * get_value (unsigned int n, char *val, unsigned int maxlen);
+	ExifMnoteVendor get_vendor ();
+	unsigned long memory_usage ();
 public:
 	MnoteCanonEntry *entries;
 	unsigned int count;
@@ -0,0 +1,471 @@
+/* exif-batch.cpp
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include "exif-batch.h"
+#include "exif-data-pool.h"
+#include "exif-jpeg.h"
+#include "i18n.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+# include <windows.h>
+# include <process.h>
+# include <io.h>
+#else
+# include <pthread.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include <sys/time.h>
+#endif
+
+static const struct {
+	ExifBatchResult result;
+	const char *name;
+} results[] = {
+	{ EXIF_BATCH_RESULT_OK, N_("OK") },
+	{ EXIF_BATCH_RESULT_PENDING, N_("Not run") },
+	{ EXIF_BATCH_RESULT_READ_FAILED, N_("Read failed") },
+	{ EXIF_BATCH_RESULT_EDIT_FAILED, N_("Edit failed") },
+	{ EXIF_BATCH_RESULT_SAVE_FAILED, N_("Save failed") },
+	{ EXIF_BATCH_RESULT_WRITE_FAILED, N_("Write failed") },
+	{ EXIF_BATCH_RESULT_RENAME_FAILED, N_("Rename failed") },
+	{ EXIF_BATCH_RESULT_COUNT, NULL }
+};
+
+/* System specific parts: threads, a lock, a clock and durable renames */
+#ifdef _WIN32
+
+typedef CRITICAL_SECTION BatchLock;
+typedef HANDLE BatchThread;
+
+static void lock_init (BatchLock *l) { InitializeCriticalSection (l); }
+static void lock_free (BatchLock *l) { DeleteCriticalSection (l); }
+static void lock_enter (BatchLock *l) { EnterCriticalSection (l); }
+static void lock_leave (BatchLock *l) { LeaveCriticalSection (l); }
+
+static double
+clock_now (void)
+{
+	LARGE_INTEGER f, c;
+
+	QueryPerformanceFrequency (&f);
+	QueryPerformanceCounter (&c);
+	return (double) c.QuadPart / (double) f.QuadPart;
+}
+
+static int
+file_sync (FILE *f)
+{
+	return !fflush (f) && !_commit (_fileno (f));
+}
+
+static int
+file_replace (const char *from, const char *to)
+{
+	return MoveFileExA (from, to,
+		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+/* MOVEFILE_WRITE_THROUGH has already made the rename durable */
+static int
+dir_sync (const char *)
+{
+	return 0;
+}
+
+#else
+
+typedef pthread_mutex_t BatchLock;
+typedef pthread_t BatchThread;
+
+static void lock_init (BatchLock *l) { pthread_mutex_init (l, NULL); }
+static void lock_free (BatchLock *l) { pthread_mutex_destroy (l); }
+static void lock_enter (BatchLock *l) { pthread_mutex_lock (l); }
+static void lock_leave (BatchLock *l) { pthread_mutex_unlock (l); }
+
+static double
+clock_now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int
+file_sync (FILE *f)
+{
+	return !fflush (f) && !fsync (fileno (f));
+}
+
+static int
+file_replace (const char *from, const char *to)
+{
+	return !rename (from, to);
+}
+
+static int
+dir_sync (const char *dir)
+{
+	int fd, r;
+
+	fd = open (dir, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	r = !fsync (fd);
+	close (fd);
+	return r;
+}
+
+#endif
+
+/* State shared by the workers of a run */
+typedef struct {
+	ExifBatchJob *jobs;
+	unsigned int n;
+	int sync;
+
+	BatchLock lock;
+	unsigned int next;
+	std::set<std::string> *dirs;
+} BatchRun;
+
+static std::string
+batch_dir_name (const char *path)
+{
+	const char *s = strrchr (path, '/');
+#ifdef _WIN32
+	const char *b = strrchr (path, '\\');
+
+	if (b && (!s || (b > s)))
+		s = b;
+#endif
+	if (!s)
+		return ".";
+	if (s == path)
+		return std::string (path, 1);
+	return std::string (path, s - path);
+}
+
+/* Create a temporary file with a unique name next to the file of path,
+ * which is open as src, and store its name in tmp. The file system has
+ * to be the same for the rename. */
+#ifdef _WIN32
+/* The temporary file inherits the ACL of the directory like the file
+ * did; its attributes are copied */
+static FILE *
+temp_open (const char *path, FILE *, std::string *tmp)
+{
+	char name[MAX_PATH];
+	DWORD a;
+	FILE *f;
+
+	if (!GetTempFileNameA (batch_dir_name (path).c_str (), "exf", 0, name))
+		return NULL;
+	*tmp = name;
+	a = GetFileAttributesA (path);
+	if (a != INVALID_FILE_ATTRIBUTES)
+		SetFileAttributesA (name, a & ~FILE_ATTRIBUTE_READONLY);
+	f = fopen (name, "wb");
+	if (!f)
+		remove (name);
+	return f;
+}
+#else
+/* The temporary file gets the mode of the file, and its owner and group
+ * as far as we may give it away */
+static FILE *
+temp_open (const char *path, FILE *src, std::string *tmp)
+{
+	std::string t = std::string (path) + ".XXXXXX";
+	std::vector<char> name (t.begin (), t.end ());
+	struct stat st;
+	FILE *f = NULL;
+	int fd;
+
+	name.push_back ('\0');
+	fd = mkstemp (&name[0]);
+	if (fd < 0)
+		return NULL;
+	*tmp = &name[0];
+	if (!fstat (fileno (src), &st)) {
+		if (fchown (fd, st.st_uid, st.st_gid) &&
+		    fchown (fd, (uid_t) -1, st.st_gid)) {
+			/* Only root may change the owner, and only to a
+			 * group of ours; keep what mkstemp gave us */
+		}
+		if (!fchmod (fd, st.st_mode & 07777))
+			f = fdopen (fd, "wb");
+	}
+	if (!f) {
+		close (fd);
+		remove (&name[0]);
+	}
+	return f;
+}
+#endif
+
+/* Edit the file of a job that is open as *src. The file is closed, and
+ * *src set to NULL, before it is replaced; otherwise it is left open. */
+static ExifBatchResult
+batch_edit (ExifBatchJob *job, ExifData *data, FILE **src, int sync)
+{
+	unsigned char *d = NULL, *s = NULL;
+	unsigned int ds = 0, ss = 0, i;
+	long start, end;
+	std::string tmp;
+	FILE *dst;
+	int ok;
+
+	/* Anything that is no JPEG file is refused before it is edited */
+	if (!exif_jpeg_find_app1_range_file (*src, &start, &end))
+		return EXIF_BATCH_RESULT_READ_FAILED;
+
+	/* Only the EXIF data is read; the rest is copied when writing. The
+	 * thumbnail is not copied out of it, so it is kept until saved. The
+	 * segment starts with its marker and length. */
+	data->exif_data_unset_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	data->exif_data_set_option (EXIF_DATA_OPTION_REFERENCE_THUMBNAIL);
+	if (end > start) {
+		ds = (unsigned int) (end - start - 4);
+		data->priv.mem.exif_mem_alloc (&d, ds);
+		if (!d || fseek (*src, start + 4, SEEK_SET) ||
+		    (fread (d, 1, ds, *src) != ds)) {
+			data->priv.mem.exif_mem_free (&d);
+			return EXIF_BATCH_RESULT_READ_FAILED;
+		}
+		data->exif_data_load_data (d, ds);
+	}
+
+	for (i = 0; i < job->count; i++)
+		if (!job->edits[i].func ||
+		    !job->edits[i].func (data, job->edits[i].user_data)) {
+			data->priv.mem.exif_mem_free (&d);
+			return EXIF_BATCH_RESULT_EDIT_FAILED;
+		}
+
+	data->exif_data_save_data (&s, &ss);
+	data->priv.mem.exif_mem_free (&d);
+	if (!s || (ss > 0xffff - 2)) {
+		data->priv.mem.exif_mem_free (&s);
+		return EXIF_BATCH_RESULT_SAVE_FAILED;
+	}
+
+	dst = temp_open (job->path, *src, &tmp);
+	if (!dst) {
+		data->priv.mem.exif_mem_free (&s);
+		return EXIF_BATCH_RESULT_WRITE_FAILED;
+	}
+	ok = exif_jpeg_replace_app1_file (*src, dst, s, ss) &&
+	     (!sync || file_sync (dst));
+	if (fclose (dst))
+		ok = 0;
+	data->priv.mem.exif_mem_free (&s);
+	if (!ok) {
+		remove (tmp.c_str ());
+		return EXIF_BATCH_RESULT_WRITE_FAILED;
+	}
+
+	/* The source has to be closed before it can be replaced */
+	fclose (*src);
+	*src = NULL;
+	if (!file_replace (tmp.c_str (), job->path)) {
+		remove (tmp.c_str ());
+		return EXIF_BATCH_RESULT_RENAME_FAILED;
+	}
+	return EXIF_BATCH_RESULT_OK;
+}
+
+static ExifBatchResult
+batch_run_job (ExifBatchJob *job, int sync)
+{
+	ExifData *data;
+	ExifBatchResult r;
+	FILE *src;
+
+	if (!job->path)
+		return EXIF_BATCH_RESULT_READ_FAILED;
+	src = fopen (job->path, "rb");
+	if (!src)
+		return EXIF_BATCH_RESULT_READ_FAILED;
+
+	/* The data of the last job of this thread is reused */
+	data = exif_data_pool_acquire ();
+	r = batch_edit (job, data, &src, sync);
+	exif_data_pool_release (data);
+	if (src)
+		fclose (src);
+	return r;
+}
+
+static void
+batch_worker (BatchRun *run)
+{
+	ExifBatchJob *job;
+	double t;
+
+	while (1) {
+		lock_enter (&run->lock);
+		job = (run->next < run->n) ? &run->jobs[run->next++] : NULL;
+		lock_leave (&run->lock);
+		if (!job)
+			break;
+
+		t = clock_now ();
+		job->result = batch_run_job (job, run->sync);
+		job->seconds = clock_now () - t;
+
+		if (run->sync && (job->result == EXIF_BATCH_RESULT_OK)) {
+			lock_enter (&run->lock);
+			run->dirs->insert (batch_dir_name (job->path));
+			lock_leave (&run->lock);
+		}
+	}
+}
+
+#ifdef _WIN32
+static unsigned __stdcall
+batch_thread_main (void *p)
+{
+	batch_worker ((BatchRun *) p);
+	exif_data_pool_clear ();
+	return 0;
+}
+
+static int
+thread_start (BatchThread *t, BatchRun *run)
+{
+	*t = (HANDLE) _beginthreadex (NULL, 0, batch_thread_main, run, 0, NULL);
+	return *t != 0;
+}
+
+static void
+thread_join (BatchThread t)
+{
+	WaitForSingleObject (t, INFINITE);
+	CloseHandle (t);
+}
+#else
+static void *
+batch_thread_main (void *p)
+{
+	batch_worker ((BatchRun *) p);
+	exif_data_pool_clear ();
+	return NULL;
+}
+
+static int
+thread_start (BatchThread *t, BatchRun *run)
+{
+	return !pthread_create (t, NULL, batch_thread_main, run);
+}
+
+static void
+thread_join (BatchThread t)
+{
+	pthread_join (t, NULL);
+}
+#endif
+
+/*! Run the given jobs. The calling thread works on the jobs as well,
+ * along with #threads - 1 additional threads. The result and timing of
+ * each job is stored in the job.
+ *
+ * \param[in,out] jobs jobs to run
+ * \param[in] n number of jobs
+ * \param[out] summary summary of the run, or NULL
+ * \return 1 if all jobs succeeded, 0 otherwise
+ */
+int ExifBatch::exif_batch_run (ExifBatchJob *jobs, unsigned int n,
+			       ExifBatchSummary *summary)
+{
+	std::set<std::string> dirs;
+	std::set<std::string>::const_iterator it;
+	BatchThread *t = NULL;
+	unsigned int i, started = 0, synced = 0, failed = 0;
+	BatchRun run;
+	double t0;
+
+	if (!jobs && n)
+		return 0;
+	for (i = 0; i < n; i++) {
+		jobs[i].result = EXIF_BATCH_RESULT_PENDING;
+		jobs[i].seconds = 0;
+	}
+
+	t0 = clock_now ();
+	run.jobs = jobs;
+	run.n = n;
+	run.sync = sync;
+	run.next = 0;
+	run.dirs = &dirs;
+	lock_init (&run.lock);
+
+	if ((threads > 1) && (n > 1)) {
+		t = new BatchThread[threads - 1];
+		for (started = 0; started < threads - 1; started++)
+			if (!thread_start (&t[started], &run))
+				break;
+	}
+	batch_worker (&run);
+	for (i = 0; i < started; i++)
+		thread_join (t[i]);
+	delete [] t;
+	lock_free (&run.lock);
+
+	/* Make the renames durable, once per directory */
+	for (it = dirs.begin (); it != dirs.end (); ++it)
+		if (dir_sync (it->c_str ()))
+			synced++;
+
+	for (i = 0; i < n; i++)
+		if (jobs[i].result != EXIF_BATCH_RESULT_OK)
+			failed++;
+	if (summary) {
+		memset (summary, 0, sizeof (ExifBatchSummary));
+		for (i = 0; i < n; i++)
+			summary->count[jobs[i].result]++;
+		summary->dirs_synced = synced;
+		summary->seconds = clock_now () - t0;
+	}
+	return !failed;
+}
+
+/*! Return a short textual name of the given #ExifBatchResult.
+ *
+ * \param[in] r result
+ * \return localized name of the result
+ */
+const char *exif_batch_result_get_name (ExifBatchResult r)
+{
+	unsigned int i;
+
+	for (i = 0; results[i].name; i++)
+		if (results[i].result == r)
+			break;
+	return _(results[i].name);
+}
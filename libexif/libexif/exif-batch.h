@@ -0,0 +1,119 @@
+/*! \file exif-batch.h
+ * \brief Editing the EXIF data of many JPEG files at once
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __EXIF_BATCH_H__
+#define __EXIF_BATCH_H__
+
+#include "exif-data.h"
+
+/*! Function editing the EXIF data of one file of a batch. It is called
+ * from the worker threads of #ExifBatch and must only touch the given
+ * #ExifData and data of its own.
+ *
+ * \param[in,out] data EXIF data loaded from the file
+ * \param[in] user_data data registered along with the function
+ * \return 1 on success, 0 to leave the file untouched
+ */
+typedef int (* ExifBatchEditFunc) (ExifData *data, void *user_data);
+
+/*! One edit of the edit list of a job */
+typedef struct {
+	ExifBatchEditFunc func;
+	void *user_data;
+} ExifBatchEdit;
+
+/*! Outcome of a job */
+typedef enum {
+	EXIF_BATCH_RESULT_OK = 0,
+	/*! The job has not been run */
+	EXIF_BATCH_RESULT_PENDING,
+	/*! The file could not be read or is no JPEG file */
+	EXIF_BATCH_RESULT_READ_FAILED,
+	/*! An edit has failed */
+	EXIF_BATCH_RESULT_EDIT_FAILED,
+	/*! The EXIF data could not be saved */
+	EXIF_BATCH_RESULT_SAVE_FAILED,
+	/*! The temporary file could not be written or synced */
+	EXIF_BATCH_RESULT_WRITE_FAILED,
+	/*! The temporary file could not replace the file */
+	EXIF_BATCH_RESULT_RENAME_FAILED,
+	EXIF_BATCH_RESULT_COUNT
+} ExifBatchResult;
+
+/*! A file and the edits to apply to it */
+typedef struct {
+	const char *path;
+	const ExifBatchEdit *edits;
+	unsigned int count;
+
+	/*! Set by #exif_batch_run */
+	ExifBatchResult result;
+
+	/*! Time spent on the job, in seconds. Set by #exif_batch_run */
+	double seconds;
+} ExifBatchJob;
+
+/*! Summary of a run of #exif_batch_run */
+typedef struct {
+	/*! Number of jobs per result */
+	unsigned int count[EXIF_BATCH_RESULT_COUNT];
+
+	/*! Number of directories synced after the files have been renamed */
+	unsigned int dirs_synced;
+
+	/*! Wall clock time of the run, in seconds */
+	double seconds;
+} ExifBatchSummary;
+
+/*! Applies edit lists to many JPEG files, on a pool of threads. Every
+ * file is written to a temporary file with a unique name next to it,
+ * which gets the permissions of the file, is synced and is then renamed
+ * over the file, so that a file is either edited completely or not at
+ * all. The directories are synced once each at the end of the run rather
+ * than once per file.
+ */
+class ExifBatch
+{
+public:
+	ExifBatch()
+	{
+		Init();
+	}
+
+	void inline Init()
+	{
+		threads=1;
+		sync=1;
+	}
+public:
+	int exif_batch_run (ExifBatchJob *jobs, unsigned int n,
+			    ExifBatchSummary *summary);
+public:
+	/*! Number of worker threads */
+	unsigned int threads;
+
+	/*! Whether files and directories are synced before and after the
+	 * rename */
+	int sync;
+};
+
+const char *exif_batch_result_get_name (ExifBatchResult r);
+
+#endif /* __EXIF_BATCH_H__ */
@@ -27,6 +27,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+
+typedef ExifMemberLess<ExifEntry, ExifTag, &ExifEntry::tag> EntryTagLess;
+
 /* unused constant
  * static const unsigned char ExifHeader[] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00};
  */
@@ -40,9 +44,11 @@
  */
 ExifEntry *ExifContent::exif_content_get_entry (ExifTag tag)
 {
-	for (std::vector<ExifEntry>::iterator it=entries.begin(); it != entries.end(); ++it)
-		if (it->tag == tag)
-			return &(*it);
+	std::vector<ExifEntry>::iterator it;
+
+	it = std::lower_bound (entries.begin(), entries.end(), tag, EntryTagLess ());
+	if ((it != entries.end()) && (it->tag == tag))
+		return &(*it);
 	return (NULL);
 }
 ExifContent::~ExifContent()
@@ -83,10 +89,27 @@ void ExifContent::exif_content_dump (unsigned int indent)
 	}
 }
 
+/*! Add an entry to the IFD, keeping the entries in ascending order of
+ * their tags. Entries usually come in this order already, in which case
+ * the entry is simply appended. An entry with data keeps the byte order
+ * it has, which may differ from that of the data after
+ * #exif_data_set_byte_order; an entry without data gets the byte order of
+ * the data.
+ *
+ * \param[in,out] ee entry to add; its data is moved into the IFD, and it
+ *   is left empty unless its tag is in the IFD already
+ */
 void ExifContent::exif_content_add_entry (ExifEntry &ee)
 {
+	std::vector<ExifEntry>::size_type i, n;
+
 	ee.parent=this;
 	ee.priv.mem=priv.mem;
+	/* Data is only converted when it is saved, so an entry moved from
+	 * another IFD or another #ExifData may still hold data in an older
+	 * byte order. Only an empty entry takes that of the data. */
+	if (parent && !ee.data)
+		ee.priv.order = parent->exif_data_get_byte_order ();
 	/* One tag can only be added once to an IFD. */
 	if (exif_content_get_entry (ee.tag)) {
 		priv.log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifContent",
@@ -96,58 +119,63 @@ void ExifContent::exif_content_add_entry (ExifEntry &ee)
 		return;
 	}
 
-	entries.push_back(ee);
-	
+	/* Append, then move the entry to its place without copying data */
+	n = std::lower_bound (entries.begin(), entries.end(), ee.tag,
+			      EntryTagLess ()) - entries.begin();
+	entries.push_back(ExifEntry());
+	entries.back().exif_entry_swap (ee);
+	for (i = entries.size() - 1; i > n; i--)
+		entries[i].exif_entry_swap (entries[i - 1]);
 }
 /*! Remove an EXIF tag from an IFD.
  * If this tag does not exist in the IFD, this function does nothing.
+ * The entries after it keep their order.
  *
-
  * \param[in] index indexed EXIF entry to remove
  */
 void ExifContent::exif_content_remove_entry (unsigned int index)
 {
-	unsigned int i=0;
+	unsigned int i;
 
-	if (index == entries.size()) return;
-			
+	if (index >= entries.size()) return;
 
-	/* Remove the entry */
-	if (entries.size() > 1) 
-	{
-		entries[index].exif_entry_free();
-		if (index == (entries.size()-1))
-		{
-			entries[index].exif_entry_free();
-			entries.pop_back();
-		}
-		else
-		{
-			entries[index].exif_entry_free();
-			int i=0;
-			for (std::vector<ExifEntry>::iterator it=entries.begin(); it!= entries.end(); )
-			{
-				++i;
-				++it;
-				if (i==index)
-				{
-					it->exif_entry_free();
-					entries.erase(it);
-				}
-				
-				
-			}
-			
-			
-		}
-		
-		
-		
+	/* Move the entry to the back without copying any data, then drop it */
+	for (i = index; i + 1 < entries.size(); i++)
+		entries[i].exif_entry_swap (entries[i + 1]);
+	entries.pop_back();
+}
+
+/*! Remove every entry of the IFD for which func returns nonzero.
+ * The remaining entries keep their order. This is a single pass over the
+ * IFD: each kept entry is moved at most once and no data is copied.
+ *
+ * \param[in] func predicate selecting the entries to remove
+ * \param[in] user_data data to pass into func on each call
+ * \return number of entries removed
+ */
+unsigned int ExifContent::exif_content_remove_entries_if (ExifContentRemoveEntryFunc func,
+							  void *user_data)
+{
+	std::vector<ExifEntry>::size_type i, n = 0, count;
+
+	if (!func) return 0;
+
+	for (i = 0; i < entries.size(); i++) {
+		if (func (&entries[i], user_data))
+			continue;
+		if (n != i)
+			entries[n].exif_entry_swap (entries[i]);
+		n++;
 	}
+	count = entries.size() - n;
+	if (count)
+		entries.erase (entries.begin() + n, entries.end());
+	return (unsigned int) count;
 }
 
 /*! Executes function on each EXIF tag in this IFD in turn.
- * The tags will not necessarily be visited in numerical order.
+ * The tags are visited in ascending numerical order, as the entries of
+ * an IFD are kept sorted by tag.
  *
  * \param[in,out] content IFD over which to iterate
  * \param[in] func function to call for each entry
@@ -200,32 +228,38 @@ fix_func (ExifEntry *e, void *UNUSED(data))
 	e->exif_entry_fix ();
 }
 
+typedef struct {
+	ExifIfd ifd;
+	ExifDataType dt;
+	ExifLog *log;
+} NotRecordedData;
+
+static int
+is_not_recorded (ExifEntry *e, void *data)
+{
+	NotRecordedData *d = (NotRecordedData *) data;
+
+	if (exif_tag_is_recorded_in_ifd (e->tag, d->ifd, d->dt))
+		return 0;
+	if (d->log)
+		d->log->exif_log (EXIF_LOG_CODE_DEBUG, "exif-content",
+			"Tag 0x%04x is not recorded in IFD '%s' and has "
+			"therefore been removed.", e->tag, exif_ifd_get_name (d->ifd));
+	return 1;
+}
+
 /*!
- * Check if this entry is unknown and if so, delete it.
- * \note Be careful calling this function in a loop. Deleting an entry from
- * an ExifContent changes the index of subsequent entries, as well as the
- * total size of the entries array.
+ * Remove all entries that are not recorded in this IFD, in one pass.
  */
 void ExifContent::remove_not_recorded ()
 {
-	for (std::vector<ExifEntry>::iterator it = entries.begin(); it != entries.end(); ++it)
-	{
-		ExifIfd ifd = exif_content_get_ifd();
-		ExifContent *c = it->parent;
-		ExifDataType dt = c->parent->exif_data_get_data_type ();
-		ExifTag t = it->tag;
-
-		if (exif_tag_get_support_level_in_ifd (t, ifd, dt) ==
-			EXIF_SUPPORT_LEVEL_NOT_RECORDED) {
-				c->priv.log->exif_log (EXIF_LOG_CODE_DEBUG, "exif-content",
-					"Tag 0x%04x is not recorded in IFD '%s' and has therefore been "
-					"removed.", t, exif_ifd_get_name (ifd));
-				it->exif_entry_free();
-				it=entries.erase(it);
-		}
-	}
-	
+	NotRecordedData d;
 
+	if (!parent) return;
+	d.ifd = exif_content_get_ifd ();
+	d.dt = parent->exif_data_get_data_type ();
+	d.log = priv.log;
+	exif_content_remove_entries_if (is_not_recorded, &d);
 }
 /*! Fix the IFD to bring it into specification. Call #exif_entry_fix on
  * each entry in this IFD to fix existing entries, create any new entries
@@ -238,41 +272,31 @@ void ExifContent::exif_content_fix ()
 {
 	ExifIfd ifd = exif_content_get_ifd ();
 	ExifDataType dt;
+	const ExifTag *tags;
 	unsigned int i, num;
 
 	dt = parent->exif_data_get_data_type ();
 
 	/*
-	 * First of all, fix all existing entries.
-	 */
-	exif_content_foreach_entry ();
-
-	/*
-	 * Go through each tag and if it's not recorded, remove it. If one
-	 * is removed, exif_content_foreach_entry() will skip the next entry,
-	 * so if this happens do the loop again from the beginning to ensure
-	 * they're all checked. This could be avoided if we stop relying on
-	 * exif_content_foreach_entry but loop intelligently here.
+	 * Remove every tag that is not recorded in this IFD.
 	 */
-	exif_content_foreach_entry ();
+	remove_not_recorded ();
 
 	/*
 	 * Then check for non-existing mandatory tags and create them if needed
 	 */
-	num = exif_tag_table_count();
+	tags = exif_tag_get_mandatory_in_ifd (ifd, dt, &num);
 	for (i = 0; i < num; ++i) {
-		const ExifTag t = exif_tag_table_get_tag (i);
-		if (exif_tag_get_support_level_in_ifd (t, ifd, dt) ==
-			EXIF_SUPPORT_LEVEL_MANDATORY) {
-			if (exif_content_get_entry (t))
-				/* This tag already exists */
-				continue;
-			priv.log->exif_log(EXIF_LOG_CODE_DEBUG, "exif-content",
-					"Tag '%s' is mandatory in IFD '%s' and has therefore been added.",
-					exif_tag_get_name_in_ifd (t, ifd), exif_ifd_get_name (ifd));
-			ExifEntry en;
-			exif_content_add_entry (en);
-			en.exif_entry_initialize (t);
-		}
+		const ExifTag t = tags[i];
+		if (exif_content_get_entry (t))
+			/* This tag already exists */
+			continue;
+		priv.log->exif_log(EXIF_LOG_CODE_DEBUG, "exif-content",
+				"Tag '%s' is mandatory in IFD '%s' and has therefore been added.",
+				exif_tag_get_name_in_ifd (t, ifd), exif_ifd_get_name (ifd));
+		ExifEntry en (this);
+		en.priv.mem = priv.mem;
+		en.exif_entry_initialize (t);
+		exif_content_add_entry (en);
 	}
 }
@@ -37,6 +37,14 @@ class ExifData;
 class ExifEntry;
 typedef void (* ExifContentForeachEntryFunc) (ExifEntry *, void *user_data);
 
+/*! Predicate for #ExifContent::exif_content_remove_entries_if.
+ *
+ * \param[in] e entry to test
+ * \param[in] user_data data passed to exif_content_remove_entries_if
+ * \return nonzero if the entry is to be removed
+ */
+typedef int (* ExifContentRemoveEntryFunc) (ExifEntry *e, void *user_data);
+
 class ExifContentPrivate
 {
 public:
@@ -88,10 +96,13 @@ public:
 	void exif_content_log_mem (ExifLog *log,ExifMem *mem);
 	void exif_content_foreach_entry ();
 	void exif_content_remove_entry (unsigned int index);
+	unsigned int exif_content_remove_entries_if (ExifContentRemoveEntryFunc func,
+						     void *user_data);
 	void exif_content_dump (unsigned int indent);
 	void exif_content_free ();
 	void remove_not_recorded ();
 public:
+	/*! Entries of the IFD, in ascending order of their tags */
     std::vector<ExifEntry> entries;
 
 	/*! Data containing this content */
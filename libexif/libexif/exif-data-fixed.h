@@ -0,0 +1,235 @@
+/*! \file exif-data-fixed.h
+ * \brief EXIF data loaded into storage of a fixed size, without the heap
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __EXIF_DATA_FIXED_H__
+#define __EXIF_DATA_FIXED_H__
+
+#include "exif-data.h"
+#include "exif-entry.h"
+#include "exif-ifd.h"
+#include "exif-parser.h"
+#include "exif-tag.h"
+#include "exif-utils.h"
+
+#include <string.h>
+
+/*! Outcome of #exif_data_fixed_load */
+typedef enum {
+	/*! All entries have been stored */
+	EXIF_DATA_FIXED_RESULT_OK = 0,
+	/*! No valid EXIF data has been found */
+	EXIF_DATA_FIXED_RESULT_NO_DATA,
+	/*! There are more entries than MaxEntries */
+	EXIF_DATA_FIXED_RESULT_TOO_MANY_ENTRIES,
+	/*! The values and the thumbnail take more than MaxBytes */
+	EXIF_DATA_FIXED_RESULT_TOO_MANY_BYTES
+} ExifDataFixedResult;
+
+/*! EXIF data loaded into storage that is part of the object: at most
+ * MaxEntries entries, whose values and the thumbnail take at most
+ * MaxBytes bytes. Loading never allocates; data that does not fit is
+ * reported as an error. The object can be static or on the stack, but
+ * it cannot be copied, as its entries point into its own storage.
+ *
+ * The directories are walked by #ExifParser, so the same entries are
+ * loaded as by #exif_data_load_data, each tag once per IFD. The
+ * MakerNote is kept as the value of its entry and is not interpreted,
+ * and the entries are not fixed to follow the specification.
+ */
+template <unsigned int MaxEntries, unsigned int MaxBytes>
+class ExifDataFixed
+{
+public:
+	ExifDataFixed()
+	{
+		Init();
+		options=EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS;
+	}
+
+	void inline Init()
+	{
+		for (unsigned int i = 0; i < EXIF_IFD_COUNT; i++)
+			count[i]=0;
+		n_entries=0;
+		n_bytes=0;
+		order=EXIF_BYTE_ORDER_MOTOROLA;
+		thumbnail=NULL;
+		thumbnail_size=0;
+		result=EXIF_DATA_FIXED_RESULT_OK;
+	}
+public:
+	/*! Load the EXIF data in the given buffer, replacing what has been
+	 * loaded before. The values are copied, so the buffer is not needed
+	 * afterwards. If the storage is too small, the entries that fit are
+	 * kept.
+	 *
+	 * \param[in] d JPEG data starting with the SOI marker, or EXIF data
+	 *   starting with the "Exif\0\0" header
+	 * \param[in] ds number of bytes at d
+	 * \return #EXIF_DATA_FIXED_RESULT_OK if all entries have been stored
+	 */
+	ExifDataFixedResult exif_data_fixed_load (const unsigned char *d,
+						  unsigned int ds)
+	{
+		ExifParser p;
+		const unsigned char *t;
+		unsigned int ts;
+
+		Init ();
+		p.callbacks.on_entry = add_entry;
+		p.user_data = this;
+		if (p.exif_parser_parse (d, ds) == EXIF_PARSER_RESULT_NO_DATA) {
+			Init ();
+			return result = EXIF_DATA_FIXED_RESULT_NO_DATA;
+		}
+		order = p.order;
+		if (result != EXIF_DATA_FIXED_RESULT_OK)
+			return result;
+
+		if (!(options & EXIF_DATA_OPTION_SKIP_THUMBNAIL) &&
+		    ((t = p.exif_parser_get_thumbnail (&ts)) != NULL)) {
+			if (ts > MaxBytes - n_bytes)
+				return result = EXIF_DATA_FIXED_RESULT_TOO_MANY_BYTES;
+			memcpy (bytes + n_bytes, t, ts);
+			thumbnail = bytes + n_bytes;
+			thumbnail_size = ts;
+			n_bytes += ts;
+		}
+		return result;
+	}
+
+	/*! Return the number of entries of an IFD.
+	 *
+	 * \param[in] ifd IFD
+	 * \return number of entries, 0 if ifd is invalid
+	 */
+	unsigned int exif_data_fixed_count (ExifIfd ifd) const
+	{
+		if ((ifd < EXIF_IFD_0) || (ifd >= EXIF_IFD_COUNT))
+			return 0;
+		return count[ifd];
+	}
+
+	/*! Return the entry of an IFD with the given tag.
+	 *
+	 * \param[in] ifd IFD
+	 * \param[in] tag tag to look up
+	 * \return the entry, or NULL if the IFD has no such tag
+	 */
+	const ExifParserEntry *exif_data_fixed_get_entry (ExifIfd ifd,
+							  ExifTag tag) const
+	{
+		unsigned int i;
+
+		for (i = 0; i < n_entries; i++)
+			if ((ifds[i] == ifd) && (entries[i].tag == tag))
+				return &entries[i];
+		return NULL;
+	}
+
+	/*! Return the entry with the given tag from any IFD, searching them
+	 * in the same order as #exif_data_get_entry.
+	 *
+	 * \param[in] tag tag to look up
+	 * \param[out] ifd IFD of the entry, or NULL
+	 * \return the entry, or NULL if there is none
+	 */
+	const ExifParserEntry *exif_data_fixed_find (ExifTag tag, ExifIfd *ifd) const
+	{
+		return exif_parser_find_entry (this,
+			&ExifDataFixed::exif_data_fixed_get_entry, tag, ifd);
+	}
+
+	/*! Return a view of all components of an entry, which must be in
+	 * format F.
+	 *
+	 * \param[in] e entry of this data
+	 * \param[out] span view of the components
+	 * \return #EXIF_ENTRY_VALUE_OK on success
+	 */
+	template <ExifFormat F> ExifEntryValueResult exif_data_fixed_get_span (
+		const ExifParserEntry *e, ExifEntrySpan<F> *span) const
+	{
+		return exif_parser_entry_get_span (e, order, span);
+	}
+private:
+	/* The entries point into bytes */
+	ExifDataFixed (const ExifDataFixed &);
+	ExifDataFixed &operator= (const ExifDataFixed &);
+
+	static int add_entry (ExifIfd ifd, const ExifParserEntry *e, void *user_data)
+	{
+		ExifDataFixed *f = (ExifDataFixed *) user_data;
+
+		if ((f->options & EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS) &&
+		    !exif_tag_get_name_in_ifd (e->tag, ifd))
+			return 1;
+
+		/* One tag can only be added once to an IFD */
+		if (f->exif_data_fixed_get_entry (ifd, e->tag))
+			return 1;
+
+		if (f->n_entries == MaxEntries) {
+			f->result = EXIF_DATA_FIXED_RESULT_TOO_MANY_ENTRIES;
+			return 0;
+		}
+		if (e->size > MaxBytes - f->n_bytes) {
+			f->result = EXIF_DATA_FIXED_RESULT_TOO_MANY_BYTES;
+			return 0;
+		}
+		memcpy (f->bytes + f->n_bytes, e->data, e->size);
+		f->entries[f->n_entries] = *e;
+		f->entries[f->n_entries].data = f->bytes + f->n_bytes;
+		f->ifds[f->n_entries++] = ifd;
+		f->n_bytes += e->size;
+		f->count[ifd]++;
+		return 1;
+	}
+public:
+	/*! Entries in the order they have been found, and their IFDs. The
+	 * values point into bytes and are in the byte order of the data. */
+	ExifParserEntry entries[MaxEntries];
+	ExifIfd ifds[MaxEntries];
+	unsigned int n_entries;
+
+	/*! Storage of the values and the thumbnail */
+	unsigned char bytes[MaxBytes];
+	unsigned int n_bytes;
+
+	/*! Number of entries per IFD */
+	unsigned int count[EXIF_IFD_COUNT];
+
+	/*! Byte order of the loaded data */
+	ExifByteOrder order;
+
+	/*! The thumbnail in bytes, or NULL if there is none */
+	const unsigned char *thumbnail;
+	unsigned int thumbnail_size;
+
+	/*! Options of #ExifData that apply to loading:
+	 * #EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS (the default) and
+	 * #EXIF_DATA_OPTION_SKIP_THUMBNAIL */
+	ExifDataOption options;
+
+	/*! Outcome of the last load */
+	ExifDataFixedResult result;
+};
+
+#endif /* __EXIF_DATA_FIXED_H__ */
@@ -0,0 +1,77 @@
+/* exif-data-pool.cpp
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include "exif-data-pool.h"
+#include "exif-system.h"
+
+#ifndef EXIF_NO_THREAD_LOCAL
+/* Released data of this thread; the last one released is used first */
+static EXIF_THREAD_LOCAL ExifData *pool[EXIF_DATA_POOL_SIZE];
+static EXIF_THREAD_LOCAL unsigned int pool_count;
+#endif
+
+/*! Return data to load into, as left by #exif_data_new: from the pool
+ * of this thread if it has any, else newly created.
+ *
+ * \return data, to be given back with #exif_data_pool_release
+ */
+ExifData *exif_data_pool_acquire ()
+{
+	ExifData *data;
+
+#ifndef EXIF_NO_THREAD_LOCAL
+	if (pool_count)
+		return pool[--pool_count];
+#endif
+	data = new ExifData;
+	data->exif_data_new ();
+	return data;
+}
+
+/*! Give back data of #exif_data_pool_acquire on the thread that
+ * acquired it. The data is reset, without its load filter, and kept in
+ * the pool of this thread, or deleted if the pool is full.
+ *
+ * \param[in] data data to give back; it must not be used any more
+ */
+void exif_data_pool_release (ExifData *data)
+{
+	if (!data)
+		return;
+#ifndef EXIF_NO_THREAD_LOCAL
+	if (pool_count < EXIF_DATA_POOL_SIZE) {
+		data->exif_data_reset ();
+		data->exif_data_set_load_filter (NULL, NULL);
+		pool[pool_count++] = data;
+		return;
+	}
+#endif
+	delete data;
+}
+
+/*! Delete the data in the pool of this thread, along with the memory
+ * it holds. */
+void exif_data_pool_clear ()
+{
+#ifndef EXIF_NO_THREAD_LOCAL
+	while (pool_count)
+		delete pool[--pool_count];
+#endif
+}
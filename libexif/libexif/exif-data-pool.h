@@ -0,0 +1,44 @@
+/*! \file exif-data-pool.h
+ * \brief Reusing #ExifData objects on the thread that loads them
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __EXIF_DATA_POOL_H__
+#define __EXIF_DATA_POOL_H__
+
+#include "exif-data.h"
+
+/*! Number of released #ExifData each thread keeps */
+#define EXIF_DATA_POOL_SIZE 4
+
+/*! Each thread has its own pool of released #ExifData, which have been
+ * reset with #exif_data_reset and still hold the memory of their last
+ * load, but no load filter. A thread that loads data over and over
+ * allocates nothing once its pool holds data of the same shape. No
+ * locking is needed, but data must be released on the thread that
+ * acquired it, and each thread that has released data must clear its
+ * pool before it ends.
+ *
+ * Where the compiler has no thread-local storage, nothing is pooled:
+ * data is created on acquire and deleted on release.
+ */
+ExifData *exif_data_pool_acquire ();
+void exif_data_pool_release (ExifData *data);
+void exif_data_pool_clear ();
+
+#endif /* __EXIF_DATA_POOL_H__ */
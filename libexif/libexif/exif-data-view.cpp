@@ -0,0 +1,251 @@
+/* exif-data-view.cpp
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include "exif-data-view.h"
+#include "exif-content.h"
+
+#include <string.h>
+#include <algorithm>
+
+static bool
+view_entry_less (const ExifDataViewEntry &a, const ExifDataViewEntry &b)
+{
+	return a.tag < b.tag;
+}
+
+static bool
+view_entry_same (const ExifDataViewEntry &a, const ExifDataViewEntry &b)
+{
+	return a.tag == b.tag;
+}
+
+typedef ExifMemberLess<ExifDataViewEntry, ExifTag, &ExifDataViewEntry::tag>
+	ViewEntryTagLess;
+
+static int
+view_add_entry (ExifIfd ifd, const ExifParserEntry *e, void *user_data)
+{
+	((ExifDataView *) user_data)->entries[ifd].push_back (*e);
+	return 1;
+}
+
+/*! Index the EXIF data in the given buffer, which is not copied. Any
+ * previous index is dropped.
+ *
+ * \param[in] d JPEG data starting with the SOI marker, or EXIF data
+ *   starting with the "Exif\0\0" header
+ * \param[in] ds number of bytes at d
+ * \return 1 on success, 0 if no valid EXIF data has been found
+ */
+int ExifDataView::exif_data_view_load (const unsigned char *d, unsigned int ds)
+{
+	ExifParser p;
+	unsigned int i;
+
+	Init ();
+	p.callbacks.on_entry = view_add_entry;
+	p.user_data = this;
+	if (p.exif_parser_parse (d, ds) != EXIF_PARSER_RESULT_OK) {
+		Init ();
+		return 0;
+	}
+	order = p.order;
+	priv.header = p.priv.header;
+	priv.header_size = p.priv.header_size;
+	priv.offset_tiff = p.priv.offset_tiff;
+	priv.tiff_size = p.priv.tiff_size;
+	priv.thumbnail_offset = p.priv.thumbnail_offset;
+	priv.thumbnail_size = p.priv.thumbnail_size;
+
+	/* Sort by tag, keeping the first entry of each tag like
+	 * exif_content_add_entry does */
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		std::stable_sort (entries[i].begin (), entries[i].end (),
+				  view_entry_less);
+		entries[i].erase (std::unique (entries[i].begin (), entries[i].end (),
+					       view_entry_same), entries[i].end ());
+	}
+	return 1;
+}
+
+/*! Return the number of entries of an IFD.
+ *
+ * \param[in] ifd IFD
+ * \return number of entries, 0 if ifd is invalid
+ */
+unsigned int ExifDataView::exif_data_view_count (ExifIfd ifd) const
+{
+	if ((ifd < EXIF_IFD_0) || (ifd >= EXIF_IFD_COUNT))
+		return 0;
+	return (unsigned int) entries[ifd].size ();
+}
+
+/*! Return an entry of an IFD by its position.
+ *
+ * \param[in] ifd IFD
+ * \param[in] i position of the entry, less than #exif_data_view_count
+ * \return the entry, or NULL if there is none
+ */
+const ExifDataViewEntry *ExifDataView::exif_data_view_get (ExifIfd ifd,
+							   unsigned int i) const
+{
+	if (i >= exif_data_view_count (ifd))
+		return NULL;
+	return &entries[ifd][i];
+}
+
+/*! Return the entry of an IFD with the given tag.
+ *
+ * \param[in] ifd IFD
+ * \param[in] tag tag to look up
+ * \return the entry, or NULL if the IFD has no such tag
+ */
+const ExifDataViewEntry *ExifDataView::exif_data_view_get_entry (ExifIfd ifd,
+								 ExifTag tag) const
+{
+	std::vector<ExifDataViewEntry>::const_iterator it;
+
+	if ((ifd < EXIF_IFD_0) || (ifd >= EXIF_IFD_COUNT))
+		return NULL;
+	it = std::lower_bound (entries[ifd].begin (), entries[ifd].end (), tag,
+			       ViewEntryTagLess ());
+	if ((it == entries[ifd].end ()) || (it->tag != tag))
+		return NULL;
+	return &*it;
+}
+
+/*! Return the entry with the given tag from any IFD, searching them in
+ * the same order as #exif_data_get_entry.
+ *
+ * \param[in] tag tag to look up
+ * \param[out] ifd IFD of the entry, or NULL
+ * \return the entry, or NULL if there is none
+ */
+const ExifDataViewEntry *ExifDataView::exif_data_view_find (ExifTag tag,
+							    ExifIfd *ifd) const
+{
+	return exif_parser_find_entry (this, &ExifDataView::exif_data_view_get_entry,
+				       tag, ifd);
+}
+
+/*! Return the byte order of the viewed data.
+ *
+ * \return byte order of the values of the entries
+ */
+ExifByteOrder ExifDataView::exif_data_view_get_byte_order () const
+{
+	return order;
+}
+
+/*! Return the thumbnail in the viewed buffer.
+ *
+ * \param[out] ds number of bytes of the thumbnail, or NULL
+ * \return the thumbnail, or NULL if there is none
+ */
+const unsigned char *ExifDataView::exif_data_view_get_thumbnail (unsigned int *ds) const
+{
+	if (ds)
+		*ds = priv.thumbnail_size;
+	if (!priv.thumbnail_size)
+		return NULL;
+	return priv.header + sizeof (ExifParserHeader) + priv.thumbnail_offset;
+}
+
+/*! Fill an #ExifData from the view, as if the viewed buffer had been
+ * loaded with #exif_data_load_data, without reading the directories
+ * again. The values are copied; the thumbnail is copied or referenced
+ * according to the options of the data, and the MakerNote is
+ * interpreted from the viewed buffer.
+ *
+ * \param[in,out] data data created with #exif_data_new; its entries,
+ *   thumbnail and MakerNote are replaced, and only its options and data
+ *   type are kept. An empty view leaves it empty.
+ * \return 1 on success, 0 if data is invalid
+ */
+int ExifDataView::exif_data_view_materialize (ExifData *data) const
+{
+	const ExifDataViewEntry *v;
+	ExifContent *c;
+	unsigned int i, j, k, n;
+	ExifDataOption options;
+	ExifDataType dt;
+
+	if (!data)
+		return 0;
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		if (!data->ifd[i])
+			return 0;
+
+	/* Nothing of what the data held before is kept, but its values are
+	 * reused for the new ones */
+	options = data->priv.options;
+	dt = data->priv.data_type;
+	data->exif_data_reset ();
+	data->priv.options = options;
+	data->priv.data_type = dt;
+	if (!priv.header)
+		return 1;
+	data->priv.order = order;
+	data->priv.offset_tiff = priv.offset_tiff;
+
+	/* The entries are sorted already, so each IFD is filled at once */
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		c = data->ifd[i];
+		for (j = 0, n = 0; j < entries[i].size (); j++)
+			if (!(data->priv.options & EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS) ||
+			    exif_tag_get_name_in_ifd (entries[i][j].tag, (ExifIfd) i))
+				n++;
+		c->entries.clear ();
+		c->entries.resize (n);
+		for (j = 0, k = 0; k < n; j++) {
+			v = &entries[i][j];
+			if ((data->priv.options & EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS) &&
+			    !exif_tag_get_name_in_ifd (v->tag, (ExifIfd) i))
+				continue;
+			ExifEntry &e = c->entries[k++];
+			e.parent = c;
+			e.priv.mem = c->priv.mem;
+			e.priv.dirty = 0;
+			e.priv.offset = v->offset;
+			e.priv.length = v->size;
+			e.priv.order = order;
+			e.tag = v->tag;
+			e.format = v->format;
+			e.components = v->components;
+			e.data = data->priv.exif_data_alloc (v->size);
+			if (e.data) {
+				e.size = v->size;
+				memcpy (e.data, v->data, v->size);
+			}
+		}
+	}
+
+	if (priv.thumbnail_size)
+		data->exif_data_load_data_thumbnail (priv.header + sizeof (ExifParserHeader),
+			priv.tiff_size, priv.thumbnail_offset, priv.thumbnail_size);
+
+	if ((v = exif_data_view_find (EXIF_TAG_MAKER_NOTE, NULL)) != NULL)
+		data->priv.offset_mnote = v->offset;
+	data->interpret_maker_note (priv.header, priv.header_size);
+
+	if (data->priv.options & EXIF_DATA_OPTION_FOLLOW_SPECIFICATION)
+		data->exif_data_fix ();
+	return 1;
+}
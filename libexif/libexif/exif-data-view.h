@@ -0,0 +1,129 @@
+/*! \file exif-data-view.h
+ * \brief Read-only access to EXIF data without copying it
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __EXIF_DATA_VIEW_H__
+#define __EXIF_DATA_VIEW_H__
+
+#include "exif-data.h"
+#include "exif-entry.h"
+#include "exif-ifd.h"
+#include "exif-parser.h"
+#include "exif-tag.h"
+#include "exif-utils.h"
+
+#include <vector>
+
+/*! One entry of an #ExifDataView. The value is not copied; it points
+ * into the buffer the view has been loaded from. */
+typedef ExifParserEntry ExifDataViewEntry;
+
+class ExifDataViewPrivate
+{
+public:
+	ExifDataViewPrivate()
+	{
+		Init();
+	}
+
+	void inline Init()
+	{
+		header=NULL;
+		header_size=0;
+		offset_tiff=0;
+		tiff_size=0;
+		thumbnail_offset=0;
+		thumbnail_size=0;
+	}
+public:
+	/* The "Exif\0\0" header in the viewed buffer, and the number of
+	 * bytes from there on */
+	const unsigned char *header;
+	unsigned int header_size;
+
+	/* Offset of the TIFF header in the buffer */
+	unsigned int offset_tiff;
+
+	/* Number of bytes of the TIFF data that the directories may
+	 * refer to, following the 64 KiB limit of the loader */
+	unsigned int tiff_size;
+
+	/* The thumbnail, relative to the TIFF header; 0 if there is none */
+	unsigned int thumbnail_offset;
+	unsigned int thumbnail_size;
+};
+
+/*! Index of the directories of EXIF data in a buffer owned by the
+ * caller, for example a mapped file. Loading reads the directories once
+ * and records where each value is; nothing is copied, so the buffer has
+ * to stay valid and unchanged as long as the view is used.
+ *
+ * A loaded view is never changed by any of its const functions, so it
+ * can be shared by any number of threads without locking. The entries
+ * of each IFD are sorted by tag; a tag is kept only once per IFD, and
+ * the same entries are skipped as by #exif_data_load_data.
+ */
+class ExifDataView
+{
+public:
+	ExifDataView()
+	{
+		Init();
+	}
+
+	void inline Init()
+	{
+		for (unsigned int i = 0; i < EXIF_IFD_COUNT; i++)
+			entries[i].clear();
+		order=EXIF_BYTE_ORDER_MOTOROLA;
+		priv.Init();
+	}
+public:
+	int exif_data_view_load (const unsigned char *d, unsigned int ds);
+	unsigned int exif_data_view_count (ExifIfd ifd) const;
+	const ExifDataViewEntry *exif_data_view_get (ExifIfd ifd, unsigned int i) const;
+	const ExifDataViewEntry *exif_data_view_get_entry (ExifIfd ifd, ExifTag tag) const;
+	const ExifDataViewEntry *exif_data_view_find (ExifTag tag, ExifIfd *ifd) const;
+	ExifByteOrder exif_data_view_get_byte_order () const;
+	const unsigned char *exif_data_view_get_thumbnail (unsigned int *ds) const;
+	int exif_data_view_materialize (ExifData *data) const;
+
+	/*! Return a view of all components of an entry of this view, which
+	 * must be in format F.
+	 *
+	 * \param[in] e entry of this view
+	 * \param[out] span view of the components
+	 * \return #EXIF_ENTRY_VALUE_OK on success
+	 */
+	template <ExifFormat F> ExifEntryValueResult exif_data_view_get_span (
+		const ExifDataViewEntry *e, ExifEntrySpan<F> *span) const
+	{
+		return exif_parser_entry_get_span (e, order, span);
+	}
+public:
+	/*! Entries of each IFD, sorted by tag */
+	std::vector<ExifDataViewEntry> entries[EXIF_IFD_COUNT];
+
+	/*! Byte order of the viewed data */
+	ExifByteOrder order;
+
+	ExifDataViewPrivate priv;
+};
+
+#endif /* __EXIF_DATA_VIEW_H__ */
@@ -23,9 +23,11 @@
 #include "exif-mnote-data.h"
 #include "exif-data.h"
 #include "exif-ifd.h"
+#include "exif-jpeg.h"
 #include "exif-utils.h"
 #include "exif-loader.h"
 #include "exif-log.h"
+#include "exif-parser.h"
 #include "i18n.h"
 #include "exif-system.h"
 
@@ -47,6 +49,9 @@
 
 static const unsigned char ExifHeader[] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00};
 
+/* Padding between chunks saved by exif_data_save_data_chunks */
+static const unsigned char ExifPadding[] = {0x00};
+
 
 ExifData::ExifData()
 {
@@ -80,6 +85,46 @@ void ExifData::Init()
 }
 
 
+/* Free the thumbnail, or drop the reference to it */
+static void
+thumbnail_free (ExifData *ed)
+{
+	ed->priv.mem.exif_mem_free (&ed->data);
+	ed->size=0;
+	ed->priv.thumbnail=NULL;
+	ed->priv.thumbnail_size=0;
+}
+
+/* The thumbnail to save: the copy in ExifData::data, or the reference */
+static unsigned int
+thumbnail_get (ExifData *ed, const unsigned char **t)
+{
+	if (ed->data) {
+		*t = ed->data;
+		return ed->size;
+	}
+	*t = ed->priv.thumbnail;
+	return ed->priv.thumbnail_size;
+}
+
+/* Options and data type of a new #ExifData */
+static void
+set_defaults (ExifData *ed)
+{
+	/* Default options */
+#ifndef NO_VERBOSE_TAG_STRINGS
+	/*
+	 * When the tag list is compiled away, setting this option prevents
+	 * any tags from being loaded
+	 */
+	ed->exif_data_set_option (EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS);
+#endif
+	ed->exif_data_set_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+
+	/* Default data type: none */
+	ed->exif_data_set_data_type (EXIF_DATA_TYPE_COUNT);
+}
+
 void ExifData::exif_data_free()
 {
 	unsigned int i=0;
@@ -93,13 +138,9 @@ void ExifData::exif_data_free()
 		}
 	}
 
-	if (data) {
-		size>1?delete [] data:delete data;
-		data=NULL;
-		size=0;
-	}
+	thumbnail_free (this);
 	priv.data_free();
-	
+	priv.mem.exif_mem_free_kept ();
 }
 
 /*! Allocate a new #ExifData. The #ExifData contains an empty
@@ -127,20 +168,48 @@ void ExifData::exif_data_new (void)
 		ifd[i]->exif_content_log_mem(&priv.log, &priv.mem);
 	}
 
-	/* Default options */
-#ifndef NO_VERBOSE_TAG_STRINGS
-	/*
-	 * When the tag list is compiled away, setting this option prevents
-	 * any tags from being loaded
-	 */
-	exif_data_set_option (EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS);
-#endif
-	exif_data_set_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	set_defaults (this);
+	return ;
+}
 
-	/* Default data type: none */
-	exif_data_set_data_type (EXIF_DATA_TYPE_COUNT);
+/*! Empty the data for the next load, leaving it as #exif_data_new
+ * does, but keeping the memory it has: the entry lists keep their
+ * capacity, and the values and the thumbnail are kept by #ExifMem to be
+ * handed out again. Loading data of the same shape again then allocates
+ * nothing, apart from the MakerNote. What is kept is freed by the next
+ * reset, so the kept memory never exceeds one load. The load filter is
+ * kept as well.
+ */
+void ExifData::exif_data_reset ()
+{
+	ExifDataLoadFilter filter = priv.filter;
+	void *filter_data = priv.filter_data;
+	unsigned int i;
 
-	return ;
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		if (!ifd[i]) {
+			exif_data_new ();
+			return;
+		}
+
+	priv.mem.exif_mem_free_kept ();
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		std::vector<ExifEntry> &entries = ifd[i]->entries;
+		for (std::vector<ExifEntry>::iterator it = entries.begin ();
+		     it != entries.end (); ++it) {
+			priv.mem.exif_mem_keep_buffer (&it->data, it->size);
+			it->size = 0;
+		}
+		entries.clear ();
+	}
+	priv.mem.exif_mem_keep_buffer (&data, size);
+	thumbnail_free (this);
+	priv.data_free ();
+
+	priv.Init ();
+	priv.filter = filter;
+	priv.filter_data = filter_data;
+	set_defaults (this);
 }
 
 /*! Set the given option on the given #ExifData.
@@ -204,7 +273,7 @@ unsigned char *ExifDataPrivate::exif_data_alloc (unsigned int i)
 	if (!i)
 		return NULL;
 
-	mem.exif_mem_alloc (&d, i/sizeof(unsigned char));
+	d = mem.exif_mem_alloc_buffer (i);
 	if (d) 
 		return d;
 
@@ -224,71 +293,21 @@ void ExifDataPrivate::exif_data_set_option(ExifDataOption Typex)
 	options =static_cast<ExifDataOption> (options | Typex);
 }
 
-int ExifDataPrivate::exif_data_load_data_entry (ExifEntry *entry,
-			   const unsigned char *d,
-			   unsigned int size, unsigned int offset)
+/* While saving with exif_data_save_data_chunks, leave a value of at
+ * least defer_min bytes out of the saved data and reference it instead.
+ * The offset field at \c field is set once the position of the value is
+ * known. Returns 1 if the value has been deferred. */
+int ExifDataPrivate::exif_data_defer_value (unsigned int field,
+			   const unsigned char *data, unsigned int size)
 {
-	unsigned int s, doff;
-
-	entry->tag        = static_cast<ExifTag>(exif_get_short (d + offset + 0, order));
-	entry->format     = static_cast<ExifFormat>(exif_get_short (d + offset + 2, order));
-	entry->components = exif_get_long  (d + offset + 4, order);
-
-	/* FIXME: should use exif_tag_get_name_in_ifd here but entry->parent 
-	 * has not been set yet
-	 */
-	log.exif_log ( EXIF_LOG_CODE_DEBUG, "ExifData",
-		  "Loading entry 0x%x ('%s')...", entry->tag,
-		  exif_tag_get_name (entry->tag));
-
-	/* {0,1,2,4,8} x { 0x00000000 .. 0xffffffff } 
-	 *   -> { 0x000000000 .. 0x7fffffff8 } */
-	s = exif_format_get_size(entry->format) * entry->components;
-	if ((s < entry->components) || (s == 0)){
-		return 0;
-	}
-
-	/*
-	 * Size? If bigger than 4 bytes, the actual data is not
-	 * in the entry but somewhere else (offset).
-	 */
-	if (s > 4)
-		doff = exif_get_long (d + offset + 8, order);
-	else
-		doff = offset + 8;
+	ExifDataChunk c;
 
-	/* Sanity checks */
-	if ((doff + s < doff) || (doff + s < s) || (doff + s > size)) {
-		log.exif_log ( EXIF_LOG_CODE_DEBUG, "ExifData",
-				  "Tag data past end of buffer (%u > %u)", doff+s, size);	
+	if (!deferred || (size < defer_min))
 		return 0;
-	}
-	entry->exif_entry_free();
-	entry->data =exif_data_alloc (s);
-	if (entry->data) {
-		entry->size = s;
-		memcpy (entry->data, d + doff, s);
-	} else {
-		/* FIXME: What do our callers do if (entry->data == NULL)? */
-		EXIF_LOG_NO_MEMORY(log, "ExifData", s);
-	}
-
-	/* If this is the MakerNote, remember the offset */
-	if (entry->tag == EXIF_TAG_MAKER_NOTE) {
-		if (!entry->data) {
-			log.exif_log ( EXIF_LOG_CODE_DEBUG, "ExifData",
-					  "MakerNote found with empty data");	
-		} else if (entry->size > 6) {
-			log.exif_log (
-					       EXIF_LOG_CODE_DEBUG, "ExifData",
-					       "MakerNote found (%02x %02x %02x %02x "
-					       "%02x %02x %02x...).",
-					       entry->data[0], entry->data[1], entry->data[2],
-					       entry->data[3], entry->data[4], entry->data[5],
-					       entry->data[6]);
-		}
-		offset_mnote = doff;
-	}
+	c.data = data;
+	c.size = size;
+	deferred->push_back (c);
+	deferred_fields.push_back (field);
 	return 1;
 }
 
@@ -312,11 +331,18 @@ void ExifDataPrivate::exif_data_save_data_entry (ExifEntry *e,
 	if (!(options & EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE)) {
 		/* If this is the maker note tag, update it. */
 		if ((e->tag == EXIF_TAG_MAKER_NOTE) && md) {
-			/* TODO: this is using the wrong ExifMem to free e->data */
-			e->size = 0;
-			md->exif_mnote_data_set_offset (*ds - 6);
-			md->exif_mnote_data_save (&e->data, &e->size);
-			e->components = e->size;
+			if (!e->priv.dirty &&
+			    md->exif_mnote_data_relocate (e->data, e->size, *ds - 6)) {
+				/* Unchanged: keep the raw MakerNote */
+				log.exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+					"Saving MakerNote as loaded.");
+				md->exif_mnote_data_set_offset (*ds - 6);
+			} else {
+				e->size = 0;
+				md->exif_mnote_data_set_offset (*ds - 6);
+				md->exif_mnote_data_save (&e->data, &e->size);
+				e->components = e->size;
+			}
 		}
 	}
 
@@ -327,6 +353,18 @@ void ExifDataPrivate::exif_data_save_data_entry (ExifEntry *e,
 	 * the entry but somewhere else.
 	 */
 	s = exif_format_get_size (e->format) * e->components;
+
+	/* Values keep their byte order until they are saved */
+	if (e->priv.order != order) {
+		if (e->data && (e->size >= s))
+			exif_array_set_byte_order (e->format, e->data, e->components,
+						   e->priv.order, order);
+		e->priv.order = order;
+	}
+
+	if ((s > 4) && (e->tag != EXIF_TAG_MAKER_NOTE) && e->data &&
+	    exif_data_defer_value (offset + 8, e->data, s))
+		return;
 	if (s > 4) {
 		unsigned char *t;
 		doff = *ds - 6;
@@ -339,7 +377,7 @@ void ExifDataPrivate::exif_data_save_data_entry (ExifEntry *e,
 		 */
 		if (s & 1)
 			ts++;
-		t =mem.exif_mem_realloc (d, ts);
+		t =mem.exif_mem_realloc (d, *ds, ts);
 		if (!t) {
 			EXIF_LOG_NO_MEMORY (log, "ExifData", ts);
 		  	return;
@@ -368,6 +406,11 @@ void
 ExifData::exif_data_load_data_thumbnail (const unsigned char *d,
 			       unsigned int ds, ExifLong o, ExifLong s)
 {
+	if (priv.options & EXIF_DATA_OPTION_SKIP_THUMBNAIL) {
+		priv.thumbnail_skipped = 1;
+		return;
+	}
+
 	/* Sanity checks */
 	if ((o + s < o) || (o + s < s) || (o + s > ds) || (o > ds)) {
 		priv.log.exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
@@ -376,9 +419,11 @@ ExifData::exif_data_load_data_thumbnail (const unsigned char *d,
 		return;
 	}
 
-	if (data)
-	{
-		priv.data_free();
+	thumbnail_free (this);
+	if (priv.options & EXIF_DATA_OPTION_REFERENCE_THUMBNAIL) {
+		priv.thumbnail = d + o;
+		priv.thumbnail_size = s;
+		return;
 	}
 	if (!(data =priv.exif_data_alloc (s))) {
 		EXIF_LOG_NO_MEMORY (priv.log, "ExifData", s);
@@ -389,193 +434,178 @@ ExifData::exif_data_load_data_thumbnail (const unsigned char *d,
 	memcpy (data, d + o, s);
 }
 
-#undef CHECK_REC
-#define CHECK_REC(i) 					\
-if ((i) == ifd0) {				\
-	priv.log.exif_log(EXIF_LOG_CODE_DEBUG, \
-		"ExifData", "Recursive entry in IFD "	\
-		"'%s' detected. Skipping...",		\
-		exif_ifd_get_name (i));			\
-	break;						\
-}							\
-if (ifd[(i)]->entries.size()) {				\
-	priv.log.exif_log(EXIF_LOG_CODE_DEBUG,	\
-		"ExifData", "Attempt to load IFD "	\
-		"'%s' multiple times detected. "	\
-		"Skipping...",				\
-		exif_ifd_get_name (i));			\
-	break;						\
-}
-
-/*! Load data for an IFD.
+/*! Pass an entry that has been loaded, or an IFD that is about to be
+ * loaded, to the load filter while it is undecided.
  *
- * \param[in] ifd IFD to load
- * \param[in] d pointer to buffer containing raw IFD data
- * \param[in] ds size of raw data in buffer at \c d
- * \param[in] offset offset into buffer at \c d at which IFD starts
- * \param[in] recursion_depth number of times this function has been
- * recursively called without returning
+ * \param[in] ifd IFD of the entry, or IFD about to be loaded
+ * \param[in] e loaded entry, or NULL
+ * \return 0 if the data has been rejected, 1 otherwise
  */
-void ExifData::exif_data_load_data_content (ExifIfd ifd0,
-			     const unsigned char *d,
-			     unsigned int ds, unsigned int offset, unsigned int recursion_depth)
+int ExifData::exif_data_load_filter (ExifIfd ifd, const ExifEntry *e)
 {
-	ExifLong o, thumbnail_offset = 0, thumbnail_length = 0;
-	ExifShort n;
-	unsigned int i;
-	ExifTag tag;
-	
+	if (priv.filter && (priv.filter_result == EXIF_DATA_FILTER_UNDECIDED))
+		priv.filter_result = priv.filter (this, ifd, e, priv.filter_data);
+	return priv.filter_result != EXIF_DATA_FILTER_REJECT;
+}
 
-	/* check for valid ExifIfd enum range */
-	if ((((int)ifd0) < 0) || ( ((int)ifd0) >= EXIF_IFD_COUNT))
-	  return;
+/* Stores the entries that the walk of the directories finds in the data */
+class ExifDataLoader
+{
+public:
+	ExifDataLoader (ExifData *data0, const unsigned char *d0, unsigned int ds0)
+	{
+		data = data0;
+		d = d0;
+		ds = ds0;
+	}
 
-	if (recursion_depth > 30) {
-		priv.log.exif_log(EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
-			  "Deep recursion detected!");
-		return;
+	/* Ask the filter before loading any IFD but the first */
+	int enter (ExifIfd ifd)
+	{
+		return data->exif_data_load_filter (ifd, NULL);
 	}
 
-	/* Read the number of entries */
-	if ((offset + 2 < offset) || (offset + 2 < 2) || (offset + 2 > ds)) {
-		priv.log.exif_log(EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
-			  "Tag data past end of buffer (%u > %u)", offset+2, ds);
-		return;
+	int begin (ExifIfd, unsigned int)
+	{
+		return 1;
 	}
-	n = exif_get_short (d + offset, priv.order);
-	priv.log.exif_log(EXIF_LOG_CODE_DEBUG, "ExifData",
-	          "Loading %hu entries...", n);
-	offset += 2;
 
-	/* Check if we have enough data. */
-	if (offset + 12 * n > ds) {
-		n = (ds - offset) / 12;
-		priv.log.exif_log(EXIF_LOG_CODE_DEBUG, "ExifData",
-				  "Short data; only loading %hu entries...", n);
+	int entry (ExifIfd ifd, const ExifParserEntry *e);
+
+	void thumbnail (ExifLong o, ExifLong s)
+	{
+		data->exif_data_load_data_thumbnail (d, ds, o, s);
 	}
 
-	for (i = 0; i < n; i++) {
-
-		tag =static_cast<ExifTag>( exif_get_short (d + offset + 12 * i, priv.order));
-		switch (tag) {
-		case EXIF_TAG_EXIF_IFD_POINTER:
-		case EXIF_TAG_GPS_INFO_IFD_POINTER:
-		case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
-		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH:
-		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT:
-			o = exif_get_long (d + offset + 12 * i + 8,
-					   priv.order);
-			/* FIXME: IFD_POINTER tags aren't marked as being in a
-			 * specific IFD, so exif_tag_get_name_in_ifd won't work
-			 */
-			priv.log.exif_log(EXIF_LOG_CODE_DEBUG, "ExifData",
-				  "Sub-IFD entry 0x%x ('%s') at %u.", tag,
-				  exif_tag_get_name(tag), o);
-			switch (tag) {
-			case EXIF_TAG_EXIF_IFD_POINTER:
-				CHECK_REC (EXIF_IFD_EXIF);
-				exif_data_load_data_content (EXIF_IFD_EXIF, d, ds, o, recursion_depth + 1);
-				break;
-			case EXIF_TAG_GPS_INFO_IFD_POINTER:
-				CHECK_REC (EXIF_IFD_GPS);
-				exif_data_load_data_content (EXIF_IFD_GPS, d, ds, o, recursion_depth + 1);
-				break;
-			case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
-				CHECK_REC (EXIF_IFD_INTEROPERABILITY);
-				exif_data_load_data_content (EXIF_IFD_INTEROPERABILITY, d, ds, o, recursion_depth + 1);
-				break;
-			case EXIF_TAG_JPEG_INTERCHANGE_FORMAT:
-				thumbnail_offset = o;
-				if (thumbnail_offset && thumbnail_length)
-					exif_data_load_data_thumbnail (d,
-								       ds, thumbnail_offset,
-								       thumbnail_length);
-				break;
-			case EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH:
-				thumbnail_length = o;
-				if (thumbnail_offset && thumbnail_length)
-					exif_data_load_data_thumbnail (d,
-								       ds, thumbnail_offset,
-								       thumbnail_length);
-				break;
-			default:
-				return;
-			}
-			break;
-		default:
-
-			/*
-			 * If we don't know the tag, don't fail. It could be that new 
-			 * versions of the standard have defined additional tags. Note that
-			 * 0 is a valid tag in the GPS IFD.
-			 */
-			if (!exif_tag_get_name_in_ifd (tag, ifd0)) {
-
-				/*
-				 * Special case: Tag and format 0. That's against specification
-				 * (at least up to 2.2). But Photoshop writes it anyways.
-				 */
-				if (!memcmp (d + offset + 12 * i, "\0\0\0\0", 4)) {
-					priv.log.exif_log(EXIF_LOG_CODE_DEBUG, "ExifData",
-						  "Skipping empty entry at position %u in '%s'.", i, 
-						  exif_ifd_get_name (ifd0));
-					break;
-				}
-				priv.log.exif_log(EXIF_LOG_CODE_DEBUG, "ExifData",
-					  "Unknown tag 0x%04x (entry %u in '%s'). Please report this tag "
-					  "to <libexif-devel@lists.sourceforge.net>.", tag, i,
-					  exif_ifd_get_name (ifd0));
-				if (priv.options & EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS)
-					break;
-			}
-			ExifEntry entry;
-			if (priv.exif_data_load_data_entry (&entry, d, ds, offset + 12 * i))
-				ifd[ifd0]->exif_content_add_entry (entry);
-			break;
-		}
+	int end (ExifIfd)
+	{
+		return 1;
 	}
-}
+public:
+	ExifData *data;
 
-static int
-cmp_func (const unsigned char *p1, const unsigned char *p2, ExifByteOrder o)
+	/* The TIFF data */
+	const unsigned char *d;
+	unsigned int ds;
+};
+
+/* Copy the value of an entry into a new entry of the IFD. Returns 0 if
+ * the filter has rejected the data. */
+int ExifDataLoader::entry (ExifIfd ifd, const ExifParserEntry *e)
 {
-	ExifShort tag1 = exif_get_short (p1, o);
-	ExifShort tag2 = exif_get_short (p2, o);
+	ExifDataPrivate *priv = &data->priv;
+	ExifContent *c = data->ifd[ifd];
+	std::vector<ExifEntry>::size_type n;
+	ExifEntry entry;
 
-	return (tag1 < tag2) ? -1 : (tag1 > tag2) ? 1 : 0;
+	if ((priv->options & EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS) &&
+	    !exif_tag_get_name_in_ifd (e->tag, ifd))
+		return 1;
+
+	/* FIXME: should use exif_tag_get_name_in_ifd here but entry->parent
+	 * has not been set yet
+	 */
+	priv->log.exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+		  "Loading entry 0x%x ('%s')...", e->tag,
+		  exif_tag_get_name (e->tag));
+	entry.tag = e->tag;
+	entry.format = e->format;
+	entry.components = e->components;
+	entry.priv.dirty = 0;
+	entry.priv.offset = e->offset;
+	entry.priv.length = e->size;
+	entry.priv.order = priv->order;
+	entry.data = priv->exif_data_alloc (e->size);
+	if (entry.data) {
+		entry.size = e->size;
+		memcpy (entry.data, e->data, e->size);
+	} else {
+		/* FIXME: What do our callers do if (entry->data == NULL)? */
+		EXIF_LOG_NO_MEMORY (priv->log, "ExifData", e->size);
+	}
+
+	/* If this is the MakerNote, remember the offset */
+	if (entry.tag == EXIF_TAG_MAKER_NOTE) {
+		if (!entry.data) {
+			priv->log.exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+					  "MakerNote found with empty data");
+		} else if (entry.size > 6) {
+			priv->log.exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+					       "MakerNote found (%02x %02x %02x %02x "
+					       "%02x %02x %02x...).",
+					       entry.data[0], entry.data[1], entry.data[2],
+					       entry.data[3], entry.data[4], entry.data[5],
+					       entry.data[6]);
+		}
+		priv->offset_mnote = e->offset;
+	}
+
+	n = c->entries.size ();
+	c->exif_content_add_entry (entry);
+	if (priv->filter && (c->entries.size () > n))
+		data->exif_data_load_filter (ifd, c->exif_content_get_entry (e->tag));
+	return priv->filter_result != EXIF_DATA_FILTER_REJECT;
 }
 
-static int
-cmp_func_intel (const void *elem1, const void *elem2)
+/*! Load data for an IFD and the IFDs it points to. The directories are
+ * walked by #exif_parser_walk_ifd, as by #ExifParser.
+ *
+ * \param[in] ifd IFD to load
+ * \param[in] d pointer to buffer containing raw IFD data
+ * \param[in] ds size of raw data in buffer at \c d
+ * \param[in] offset offset into buffer at \c d at which IFD starts
+ * \param[in] recursion_depth number of times this function has been
+ * recursively called without returning
+ */
+void ExifData::exif_data_load_data_content (ExifIfd ifd0,
+			     const unsigned char *d,
+			     unsigned int ds, unsigned int offset, unsigned int recursion_depth)
 {
-	return cmp_func ((const unsigned char *) elem1,
-			 (const unsigned char *) elem2, EXIF_BYTE_ORDER_INTEL);
+	ExifDataLoader l (this, d, ds);
+	unsigned int count[EXIF_IFD_COUNT], i;
+
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		count[i] = (unsigned int) ifd[i]->entries.size ();
+	if (priv.order == EXIF_BYTE_ORDER_INTEL)
+		exif_parser_walk_ifd (&l, ifd0, ExifBufferReader<EXIF_BYTE_ORDER_INTEL> (d, ds),
+				      offset, recursion_depth, count, &priv.log);
+	else
+		exif_parser_walk_ifd (&l, ifd0, ExifBufferReader<EXIF_BYTE_ORDER_MOTOROLA> (d, ds),
+				      offset, recursion_depth, count, &priv.log);
 }
 
-static int
-cmp_func_motorola (const void *elem1, const void *elem2)
+/* Number of entries of the IFD that come before a special entry for the
+ * given tag, which is the kth special entry of the IFD */
+static unsigned int
+special_entry_slot (ExifContent *c, ExifTag tag, unsigned int k)
 {
-	return cmp_func ((const unsigned char *) elem1,
-			 (const unsigned char *) elem2, EXIF_BYTE_ORDER_MOTOROLA);
+	std::vector<ExifEntry>::size_type n = 0;
+
+	while ((n < c->entries.size()) && (c->entries[n].tag <= tag))
+		n++;
+	return (unsigned int) n + k;
 }
 
 void ExifData::exif_data_save_data_content (ExifContent *ifd0,
 			     unsigned char **d, unsigned int *ds,
 			     unsigned int offset)
 {
-	unsigned int j=0, n_ptr = 0, n_thumb = 0;
+	unsigned int j=0, n_ptr = 0, n_thumb = 0, n_total, k = 0, o;
 	ExifIfd i=EXIF_IFD_0;
 	unsigned char *t=NULL;
-	unsigned int ts=0;
+	unsigned int ts=0, th_size;
+	const unsigned char *th;
+	ExifTag special[2];
 
 	if (!ifd || !d || !ds) 
 		return;
 
-	for (int i = EXIF_IFD_0; i < EXIF_IFD_COUNT; i++)
+	for (i = EXIF_IFD_0; i < EXIF_IFD_COUNT; i = (ExifIfd) (i + 1))
 		if (ifd0 == ifd[i])
 			break;
 	if (i == EXIF_IFD_COUNT)
 		return;	/* error */
+	th_size = thumbnail_get (this, &th);
 
 	/*
 	 * Check if we need some extra entries for pointers or the thumbnail.
@@ -589,30 +619,34 @@ void ExifData::exif_data_save_data_content (ExifContent *ifd0,
 		 */
 		if (ifd[EXIF_IFD_EXIF]->entries.size() ||
 		    ifd[EXIF_IFD_INTEROPERABILITY]->entries.size())
-			n_ptr++;
+			special[n_ptr++] = EXIF_TAG_EXIF_IFD_POINTER;
 
 		/* The pointer to IFD_GPS is in IFD_0. */
 		if (ifd[EXIF_IFD_GPS]->entries.size())
-			n_ptr++;
+			special[n_ptr++] = EXIF_TAG_GPS_INFO_IFD_POINTER;
 
 		break;
 	case EXIF_IFD_1:
-		if (size)
+		if (th_size) {
+			special[0] = EXIF_TAG_JPEG_INTERCHANGE_FORMAT;
+			special[1] = EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH;
 			n_thumb = 2;
+		}
 		break;
 	case EXIF_IFD_EXIF:
 		if (ifd[EXIF_IFD_INTEROPERABILITY]->entries.size())
-			n_ptr++;
+			special[n_ptr++] = EXIF_TAG_INTEROPERABILITY_IFD_POINTER;
 	default:
 		break;
 	}
+	n_total = (unsigned int) ifd0->entries.size() + n_ptr + n_thumb;
 
 	/*
 	 * Allocate enough memory for all entries
 	 * and the number of entries.
 	 */
-	ts = *ds + (2 + (ifd0->entries.size() + n_ptr + n_thumb) * 12 + 4);
-	t =priv.mem.exif_mem_realloc (d, ts);
+	ts = *ds + (2 + n_total * 12 + 4);
+	t =priv.mem.exif_mem_realloc (d, *ds, ts);
 	if (!t) {
 		EXIF_LOG_NO_MEMORY (priv.log, "ExifData", ts);
 	  	return;
@@ -621,24 +655,26 @@ void ExifData::exif_data_save_data_content (ExifContent *ifd0,
 	*ds = ts;
 
 	/* Save the number of entries */
-	exif_set_short (*d + 6 + offset, priv.order,
-			(ExifShort) (ifd0->entries.size() + n_ptr + n_thumb));
+	exif_set_short (*d + 6 + offset, priv.order, (ExifShort) n_total);
 	offset += 2;
 
 	/*
 	 * Save each entry. Make sure that no memcpys from NULL pointers are
-	 * performed
+	 * performed. The entries are in ascending order of their tags
+	 * already, so the directory is written in order as it is, leaving
+	 * the slots for the special entries among them.
 	 */
 	priv.log.exif_log(EXIF_LOG_CODE_DEBUG, "ExifData",
 		  "Saving %i entries (IFD '%s', offset: %i)...",
 		  ifd0->entries.size(), exif_ifd_get_name (i), offset);
 	for (std::vector<ExifEntry>::iterator it = ifd0->entries.begin(); it < ifd0->entries.end(); ++it) 
 	{
-		priv.exif_data_save_data_entry (&(*it), d, ds,offset + 12 * j);
+		while ((k < n_ptr + n_thumb) && (special[k] < it->tag))
+			k++;
+		priv.exif_data_save_data_entry (&(*it), d, ds,offset + 12 * (j + k));
 		j++;
 	}
-
-	offset += 12 * ifd0->entries.size();
+	k = 0;
 
 	/* Now save special entries. */
 	switch (i) {
@@ -652,30 +688,30 @@ void ExifData::exif_data_save_data_content (ExifContent *ifd0,
 		 */
 		if (ifd[EXIF_IFD_EXIF]->entries.size() ||
 		    ifd[EXIF_IFD_INTEROPERABILITY]->entries.size()) {
-			exif_set_short (*d + 6 + offset + 0, priv.order,
+			o = offset + 12 * special_entry_slot (ifd0, EXIF_TAG_EXIF_IFD_POINTER, k++);
+			exif_set_short (*d + 6 + o + 0, priv.order,
 					EXIF_TAG_EXIF_IFD_POINTER);
-			exif_set_short (*d + 6 + offset + 2, priv.order,
+			exif_set_short (*d + 6 + o + 2, priv.order,
 					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, priv.order,
+			exif_set_long  (*d + 6 + o + 4, priv.order,
 					1);
-			exif_set_long  (*d + 6 + offset + 8, priv.order,
+			exif_set_long  (*d + 6 + o + 8, priv.order,
 					*ds - 6);
 			exif_data_save_data_content (ifd[EXIF_IFD_EXIF], d, ds, *ds - 6);
-			offset += 12;
 		}
 
 		/* The pointer to IFD_GPS is in IFD_0, too. */
 		if (ifd[EXIF_IFD_GPS]->entries.size()) {
-			exif_set_short (*d + 6 + offset + 0, priv.order,
+			o = offset + 12 * special_entry_slot (ifd0, EXIF_TAG_GPS_INFO_IFD_POINTER, k++);
+			exif_set_short (*d + 6 + o + 0, priv.order,
 					EXIF_TAG_GPS_INFO_IFD_POINTER);
-			exif_set_short (*d + 6 + offset + 2, priv.order,
+			exif_set_short (*d + 6 + o + 2, priv.order,
 					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, priv.order,
+			exif_set_long  (*d + 6 + o + 4, priv.order,
 					1);
-			exif_set_long  (*d + 6 + offset + 8, priv.order,
+			exif_set_long  (*d + 6 + o + 8, priv.order,
 					*ds - 6);
 			exif_data_save_data_content (ifd[EXIF_IFD_GPS], d, ds, *ds - 6);
-			offset += 12;
 		}
 
 		break;
@@ -686,17 +722,17 @@ void ExifData::exif_data_save_data_content (ExifContent *ifd0,
 		 * See note above.
 		 */
 		if (ifd[EXIF_IFD_INTEROPERABILITY]->entries.size()) {
-			exif_set_short (*d + 6 + offset + 0, priv.order,
+			o = offset + 12 * special_entry_slot (ifd0, EXIF_TAG_INTEROPERABILITY_IFD_POINTER, k++);
+			exif_set_short (*d + 6 + o + 0, priv.order,
 					EXIF_TAG_INTEROPERABILITY_IFD_POINTER);
-			exif_set_short (*d + 6 + offset + 2, priv.order,
+			exif_set_short (*d + 6 + o + 2, priv.order,
 					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, priv.order,
+			exif_set_long  (*d + 6 + o + 4, priv.order,
 					1);
-			exif_set_long  (*d + 6 + offset + 8, priv.order,
+			exif_set_long  (*d + 6 + o + 8, priv.order,
 					*ds - 6);
 			exif_data_save_data_content (ifd[EXIF_IFD_INTEROPERABILITY], d, ds,
 						     *ds - 6);
-			offset += 12;
 		}
 
 		break;
@@ -706,39 +742,41 @@ void ExifData::exif_data_save_data_content (ExifContent *ifd0,
 		 * Information about the thumbnail (if any) is saved in
 		 * IFD_1.
 		 */
-		if (size) {
+		if (th_size) {
 
 			/* EXIF_TAG_JPEG_INTERCHANGE_FORMAT */
-			exif_set_short (*d + 6 + offset + 0, priv.order,
+			o = offset + 12 * special_entry_slot (ifd0, EXIF_TAG_JPEG_INTERCHANGE_FORMAT, k++);
+			exif_set_short (*d + 6 + o + 0, priv.order,
 					EXIF_TAG_JPEG_INTERCHANGE_FORMAT);
-			exif_set_short (*d + 6 + offset + 2, priv.order,
+			exif_set_short (*d + 6 + o + 2, priv.order,
 					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, priv.order,
+			exif_set_long  (*d + 6 + o + 4, priv.order,
 					1);
-			exif_set_long  (*d + 6 + offset + 8, priv.order,
+			exif_set_long  (*d + 6 + o + 8, priv.order,
 					*ds - 6);
-			ts = *ds + size;
-			t = priv.mem.exif_mem_realloc (d, ts);
-			if (!t) {
-				EXIF_LOG_NO_MEMORY (priv.log, "ExifData",
-						    ts);
-			  	return;
+			if (!priv.exif_data_defer_value (o + 8, th, th_size)) {
+				ts = *ds + th_size;
+				t = priv.mem.exif_mem_realloc (d, *ds, ts);
+				if (!t) {
+					EXIF_LOG_NO_MEMORY (priv.log, "ExifData",
+							    ts);
+				  	return;
+				}
+				*d = t;
+				*ds = ts;
+				memcpy (*d + *ds - th_size, th, th_size);
 			}
-			*d = t;
-			*ds = ts;
-			memcpy (*d + *ds - size, data, size);
-			offset += 12;
 
 			/* EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH */
-			exif_set_short (*d + 6 + offset + 0, priv.order,
+			o = offset + 12 * special_entry_slot (ifd0, EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH, k++);
+			exif_set_short (*d + 6 + o + 0, priv.order,
 					EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH);
-			exif_set_short (*d + 6 + offset + 2, priv.order,
+			exif_set_short (*d + 6 + o + 2, priv.order,
 					EXIF_FORMAT_LONG);
-			exif_set_long  (*d + 6 + offset + 4, priv.order,
+			exif_set_long  (*d + 6 + o + 4, priv.order,
 					1);
-			exif_set_long  (*d + 6 + offset + 8, priv.order,
-					size);
-			offset += 12;
+			exif_set_long  (*d + 6 + o + 8, priv.order,
+					th_size);
 		}
 
 		break;
@@ -746,13 +784,10 @@ void ExifData::exif_data_save_data_content (ExifContent *ifd0,
 		break;
 	}
 
-	/* Sort the directory according to TIFF specification */
-	qsort (*d + 6 + offset - (ifd0->entries.size() + n_ptr + n_thumb) * 12,
-	       (ifd0->entries.size() + n_ptr + n_thumb), 12,
-	       (priv.order == EXIF_BYTE_ORDER_INTEL) ? cmp_func_intel : cmp_func_motorola);
+	offset += 12 * n_total;
 
 	/* Correctly terminate the directory */
-	if (i == EXIF_IFD_0 && (ifd[EXIF_IFD_1]->entries.size() || size))
+	if (i == EXIF_IFD_0 && (ifd[EXIF_IFD_1]->entries.size() || th_size))
 	{
 
 		/*
@@ -765,6 +800,21 @@ void ExifData::exif_data_save_data_content (ExifContent *ifd0,
 		exif_set_long (*d + 6 + offset, priv.order, 0);
 }
 
+/* Describe an entry, which may be NULL, as the parser would report it */
+static void
+parser_entry_set (ExifParserEntry *p, const ExifEntry *e)
+{
+	memset (p, 0, sizeof (*p));
+	if (!e)
+		return;
+	p->tag = e->tag;
+	p->format = e->format;
+	p->components = e->components;
+	p->data = e->data;
+	p->size = e->size;
+	p->offset = e->priv.offset;
+}
+
 typedef enum {
 	EXIF_DATA_TYPE_MAKER_NOTE_NONE		= 0,
 	EXIF_DATA_TYPE_MAKER_NOTE_CANON		= 1,
@@ -783,6 +833,7 @@ typedef enum {
  */
 void ExifData::interpret_maker_note(const unsigned char *d, unsigned int ds)
 {
+	ExifParserEntry m, make;
 	int mnoteid=0;
 
 	ExifEntry* e = exif_data_get_entry (EXIF_TAG_MAKER_NOTE);
@@ -790,29 +841,31 @@ void ExifData::interpret_maker_note(const unsigned char *d, unsigned int ds)
 		return;
 	
 	priv.data_free();
-	if ((mnoteid = exif_mnote_data_olympus_identify (e)) != 0) {
+	parser_entry_set (&m, e);
+	parser_entry_set (&make, exif_data_get_entry (EXIF_TAG_MAKE));
+	switch (exif_parser_identify_makernote (&m, make.data ? &make : NULL, &mnoteid)) {
+	case EXIF_MNOTE_VENDOR_OLYMPUS:
 		priv.log.exif_log(EXIF_LOG_CODE_DEBUG,
 			"ExifData", "Olympus MakerNote variant type %d", mnoteid);
-		
-		
 		priv.md = new ExifMnoteDataOlympus;
-
-	} else if ((mnoteid = exif_mnote_data_canon_identify (e)) != 0) {
+		break;
+	case EXIF_MNOTE_VENDOR_CANON:
 		priv.log.exif_log(EXIF_LOG_CODE_DEBUG,
 			"ExifData", "Canon MakerNote variant type %d", mnoteid);
 		priv.md = new ExifMnoteDataCanon;
-
-	} else if ((mnoteid = exif_mnote_data_fuji_identify (e)) != 0) {
+		break;
+	case EXIF_MNOTE_VENDOR_FUJI:
 		priv.log.exif_log(EXIF_LOG_CODE_DEBUG,
 			"ExifData", "Fuji MakerNote variant type %d", mnoteid);
 		priv.md = new ExifMnoteDataFuji;
-
-	/* NOTE: Must do Pentax detection last because some of the
-	 * heuristics are pretty general. */
-	} else if ((mnoteid = exif_mnote_data_pentax_identify (e)) != 0) {
+		break;
+	case EXIF_MNOTE_VENDOR_PENTAX:
 		priv.log.exif_log(EXIF_LOG_CODE_DEBUG,
 			"ExifData", "Pentax MakerNote variant type %d", mnoteid);
 		priv.md = new ExifMnoteDataPentax;
+		break;
+	default:
+		break;
 	}
 
 	/* 
@@ -845,12 +898,15 @@ void ExifData::exif_data_load_data (const unsigned char *d_orig,unsigned int ds)
 {
 	unsigned int l=0;
 	ExifLong offset=0;
-	ExifShort n=0;
 	const unsigned char *d = d_orig;
 	unsigned int len=0, fullds=0;
 
 	if (!d || !ds) return;
-		
+	priv.offset_tiff = 0;
+	priv.thumbnail = NULL;
+	priv.thumbnail_size = 0;
+	priv.thumbnail_skipped = 0;
+	priv.filter_result = EXIF_DATA_FILTER_UNDECIDED;
 
 	priv.log.exif_log(EXIF_LOG_CODE_DEBUG, "ExifData", "Parsing %i byte(s) EXIF data...\n", ds);
 
@@ -935,6 +991,7 @@ void ExifData::exif_data_load_data (const unsigned char *d_orig,unsigned int ds)
 	/* Sanity check the data length */
 	if (ds < 14)
 		return;
+	priv.offset_tiff = (unsigned int) (d - d_orig) + 6;
 
 	/* The JPEG APP1 section can be no longer than 64 KiB (including a
 	   16-bit length), so cap the data length to protect against overflow
@@ -967,26 +1024,36 @@ void ExifData::exif_data_load_data (const unsigned char *d_orig,unsigned int ds)
 	if (offset > ds || offset + 6 + 2 > ds)
 		return;
 
-	/* Parse the actual exif data (usually offset 14 from start) */
-	exif_data_load_data_content (EXIF_IFD_0, d + 6, ds - 6, offset, 0);
-
-	/* IFD 1 offset */
-	n = exif_get_short (d + 6 + offset, priv.order);
-	if (offset + 6 + 2 + 12 * n + 4 > ds)
-		return;
+	/* Parse the actual exif data (usually offset 14 from start).
+	 * The byte order is known from here on, so all directories
+	 * are decoded by the walk specialised for it. */
+	{
+		ExifDataLoader loader (this, d + 6, ds - 6);
+		unsigned int count[EXIF_IFD_COUNT];
+
+		for (l = 0; l < EXIF_IFD_COUNT; l++)
+			count[l] = (unsigned int) ifd[l]->entries.size ();
+		if (priv.order == EXIF_BYTE_ORDER_INTEL)
+			exif_parser_walk_ifds (&loader,
+				ExifBufferReader<EXIF_BYTE_ORDER_INTEL> (d + 6, ds - 6),
+				offset, count, &priv.log);
+		else
+			exif_parser_walk_ifds (&loader,
+				ExifBufferReader<EXIF_BYTE_ORDER_MOTOROLA> (d + 6, ds - 6),
+				offset, count, &priv.log);
+	}
 
-	offset = exif_get_long (d + 6 + offset + 2 + 12 * n, priv.order);
-	if (offset) {
+	/* Drop everything that has been loaded if the filter has rejected
+	 * the data, before the MakerNote is looked at */
+	if (priv.filter_result == EXIF_DATA_FILTER_REJECT) {
 		priv.log.exif_log(EXIF_LOG_CODE_DEBUG, "ExifData",
-			  "IFD 1 at %i.", (int) offset);
-
-		/* Sanity check. */
-		if (offset > ds || offset + 6 > ds) {
-			priv.log.exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
-				  "ExifData", "Bogus offset of IFD1.");
-		} else {
-		   exif_data_load_data_content (EXIF_IFD_1, d + 6, ds - 6, offset, 0);
-		}
+			  "Data rejected by the load filter.");
+		for (l = 0; l < EXIF_IFD_COUNT; l++)
+			ifd[l]->entries.clear ();
+		thumbnail_free (this);
+		priv.thumbnail_skipped = 0;
+		priv.data_free ();
+		return;
 	}
 
 	/*
@@ -1002,6 +1069,12 @@ void ExifData::exif_data_load_data (const unsigned char *d_orig,unsigned int ds)
 		exif_data_fix ();
 }
 
+/*! Save the data, starting with the "Exif\0\0" header.
+ *
+ * \param[out] d saved data, allocated by the allocator of the data, so
+ *   it is freed with priv.mem.exif_mem_free
+ * \param[out] ds number of bytes at d
+ */
 void ExifData::exif_data_save_data (unsigned char **d, unsigned int *ds)
 {
 	if (ds)
@@ -1045,6 +1118,58 @@ void ExifData::exif_data_save_data (unsigned char **d, unsigned int *ds)
 		  "Saved %i byte(s) EXIF data.", *ds);
 }
 
+/*! Save the EXIF data like #exif_data_save_data, but without copying
+ * the thumbnail and the values of at least \c min bytes. They are
+ * moved to the end of the EXIF data and referenced in the list of
+ * chunks, which can be written out with a single gathering write. The
+ * MakerNote is always copied, because its offsets depend on where it is.
+ *
+ * \param[out] d pointer to buffer pointer containing the directories
+ *   and remaining values on return; it is the first chunk
+ * \param[out] ds pointer to variable to hold the size of the buffer
+ * \param[out] chunks pieces of the EXIF data, in order. They point into
+ *   *d and into this #ExifData, and are valid until either is changed.
+ * \param[in] min size from which values are referenced
+ */
+void ExifData::exif_data_save_data_chunks (unsigned char **d, unsigned int *ds,
+				std::vector<ExifDataChunk> *chunks, unsigned int min)
+{
+	std::vector<ExifDataChunk> deferred;
+	ExifDataChunk c;
+	unsigned int i, o;
+
+	if (!chunks)
+		return;
+	chunks->clear ();
+
+	priv.deferred = &deferred;
+	priv.deferred_fields.clear ();
+	priv.defer_min = min;
+	exif_data_save_data (d, ds);
+	priv.deferred = NULL;
+	if (!d || !ds || !*ds)
+		return;
+
+	c.data = *d;
+	c.size = *ds;
+	chunks->push_back (c);
+
+	/* Place the values after the buffer, at even offsets */
+	o = *ds - 6;
+	for (i = 0; i < deferred.size (); i++) {
+		if (o & 1) {
+			c.data = ExifPadding;
+			c.size = sizeof (ExifPadding);
+			chunks->push_back (c);
+			o++;
+		}
+		exif_set_long (*d + 6 + priv.deferred_fields[i], priv.order, o);
+		chunks->push_back (deferred[i]);
+		o += deferred[i].size;
+	}
+	priv.deferred_fields.clear ();
+}
+
 /*! Allocate a new #ExifData and load EXIF data from a JPEG file.
  * Uses an #ExifLoader internally to do the loading.
  *
@@ -1071,7 +1196,8 @@ void ExifData::exif_data_new_from_file (const char *path)
  */
 void ExifData::exif_data_dump ()
 {
-	unsigned int i=0;
+	unsigned int i=0, th_size;
+	const unsigned char *th;
 
 	for (i = 0; i < EXIF_IFD_COUNT; i++) {
 		if (ifd[i] && ifd[i]->entries.size()) {
@@ -1081,17 +1207,55 @@ void ExifData::exif_data_dump ()
 		}
 	}
 
-	if (data) {
-		printf ("%i byte(s) thumbnail data available.", size);
-		if (size >= 4) {
+	th_size = thumbnail_get (this, &th);
+	if (th) {
+		printf ("%i byte(s) thumbnail data available.", th_size);
+		if (th_size >= 4) {
 			printf ("0x%02x 0x%02x ... 0x%02x 0x%02x\n",
-				data[0], data[1],
-				data[size - 2],
-				data[size - 1]);
+				th[0], th[1],
+				th[th_size - 2],
+				th[th_size - 1]);
 		}
 	}
 }
 
+/*! Return the size of the thumbnail, without copying a thumbnail that
+ * is only referenced.
+ *
+ * \return number of bytes of the thumbnail, or 0 if there is none
+ */
+unsigned int ExifData::exif_data_get_thumbnail_size ()
+{
+	const unsigned char *th;
+
+	return thumbnail_get (this, &th);
+}
+
+/*! Return the thumbnail. A thumbnail that has been loaded with
+ * #EXIF_DATA_OPTION_REFERENCE_THUMBNAIL is copied to \c data first;
+ * from then on the loaded data is no longer needed.
+ *
+ * \param[out] ds number of bytes of the thumbnail, or NULL
+ * \return the thumbnail, the same as \c data, or NULL if there is none
+ */
+unsigned char *ExifData::exif_data_get_thumbnail (unsigned int *ds)
+{
+	if (!data && priv.thumbnail) {
+		data = priv.exif_data_alloc (priv.thumbnail_size);
+		if (!data) {
+			EXIF_LOG_NO_MEMORY (priv.log, "ExifData", priv.thumbnail_size);
+		} else {
+			size = priv.thumbnail_size;
+			memcpy (data, priv.thumbnail, size);
+			priv.thumbnail = NULL;
+			priv.thumbnail_size = 0;
+		}
+	}
+	if (ds)
+		*ds = data ? size : 0;
+	return data;
+}
+
 /*! Return the byte order in use by this EXIF structure.
  *
  * \return byte order
@@ -1115,55 +1279,134 @@ void ExifData::exif_data_foreach_content (ExifDataForeachContentFunc func, void
 		func (ifd[i], user_data);
 }
 
-typedef struct _ByteOrderChangeData ByteOrderChangeData;
-struct _ByteOrderChangeData {
-	ExifByteOrder old, newx;
+/*! Set the byte order to use for this EXIF data. Tags that already exist
+ * (including MakerNote tags) are not touched: each keeps the byte order
+ * of its value, see #exif_entry_get_byte_order, and is converted to the
+ * new byte order when it is saved.
+ *
+ * \param[in] order byte order
+ */
+void ExifData::exif_data_set_byte_order (ExifByteOrder order)
+{
+	if ((order == priv.order))
+		return;
 
-	_ByteOrderChangeData()
-	{
-		Init();
-	}
-	void inline Init()
-	{
-		old = EXIF_BYTE_ORDER_MOTOROLA;
-		newx= EXIF_BYTE_ORDER_MOTOROLA;
-	}
-};
+	priv.order = order;
+	if (priv.md)
+		priv.md->exif_mnote_data_set_byte_order (order);
+}
 
-void ExifData::entry_set_byte_order (ExifEntry *e, void *data)
+/*! Return the offset at which the value of the given entry was loaded,
+ * in the data passed to #exif_data_load_data.
+ *
+ * \param[in] e entry of this #ExifData
+ * \return offset of the value, or 0 if the entry has not been loaded
+ */
+unsigned int ExifData::exif_data_get_entry_offset (ExifEntry *e)
 {
-	ByteOrderChangeData *d = (ByteOrderChangeData *) data;
-
-	if (!e)
-		return;
+	if (!e || !e->priv.offset)
+		return 0;
+	return priv.offset_tiff + e->priv.offset;
+}
 
-	exif_array_set_byte_order (e->format, e->data, e->components, d->old, d->newx);
+/* Check that the value of e can be written over the one it was loaded
+ * from, in TIFF data whose header starts with the byte order mark bo */
+static int
+patch_check (ExifLog &log, ExifEntry *e, const unsigned char *bo)
+{
+	if (!e->priv.offset) {
+		log.exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+			      "Entry 0x%x has not been loaded.", e->tag);
+		return 0;
+	}
+	if (!e->data ||
+	    (exif_format_get_size (e->format) * e->components != e->priv.length) ||
+	    (e->size < e->priv.length)) {
+		log.exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+			      "Size of entry 0x%x has changed.", e->tag);
+		return 0;
+	}
+	if (memcmp (bo, (e->priv.order == EXIF_BYTE_ORDER_INTEL) ? "II" : "MM", 2)) {
+		log.exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+			      "Byte order has changed.");
+		return 0;
+	}
+	return 1;
 }
 
-void content_set_byte_order (ExifContent *content, void *data)
+/*! Write the value of the given entry over the one it was loaded from,
+ * in the data passed to #exif_data_load_data or a copy of it. Only
+ * values that still have their loaded size can be patched this way;
+ * everything else needs #exif_data_save_data.
+ *
+ * \param[in] e entry of this #ExifData
+ * \param[in,out] d data this #ExifData has been loaded from
+ * \param[in] ds number of bytes at d
+ * \return 1 if the value has been written, 0 otherwise
+ */
+int ExifData::exif_data_patch_entry (ExifEntry *e, unsigned char *d,
+				     unsigned int ds)
 {
-	content->exif_content_foreach_entry ();
+	unsigned int o;
+
+	if (!e || !d)
+		return 0;
+	if ((priv.offset_tiff > ds) || (ds - priv.offset_tiff < 2) ||
+	    !patch_check (priv.log, e, d + priv.offset_tiff))
+		return 0;
+	o = priv.offset_tiff + e->priv.offset;
+	if ((o < priv.offset_tiff) || (o > ds) || (e->priv.length > ds - o)) {
+		priv.log.exif_log (EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+				   "Entry 0x%x lies past the end of the data.", e->tag);
+		return 0;
+	}
+	memcpy (d + o, e->data, e->priv.length);
+	return 1;
 }
 
-/*! Set the byte order to use for this EXIF data. If any tags already exist
- * (including MakerNote tags) they are are converted to the specified byte
- * order.
+/*! Write the value of the given entry over the one it was loaded from,
+ * in the JPEG file this #ExifData has been loaded from. Only the bytes
+ * of the value are written; see #exif_data_patch_entry.
  *
- * \param[in] order byte order
+ * \param[in] e entry of this #ExifData
+ * \param[in] path filename including path
+ * \return 1 if the value has been written, 0 otherwise
  */
-void ExifData::exif_data_set_byte_order (ExifByteOrder order)
+int ExifData::exif_data_patch_entry_file (ExifEntry *e, const char *path)
 {
-	ByteOrderChangeData d;
+	unsigned char bo[2];
+	unsigned int size;
+	long offset;
+	int r = 0;
+	FILE *f;
 
-	if ((order == priv.order))
-		return;
+	if (!e || !path)
+		return 0;
+	f = fopen (path, "r+b");
+	if (!f) {
+		priv.log.exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+				   "Unable to open '%s'.", path);
+		return 0;
+	}
 
-	d.old = priv.order;
-	d.newx = order;
-	exif_data_foreach_content (content_set_byte_order, &d);
-	priv.order = order;
-	if (priv.md)
-		priv.md->set_byte_order (order);
+	/* The TIFF header follows the EXIF header */
+	if (!exif_jpeg_find_app1_file (f, &offset, &size) || (size < 8)) {
+		priv.log.exif_log (EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+				   _("EXIF marker not found."));
+	} else if (fseek (f, offset + 6, SEEK_SET) || (fread (bo, 1, 2, f) != 2)) {
+		LOG_TOO_SMALL;
+	} else if (patch_check (priv.log, e, bo)) {
+		if ((e->priv.offset > size - 6) ||
+		    (e->priv.length > size - 6 - e->priv.offset))
+			priv.log.exif_log (EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+					   "Entry 0x%x lies past the end of the data.", e->tag);
+		else if (!fseek (f, offset + 6 + (long) e->priv.offset, SEEK_SET) &&
+			 (fwrite (e->data, 1, e->priv.length, f) == e->priv.length))
+			r = 1;
+	}
+	if (fclose (f))
+		r = 0;
+	return r;
 }
 
 /*! Set the log message object for all IFDs.
@@ -1195,6 +1438,12 @@ static const struct {
 	{EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE, N_("Do not change maker note"),
 	 N_("When loading and resaving Exif data, save the maker note unmodified."
 	    " Be aware that the maker note can get corrupted.")},
+	{EXIF_DATA_OPTION_SKIP_THUMBNAIL, N_("Skip thumbnail"),
+	 N_("Do not load the thumbnail. It is lost when the EXIF data is "
+	    "saved again.")},
+	{EXIF_DATA_OPTION_REFERENCE_THUMBNAIL, N_("Reference thumbnail"),
+	 N_("Do not copy the thumbnail when loading EXIF data but refer to "
+	    "it in the loaded data until it is needed.")},
 	{EXIF_DATA_OPTION_IGNORE_UNKNOWN, NULL, NULL}
 };
 
@@ -1238,11 +1487,131 @@ void ExifData::exif_data_unset_option (ExifDataOption o)
 	priv.options = (ExifDataOption)(priv.options & (~o));
 }
 
+/*! Set a filter that can stop #exif_data_load_data as soon as it is
+ * clear that the data is not wanted, for example once IFD 0 has shown
+ * the wrong Make. Rejected data is loaded as empty: the IFDs have no
+ * entries and there is no thumbnail or MakerNote. The filter is kept
+ * for further loads, including those after #exif_data_reset, until
+ * #exif_data_new is called.
+ *
+ * \param[in] func filter, or NULL to load all data
+ * \param[in] user_data data to pass to func
+ */
+void ExifData::exif_data_set_load_filter (ExifDataLoadFilter func, void *user_data)
+{
+	priv.filter = func;
+	priv.filter_data = user_data;
+}
+
+/*! Return the decision of the load filter on the data last loaded.
+ *
+ * \return #EXIF_DATA_FILTER_REJECT if the data has been dropped, and
+ *   #EXIF_DATA_FILTER_UNDECIDED if there was no filter or it has not
+ *   decided
+ */
+ExifDataFilterResult ExifData::exif_data_get_filter_result ()
+{
+	return priv.filter_result;
+}
+
+/* Free the values, the thumbnail and the MakerNote, which have been
+ * allocated by the allocator in use */
+static void
+drop_allocated (ExifData *ed)
+{
+	unsigned int i;
+
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		if (ed->ifd[i])
+			ed->ifd[i]->entries.clear ();
+	thumbnail_free (ed);
+	ed->priv.data_free ();
+}
+
+/*! Set the functions that allocate the values, the thumbnail and the
+ * MakerNote of the data, and the buffers it saves to. The entries,
+ * thumbnail and MakerNote the data has are dropped first, as they belong
+ * to the previous allocator; the options are kept. The allocator stays
+ * in use through #exif_data_new and #exif_data_reset.
+ *
+ * \param[in] alloc0 allocating function, or NULL for new[]
+ * \param[in] free0 freeing function, or NULL for delete[]
+ * \param[in] user_data0 data to pass to both functions
+ */
+void ExifData::exif_data_set_allocator (ExifMemAllocFunc alloc0,
+					ExifMemFreeFunc free0, void *user_data0)
+{
+	drop_allocated (this);
+	priv.mem.exif_mem_set_allocator (alloc0, free0, user_data0);
+}
+
+/*! Count what the allocator of the data allocates from now on, see
+ * #exif_mem_set_counting. Like #exif_data_set_allocator, it drops the
+ * entries, thumbnail and MakerNote the data has. Restart the stats with
+ * #exif_mem_stats_restart before each load to get the numbers of that
+ * load; the peak then includes what the data held before.
+ *
+ * \param[in,out] stats counts, which have to outlive the data
+ */
+void ExifData::exif_data_set_counting (ExifMemStats *stats)
+{
+	drop_allocated (this);
+	priv.mem.exif_mem_set_counting (stats);
+}
+
+/*! Return how many bytes the data holds, broken down into the values
+ * of each IFD, the thumbnail, the MakerNote and the containers. Vectors
+ * are counted by their capacity, so the numbers include what has been
+ * reserved but is not used yet.
+ *
+ * \param[out] usage breakdown of the bytes held
+ */
+void ExifData::exif_data_memory_usage (ExifDataMemoryUsage *usage)
+{
+	unsigned int i, j;
+	ExifContent *c;
+	ExifMnoteVendor v;
+
+	if (!usage)
+		return;
+	memset (usage, 0, sizeof (*usage));
+
+	usage->containers = sizeof (ExifData) +
+		priv.mem.kept.capacity () * sizeof (ExifMemBlock) +
+		priv.deferred_fields.capacity () * sizeof (unsigned int);
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		if (!(c = ifd[i]))
+			continue;
+		usage->containers += sizeof (ExifContent) +
+			c->entries.capacity () * sizeof (ExifEntry);
+		for (j = 0; j < c->entries.size (); j++)
+			if (c->entries[j].data)
+				usage->entries[i] += c->entries[j].size;
+		usage->total += usage->entries[i];
+	}
+	usage->total += usage->containers;
+
+	if (data)
+		usage->thumbnail = size;
+	usage->total += usage->thumbnail;
+
+	if (priv.md) {
+		v = priv.md->exif_mnote_data_get_vendor ();
+		usage->mnote[v] = priv.md->exif_mnote_data_memory_usage ();
+		usage->total += usage->mnote[v];
+	}
+
+	for (i = 0; i < priv.mem.kept.size (); i++)
+		usage->kept += priv.mem.kept[i].size;
+	usage->total += usage->kept;
+}
+
 static void fix_func (ExifContent *c, void *UNUSED(data))
 {
 	switch (c->exif_content_get_ifd ()) {
 	case EXIF_IFD_1:
-		if (c->parent->data)
+		if (c->parent->exif_data_get_thumbnail_size () ||
+		    c->parent->priv.thumbnail_skipped)
 			c->exif_content_fix ();
 		else if (c->entries.size()) {
 			c->parent->priv.log.exif_log (EXIF_LOG_CODE_DEBUG, "exif-data",
@@ -1285,6 +1654,17 @@ ExifDataType ExifData::exif_data_get_data_type ()
 	return priv.data_type;
 }
 
+/* Whether the module of a vendor interprets the MakerNote e of ed */
+static int
+mnote_identify (ExifData *ed, ExifMnoteVendor vendor, const ExifEntry *e)
+{
+	ExifParserEntry m, make;
+
+	parser_entry_set (&m, e);
+	parser_entry_set (&make, ed->exif_data_get_entry (EXIF_TAG_MAKE));
+	return exif_parser_makernote_variant (vendor, &m, make.data ? &make : NULL);
+}
+
 /*! Detect if MakerNote is recognized as one handled by the Pentax module.
  * 
  * \param[in] ed image #ExifData to identify as as a Pentax type
@@ -1296,52 +1676,16 @@ ExifDataType ExifData::exif_data_get_data_type ()
 
 int ExifData::exif_mnote_data_pentax_identify (const ExifEntry *e)
 {
-	if ((e->size >= 8) && !memcmp (e->data, "AOC", 4)) {
-		if (((e->data[4] == 'I') && (e->data[5] == 'I')) ||
-			((e->data[4] == 'M') && (e->data[5] == 'M')))
-			return pentaxV3;
-		else
-			/* Uses Casio v2 tags */
-			return pentaxV2;
-	}
-
-	if ((e->size >= 8) && !memcmp (e->data, "QVC", 4))
-		return casioV2;
-
-	/* This isn't a very robust test, so make sure it's done last */
-	/* Maybe we should additionally check for a make of Asahi or Pentax */
-	if ((e->size >= 2) && (e->data[0] == 0x00) && (e->data[1] == 0x1b))
-		return pentaxV1;
-
-	return 0;
+	return mnote_identify (this, EXIF_MNOTE_VENDOR_PENTAX, e);
 }
 int ExifData::exif_mnote_data_olympus_identify (const ExifEntry *e)
 {
-	int variant = exif_mnote_data_olympus_identify_variant(e->data, e->size);
-
-	if (variant == nikonV0) {
-		/* This variant needs some extra checking with the Make */
-		char value[5];
-		ExifEntry *em = exif_data_get_entry (EXIF_TAG_MAKE);
-		variant = unrecognized;
-
-		if (em) {
-			const char *v = em->exif_entry_get_value (value, sizeof(value));
-			if (v && (!strncmp (v, "Nikon", sizeof(value)) || 
-					  !strncmp (v, "NIKON", sizeof(value)) ))
-				/* When saved, this variant will be written out like the
-				 * alternative nikonV2 form above instead
-				 */
-				variant = nikonV0;
-		}
-	}
-
-	return variant;
+	return mnote_identify (this, EXIF_MNOTE_VENDOR_OLYMPUS, e);
 }
 
 int ExifData::exif_mnote_data_fuji_identify (const ExifEntry *e)
 {
-	return ((e->size >= 12) && !memcmp (e->data, "FUJIFILM", 8));
+	return mnote_identify (this, EXIF_MNOTE_VENDOR_FUJI, e);
 }
 
 /*! Detect if MakerNote is recognized as one handled by the Canon module.
@@ -1354,11 +1698,7 @@ int ExifData::exif_mnote_data_fuji_identify (const ExifEntry *e)
  */
 int  ExifData::exif_mnote_data_canon_identify (const ExifEntry *e)
 {
-	char value[8];
-	ExifEntry *em = exif_data_get_entry (EXIF_TAG_MAKE);
-	if (!em) 
-		return 0;
-	return !strcmp (em->exif_entry_get_value(value, sizeof (value)), "Canon");
+	return mnote_identify (this, EXIF_MNOTE_VENDOR_CANON, e);
 }
 
 
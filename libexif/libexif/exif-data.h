@@ -39,13 +39,42 @@
 #include "exif-content.h"
 #include "exif-mnote-data.h"
 
+#include <vector>
+
 class ExifContent;
 class ExifEntry;
+class ExifData;
 class ExifDataPrivate;
 
 
 typedef void (* ExifDataForeachContentFunc) (ExifContent *, void *user_data);
 
+/*! Decision of an #ExifDataLoadFilter */
+typedef enum {
+	/*! Go on loading and keep asking */
+	EXIF_DATA_FILTER_UNDECIDED = 0,
+	/*! Load the rest of the data without asking again */
+	EXIF_DATA_FILTER_ACCEPT,
+	/*! Stop loading and drop what has been loaded */
+	EXIF_DATA_FILTER_REJECT
+} ExifDataFilterResult;
+
+/*! Function deciding while loading whether the data is wanted, set with
+ * #exif_data_set_load_filter. Until it has decided, it is called with
+ * each entry once it has been loaded into IFD ifd, and with e NULL
+ * before any IFD other than IFD 0 is loaded. The MakerNote is only
+ * interpreted once all IFDs have been loaded, so a rejection always
+ * saves that work. Data the filter never decides on is kept.
+ *
+ * \param[in] data data being loaded
+ * \param[in] ifd IFD of the entry, or IFD about to be loaded
+ * \param[in] e loaded entry, or NULL
+ * \param[in] user_data data passed to exif_data_set_load_filter
+ * \return decision
+ */
+typedef ExifDataFilterResult (* ExifDataLoadFilter) (ExifData *data,
+		ExifIfd ifd, const ExifEntry *e, void *user_data);
+
 
 
 /*! Options to configure the behaviour of #ExifData */
@@ -58,9 +87,47 @@ typedef enum {
 	EXIF_DATA_OPTION_FOLLOW_SPECIFICATION = 1 << 1,
 
 	/*! Leave the MakerNote alone, which could cause it to be corrupted */
-	EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE = 1 << 2
+	EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE = 1 << 2,
+
+	/*! Do not load the thumbnail. It is dropped when the data is saved */
+	EXIF_DATA_OPTION_SKIP_THUMBNAIL = 1 << 3,
+
+	/*! Keep a reference to the thumbnail in the loaded data instead of
+	 * copying it. That data has to stay valid until the thumbnail has
+	 * been fetched with #exif_data_get_thumbnail, or until the
+	 * #ExifData is loaded again or freed. */
+	EXIF_DATA_OPTION_REFERENCE_THUMBNAIL = 1 << 4
 } ExifDataOption;
 
+/*! One piece of the EXIF data saved by #exif_data_save_data_chunks */
+typedef struct {
+	const unsigned char *data;
+	unsigned int size;
+} ExifDataChunk;
+
+/*! Bytes held by an #ExifData, as returned by #exif_data_memory_usage.
+ * What the allocator itself needs per block is not included. */
+typedef struct {
+	/*! Values of the entries of each IFD */
+	unsigned long entries[EXIF_IFD_COUNT];
+
+	/*! Copy of the thumbnail; a referenced thumbnail is not counted */
+	unsigned long thumbnail;
+
+	/*! Interpreted MakerNote, by the vendor it has been read as */
+	unsigned long mnote[EXIF_MNOTE_VENDOR_COUNT];
+
+	/*! The #ExifData and #ExifContent objects and the capacity of
+	 * their vectors */
+	unsigned long containers;
+
+	/*! Buffers kept by #exif_data_reset to be used again */
+	unsigned long kept;
+
+	/*! Sum of all of the above */
+	unsigned long total;
+} ExifDataMemoryUsage;
+
 class  ExifDataPrivate
 {
 public:
@@ -76,6 +143,15 @@ public:
 		md=NULL;
 		options=EXIF_DATA_OPTION_IGNORE_UNKNOWN;
 		data_type=EXIF_DATA_TYPE_UNCOMPRESSED_CHUNKY;
+		offset_tiff=0;
+		deferred=NULL;
+		defer_min=0;
+		thumbnail=NULL;
+		thumbnail_size=0;
+		thumbnail_skipped=0;
+		filter=NULL;
+		filter_data=NULL;
+		filter_result=EXIF_DATA_FILTER_UNDECIDED;
 	}
 
 	virtual void inline data_free()
@@ -88,13 +164,12 @@ public:
 
 	}
 	void exif_data_set_option(ExifDataOption Typex);
-	int exif_data_load_data_entry (ExifEntry *entry,
-		const unsigned char *d,
-		unsigned int size, unsigned int offset);
 	unsigned char *exif_data_alloc (unsigned int i);
 	void exif_data_save_data_entry (ExifEntry *e,
 		unsigned char **d, unsigned int *ds,
 		unsigned int offset);
+	int exif_data_defer_value (unsigned int field,
+		const unsigned char *data, unsigned int size);
 
 public:
 	ExifByteOrder order;
@@ -107,6 +182,30 @@ public:
 	/* Temporarily used while loading data */
 	unsigned int offset_mnote;
 
+	/* Offset of the TIFF header in the data last loaded */
+	unsigned int offset_tiff;
+
+	/* Thumbnail in the data last loaded, if it has not been copied to
+	 * ExifData::data because of EXIF_DATA_OPTION_REFERENCE_THUMBNAIL,
+	 * and whether it has been skipped because of
+	 * EXIF_DATA_OPTION_SKIP_THUMBNAIL */
+	const unsigned char *thumbnail;
+	unsigned int thumbnail_size;
+	int thumbnail_skipped;
+
+	/* Filter deciding while loading whether to go on, and its decision
+	 * on the data last loaded */
+	ExifDataLoadFilter filter;
+	void *filter_data;
+	ExifDataFilterResult filter_result;
+
+	/* Used while saving with exif_data_save_data_chunks: the values of
+	 * at least defer_min bytes that are referenced instead of copied,
+	 * and the offsets of the fields that have to point to them */
+	std::vector<ExifDataChunk> *deferred;
+	std::vector<unsigned int> deferred_fields;
+	unsigned int defer_min;
+
 	ExifDataOption options;
 	ExifDataType data_type;
 };
@@ -124,6 +223,7 @@ public:
 	ExifEntry *exif_data_get_entry(ExifTag t);
 	void exif_data_free();
 	void exif_data_new ();
+	void exif_data_reset ();
 	void exif_data_dump ();
 	void exif_data_set_option(ExifDataOption Typex);
 	void exif_data_set_data_type (ExifDataType dt);
@@ -133,7 +233,16 @@ public:
 		unsigned int ds, unsigned int offset, unsigned int recursion_depth);
 	void exif_data_load_data_thumbnail (const unsigned char *d,
 				unsigned int ds, ExifLong o, ExifLong s);
+	int exif_data_load_filter (ExifIfd ifd, const ExifEntry *e);
+	void exif_data_set_load_filter (ExifDataLoadFilter func, void *user_data);
+	ExifDataFilterResult exif_data_get_filter_result ();
+	void exif_data_set_allocator (ExifMemAllocFunc alloc0, ExifMemFreeFunc free0,
+		void *user_data0);
+	void exif_data_set_counting (ExifMemStats *stats);
+	void exif_data_memory_usage (ExifDataMemoryUsage *usage);
 	void exif_data_save_data (unsigned char **d, unsigned int *ds);
+	void exif_data_save_data_chunks (unsigned char **d, unsigned int *ds,
+		std::vector<ExifDataChunk> *chunks, unsigned int min);
 	void exif_data_save_data_content (ExifContent *ifd0,
 		unsigned char **d, unsigned int *ds,
 		unsigned int offset);
@@ -152,6 +261,11 @@ public:
 	void exif_data_log ();
 	ExifByteOrder exif_data_get_byte_order ();
 	void exif_data_set_byte_order (ExifByteOrder order);
+	unsigned int exif_data_get_entry_offset (ExifEntry *e);
+	int exif_data_patch_entry (ExifEntry *e, unsigned char *d, unsigned int ds);
+	int exif_data_patch_entry_file (ExifEntry *e, const char *path);
+	unsigned int exif_data_get_thumbnail_size ();
+	unsigned char *exif_data_get_thumbnail (unsigned int *ds);
 public:
 	//Camera Type
 	int exif_mnote_data_olympus_identify (const ExifEntry *e);
@@ -159,12 +273,13 @@ public:
 	int exif_mnote_data_fuji_identify (const ExifEntry *e);
 	int  exif_mnote_data_canon_identify (const ExifEntry *e);
 	int exif_mnote_data_pentax_identify (const ExifEntry *e);
-	void entry_set_byte_order (ExifEntry *e, void *data);
 public:
 	/*! Data for each IFD */
 	ExifContent *ifd[EXIF_IFD_COUNT];
 
-	/*! Pointer to thumbnail image, or NULL if not available */
+	/*! Pointer to thumbnail image, or NULL if not available. With
+	 * #EXIF_DATA_OPTION_REFERENCE_THUMBNAIL, it is only set once
+	 * #exif_data_get_thumbnail has been called. */
 	unsigned char *data;
 
 	/*! Number of bytes in thumbnail image at \c data */
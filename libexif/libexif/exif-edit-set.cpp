@@ -0,0 +1,301 @@
+/* exif-edit-set.cpp
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include "exif-edit-set.h"
+#include "exif-content.h"
+#include "exif-entry.h"
+
+#include <string.h>
+#include <algorithm>
+
+static bool
+edit_less (const ExifEdit &a, const ExifEdit &b)
+{
+	if (a.ifd != b.ifd)
+		return a.ifd < b.ifd;
+	return a.tag < b.tag;
+}
+
+/* Tags that are written by exif_data_save_data from the structure of
+ * the data and must not be edited */
+static int
+edit_tag_is_pointer (ExifTag tag)
+{
+	switch (tag) {
+	case EXIF_TAG_EXIF_IFD_POINTER:
+	case EXIF_TAG_GPS_INFO_IFD_POINTER:
+	case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
+	case EXIF_TAG_JPEG_INTERCHANGE_FORMAT:
+	case EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static ExifEdit
+edit_new (ExifEditType type, ExifIfd ifd, ExifTag tag)
+{
+	ExifEdit e;
+
+	e.type = type;
+	e.ifd = ifd;
+	e.tag = tag;
+	e.format = EXIF_FORMAT_NULL;
+	e.components = 0;
+	e.order = EXIF_BYTE_ORDER_MOTOROLA;
+	e.offset = 0;
+	e.size = 0;
+	return e;
+}
+
+/*! Add an edit setting the value of a tag. The tag is added to the IFD
+ * if it does not exist. The value is copied into the set.
+ *
+ * \param[in] ifd IFD of the tag
+ * \param[in] tag tag to set
+ * \param[in] format format of the value
+ * \param[in] components number of components of the value
+ * \param[in] value components in the given format
+ * \param[in] order byte order of value; it is converted to the byte
+ *   order of the data the set is applied to
+ * \return 1 on success, 0 if the value is invalid
+ */
+int ExifEditSet::exif_edit_set_set (ExifIfd ifd, ExifTag tag,
+				    ExifFormat format, unsigned long components,
+				    const unsigned char *value, ExifByteOrder order)
+{
+	unsigned int s = exif_format_get_size (format);
+	ExifEdit e;
+
+	if (!s || (components > 0xffffffffUL / s))
+		return 0;
+	s *= (unsigned int) components;
+	if (s && !value)
+		return 0;
+
+	e = edit_new (EXIF_EDIT_SET, ifd, tag);
+	e.format = format;
+	e.components = components;
+	e.order = order;
+	e.offset = (unsigned int) priv.values.size ();
+	e.size = s;
+	priv.values.insert (priv.values.end (), value, value + s);
+	edits.push_back (e);
+	priv.sorted = 0;
+	return 1;
+}
+
+/*! Add an edit removing a tag from an IFD.
+ *
+ * \param[in] ifd IFD of the tag
+ * \param[in] tag tag to remove
+ * \return 1
+ */
+int ExifEditSet::exif_edit_set_remove (ExifIfd ifd, ExifTag tag)
+{
+	edits.push_back (edit_new (EXIF_EDIT_REMOVE, ifd, tag));
+	priv.sorted = 0;
+	return 1;
+}
+
+/*! Add an edit adding a tag with the default value set by
+ * #exif_entry_initialize. An existing tag is left as it is.
+ *
+ * \param[in] ifd IFD of the tag
+ * \param[in] tag tag to add
+ * \return 1
+ */
+int ExifEditSet::exif_edit_set_initialize (ExifIfd ifd, ExifTag tag)
+{
+	edits.push_back (edit_new (EXIF_EDIT_INITIALIZE, ifd, tag));
+	priv.sorted = 0;
+	return 1;
+}
+
+/*! Sort the edits by IFD and tag and check them. Every edit has to
+ * refer to a valid IFD, must not touch the tags pointing to other IFDs
+ * or the thumbnail, and each tag of an IFD may be edited only once.
+ *
+ * \param[in] log where to report invalid edits, or NULL
+ * \return 1 if the set is valid, 0 otherwise
+ */
+int ExifEditSet::exif_edit_set_validate (ExifLog *log)
+{
+	std::vector<ExifEdit>::size_type i;
+
+	if (!priv.sorted) {
+		std::stable_sort (edits.begin (), edits.end (), edit_less);
+		priv.sorted = 1;
+	}
+
+	for (i = 0; i < edits.size (); i++) {
+		if ((edits[i].ifd < EXIF_IFD_0) || (edits[i].ifd >= EXIF_IFD_COUNT)) {
+			if (log)
+				log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifEditSet",
+					"Edit of tag 0x%04x refers to an invalid "
+					"IFD.", edits[i].tag);
+			return 0;
+		}
+		if (edit_tag_is_pointer (edits[i].tag)) {
+			if (log)
+				log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifEditSet",
+					"Tag 0x%04x is set when saving and cannot "
+					"be edited.", edits[i].tag);
+			return 0;
+		}
+		if (i && !edit_less (edits[i - 1], edits[i])) {
+			if (log)
+				log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifEditSet",
+					"Tag 0x%04x is edited more than once in "
+					"IFD '%s'.", edits[i].tag,
+					exif_ifd_get_name (edits[i].ifd));
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Move entry j of the IFD to position w of dst */
+static void
+edit_move (std::vector<ExifEntry> &entries, std::vector<ExifEntry> &dst,
+	   std::vector<ExifEntry>::size_type j,
+	   std::vector<ExifEntry>::size_type w)
+{
+	if ((&dst != &entries) || (w != j))
+		dst[w].exif_entry_swap (entries[j]);
+}
+
+/* Apply the edits [b, e), all of them for the IFD c */
+static int
+edit_apply_content (ExifContent *c, const ExifEdit *b, const ExifEdit *e,
+		    const unsigned char *values)
+{
+	std::vector<ExifEntry> &entries = c->entries;
+	std::vector<ExifEntry> out;
+	std::vector<ExifEntry>::size_type j, w, n = entries.size (), added = 0, removed = 0;
+	std::vector<ExifEntry> *dst;
+	const ExifEdit *k;
+	int found, ok = 1;
+
+	/* Count the entries added and removed, to size the IFD once */
+	for (j = 0, k = b; k != e; k++) {
+		while ((j < n) && (entries[j].tag < k->tag))
+			j++;
+		found = (j < n) && (entries[j].tag == k->tag);
+		if (found && (k->type == EXIF_EDIT_REMOVE))
+			removed++;
+		else if (!found && (k->type != EXIF_EDIT_REMOVE))
+			added++;
+	}
+
+	/* Without new entries, the IFD is edited in place */
+	if (added) {
+		out.resize (n - removed + added);
+		dst = &out;
+	} else
+		dst = &entries;
+
+	for (j = 0, w = 0, k = b; k != e; k++) {
+		while ((j < n) && (entries[j].tag < k->tag))
+			edit_move (entries, *dst, j++, w++);
+		found = (j < n) && (entries[j].tag == k->tag);
+
+		switch (k->type) {
+		case EXIF_EDIT_REMOVE:
+			if (found)
+				j++;
+			break;
+		case EXIF_EDIT_INITIALIZE:
+			if (found) {
+				edit_move (entries, *dst, j++, w++);
+				break;
+			}
+			(*dst)[w].parent = c;
+			(*dst)[w].priv.mem = c->priv.mem;
+			(*dst)[w++].exif_entry_initialize (k->tag);
+			break;
+		case EXIF_EDIT_SET:
+			if (!found) {
+				(*dst)[w].parent = c;
+				(*dst)[w].priv.mem = c->priv.mem;
+				(*dst)[w].tag = k->tag;
+				if (!(*dst)[w].exif_entry_set_value (k->format,
+						k->components, values + k->offset, k->order))
+					ok = 0;
+				w++;
+				break;
+			}
+			if (!entries[j].exif_entry_set_value (k->format,
+					k->components, values + k->offset, k->order))
+				ok = 0;
+			edit_move (entries, *dst, j++, w++);
+			break;
+		}
+	}
+	while (j < n)
+		edit_move (entries, *dst, j++, w++);
+
+	if (added)
+		entries.swap (out);
+	else
+		entries.erase (entries.begin () + w, entries.end ());
+	return ok;
+}
+
+/*! Apply the edits to the given data and, optionally, save it. The set
+ * is validated first; if it is invalid, the data is left untouched.
+ *
+ * \param[in,out] data data to edit
+ * \param[out] d if not NULL, the data saved by #exif_data_save_data
+ *   after editing
+ * \param[out] ds number of bytes at d
+ * \return 1 on success, 0 if the set is invalid, a value could not be
+ *   set for lack of memory or the data could not be saved
+ */
+int ExifEditSet::exif_edit_set_apply (ExifData *data,
+				      unsigned char **d, unsigned int *ds)
+{
+	std::vector<ExifEdit>::size_type b, e;
+	const unsigned char *values;
+	int ok = 1;
+
+	if (!data)
+		return 0;
+	if (!exif_edit_set_validate (&data->priv.log))
+		return 0;
+
+	values = priv.values.empty () ? NULL : &priv.values[0];
+	for (b = 0; b < edits.size (); b = e) {
+		for (e = b + 1; (e < edits.size ()) && (edits[e].ifd == edits[b].ifd); e++)
+			;
+		if (data->ifd[edits[b].ifd] &&
+		    !edit_apply_content (data->ifd[edits[b].ifd],
+					 &edits[0] + b, &edits[0] + e, values))
+			ok = 0;
+	}
+
+	if (d && ds) {
+		data->exif_data_save_data (d, ds);
+		if (!*d)
+			ok = 0;
+	}
+	return ok;
+}
@@ -0,0 +1,107 @@
+/*! \file exif-edit-set.h
+ * \brief Applying many edits to the EXIF data at once
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __EXIF_EDIT_SET_H__
+#define __EXIF_EDIT_SET_H__
+
+#include "exif-data.h"
+#include "exif-log.h"
+
+#include <vector>
+
+/*! Kind of an edit */
+typedef enum {
+	/*! Set the value of the tag, adding the tag if needed */
+	EXIF_EDIT_SET = 0,
+	/*! Remove the tag if it exists */
+	EXIF_EDIT_REMOVE,
+	/*! Add the tag with its default value unless it exists */
+	EXIF_EDIT_INITIALIZE
+} ExifEditType;
+
+/*! One edit of an #ExifEditSet */
+typedef struct {
+	ExifEditType type;
+	ExifIfd ifd;
+	ExifTag tag;
+
+	/*! Value of an #EXIF_EDIT_SET edit: its format, number of
+	 * components and byte order, and where its bytes are stored in
+	 * the value store of the set */
+	ExifFormat format;
+	unsigned long components;
+	ExifByteOrder order;
+	unsigned int offset;
+	unsigned int size;
+} ExifEdit;
+
+class ExifEditSetPrivate
+{
+public:
+	ExifEditSetPrivate()
+	{
+		sorted=1;
+	}
+public:
+	/* Values of the EXIF_EDIT_SET edits, one after the other */
+	std::vector<unsigned char> values;
+
+	/* Set while the edits are in order of IFD and tag */
+	int sorted;
+};
+
+/*! Set, remove and initialize operations on tags of several IFDs,
+ * collected once and applied to any number of #ExifData. Each IFD that
+ * is edited is updated in a single pass over its entries, with at most
+ * one allocation for the entries of the IFD, instead of one lookup and
+ * reallocation per tag.
+ */
+class ExifEditSet
+{
+public:
+	ExifEditSet()
+	{
+		Init();
+	}
+
+	void inline Init()
+	{
+		edits.clear();
+		priv.values.clear();
+		priv.sorted=1;
+	}
+public:
+	int exif_edit_set_set (ExifIfd ifd, ExifTag tag, ExifFormat format,
+			       unsigned long components,
+			       const unsigned char *value, ExifByteOrder order);
+	int exif_edit_set_remove (ExifIfd ifd, ExifTag tag);
+	int exif_edit_set_initialize (ExifIfd ifd, ExifTag tag);
+	int exif_edit_set_validate (ExifLog *log);
+	int exif_edit_set_apply (ExifData *data,
+				 unsigned char **d, unsigned int *ds);
+public:
+	/*! Edits of the set. They are sorted by IFD and tag when the set
+	 * is validated. */
+	std::vector<ExifEdit> edits;
+
+	ExifEditSetPrivate priv;
+};
+
+#endif /* __EXIF_EDIT_SET_H__ */
@@ -22,6 +22,7 @@
 
 #include "exif-entry.h"
 #include "exif-ifd.h"
+#include "exif-system.h"
 #include "exif-utils.h"
 #include "i18n.h"
 
@@ -32,6 +33,8 @@
 #include <time.h>
 #include <math.h>
 
+#include <algorithm>
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -67,7 +70,7 @@ unsigned char *ExifEntry::exif_entry_alloc (unsigned int i)
 
 	if (!i) return NULL;
 
-	priv.mem->exif_mem_alloc (&d, i/sizeof(unsigned char));
+	d = priv.mem->exif_mem_alloc_buffer (i);
 	if (d) return d;
 
 	if ( parent &&  parent->parent)
@@ -83,7 +86,7 @@ unsigned char *ExifEntry::exif_entry_realloc (unsigned char *d_orig, unsigned in
 
 	if (!i) {  return NULL; }
 
-	d =  priv.mem->exif_mem_realloc (&d_orig, i);
+	d =  priv.mem->exif_mem_realloc (&d_orig, size, i);
 	if (d) return d;
 
 	if ( parent &&  parent->parent)
@@ -109,6 +112,21 @@ void ExifEntry::exif_entry_free()
 	data_free();
 }
 
+/*! Exchange the contents of two entries without copying their data.
+ *
+ * \param[in,out] e entry to exchange with this one
+ */
+void ExifEntry::exif_entry_swap (ExifEntry &e)
+{
+	std::swap (tag, e.tag);
+	std::swap (format, e.format);
+	std::swap (components, e.components);
+	std::swap (data, e.data);
+	std::swap (size, e.size);
+	std::swap (parent, e.parent);
+	std::swap (priv, e.priv);
+}
+
 /*! Get a value and convert it to an ExifShort.
  * \bug Not all types are converted that could be converted and no indication
  *      is made when that occurs
@@ -156,6 +174,9 @@ void ExifEntry::exif_entry_fix ()
 	ExifRational r;
 	ExifSRational sr;
 
+	/* Whatever is fixed below has to be saved from the entry again */
+	priv.dirty = 1;
+
 	switch ( tag) {
 	
 	/* These tags all need to be of format SHORT. */
@@ -193,7 +214,7 @@ void ExifEntry::exif_entry_fix ()
 				exif_format_get_name ( format),
 				exif_format_get_name (EXIF_FORMAT_SHORT));
 
-			o = parent->parent->exif_data_get_byte_order ();
+			o = exif_entry_get_byte_order ();
 			newsize =  components * exif_format_get_size (EXIF_FORMAT_SHORT);
 			newdata = exif_entry_alloc (newsize);
 			if (!newdata) {
@@ -240,7 +261,7 @@ void ExifEntry::exif_entry_fix ()
 		switch ( format) {
 		case EXIF_FORMAT_SRATIONAL:
 			if (! parent || ! parent->parent) break;
-			o = parent->parent->exif_data_get_byte_order ();
+			o = exif_entry_get_byte_order ();
 			for (i = 0; i <  components; i++) {
 				sr = exif_get_srational ( data + i * 
 					exif_format_get_size (
@@ -273,7 +294,7 @@ void ExifEntry::exif_entry_fix ()
 		switch ( format) {
 		case EXIF_FORMAT_RATIONAL:
 			if (! parent || ! parent->parent) break;
-			o = parent->parent->exif_data_get_byte_order ();
+			o = exif_entry_get_byte_order ();
 			for (i = 0; i <  components; i++) {
 				r = exif_get_rational ( data + i * 
 					exif_format_get_size (
@@ -386,6 +407,71 @@ void ExifEntry::exif_entry_fix ()
 	}
 }
 
+/*
+ * Helpers for exif_entry_format_value. They print numbers right-aligned
+ * into the end of a small scratch buffer and append the result to the
+ * caller's buffer, keeping track of the length so that long arrays do not
+ * need to rescan the output.
+ */
+
+/*! Print v in decimal, ending just before end.
+ * \return pointer to the first character printed
+ */
+static char *format_ulong (char *end, unsigned long v)
+{
+	do {
+		*--end = (char) ('0' + v % 10);
+		v /= 10;
+	} while (v);
+	return end;
+}
+
+/*! Print v in decimal, ending just before end.
+ * \return pointer to the first character printed
+ */
+static char *format_slong (char *end, long v)
+{
+	if (v >= 0)
+		return format_ulong (end, (unsigned long) v);
+	end = format_ulong (end, (unsigned long) -(v + 1) + 1);
+	*--end = '-';
+	return end;
+}
+
+/*! Append the n characters at s to the string of length len in val, a
+ * buffer of maxlen bytes. Like snprintf, the output is truncated to fit and
+ * is always NUL-terminated.
+ * \return new length of the string in val
+ */
+static size_t format_append (char *val, size_t maxlen, size_t len,
+			     const char *s, size_t n)
+{
+	if (n > maxlen - 1 - len)
+		n = maxlen - 1 - len;
+	memcpy (val + len, s, n);
+	len += n;
+	val[len] = '\0';
+	return len;
+}
+
+/*! Number of decimals to print for a rational with the given denominator.
+ * This is (int)(log10(den)-0.08+1.0), scaled so that denominators within
+ * the range 13..120 will show 2 decimal points, without calling log10.
+ */
+static int format_rational_decimals (unsigned long den)
+{
+	static const unsigned long thresholds[] = {
+		2UL, 13UL, 121UL, 1203UL, 12023UL, 120227UL, 1202265UL,
+		12022645UL, 120226444UL, 1202264435UL
+	};
+	int decimals = 0;
+
+	while ((decimals < (int) (sizeof (thresholds) / sizeof (thresholds[0]))) &&
+	       (den >= thresholds[decimals]))
+		decimals++;
+	return decimals;
+}
+
 /*! Format the value of an ExifEntry for human display in a generic way.
  * The output is localized. The formatting is independent of the tag number
  * and is based entirely on the data type.
@@ -395,16 +481,16 @@ void ExifEntry::exif_entry_fix ()
  */
 void ExifEntry::exif_entry_format_value(char *val, size_t maxlen)
 {
+	static const char hex[] = "0123456789abcdef";
 	ExifByte v_byte;
-	ExifShort v_short;
-	ExifSShort v_sshort;
-	ExifLong v_long;
 	ExifRational v_rat;
 	ExifSRational v_srat;
-	ExifSLong v_slong;
 	unsigned int i;
 	size_t len;
-	const ExifByteOrder o = parent->parent->exif_data_get_byte_order ();
+	int n;
+	char b[32], *p;
+	char * const e = b + sizeof (b);
+	const ExifByteOrder o = exif_entry_get_byte_order ();
 
 	if (! size || !maxlen)
 		return;
@@ -415,63 +501,47 @@ void ExifEntry::exif_entry_format_value(char *val, size_t maxlen)
 		break;
 	case EXIF_FORMAT_BYTE:
 	case EXIF_FORMAT_SBYTE:
-		v_byte =  data[0];
-		snprintf (val, maxlen, "0x%02x", v_byte);
-		len = strlen (val);
-		for (i = 1; i <  components; i++) {
+		len = 0;
+		for (i = 0; !i || (i <  components); i++) {
 			v_byte =  data[i];
-			snprintf (val+len, maxlen-len, ", 0x%02x", v_byte);
-			len += strlen (val+len);
+			p = e;
+			*--p = hex[v_byte & 0xf];
+			*--p = hex[v_byte >> 4];
+			*--p = 'x';
+			*--p = '0';
+			if (i) {
+				*--p = ' ';
+				*--p = ',';
+			}
+			len = format_append (val, maxlen, len, p, e - p);
 			if (len >= maxlen-1) break;
 		}
 		break;
 	case EXIF_FORMAT_SHORT:
-		v_short = exif_get_short ( data, o);
-		snprintf (val, maxlen, "%u", v_short);
-		len = strlen (val);
-		for (i = 1; i <  components; i++) {
-			v_short = exif_get_short ( data +
-				exif_format_get_size ( format) * i, o);
-			snprintf (val+len, maxlen-len, ", %u", v_short);
-			len += strlen (val+len);
-			if (len >= maxlen-1) break;
-		}
-		break;
 	case EXIF_FORMAT_SSHORT:
-		v_sshort = exif_get_sshort ( data, o);
-		snprintf (val, maxlen, "%i", v_sshort);
-		len = strlen (val);
-		for (i = 1; i <  components; i++) {
-			v_sshort = exif_get_short ( data +
-				exif_format_get_size ( format) *
-				i, o);
-			snprintf (val+len, maxlen-len, ", %i", v_sshort);
-			len += strlen (val+len);
-			if (len >= maxlen-1) break;
-		}
-		break;
 	case EXIF_FORMAT_LONG:
-		v_long = exif_get_long ( data, o);
-		snprintf (val, maxlen, "%lu", (unsigned long) v_long);
-		len = strlen (val);
-		for (i = 1; i <  components; i++) {
-			v_long = exif_get_long ( data +
-				exif_format_get_size ( format) *
-				i, o);
-			snprintf (val+len, maxlen-len, ", %lu", (unsigned long) v_long);
-			len += strlen (val+len);
-			if (len >= maxlen-1) break;
-		}
-		break;
 	case EXIF_FORMAT_SLONG:
-		v_slong = exif_get_slong ( data, o);
-		snprintf (val, maxlen, "%li", (long) v_slong);
-		len = strlen (val);
-		for (i = 1; i <  components; i++) {
-			v_slong = exif_get_slong ( data +
-				exif_format_get_size ( format) * i, o);
-			snprintf (val+len, maxlen-len, ", %li", (long) v_slong);
-			len += strlen (val+len);
+		len = 0;
+		for (i = 0; !i || (i <  components); i++) {
+			switch ( format) {
+			case EXIF_FORMAT_SHORT:
+				p = format_ulong (e, exif_get_short ( data + 2 * i, o));
+				break;
+			case EXIF_FORMAT_SSHORT:
+				p = format_slong (e, exif_get_sshort ( data + 2 * i, o));
+				break;
+			case EXIF_FORMAT_LONG:
+				p = format_ulong (e, exif_get_long ( data + 4 * i, o));
+				break;
+			default:
+				p = format_slong (e, exif_get_slong ( data + 4 * i, o));
+				break;
+			}
+			if (i) {
+				*--p = ' ';
+				*--p = ',';
+			}
+			len = format_append (val, maxlen, len, p, e - p);
 			if (len >= maxlen-1) break;
 		}
 		break;
@@ -482,52 +552,48 @@ void ExifEntry::exif_entry_format_value(char *val, size_t maxlen)
 	case EXIF_FORMAT_RATIONAL:
 		len = 0;
 		for (i = 0; i <  components; i++) {
-			if (i > 0) {
-				snprintf (val+len, maxlen-len, ", ");
-				len += strlen (val+len);
-			}
+			if (i > 0)
+				len = format_append (val, maxlen, len, ", ", 2);
 			v_rat = exif_get_rational (
 				 data + 8 * i, o);
 			if (v_rat.denominator) {
-				/*
-				 * Choose the number of significant digits to
-				 * display based on the size of the denominator.
-				 * It is scaled so that denominators within the
-				 * range 13..120 will show 2 decimal points.
-				 */
-				int decimals = (int)(log10((double)v_rat.denominator)-0.08+1.0);
-				snprintf (val+len, maxlen-len, "%2.*f",
-					  decimals,
+				n = snprintf (val+len, maxlen-len, "%2.*f",
+					  format_rational_decimals (v_rat.denominator),
 					  (double) v_rat.numerator /
 					  (double) v_rat.denominator);
-			} else
-				snprintf (val+len, maxlen-len, "%lu/%lu",
-				  (unsigned long) v_rat.numerator,
-				  (unsigned long) v_rat.denominator);
-			len += strlen (val+len);
+				if (n > 0)
+					len += MIN ((size_t) n, maxlen-1-len);
+			} else {
+				p = format_ulong (e, v_rat.denominator);
+				*--p = '/';
+				p = format_ulong (p, v_rat.numerator);
+				len = format_append (val, maxlen, len, p, e - p);
+			}
 			if (len >= maxlen-1) break;
 		}
 		break;
 	case EXIF_FORMAT_SRATIONAL:
 		len = 0;
 		for (i = 0; i <  components; i++) {
-			if (i > 0) {
-				snprintf (val+len, maxlen-len, ", ");
-				len += strlen (val+len);
-			}
+			if (i > 0)
+				len = format_append (val, maxlen, len, ", ", 2);
 			v_srat = exif_get_srational (
 				 data + 8 * i, o);
 			if (v_srat.denominator) {
-				int decimals = (int)(log10(fabs((double)v_srat.denominator))-0.08+1.0);
-				snprintf (val+len, maxlen-len, "%2.*f",
-					  decimals,
+				n = snprintf (val+len, maxlen-len, "%2.*f",
+					  format_rational_decimals (v_srat.denominator < 0 ?
+						(unsigned long) -(v_srat.denominator + 1) + 1 :
+						(unsigned long) v_srat.denominator),
 					  (double) v_srat.numerator /
 					  (double) v_srat.denominator);
-			} else
-				snprintf (val+len, maxlen-len, "%li/%li",
-				  (long) v_srat.numerator,
-				  (long) v_srat.denominator);
-			len += strlen (val+len);
+				if (n > 0)
+					len += MIN ((size_t) n, maxlen-1-len);
+			} else {
+				p = format_slong (e, v_srat.denominator);
+				*--p = '/';
+				p = format_slong (p, v_srat.numerator);
+				len = format_append (val, maxlen, len, p, e - p);
+			}
 			if (len >= maxlen-1) break;
 		}
 		break;
@@ -587,35 +653,44 @@ int ExifEntry::match_repeated_char(const unsigned char *data, unsigned char ch,
 	return i;
 }
 
-#define CF(target,v,maxlen)					\
+#ifndef NO_VERBOSE_TAG_STRINGS
+#define exif_entry_format_log(e,args) (e)->exif_entry_log args
+#else
+#define exif_entry_format_log(e,args) do { } while (0)
+#endif
+
+#define CF(e,target)							\
 {									\
-	if (format != target) {					\
-		exif_entry_log (EXIF_LOG_CODE_CORRUPT_DATA,	\
+	if ((e)->format != target) {					\
+		exif_entry_format_log (e, (EXIF_LOG_CODE_CORRUPT_DATA,	\
 			_("The tag '%s' contains data of an invalid "	\
 			"format ('%s', expected '%s')."),		\
-			exif_tag_get_name (tag),			\
-			exif_format_get_name (format),		\
-			exif_format_get_name (target));			\
-		break;							\
+			exif_tag_get_name ((e)->tag),			\
+			exif_format_get_name ((e)->format),		\
+			exif_format_get_name (target)));		\
+		return;							\
 	}								\
 }
 
-#define CC(target,v,maxlen)					\
+#define CC(e,target)							\
 {									\
-	if (components != target) {				\
-		exif_entry_log (EXIF_LOG_CODE_CORRUPT_DATA,	\
+	if ((e)->components != target) {				\
+		exif_entry_format_log (e, (EXIF_LOG_CODE_CORRUPT_DATA,	\
 			_("The tag '%s' contains an invalid number of "	\
 			  "components (%i, expected %i)."),		\
-			exif_tag_get_name (tag),		\
-			(int) components, (int) target);		\
-		break;							\
+			exif_tag_get_name ((e)->tag),			\
+			(int) (e)->components, (int) target));		\
+		return;							\
 	}								\
 }
 
-static const struct {
+/*! Values of an enumerated tag, indexed directly by the tag value */
+typedef struct {
 	ExifTag tag;
 	const char *strings[10];
-} list[] = {
+} ExifEntryValueList;
+
+static const ExifEntryValueList list[] = {
 #ifndef NO_VERBOSE_TAG_DATA
   { EXIF_TAG_PLANAR_CONFIGURATION,
     { N_("Chunky format"), N_("Planar format"), NULL}},
@@ -653,7 +728,8 @@ static const struct {
   { EXIF_TAG_NULL, {NULL}}
 };
 
-static const struct {
+/*! Sparse values of an enumerated tag, sorted by value */
+typedef struct {
   ExifTag tag;
   struct {
     int index;
@@ -661,7 +737,9 @@ static const struct {
 			    descriptions; the longest one that fits will be
 			    selected */
   } elem[25];
-} list2[] = {
+} ExifEntryValueList2;
+
+static const ExifEntryValueList2 list2[] = {
 #ifndef NO_VERBOSE_TAG_DATA
   { EXIF_TAG_METERING_MODE,
     { {  0, {N_("Unknown"), NULL}},
@@ -778,36 +856,82 @@ static const struct {
   {EXIF_TAG_NULL, { { 0, {NULL}}} }
 };
 
-/*! Return a localized textual representation of the value of the EXIF entry.
- * This is meant for display to the user. The format of each tag is subject
- * to change between locales and in newer versions of libexif.  Users who
- * require the tag data in an unambiguous form should access the data members
- * of the #ExifEntry structure directly.
- *
- * \warning The character set of the returned string may be in
- *          the encoding of the current locale or the native encoding
- *          of the camera.
- * \bug     The EXIF_TAG_XP_* tags are currently always returned in UTF-8,
- *          regardless of locale, and code points above U+FFFF are not
- *          supported.
- *
- * \param[out] val buffer in which to store value
- * \param[in] maxlen length of the buffer val
- * \return val pointer
- */
-const char *ExifEntry::exif_entry_get_value(char *val, unsigned int maxlen)
+/*! Direct lookup from the small values (below 0x100) of each #list2 row to
+ * the matching element, stored as element index plus one. Filled in once by
+ * exif_entry_formatter_init. */
+static unsigned char list2_index[sizeof (list2) / sizeof (list2[0])][0x100];
+
+static ExifByteOrder format_order (ExifEntry *e)
 {
-	unsigned short *utf16=NULL;
-	unsigned int i, j, k;
-	ExifShort v_short, v_short2, v_short3, v_short4;
-	ExifByte v_byte;
-	ExifRational v_rat;
-	ExifSRational v_srat;
-	char b[64];
-	const char *c;
-	ExifByteOrder o;
-	double d;
-	ExifEntry *entry;
+	return e->exif_entry_get_byte_order ();
+}
+
+static void format_user_comment (ExifEntry *e, char *val, unsigned int maxlen,
+				 void *UNUSED(user_data))
+{
+	unsigned int i, j;
+
+	/*
+	 * The specification says UNDEFINED, but some
+	 * manufacturers don't care and use ASCII. If this is the
+	 * case here, only refuse to read it if there is no chance
+	 * of finding readable data.
+	 */
+	if ((e->format != EXIF_FORMAT_ASCII) || 
+	    (e->size <= 8) ||
+	    ( memcmp (e->data, "ASCII\0\0\0"  , 8) &&
+	      memcmp (e->data, "UNICODE\0"    , 8) &&
+	      memcmp (e->data, "JIS\0\0\0\0\0", 8) &&
+	      memcmp (e->data, "\0\0\0\0\0\0\0\0", 8)))
+		CF (e, EXIF_FORMAT_UNDEFINED);
+
+	/*
+	 * Note that, according to the specification (V2.1, p 40),
+	 * the user comment field does not have to be 
+	 * NULL terminated.
+	 */
+	if ((e->size >= 8) && !memcmp (e->data, "ASCII\0\0\0", 8)) {
+		strncpy (val, (char *) e->data + 8, MIN (e->size - 8, maxlen));
+		return;
+	}
+	if ((e->size >= 8) && !memcmp (e->data, "UNICODE\0", 8)) {
+		strncpy (val, _("Unsupported UNICODE string"), maxlen);
+	/* FIXME: use iconv to convert into the locale encoding.
+	 * EXIF 2.2 implies (but does not say) that this encoding is
+	 * UCS-2.
+	 */
+		return;
+	}
+	if ((e->size >= 8) && !memcmp (e->data, "JIS\0\0\0\0\0", 8)) {
+		strncpy (val, _("Unsupported JIS string"), maxlen);
+	/* FIXME: use iconv to convert into the locale encoding */
+		return;
+	}
+
+	/* Check if there is really some information in the tag. */
+	for (i = 0; (i < e->size) &&
+		    (!e->data[i] || (e->data[i] == ' ')); i++);
+	if (i == e->size) return;
+
+	/*
+	 * If we reach this point, the tag does not
+	 * comply with the standard but seems to contain data.
+	 * Print as much as possible.
+	 */
+	exif_entry_format_log (e, (EXIF_LOG_CODE_DEBUG,
+		_("Tag UserComment contains data but is "
+		  "against specification.")));
+	for (j = 0; (i < e->size) && (j < maxlen); i++, j++) {
+		exif_entry_format_log (e, (EXIF_LOG_CODE_DEBUG,
+			_("Byte at position %i: 0x%02x"), i, e->data[i]));
+		val[j] = isprint (e->data[i]) ? e->data[i] : '.';
+	}
+}
+
+static void format_exif_version (ExifEntry *e, char *val, unsigned int maxlen,
+				 void *UNUSED(user_data))
+{
+	unsigned int i;
 	static const struct {
 		char label[5];
 		char major, minor;
@@ -822,547 +946,830 @@ const char *ExifEntry::exif_entry_get_value(char *val, unsigned int maxlen)
 		{""    , 0,  0}
 	};
 
-	/* FIXME: This belongs to somewhere else. */
-	/* libexif should use the default system locale.
-	 * If an application specifically requires UTF-8, then we
-	 * must give the application a way to tell libexif that.
-	 * 
-	 * bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	CF (e, EXIF_FORMAT_UNDEFINED);
+	CC (e, 4);
+	strncpy (val, _("Unknown Exif Version"), maxlen);
+	for (i = 0; *versions[i].label; i++) {
+		if (!memcmp (e->data, versions[i].label, 4)) {
+			snprintf (val, maxlen,
+				_("Exif Version %d.%d"),
+				versions[i].major,
+				versions[i].minor);
+			break;
+		}
+	}
+}
+
+static void format_flash_pix_version (ExifEntry *e, char *val,
+				      unsigned int maxlen,
+				      void *UNUSED(user_data))
+{
+	CF (e, EXIF_FORMAT_UNDEFINED);
+	CC (e, 4);
+	if (!memcmp (e->data, "0100", 4))
+		strncpy (val, _("FlashPix Version 1.0"), maxlen);
+	else if (!memcmp (e->data, "0101", 4))
+		strncpy (val, _("FlashPix Version 1.01"), maxlen);
+	else
+		strncpy (val, _("Unknown FlashPix Version"), maxlen);
+}
+
+static void format_copyright (ExifEntry *e, char *val, unsigned int maxlen,
+			      void *UNUSED(user_data))
+{
+	unsigned int k;
+
+	CF (e, EXIF_FORMAT_ASCII);
+
+	/*
+	 * First part: Photographer.
+	 * Some cameras store a string like "   " here. Ignore it.
+	 * Remember that a corrupted tag might not be NUL-terminated
 	 */
-	bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	if (e->size && e->data && e->match_repeated_char (e->data, ' ', e->size))
+		strncpy (val, (char *) e->data, MIN (maxlen, e->size));
+	else
+		strncpy (val, _("[None]"), maxlen);
+	strncat (val, " ", maxlen - strlen (val));
+	strncat (val, _("(Photographer)"), maxlen - strlen (val));
+
+	/* Second part: Editor. */
+	strncat (val, " - ", maxlen - strlen (val));
+	k = 0;
+	if (e->size && e->data) {
+		const unsigned char *tagdata = (const unsigned char *)memchr (e->data, 0, e->size);
+		if (tagdata++) {
+			int editor_ofs = tagdata - e->data;
+			unsigned int remaining = e->size - editor_ofs;
+			if (e->match_repeated_char (tagdata, ' ', remaining)) {
+				strncat (val, (const char*)tagdata, MIN (maxlen - strlen (val), remaining));
+				++k;
+			}
+		}
+	}
+	if (!k)
+		strncat (val, _("[None]"), maxlen - strlen (val));
+	strncat (val, " ", maxlen - strlen (val));
+	strncat (val, _("(Editor)"), maxlen - strlen (val));
+}
 
-	if (!parent || ! parent->parent || !maxlen)
-		return val;
+static void format_fnumber (ExifEntry *e, char *val, unsigned int maxlen,
+			    void *UNUSED(user_data))
+{
+	ExifRational v_rat;
+	double d;
 
-	/* make sure the returned string is zero terminated */
-	memset (val, 0, maxlen);
-	maxlen--;
-	memset (b, 0, sizeof (b));
+	CF (e, EXIF_FORMAT_RATIONAL);
+	CC (e, 1);
+	v_rat = exif_get_rational (e->data, format_order (e));
+	if (!v_rat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
+	d = (double) v_rat.numerator / (double) v_rat.denominator;
+	snprintf (val, maxlen, "f/%.01f", d);
+}
 
-	/* We need the byte order */
-	o = parent->parent->exif_data_get_byte_order ();
+static void format_aperture_value (ExifEntry *e, char *val, unsigned int maxlen,
+				   void *UNUSED(user_data))
+{
+	ExifRational v_rat;
+	double d;
+	char b[64];
 
-	/* Sanity check */
-	if ( size !=  components * exif_format_get_size ( format)) {
-		snprintf (val, maxlen, _("Invalid size of entry (%i, "
-			"expected %li x %i)."),  size,  components,
-				exif_format_get_size ( format));
-		return val;
+	CF (e, EXIF_FORMAT_RATIONAL);
+	CC (e, 1);
+	v_rat = exif_get_rational (e->data, format_order (e));
+	if (!v_rat.denominator || (0x80000000 == v_rat.numerator)) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
 	}
+	d = (double) v_rat.numerator / (double) v_rat.denominator;
+	snprintf (val, maxlen, _("%.02f EV"), d);
+	snprintf (b, sizeof (b), _(" (f/%.01f)"), pow (2, d / 2.));
+	if (maxlen > strlen (val) + strlen (b))
+		strncat (val, b, maxlen - strlen (val));
+}
 
-	switch ( tag) {
-	case EXIF_TAG_USER_COMMENT:
+static void format_focal_length (ExifEntry *e, char *val, unsigned int maxlen,
+				 void *UNUSED(user_data))
+{
+	ExifRational v_rat;
+	ExifEntry *entry;
+	double d;
+	char b[64];
 
-		/*
-		 * The specification says UNDEFINED, but some
-		 * manufacturers don't care and use ASCII. If this is the
-		 * case here, only refuse to read it if there is no chance
-		 * of finding readable data.
-		 */
-		if (( format != EXIF_FORMAT_ASCII) || 
-		    ( size <= 8) ||
-		    ( memcmp ( data, "ASCII\0\0\0"  , 8) &&
-		      memcmp ( data, "UNICODE\0"    , 8) &&
-		      memcmp ( data, "JIS\0\0\0\0\0", 8) &&
-		      memcmp ( data, "\0\0\0\0\0\0\0\0", 8)))
-			CF (EXIF_FORMAT_UNDEFINED, val, maxlen);
+	CF (e, EXIF_FORMAT_RATIONAL);
+	CC (e, 1);
+	v_rat = exif_get_rational (e->data, format_order (e));
+	if (!v_rat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
 
-		/*
-		 * Note that, according to the specification (V2.1, p 40),
-		 * the user comment field does not have to be 
-		 * NULL terminated.
-		 */
-		if (( size >= 8) && !memcmp ( data, "ASCII\0\0\0", 8)) {
-			strncpy (val, (char *)  data + 8, MIN ( size - 8, maxlen));
-			break;
-		}
-		if (( size >= 8) && !memcmp ( data, "UNICODE\0", 8)) {
-			strncpy (val, _("Unsupported UNICODE string"), maxlen);
-		/* FIXME: use iconv to convert into the locale encoding.
-		 * EXIF 2.2 implies (but does not say) that this encoding is
-		 * UCS-2.
-		 */
-			break;
-		}
-		if (( size >= 8) && !memcmp ( data, "JIS\0\0\0\0\0", 8)) {
-			strncpy (val, _("Unsupported JIS string"), maxlen);
-		/* FIXME: use iconv to convert into the locale encoding */
-			break;
+	/*
+	 * For calculation of the 35mm equivalent,
+	 * Minolta cameras need a multiplier that depends on the
+	 * camera model.
+	 */
+	memset (b, 0, sizeof (b));
+	d = 0.;
+	entry = e->parent->parent->ifd[EXIF_IFD_0]->exif_content_get_entry (EXIF_TAG_MAKE);
+	if (entry && entry->data &&
+	    !strncmp ((char *)entry->data, "Minolta", 7)) {
+		entry = e->parent->parent->ifd[EXIF_IFD_0]->exif_content_get_entry (EXIF_TAG_MODEL);
+		if (entry && entry->data) {
+			if (!strncmp ((char *)entry->data, "DiMAGE 7", 8))
+				d = 3.9;
+			else if (!strncmp ((char *)entry->data, "DiMAGE 5", 8))
+				d = 4.9;
 		}
+	}
+	if (d)
+		snprintf (b, sizeof (b), _(" (35 equivalent: %d mm)"),
+			  (int) (d * (double) v_rat.numerator /
+			  	     (double) v_rat.denominator));
+
+	d = (double) v_rat.numerator / (double) v_rat.denominator;
+	snprintf (val, maxlen, "%.1f mm", d);
+	if (maxlen > strlen (val) + strlen (b))
+		strncat (val, b, maxlen - strlen (val));
+}
 
-		/* Check if there is really some information in the tag. */
-		for (i = 0; (i <  size) &&
-			    (! data[i] || ( data[i] == ' ')); i++);
-		if (i ==  size) break;
+static void format_subject_distance (ExifEntry *e, char *val,
+				     unsigned int maxlen,
+				     void *UNUSED(user_data))
+{
+	ExifRational v_rat;
+	double d;
 
-		/*
-		 * If we reach this point, the tag does not
- 		 * comply with the standard but seems to contain data.
-		 * Print as much as possible.
-		 */
-		exif_entry_log (EXIF_LOG_CODE_DEBUG,
-			_("Tag UserComment contains data but is "
-			  "against specification."));
- 		for (j = 0; (i <  size) && (j < maxlen); i++, j++) {
-			exif_entry_log (EXIF_LOG_CODE_DEBUG,
-				_("Byte at position %i: 0x%02x"), i,  data[i]);
- 			val[j] = isprint ( data[i]) ?  data[i] : '.';
-		}
-		break;
+	CF (e, EXIF_FORMAT_RATIONAL);
+	CC (e, 1);
+	v_rat = exif_get_rational (e->data, format_order (e));
+	if (!v_rat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
+	d = (double) v_rat.numerator / (double) v_rat.denominator;
+	snprintf (val, maxlen, "%.1f m", d);
+}
 
-	case EXIF_TAG_EXIF_VERSION:
-		CF (EXIF_FORMAT_UNDEFINED, val, maxlen);
-		CC ( 4, val, maxlen);
-		strncpy (val, _("Unknown Exif Version"), maxlen);
-		for (i = 0; *versions[i].label; i++) {
-			if (!memcmp ( data, versions[i].label, 4)) {
-    				snprintf (val, maxlen,
-					_("Exif Version %d.%d"),
-					versions[i].major,
-					versions[i].minor);
-    				break;
-			}
-		}
-		break;
-	case EXIF_TAG_FLASH_PIX_VERSION:
-		CF (EXIF_FORMAT_UNDEFINED, val, maxlen);
-		CC ( 4, val, maxlen);
-		if (!memcmp ( data, "0100", 4))
-			strncpy (val, _("FlashPix Version 1.0"), maxlen);
-		else if (!memcmp ( data, "0101", 4))
-			strncpy (val, _("FlashPix Version 1.01"), maxlen);
-		else
-			strncpy (val, _("Unknown FlashPix Version"), maxlen);
-		break;
-	case EXIF_TAG_COPYRIGHT:
-		CF (EXIF_FORMAT_ASCII, val, maxlen);
+static void format_exposure_time (ExifEntry *e, char *val, unsigned int maxlen,
+				  void *UNUSED(user_data))
+{
+	ExifRational v_rat;
+	double d;
 
-		/*
-		 * First part: Photographer.
-		 * Some cameras store a string like "   " here. Ignore it.
-		 * Remember that a corrupted tag might not be NUL-terminated
-		 */
-		if ( size &&  data && match_repeated_char( data, ' ',  size))
-			strncpy (val, (char *)  data, MIN (maxlen,  size));
-		else
-			strncpy (val, _("[None]"), maxlen);
-		strncat (val, " ", maxlen - strlen (val));
-		strncat (val, _("(Photographer)"), maxlen - strlen (val));
-
-		/* Second part: Editor. */
-		strncat (val, " - ", maxlen - strlen (val));
-		k = 0;
-		if ( size &&  data) {
-			const unsigned char *tagdata = (const unsigned char *)memchr( data, 0,  size);
-			if (tagdata++) {
-				int editor_ofs = tagdata -  data;
-				unsigned int remaining =  size - editor_ofs;
-				if (match_repeated_char(tagdata, ' ', remaining)) {
-					strncat (val, (const char*)tagdata, MIN (maxlen - strlen (val), remaining));
-					++k;
-				}
-			}
-		}
-		if (!k)
-			strncat (val, _("[None]"), maxlen - strlen (val));
-		strncat (val, " ", maxlen - strlen (val));
-		strncat (val, _("(Editor)"), maxlen - strlen (val));
+	CF (e, EXIF_FORMAT_RATIONAL);
+	CC (e, 1);
+	v_rat = exif_get_rational (e->data, format_order (e));
+	if (!v_rat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
+	d = (double) v_rat.numerator / (double) v_rat.denominator;
+	if (d < 1)
+		snprintf (val, maxlen, _("1/%i"), (int) (0.5 + 1. / d));
+	else
+		snprintf (val, maxlen, "%i", (int) d);
+	if (maxlen > strlen (val) + strlen (_(" sec.")))
+		strncat (val, _(" sec."), maxlen - strlen (val));
+}
 
-		break;
-	case EXIF_TAG_FNUMBER:
-		CF (EXIF_FORMAT_RATIONAL, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_rat = exif_get_rational ( data, o);
-		if (!v_rat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		d = (double) v_rat.numerator / (double) v_rat.denominator;
-		snprintf (val, maxlen, "f/%.01f", d);
-		break;
-	case EXIF_TAG_APERTURE_VALUE:
-	case EXIF_TAG_MAX_APERTURE_VALUE:
-		CF (EXIF_FORMAT_RATIONAL, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_rat = exif_get_rational ( data, o);
-		if (!v_rat.denominator || (0x80000000 == v_rat.numerator)) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		d = (double) v_rat.numerator / (double) v_rat.denominator;
-		snprintf (val, maxlen, _("%.02f EV"), d);
-		snprintf (b, sizeof (b), _(" (f/%.01f)"), pow (2, d / 2.));
-		if (maxlen > strlen (val) + strlen (b))
-			strncat (val, b, maxlen - strlen (val));
-		break;
-	case EXIF_TAG_FOCAL_LENGTH:
-		CF (EXIF_FORMAT_RATIONAL, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_rat = exif_get_rational ( data, o);
-		if (!v_rat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
+static void format_shutter_speed_value (ExifEntry *e, char *val,
+					unsigned int maxlen,
+					void *UNUSED(user_data))
+{
+	ExifSRational v_srat;
+	double d;
+	char b[64];
 
-		/*
-		 * For calculation of the 35mm equivalent,
-		 * Minolta cameras need a multiplier that depends on the
-		 * camera model.
-		 */
-		d = 0.;
-		entry =  parent->parent->ifd[EXIF_IFD_0]->exif_content_get_entry (EXIF_TAG_MAKE);
-		if (entry && entry->data &&
-		    !strncmp ((char *)entry->data, "Minolta", 7)) {
-			entry =  parent->parent->ifd[EXIF_IFD_0]->exif_content_get_entry (EXIF_TAG_MODEL);
-			if (entry && entry->data) {
-				if (!strncmp ((char *)entry->data, "DiMAGE 7", 8))
-					d = 3.9;
-				else if (!strncmp ((char *)entry->data, "DiMAGE 5", 8))
-					d = 4.9;
-			}
-		}
-		if (d)
-			snprintf (b, sizeof (b), _(" (35 equivalent: %d mm)"),
-				  (int) (d * (double) v_rat.numerator /
-				  	     (double) v_rat.denominator));
-
-		d = (double) v_rat.numerator / (double) v_rat.denominator;
-		snprintf (val, maxlen, "%.1f mm", d);
-		if (maxlen > strlen (val) + strlen (b))
-			strncat (val, b, maxlen - strlen (val));
-		break;
-	case EXIF_TAG_SUBJECT_DISTANCE:
-		CF (EXIF_FORMAT_RATIONAL, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_rat = exif_get_rational ( data, o);
-		if (!v_rat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		d = (double) v_rat.numerator / (double) v_rat.denominator;
-		snprintf (val, maxlen, "%.1f m", d);
-		break;
-	case EXIF_TAG_EXPOSURE_TIME:
-		CF (EXIF_FORMAT_RATIONAL, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_rat = exif_get_rational ( data, o);
-		if (!v_rat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		d = (double) v_rat.numerator / (double) v_rat.denominator;
-		if (d < 1)
-			snprintf (val, maxlen, _("1/%i"), (int) (0.5 + 1. / d));
-		else
-			snprintf (val, maxlen, "%i", (int) d);
-		if (maxlen > strlen (val) + strlen (_(" sec.")))
-			strncat (val, _(" sec."), maxlen - strlen (val));
-		break;
-	case EXIF_TAG_SHUTTER_SPEED_VALUE:
-		CF (EXIF_FORMAT_SRATIONAL, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_srat = exif_get_srational ( data, o);
-		if (!v_srat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		d = (double) v_srat.numerator / (double) v_srat.denominator;
-		snprintf (val, maxlen, _("%.02f EV"), d);
-		d = 1. / pow (2, d);
-		if (d < 1)
-		  snprintf (b, sizeof (b), _(" (1/%d sec.)"), (int) (1. / d));
-		else
-		  snprintf (b, sizeof (b), _(" (%d sec.)"), (int) d);
+	CF (e, EXIF_FORMAT_SRATIONAL);
+	CC (e, 1);
+	v_srat = exif_get_srational (e->data, format_order (e));
+	if (!v_srat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
+	d = (double) v_srat.numerator / (double) v_srat.denominator;
+	snprintf (val, maxlen, _("%.02f EV"), d);
+	d = 1. / pow (2, d);
+	if (d < 1)
+	  snprintf (b, sizeof (b), _(" (1/%d sec.)"), (int) (1. / d));
+	else
+	  snprintf (b, sizeof (b), _(" (%d sec.)"), (int) d);
+	strncat (val, b, maxlen - strlen (val));
+}
+
+static void format_brightness_value (ExifEntry *e, char *val,
+				     unsigned int maxlen,
+				     void *UNUSED(user_data))
+{
+	ExifSRational v_srat;
+	double d;
+	char b[64];
+
+	CF (e, EXIF_FORMAT_SRATIONAL);
+	CC (e, 1);
+	v_srat = exif_get_srational (e->data, format_order (e));
+	if (!v_srat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
+	d = (double) v_srat.numerator / (double) v_srat.denominator;
+	snprintf (val, maxlen, _("%.02f EV"), d);
+	snprintf (b, sizeof (b), _(" (%.02f cd/m^2)"),
+		1. / (M_PI * 0.3048 * 0.3048) * pow (2, d));
+	if (maxlen > strlen (val) + strlen (b))
 		strncat (val, b, maxlen - strlen (val));
-		break;
-	case EXIF_TAG_BRIGHTNESS_VALUE:
-		CF (EXIF_FORMAT_SRATIONAL, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_srat = exif_get_srational ( data, o);
-		if (!v_srat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		d = (double) v_srat.numerator / (double) v_srat.denominator;
-		snprintf (val, maxlen, _("%.02f EV"), d);
-		snprintf (b, sizeof (b), _(" (%.02f cd/m^2)"),
-			1. / (M_PI * 0.3048 * 0.3048) * pow (2, d));
-		if (maxlen > strlen (val) + strlen (b))
-			strncat (val, b, maxlen - strlen (val));
-		break;
-	case EXIF_TAG_FILE_SOURCE:
-		CF (EXIF_FORMAT_UNDEFINED, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_byte =  data[0];
-		if (v_byte == 3)
-			strncpy (val, _("DSC"), maxlen);
-		else
-			snprintf (val, maxlen, _("Internal error (unknown "
-				  "value %i)"), v_byte);
-		break;
-	case EXIF_TAG_COMPONENTS_CONFIGURATION:
-		CF (EXIF_FORMAT_UNDEFINED, val, maxlen);
-		CC ( 4, val, maxlen);
-		for (i = 0; i < 4; i++) {
-			switch ( data[i]) {
-			case 0: c = _("-"); break;
-			case 1: c = _("Y"); break;
-			case 2: c = _("Cb"); break;
-			case 3: c = _("Cr"); break;
-			case 4: c = _("R"); break;
-			case 5: c = _("G"); break;
-			case 6: c = _("B"); break;
-			default: c = _("Reserved"); break;
-			}
-			strncat (val, c, maxlen - strlen (val));
-			if (i < 3)
-				strncat (val, " ", maxlen - strlen (val));
-		}
-		break;
-	case EXIF_TAG_EXPOSURE_BIAS_VALUE:
-		CF (EXIF_FORMAT_SRATIONAL, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_srat = exif_get_srational ( data, o);
-		if (!v_srat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		d = (double) v_srat.numerator / (double) v_srat.denominator;
-		snprintf (val, maxlen, _("%.02f EV"), d);
-		break;
-	case EXIF_TAG_SCENE_TYPE:
-		CF (EXIF_FORMAT_UNDEFINED, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_byte =  data[0];
-		if (v_byte == 1)
-			strncpy (val, _("Directly photographed"), maxlen);
-		else
-			snprintf (val, maxlen, _("Internal error (unknown "
-				  "value %i)"), v_byte);
-		break;
-	case EXIF_TAG_YCBCR_SUB_SAMPLING:
-		CF (EXIF_FORMAT_SHORT, val, maxlen);
-		CC ( 2, val, maxlen);
-		v_short  = exif_get_short ( data, o);
-		v_short2 = exif_get_short (
-			 data + exif_format_get_size ( format),
-			o);
-		if ((v_short == 2) && (v_short2 == 1))
-			strncpy (val, _("YCbCr4:2:2"), maxlen);
-		else if ((v_short == 2) && (v_short2 == 2))
-			strncpy (val, _("YCbCr4:2:0"), maxlen);
-		else
-			snprintf (val, maxlen, "%u, %u", v_short, v_short2);
-		break;
-	case EXIF_TAG_SUBJECT_AREA:
-		CF (EXIF_FORMAT_SHORT, val, maxlen);
-		switch ( components) {
-		case 2:
-			v_short  = exif_get_short ( data, o);
-			v_short2 = exif_get_short ( data + 2, o);
-			snprintf (val, maxlen, "(x,y) = (%i,%i)",
-				  v_short, v_short2);
-			break;
-		case 3:
-			v_short  = exif_get_short ( data, o);
-			v_short2 = exif_get_short ( data + 2, o);
-			v_short3 = exif_get_short ( data + 4, o);
-			snprintf (val, maxlen, _("Within distance %i of "
-				"(x,y) = (%i,%i)"), v_short3, v_short,
-				v_short2);
-			break;
-		case 4:
-			v_short  = exif_get_short ( data, o);
-			v_short2 = exif_get_short ( data + 2, o);
-			v_short3 = exif_get_short ( data + 4, o);
-			v_short4 = exif_get_short ( data + 6, o);
-			snprintf (val, maxlen, _("Within rectangle "
-				"(width %i, height %i) around "
-				"(x,y) = (%i,%i)"), v_short3, v_short4,
-				v_short, v_short2);
-			break;
-		default:
-			snprintf (val, maxlen, _("Unexpected number "
-				"of components (%li, expected 2, 3, or 4)."),
-				 components);	
-		}
-		break;
-	case EXIF_TAG_GPS_VERSION_ID:
-		/* This is only valid in the GPS IFD */
-		CF (EXIF_FORMAT_BYTE, val, maxlen);
-		CC ( 4, val, maxlen);
-		v_byte =  data[0];
-		snprintf (val, maxlen, "%u", v_byte);
-		maxlen -= strlen (val);
-		for (i = 1; i <  components; i++) {
-			v_byte =  data[i];
-			snprintf (b, sizeof (b), ".%u", v_byte);
-			strncat (val, b, maxlen);
-			maxlen -= strlen (b);
-			if ((signed)maxlen <= 0) break;
+}
+
+static void format_file_source (ExifEntry *e, char *val, unsigned int maxlen,
+				void *UNUSED(user_data))
+{
+	ExifByte v_byte;
+
+	CF (e, EXIF_FORMAT_UNDEFINED);
+	CC (e, 1);
+	v_byte = e->data[0];
+	if (v_byte == 3)
+		strncpy (val, _("DSC"), maxlen);
+	else
+		snprintf (val, maxlen, _("Internal error (unknown "
+			  "value %i)"), v_byte);
+}
+
+static void format_components_configuration (ExifEntry *e, char *val,
+					     unsigned int maxlen,
+					     void *UNUSED(user_data))
+{
+	unsigned int i;
+	const char *c;
+
+	CF (e, EXIF_FORMAT_UNDEFINED);
+	CC (e, 4);
+	for (i = 0; i < 4; i++) {
+		switch (e->data[i]) {
+		case 0: c = _("-"); break;
+		case 1: c = _("Y"); break;
+		case 2: c = _("Cb"); break;
+		case 3: c = _("Cr"); break;
+		case 4: c = _("R"); break;
+		case 5: c = _("G"); break;
+		case 6: c = _("B"); break;
+		default: c = _("Reserved"); break;
 		}
+		strncat (val, c, maxlen - strlen (val));
+		if (i < 3)
+			strncat (val, " ", maxlen - strlen (val));
+	}
+}
+
+static void format_exposure_bias_value (ExifEntry *e, char *val,
+					unsigned int maxlen,
+					void *UNUSED(user_data))
+{
+	ExifSRational v_srat;
+	double d;
+
+	CF (e, EXIF_FORMAT_SRATIONAL);
+	CC (e, 1);
+	v_srat = exif_get_srational (e->data, format_order (e));
+	if (!v_srat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
+	d = (double) v_srat.numerator / (double) v_srat.denominator;
+	snprintf (val, maxlen, _("%.02f EV"), d);
+}
+
+static void format_scene_type (ExifEntry *e, char *val, unsigned int maxlen,
+			       void *UNUSED(user_data))
+{
+	ExifByte v_byte;
+
+	CF (e, EXIF_FORMAT_UNDEFINED);
+	CC (e, 1);
+	v_byte = e->data[0];
+	if (v_byte == 1)
+		strncpy (val, _("Directly photographed"), maxlen);
+	else
+		snprintf (val, maxlen, _("Internal error (unknown "
+			  "value %i)"), v_byte);
+}
+
+static void format_ycbcr_sub_sampling (ExifEntry *e, char *val,
+				       unsigned int maxlen,
+				       void *UNUSED(user_data))
+{
+	ExifShort v_short, v_short2;
+	const ExifByteOrder o = format_order (e);
+
+	CF (e, EXIF_FORMAT_SHORT);
+	CC (e, 2);
+	v_short  = exif_get_short (e->data, o);
+	v_short2 = exif_get_short (
+		e->data + exif_format_get_size (e->format),
+		o);
+	if ((v_short == 2) && (v_short2 == 1))
+		strncpy (val, _("YCbCr4:2:2"), maxlen);
+	else if ((v_short == 2) && (v_short2 == 2))
+		strncpy (val, _("YCbCr4:2:0"), maxlen);
+	else
+		snprintf (val, maxlen, "%u, %u", v_short, v_short2);
+}
+
+static void format_subject_area (ExifEntry *e, char *val, unsigned int maxlen,
+				 void *UNUSED(user_data))
+{
+	ExifShort v_short, v_short2, v_short3, v_short4;
+	const ExifByteOrder o = format_order (e);
+
+	CF (e, EXIF_FORMAT_SHORT);
+	switch (e->components) {
+	case 2:
+		v_short  = exif_get_short (e->data, o);
+		v_short2 = exif_get_short (e->data + 2, o);
+		snprintf (val, maxlen, "(x,y) = (%i,%i)",
+			  v_short, v_short2);
 		break;
-	case EXIF_TAG_INTEROPERABILITY_VERSION:
-	/* a.k.a. case EXIF_TAG_GPS_LATITUDE: */
-		/* This tag occurs in EXIF_IFD_INTEROPERABILITY */
-		if ( format == EXIF_FORMAT_UNDEFINED) {
-			strncpy (val, (char *)  data, MIN (maxlen,  size));
-			break;
-		}
-		/* EXIF_TAG_GPS_LATITUDE is the same numerically as
-		 * EXIF_TAG_INTEROPERABILITY_VERSION but in EXIF_IFD_GPS
-		 */
-		exif_entry_format_value( val, maxlen);
+	case 3:
+		v_short  = exif_get_short (e->data, o);
+		v_short2 = exif_get_short (e->data + 2, o);
+		v_short3 = exif_get_short (e->data + 4, o);
+		snprintf (val, maxlen, _("Within distance %i of "
+			"(x,y) = (%i,%i)"), v_short3, v_short,
+			v_short2);
 		break;
-	case EXIF_TAG_GPS_ALTITUDE_REF:
-		/* This is only valid in the GPS IFD */
-		CF (EXIF_FORMAT_BYTE, val, maxlen);
-		CC ( 1, val, maxlen);
-		v_byte =  data[0];
-		if (v_byte == 0)
-			strncpy (val, _("Sea level"), maxlen);
-		else if (v_byte == 1)
-			strncpy (val, _("Sea level reference"), maxlen);
-		else
-			snprintf (val, maxlen, _("Internal error (unknown "
-				  "value %i)"), v_byte);
+	case 4:
+		v_short  = exif_get_short (e->data, o);
+		v_short2 = exif_get_short (e->data + 2, o);
+		v_short3 = exif_get_short (e->data + 4, o);
+		v_short4 = exif_get_short (e->data + 6, o);
+		snprintf (val, maxlen, _("Within rectangle "
+			"(width %i, height %i) around "
+			"(x,y) = (%i,%i)"), v_short3, v_short4,
+			v_short, v_short2);
 		break;
-	case EXIF_TAG_GPS_TIME_STAMP:
-		/* This is only valid in the GPS IFD */
-		CF (EXIF_FORMAT_RATIONAL, val, maxlen);
-		CC ( 3, val, maxlen);
-
-		v_rat  = exif_get_rational ( data, o);
-		if (!v_rat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		i = v_rat.numerator / v_rat.denominator;
+	default:
+		snprintf (val, maxlen, _("Unexpected number "
+			"of components (%li, expected 2, 3, or 4)."),
+			e->components);	
+	}
+}
 
-		v_rat = exif_get_rational ( data +
-					     exif_format_get_size ( format),
-					   o);
-		if (!v_rat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		j = v_rat.numerator / v_rat.denominator;
+static void format_gps_version_id (ExifEntry *e, char *val, unsigned int maxlen,
+				   void *UNUSED(user_data))
+{
+	unsigned int i;
+	ExifByte v_byte;
+	char b[64];
 
-		v_rat = exif_get_rational ( data +
-					     2*exif_format_get_size ( format),
-					     o);
-		if (!v_rat.denominator) {
-			exif_entry_format_value( val, maxlen);
-			break;
-		}
-		d = (double) v_rat.numerator / (double) v_rat.denominator;
-		snprintf (val, maxlen, "%02u:%02u:%05.2f", i, j, d);
-		break;
+	/* This is only valid in the GPS IFD */
+	CF (e, EXIF_FORMAT_BYTE);
+	CC (e, 4);
+	v_byte = e->data[0];
+	snprintf (val, maxlen, "%u", v_byte);
+	maxlen -= strlen (val);
+	for (i = 1; i < e->components; i++) {
+		v_byte = e->data[i];
+		snprintf (b, sizeof (b), ".%u", v_byte);
+		strncat (val, b, maxlen);
+		maxlen -= strlen (b);
+		if ((signed)maxlen <= 0) break;
+	}
+}
 
-	case EXIF_TAG_METERING_MODE:
-	case EXIF_TAG_COMPRESSION:
-	case EXIF_TAG_LIGHT_SOURCE:
-	case EXIF_TAG_FOCAL_PLANE_RESOLUTION_UNIT:
-	case EXIF_TAG_RESOLUTION_UNIT:
-	case EXIF_TAG_EXPOSURE_PROGRAM:
-	case EXIF_TAG_FLASH:
-	case EXIF_TAG_SUBJECT_DISTANCE_RANGE:
-	case EXIF_TAG_COLOR_SPACE:
-		CF (EXIF_FORMAT_SHORT, val, maxlen);
-		CC (1, val, maxlen);
-		v_short = exif_get_short ( data, o);
-
-		/* Search the tag */
-		for (i = 0; list2[i].tag && (list2[i].tag !=  tag); i++);
-		if (!list2[i].tag) {
-			snprintf (val, maxlen, _("Internal error (unknown "
-				  "value %i)"), v_short);
-			break;
-		}
+static void format_interoperability_version (ExifEntry *e, char *val,
+					     unsigned int maxlen,
+					     void *UNUSED(user_data))
+{
+	/* a.k.a. EXIF_TAG_GPS_LATITUDE */
+	/* This tag occurs in EXIF_IFD_INTEROPERABILITY */
+	if (e->format == EXIF_FORMAT_UNDEFINED) {
+		strncpy (val, (char *) e->data, MIN (maxlen, e->size));
+		return;
+	}
+	/* EXIF_TAG_GPS_LATITUDE is the same numerically as
+	 * EXIF_TAG_INTEROPERABILITY_VERSION but in EXIF_IFD_GPS
+	 */
+	e->exif_entry_format_value (val, maxlen);
+}
 
-		/* Find the value */
-		for (j = 0; list2[i].elem[j].values[0] &&
-			    (list2[i].elem[j].index < v_short); j++);
-		if (list2[i].elem[j].index != v_short) {
-			snprintf (val, maxlen, _("Internal error (unknown "
-				  "value %i)"), v_short);
-			break;
-		}
+static void format_gps_altitude_ref (ExifEntry *e, char *val,
+				     unsigned int maxlen,
+				     void *UNUSED(user_data))
+{
+	ExifByte v_byte;
 
-		/* Find a short enough value */
-		memset (val, 0, maxlen);
-		for (k = 0; list2[i].elem[j].values[k]; k++) {
-			size_t l = strlen (_(list2[i].elem[j].values[k]));
-			if ((maxlen > l) && (strlen (val) < l))
-				strncpy (val, _(list2[i].elem[j].values[k]), maxlen);
-		}
-		if (!val[0]) snprintf (val, maxlen, "%i", v_short);
+	/* This is only valid in the GPS IFD */
+	CF (e, EXIF_FORMAT_BYTE);
+	CC (e, 1);
+	v_byte = e->data[0];
+	if (v_byte == 0)
+		strncpy (val, _("Sea level"), maxlen);
+	else if (v_byte == 1)
+		strncpy (val, _("Sea level reference"), maxlen);
+	else
+		snprintf (val, maxlen, _("Internal error (unknown "
+			  "value %i)"), v_byte);
+}
 
-		break;
+static void format_gps_time_stamp (ExifEntry *e, char *val, unsigned int maxlen,
+				   void *UNUSED(user_data))
+{
+	unsigned int i, j;
+	ExifRational v_rat;
+	double d;
+	const ExifByteOrder o = format_order (e);
 
-	case EXIF_TAG_PLANAR_CONFIGURATION:
-	case EXIF_TAG_SENSING_METHOD:
-	case EXIF_TAG_ORIENTATION:
-	case EXIF_TAG_YCBCR_POSITIONING:
-	case EXIF_TAG_PHOTOMETRIC_INTERPRETATION:
-	case EXIF_TAG_CUSTOM_RENDERED:
-	case EXIF_TAG_EXPOSURE_MODE:
-	case EXIF_TAG_WHITE_BALANCE:
-	case EXIF_TAG_SCENE_CAPTURE_TYPE:
-	case EXIF_TAG_GAIN_CONTROL:
-	case EXIF_TAG_SATURATION:
-	case EXIF_TAG_CONTRAST:
-	case EXIF_TAG_SHARPNESS:
-		CF (EXIF_FORMAT_SHORT, val, maxlen);
-		CC (1, val, maxlen);
-		v_short = exif_get_short ( data, o);
-
-		/* Search the tag */
-		for (i = 0; list[i].tag && (list[i].tag !=  tag); i++);
-		if (!list[i].tag) {
-			snprintf (val, maxlen, _("Internal error (unknown "
-				  "value %i)"), v_short);
-			break;
+	/* This is only valid in the GPS IFD */
+	CF (e, EXIF_FORMAT_RATIONAL);
+	CC (e, 3);
+
+	v_rat  = exif_get_rational (e->data, o);
+	if (!v_rat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
+	i = v_rat.numerator / v_rat.denominator;
+
+	v_rat = exif_get_rational (e->data +
+				     exif_format_get_size (e->format),
+				   o);
+	if (!v_rat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
+	j = v_rat.numerator / v_rat.denominator;
+
+	v_rat = exif_get_rational (e->data +
+				     2*exif_format_get_size (e->format),
+				     o);
+	if (!v_rat.denominator) {
+		e->exif_entry_format_value (val, maxlen);
+		return;
+	}
+	d = (double) v_rat.numerator / (double) v_rat.denominator;
+	snprintf (val, maxlen, "%02u:%02u:%05.2f", i, j, d);
+}
+
+/*! Formatter for the tags in #list2. \c user_data is the matching row of
+ * #list2, or NULL if the tag has no descriptions compiled in. */
+static void format_list2 (ExifEntry *e, char *val, unsigned int maxlen,
+			  void *user_data)
+{
+	const ExifEntryValueList2 *l = (const ExifEntryValueList2 *) user_data;
+	ExifShort v_short;
+	unsigned int j, k;
+
+	CF (e, EXIF_FORMAT_SHORT);
+	CC (e, 1);
+	v_short = exif_get_short (e->data, format_order (e));
+
+	if (!l) {
+		snprintf (val, maxlen, _("Internal error (unknown "
+			  "value %i)"), v_short);
+		return;
+	}
+
+	/* Find the value */
+	if (v_short < 0x100)
+		j = list2_index[l - list2][v_short];
+	else
+		for (j = 0; l->elem[j].values[0] &&
+			    (l->elem[j].index != v_short); j++);
+	if (v_short < 0x100 ? !j-- : !l->elem[j].values[0]) {
+		snprintf (val, maxlen, _("Internal error (unknown "
+			  "value %i)"), v_short);
+		return;
+	}
+
+	/* Find a short enough value */
+	memset (val, 0, maxlen);
+	for (k = 0; l->elem[j].values[k]; k++) {
+		size_t len = strlen (_(l->elem[j].values[k]));
+		if ((maxlen > len) && (strlen (val) < len))
+			strncpy (val, _(l->elem[j].values[k]), maxlen);
+	}
+	if (!val[0]) snprintf (val, maxlen, "%i", v_short);
+}
+
+/*! Formatter for the tags in #list. \c user_data is the matching row of
+ * #list, or NULL if the tag has no descriptions compiled in. */
+static void format_list (ExifEntry *e, char *val, unsigned int maxlen,
+			 void *user_data)
+{
+	const ExifEntryValueList *l = (const ExifEntryValueList *) user_data;
+	ExifShort v_short;
+	const char *s;
+
+	CF (e, EXIF_FORMAT_SHORT);
+	CC (e, 1);
+	v_short = exif_get_short (e->data, format_order (e));
+
+	if (!l) {
+		snprintf (val, maxlen, _("Internal error (unknown "
+			  "value %i)"), v_short);
+		return;
+	}
+
+	/* The list is terminated by NULL and padded with NULL after that */
+	s = (v_short < sizeof (l->strings) / sizeof (l->strings[0])) ?
+		l->strings[v_short] : NULL;
+	if (!s)
+		snprintf (val, maxlen, "%i", v_short);
+	else if (!*s)
+		snprintf (val, maxlen, _("Unknown value %i"), v_short);
+	else
+		strncpy (val, _(s), maxlen);
+}
+
+static void format_xp (ExifEntry *e, char *val, unsigned int maxlen,
+		       void *UNUSED(user_data))
+{
+	unsigned short *utf16 = NULL;
+
+	/* Sanity check the size to prevent overflow */
+	if (e->size+sizeof(unsigned short) < e->size) return;
+
+	/* The tag may not be U+0000-terminated , so make a local
+	   U+0000-terminated copy before converting it */
+	e->priv.mem->exif_mem_alloc (&utf16, e->size/sizeof(unsigned short)+1);
+	if (!utf16) return;
+	memcpy(utf16, e->data, e->size);
+	utf16[e->size/sizeof(unsigned short)] = 0;
+
+	/* Warning! The texts are converted from UTF16 to UTF8 */
+	/* FIXME: use iconv to convert into the locale encoding */
+	exif_convert_utf16_to_utf8(val, utf16, maxlen);
+	e->priv.mem->exif_mem_free (&utf16);
+}
+
+/*! Built-in formatters. Tags not listed here are printed by
+ * exif_entry_format_value. The list is terminated by a NULL function since
+ * EXIF_TAG_GPS_VERSION_ID equals EXIF_TAG_NULL. */
+static const struct {
+	ExifTag tag;
+	ExifEntryFormatterFunc func;
+} formatter_table[] = {
+	{ EXIF_TAG_USER_COMMENT, format_user_comment },
+	{ EXIF_TAG_EXIF_VERSION, format_exif_version },
+	{ EXIF_TAG_FLASH_PIX_VERSION, format_flash_pix_version },
+	{ EXIF_TAG_COPYRIGHT, format_copyright },
+	{ EXIF_TAG_FNUMBER, format_fnumber },
+	{ EXIF_TAG_APERTURE_VALUE, format_aperture_value },
+	{ EXIF_TAG_MAX_APERTURE_VALUE, format_aperture_value },
+	{ EXIF_TAG_FOCAL_LENGTH, format_focal_length },
+	{ EXIF_TAG_SUBJECT_DISTANCE, format_subject_distance },
+	{ EXIF_TAG_EXPOSURE_TIME, format_exposure_time },
+	{ EXIF_TAG_SHUTTER_SPEED_VALUE, format_shutter_speed_value },
+	{ EXIF_TAG_BRIGHTNESS_VALUE, format_brightness_value },
+	{ EXIF_TAG_FILE_SOURCE, format_file_source },
+	{ EXIF_TAG_COMPONENTS_CONFIGURATION, format_components_configuration },
+	{ EXIF_TAG_EXPOSURE_BIAS_VALUE, format_exposure_bias_value },
+	{ EXIF_TAG_SCENE_TYPE, format_scene_type },
+	{ EXIF_TAG_YCBCR_SUB_SAMPLING, format_ycbcr_sub_sampling },
+	{ EXIF_TAG_SUBJECT_AREA, format_subject_area },
+	{ (ExifTag) EXIF_TAG_GPS_VERSION_ID, format_gps_version_id },
+	{ EXIF_TAG_INTEROPERABILITY_VERSION, format_interoperability_version },
+	{ (ExifTag) EXIF_TAG_GPS_ALTITUDE_REF, format_gps_altitude_ref },
+	{ (ExifTag) EXIF_TAG_GPS_TIME_STAMP, format_gps_time_stamp },
+	{ EXIF_TAG_METERING_MODE, format_list2 },
+	{ EXIF_TAG_COMPRESSION, format_list2 },
+	{ EXIF_TAG_LIGHT_SOURCE, format_list2 },
+	{ EXIF_TAG_FOCAL_PLANE_RESOLUTION_UNIT, format_list2 },
+	{ EXIF_TAG_RESOLUTION_UNIT, format_list2 },
+	{ EXIF_TAG_EXPOSURE_PROGRAM, format_list2 },
+	{ EXIF_TAG_FLASH, format_list2 },
+	{ EXIF_TAG_SUBJECT_DISTANCE_RANGE, format_list2 },
+	{ EXIF_TAG_COLOR_SPACE, format_list2 },
+	{ EXIF_TAG_PLANAR_CONFIGURATION, format_list },
+	{ EXIF_TAG_SENSING_METHOD, format_list },
+	{ EXIF_TAG_ORIENTATION, format_list },
+	{ EXIF_TAG_YCBCR_POSITIONING, format_list },
+	{ EXIF_TAG_PHOTOMETRIC_INTERPRETATION, format_list },
+	{ EXIF_TAG_CUSTOM_RENDERED, format_list },
+	{ EXIF_TAG_EXPOSURE_MODE, format_list },
+	{ EXIF_TAG_WHITE_BALANCE, format_list },
+	{ EXIF_TAG_SCENE_CAPTURE_TYPE, format_list },
+	{ EXIF_TAG_GAIN_CONTROL, format_list },
+	{ EXIF_TAG_SATURATION, format_list },
+	{ EXIF_TAG_CONTRAST, format_list },
+	{ EXIF_TAG_SHARPNESS, format_list },
+	{ EXIF_TAG_XP_TITLE, format_xp },
+	{ EXIF_TAG_XP_COMMENT, format_xp },
+	{ EXIF_TAG_XP_AUTHOR, format_xp },
+	{ EXIF_TAG_XP_KEYWORDS, format_xp },
+	{ EXIF_TAG_XP_SUBJECT, format_xp },
+	{ EXIF_TAG_NULL, NULL }
+};
+
+/*! A formatter together with the data registered for it */
+typedef struct {
+	ExifEntryFormatterFunc func;
+	void *user_data;
+} ExifEntryFormatter;
+
+/*
+ * The registry maps a tag to a slot in #formatters in two steps: the high
+ * byte of the tag selects a page of #formatter_map, the low byte the slot
+ * number within that page. Slot 0 means "no formatter". Pages are only
+ * allocated for tag ranges that actually have formatters.
+ */
+static ExifEntryFormatter formatters[0x100];
+static unsigned int formatters_count = 1;
+static unsigned char *formatter_map[0x100];
+
+static void *formatter_default_data (ExifTag tag, ExifEntryFormatterFunc func)
+{
+	unsigned int i;
+
+	if (func == format_list2) {
+		for (i = 0; list2[i].tag && (list2[i].tag != tag); i++);
+		return list2[i].tag ? (void *) &list2[i] : NULL;
+	}
+	if (func == format_list) {
+		for (i = 0; list[i].tag && (list[i].tag != tag); i++);
+		return list[i].tag ? (void *) &list[i] : NULL;
+	}
+	return NULL;
+}
+
+static int formatter_register (ExifTag tag, ExifEntryFormatterFunc func,
+			       void *user_data)
+{
+	unsigned char *page = formatter_map[(tag >> 8) & 0xff];
+	unsigned int slot;
+
+	if (!page) {
+		if (!func)
+			return 1;
+		page = new unsigned char[0x100];
+		memset (page, 0, 0x100);
+		formatter_map[(tag >> 8) & 0xff] = page;
+	}
+	slot = page[tag & 0xff];
+	if (!func) {
+		/* The slot is kept, so the tag gets it back when registered again */
+		if (slot) {
+			formatters[slot].func = NULL;
+			formatters[slot].user_data = NULL;
 		}
+		return 1;
+	}
+	if (!slot) {
+		if (formatters_count >= sizeof (formatters) / sizeof (formatters[0]))
+			return 0;
+		slot = formatters_count++;
+		page[tag & 0xff] = (unsigned char) slot;
+	}
+	formatters[slot].func = func;
+	formatters[slot].user_data = user_data;
+	return 1;
+}
 
-		/* Find the value */
-		for (j = 0; list[i].strings[j] && (j < v_short); j++);
-		if (!list[i].strings[j])
-			snprintf (val, maxlen, "%i", v_short);
-		else if (!*list[i].strings[j])
-			snprintf (val, maxlen, _("Unknown value %i"), v_short);
-		else
-			strncpy (val, _(list[i].strings[j]), maxlen);
-		break;
+static void exif_entry_formatter_init (void)
+{
+	static int initialized = 0;
+	unsigned int i, j;
+
+	if (initialized)
+		return;
+	initialized = 1;
+
+	for (i = 0; list2[i].tag; i++)
+		for (j = 0; list2[i].elem[j].values[0]; j++)
+			if ((list2[i].elem[j].index < 0x100) &&
+			    !list2_index[i][list2[i].elem[j].index])
+				list2_index[i][list2[i].elem[j].index] =
+					(unsigned char) (j + 1);
+
+	for (i = 0; formatter_table[i].func; i++)
+		formatter_register (formatter_table[i].tag,
+			formatter_table[i].func,
+			formatter_default_data (formatter_table[i].tag,
+						formatter_table[i].func));
+}
 
-	case EXIF_TAG_XP_TITLE:
-	case EXIF_TAG_XP_COMMENT:
-	case EXIF_TAG_XP_AUTHOR:
-	case EXIF_TAG_XP_KEYWORDS:
-	case EXIF_TAG_XP_SUBJECT:
+/* Build the registry while the library is loaded, before any thread of the
+ * application can call exif_entry_get_value. */
+static class ExifEntryFormatterInit
+{
+public:
+	ExifEntryFormatterInit ()
 	{
-		/* Sanity check the size to prevent overflow */
-		if ( size+sizeof(unsigned short) <  size) break;
-
-		/* The tag may not be U+0000-terminated , so make a local
-		   U+0000-terminated copy before converting it */
-		 priv.mem->exif_mem_alloc (&utf16,  size/sizeof(unsigned short)+1);
-		if (!utf16) break;
-		memcpy(utf16,  data,  size);
-		utf16[ size/sizeof(unsigned short)] = 0;
-
-		/* Warning! The texts are converted from UTF16 to UTF8 */
-		/* FIXME: use iconv to convert into the locale encoding */
-		exif_convert_utf16_to_utf8(val, utf16, maxlen);
-		size>1?delete [] utf16:delete utf16;
-		utf16=NULL;
-		break;
+		exif_entry_formatter_init ();
 	}
+} exif_entry_formatter_init_instance;
+
+/*! Install the function used by #exif_entry_get_value to print the value
+ * of entries with the given tag, replacing the built-in one if there is any.
+ * Formatters receive a zero-filled buffer and must not write more than
+ * \c maxlen characters to it; the entry is a member of an #ExifData and its
+ * size has been checked against its format and number of components.
+ * Registration is global and is not synchronized with exif_entry_get_value,
+ * so applications should install their formatters before sharing entries
+ * between threads.
+ *
+ * \param[in] tag tag whose values are printed by func
+ * \param[in] func formatter, or NULL to restore the built-in behaviour
+ * \param[in] user_data data passed to func on each call
+ * \return 1 on success, 0 if no more formatters can be installed
+ */
+int exif_entry_set_formatter (ExifTag tag, ExifEntryFormatterFunc func,
+			      void *user_data)
+{
+	unsigned int i;
 
-	default:
+	exif_entry_formatter_init ();
+	if (!func) {
+		for (i = 0; formatter_table[i].func &&
+			    (formatter_table[i].tag != tag); i++);
+		if (formatter_table[i].func) {
+			func = formatter_table[i].func;
+			user_data = formatter_default_data (tag, func);
+		}
+	}
+	return formatter_register (tag, func, user_data);
+}
+
+/*! Return the function #exif_entry_get_value uses for the given tag. An
+ * application may use this to wrap the built-in formatter of a tag.
+ *
+ * \param[in] tag tag to look up
+ * \param[out] user_data data registered along with the formatter, may be NULL
+ * \return formatter, or NULL if the value is printed by
+ *         #exif_entry_format_value
+ */
+ExifEntryFormatterFunc exif_entry_get_formatter (ExifTag tag, void **user_data)
+{
+	const unsigned char *page;
+	const ExifEntryFormatter *f = NULL;
+
+	exif_entry_formatter_init ();
+	page = formatter_map[(tag >> 8) & 0xff];
+	if (page && page[tag & 0xff])
+		f = &formatters[page[tag & 0xff]];
+	if (user_data)
+		*user_data = f ? f->user_data : NULL;
+	return f ? f->func : NULL;
+}
+
+/*! Return a localized textual representation of the value of the EXIF entry.
+ * This is meant for display to the user. The format of each tag is subject
+ * to change between locales and in newer versions of libexif.  Users who
+ * require the tag data in an unambiguous form should access the data members
+ * of the #ExifEntry structure directly.
+ * The value is printed by the formatter installed for the tag, see
+ * #exif_entry_set_formatter.
+ *
+ * \warning The character set of the returned string may be in
+ *          the encoding of the current locale or the native encoding
+ *          of the camera.
+ * \bug     The EXIF_TAG_XP_* tags are currently always returned in UTF-8,
+ *          regardless of locale, and code points above U+FFFF are not
+ *          supported.
+ *
+ * \param[out] val buffer in which to store value
+ * \param[in] maxlen length of the buffer val
+ * \return val pointer
+ */
+const char *ExifEntry::exif_entry_get_value(char *val, unsigned int maxlen)
+{
+	ExifEntryFormatterFunc func;
+	void *user_data;
+
+	/* FIXME: This belongs to somewhere else. */
+	/* libexif should use the default system locale.
+	 * If an application specifically requires UTF-8, then we
+	 * must give the application a way to tell libexif that.
+	 * 
+	 * bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	 */
+	bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+
+	if (!parent || ! parent->parent || !maxlen)
+		return val;
+
+	/* make sure the returned string is zero terminated */
+	memset (val, 0, maxlen);
+	maxlen--;
+
+	/* Sanity check */
+	if ( size !=  components * exif_format_get_size ( format)) {
+		snprintf (val, maxlen, _("Invalid size of entry (%i, "
+			"expected %li x %i)."),  size,  components,
+				exif_format_get_size ( format));
+		return val;
+	}
+
+	func = exif_entry_get_formatter (tag, &user_data);
+	if (func)
+		func (this, val, maxlen, user_data);
+	else
 		/* Use a generic value formatting */
 		exif_entry_format_value( val, maxlen);
-	}
 
 	return val;
 }
@@ -1389,7 +1796,9 @@ void ExifEntry::exif_entry_initialize (ExifTag tag)
 		return;
 	o = parent->parent->exif_data_get_byte_order ();
 
-	 tag = tag;
+	this->tag = tag;
+	priv.dirty = 1;
+	priv.order = o;
 	switch (tag) {
 
 	/* LONG, 1 component, no default */
@@ -1720,3 +2129,232 @@ void ExifEntry::exif_entry_initialize (ExifTag tag)
 		break;
 	}
 }
+
+/*! Replace the value of the entry. The value is copied and converted
+ * to the byte order of the #ExifData containing the entry. The data
+ * buffer of the entry is kept if it has the right size already.
+ *
+ * \param[in] f format of the value
+ * \param[in] n number of components
+ * \param[in] value n components in format f
+ * \param[in] o byte order of value
+ * \return 1 on success, 0 if the format is unknown or no memory is left
+ */
+int ExifEntry::exif_entry_set_value (ExifFormat f, unsigned long n,
+				     const unsigned char *value, ExifByteOrder o)
+{
+	unsigned int s = exif_format_get_size (f);
+	unsigned char *d;
+
+	if (!s || (n > 0xffffffffUL / s))
+		return 0;
+	s *= (unsigned int) n;
+	if (s && !value)
+		return 0;
+
+	if (s != size) {
+		d = exif_entry_alloc (s);
+		if (s && !d)
+			return 0;
+		if (s)
+			memcpy (d, value, s);
+		data_free ();
+		data = d;
+		size = s;
+	} else if (s)
+		memmove (data, value, s);
+	if (parent && parent->parent)
+		priv.order = parent->parent->exif_data_get_byte_order ();
+	exif_array_set_byte_order (f, data, (unsigned int) n, o, priv.order);
+	format = f;
+	components = n;
+	priv.dirty = 1;
+	return 1;
+}
+
+/*! Return the byte order of the data of this entry. This is the byte
+ * order the value has been loaded or set in, which differs from that of
+ * the #ExifData containing the entry after #exif_data_set_byte_order
+ * until the entry is saved.
+ *
+ * \return byte order of \c data
+ */
+ExifByteOrder ExifEntry::exif_entry_get_byte_order ()
+{
+	return priv.order;
+}
+
+ExifEntryValueResult ExifEntry::exif_entry_check_value (unsigned long index)
+{
+	unsigned char s = exif_format_get_size (format);
+
+	if (!data || !s || (size / s < components))
+		return EXIF_ENTRY_VALUE_NO_DATA;
+	if (index >= components)
+		return EXIF_ENTRY_VALUE_OUT_OF_RANGE;
+	return EXIF_ENTRY_VALUE_OK;
+}
+
+/*! Read an unsigned integer component without formatting it.
+ *
+ * \param[in] index number of the component
+ * \param[out] value the component; untouched on error
+ * \return #EXIF_ENTRY_VALUE_OK on success, or why the value could not be
+ *         read. The entry must be in BYTE, SHORT or LONG format.
+ */
+ExifEntryValueResult ExifEntry::exif_entry_get_uint (unsigned long index, ExifLong *value)
+{
+	const unsigned char *b;
+	ExifEntryValueResult r;
+
+	if ((format != EXIF_FORMAT_BYTE) && (format != EXIF_FORMAT_SHORT) &&
+	    (format != EXIF_FORMAT_LONG))
+		return EXIF_ENTRY_VALUE_WRONG_FORMAT;
+	r = exif_entry_check_value (index);
+	if (r != EXIF_ENTRY_VALUE_OK)
+		return r;
+
+	b = data + index * exif_format_get_size (format);
+	switch (format) {
+	case EXIF_FORMAT_BYTE:
+		*value = ExifFormatTraits<EXIF_FORMAT_BYTE>::get (b, exif_entry_get_byte_order ());
+		break;
+	case EXIF_FORMAT_SHORT:
+		*value = ExifFormatTraits<EXIF_FORMAT_SHORT>::get (b, exif_entry_get_byte_order ());
+		break;
+	default:
+		*value = ExifFormatTraits<EXIF_FORMAT_LONG>::get (b, exif_entry_get_byte_order ());
+		break;
+	}
+	return EXIF_ENTRY_VALUE_OK;
+}
+
+/*! Read a signed integer component without formatting it.
+ *
+ * \param[in] index number of the component
+ * \param[out] value the component; untouched on error
+ * \return #EXIF_ENTRY_VALUE_OK on success, or why the value could not be
+ *         read. The entry must be in SBYTE, SSHORT or SLONG format.
+ */
+ExifEntryValueResult ExifEntry::exif_entry_get_sint (unsigned long index, ExifSLong *value)
+{
+	const unsigned char *b;
+	ExifEntryValueResult r;
+
+	if ((format != EXIF_FORMAT_SBYTE) && (format != EXIF_FORMAT_SSHORT) &&
+	    (format != EXIF_FORMAT_SLONG))
+		return EXIF_ENTRY_VALUE_WRONG_FORMAT;
+	r = exif_entry_check_value (index);
+	if (r != EXIF_ENTRY_VALUE_OK)
+		return r;
+
+	b = data + index * exif_format_get_size (format);
+	switch (format) {
+	case EXIF_FORMAT_SBYTE:
+		*value = ExifFormatTraits<EXIF_FORMAT_SBYTE>::get (b, exif_entry_get_byte_order ());
+		break;
+	case EXIF_FORMAT_SSHORT:
+		*value = ExifFormatTraits<EXIF_FORMAT_SSHORT>::get (b, exif_entry_get_byte_order ());
+		break;
+	default:
+		*value = ExifFormatTraits<EXIF_FORMAT_SLONG>::get (b, exif_entry_get_byte_order ());
+		break;
+	}
+	return EXIF_ENTRY_VALUE_OK;
+}
+
+/*! Read an unsigned rational component without formatting it.
+ *
+ * \param[in] index number of the component
+ * \param[out] value the component; untouched on error
+ * \return #EXIF_ENTRY_VALUE_OK on success, or why the value could not be
+ *         read. The entry must be in RATIONAL format.
+ */
+ExifEntryValueResult ExifEntry::exif_entry_get_rational (unsigned long index, ExifRational *value)
+{
+	ExifEntryValueResult r;
+
+	if (format != EXIF_FORMAT_RATIONAL)
+		return EXIF_ENTRY_VALUE_WRONG_FORMAT;
+	r = exif_entry_check_value (index);
+	if (r != EXIF_ENTRY_VALUE_OK)
+		return r;
+	*value = ExifFormatTraits<EXIF_FORMAT_RATIONAL>::get (
+		data + index * ExifFormatTraits<EXIF_FORMAT_RATIONAL>::size,
+		exif_entry_get_byte_order ());
+	return EXIF_ENTRY_VALUE_OK;
+}
+
+/*! Read a signed rational component without formatting it.
+ *
+ * \param[in] index number of the component
+ * \param[out] value the component; untouched on error
+ * \return #EXIF_ENTRY_VALUE_OK on success, or why the value could not be
+ *         read. The entry must be in SRATIONAL format.
+ */
+ExifEntryValueResult ExifEntry::exif_entry_get_srational (unsigned long index, ExifSRational *value)
+{
+	ExifEntryValueResult r;
+
+	if (format != EXIF_FORMAT_SRATIONAL)
+		return EXIF_ENTRY_VALUE_WRONG_FORMAT;
+	r = exif_entry_check_value (index);
+	if (r != EXIF_ENTRY_VALUE_OK)
+		return r;
+	*value = ExifFormatTraits<EXIF_FORMAT_SRATIONAL>::get (
+		data + index * ExifFormatTraits<EXIF_FORMAT_SRATIONAL>::size,
+		exif_entry_get_byte_order ());
+	return EXIF_ENTRY_VALUE_OK;
+}
+
+/*! Read any numeric component as a floating point number.
+ *
+ * \param[in] index number of the component
+ * \param[out] value the component; untouched on error
+ * \return #EXIF_ENTRY_VALUE_OK on success, or why the value could not be
+ *         read. Rationals with a zero denominator are reported as
+ *         #EXIF_ENTRY_VALUE_ZERO_DENOMINATOR.
+ */
+ExifEntryValueResult ExifEntry::exif_entry_get_double (unsigned long index, double *value)
+{
+	ExifEntryValueResult r;
+	ExifLong v_long;
+	ExifSLong v_slong;
+	ExifRational v_rat;
+	ExifSRational v_srat;
+
+	switch (format) {
+	case EXIF_FORMAT_BYTE:
+	case EXIF_FORMAT_SHORT:
+	case EXIF_FORMAT_LONG:
+		r = exif_entry_get_uint (index, &v_long);
+		if (r == EXIF_ENTRY_VALUE_OK)
+			*value = (double) v_long;
+		return r;
+	case EXIF_FORMAT_SBYTE:
+	case EXIF_FORMAT_SSHORT:
+	case EXIF_FORMAT_SLONG:
+		r = exif_entry_get_sint (index, &v_slong);
+		if (r == EXIF_ENTRY_VALUE_OK)
+			*value = (double) v_slong;
+		return r;
+	case EXIF_FORMAT_RATIONAL:
+		r = exif_entry_get_rational (index, &v_rat);
+		if (r != EXIF_ENTRY_VALUE_OK)
+			return r;
+		if (!v_rat.denominator)
+			return EXIF_ENTRY_VALUE_ZERO_DENOMINATOR;
+		*value = (double) v_rat.numerator / (double) v_rat.denominator;
+		return EXIF_ENTRY_VALUE_OK;
+	case EXIF_FORMAT_SRATIONAL:
+		r = exif_entry_get_srational (index, &v_srat);
+		if (r != EXIF_ENTRY_VALUE_OK)
+			return r;
+		if (!v_srat.denominator)
+			return EXIF_ENTRY_VALUE_ZERO_DENOMINATOR;
+		*value = (double) v_srat.numerator / (double) v_srat.denominator;
+		return EXIF_ENTRY_VALUE_OK;
+	default:
+		return EXIF_ENTRY_VALUE_WRONG_FORMAT;
+	}
+}
@@ -29,9 +29,71 @@
 #include "exif-mem.h"
 #include "exif-content.h"
 #include "exif-format.h"
+#include "exif-utils.h"
 
 
 class ExifContent;
+class ExifEntry;
+
+/*! Function printing the value of an entry for #exif_entry_get_value.
+ *
+ * \param[in] e entry to print
+ * \param[out] val zero-filled buffer in which to store the value
+ * \param[in] maxlen maximum number of characters to store in val, not
+ *            counting the terminating NUL
+ * \param[in] user_data data registered along with the function
+ */
+typedef void (* ExifEntryFormatterFunc) (ExifEntry *e, char *val,
+					 unsigned int maxlen, void *user_data);
+
+/*! Result of reading a value through the typed accessors of #ExifEntry */
+typedef enum {
+	EXIF_ENTRY_VALUE_OK = 0,
+	/*! The entry has no data, or less than its components need */
+	EXIF_ENTRY_VALUE_NO_DATA,
+	/*! The format of the entry cannot be read as the requested type */
+	EXIF_ENTRY_VALUE_WRONG_FORMAT,
+	/*! The requested component does not exist */
+	EXIF_ENTRY_VALUE_OUT_OF_RANGE,
+	/*! A rational with a zero denominator was read as a number */
+	EXIF_ENTRY_VALUE_ZERO_DENOMINATOR
+} ExifEntryValueResult;
+
+/*! Read-only view of the components of an entry in format F. It points
+ * into the data of the entry and is valid as long as that data is.
+ */
+template <ExifFormat F> class ExifEntrySpan
+{
+public:
+	typedef typename ExifFormatTraits<F>::type value_type;
+
+	ExifEntrySpan ()
+	{
+		data = NULL;
+		count = 0;
+		order = EXIF_BYTE_ORDER_MOTOROLA;
+	}
+	ExifEntrySpan (const unsigned char *d, unsigned long n, ExifByteOrder o)
+	{
+		data = d;
+		count = n;
+		order = o;
+	}
+	/*! Number of components */
+	unsigned long size () const
+	{
+		return count;
+	}
+	/*! Component i, which must be less than size() */
+	value_type operator[] (unsigned long i) const
+	{
+		return ExifFormatTraits<F>::get (data + i * ExifFormatTraits<F>::size, order);
+	}
+public:
+	const unsigned char *data;
+	unsigned long count;
+	ExifByteOrder order;
+};
 
 class ExifEntryPrivate
 {
@@ -40,16 +102,36 @@ public:
 	ExifEntryPrivate()
 	{
 		mem=NULL;
-		
+		dirty=1;
+		offset=0;
+		length=0;
+		order=EXIF_BYTE_ORDER_MOTOROLA;
 	}
 	ExifEntryPrivate& operator=(const ExifEntryPrivate& input)
 	{
 		mem=input.mem;
+		dirty=input.dirty;
+		offset=input.offset;
+		length=input.length;
+		order=input.order;
 		return *this;
 	}
 public:
 	ExifMem *mem;
 
+	/* Set once the entry has been changed by libexif after loading.
+	 * Entries that have not been loaded are always dirty. */
+	int dirty;
+
+	/* Where the value was loaded from, relative to the TIFF header,
+	 * and how many bytes it took there. 0 if it has not been loaded. */
+	unsigned int offset;
+	unsigned int length;
+
+	/* Byte order of the data. Changing the byte order of the #ExifData
+	 * leaves it alone; the data is converted when it is saved. */
+	ExifByteOrder order;
+
 };
 
 /*! Data found in one EXIF tag */
@@ -66,12 +148,20 @@ public:
 		
 	}
 	ExifEntry(const ExifEntry &input)
-	{  
+	{
+		data=NULL;
+		size=0;
 		if (input.data)
 		{
-			size=input.size;
-			data=new unsigned char[size];
-			memcpy(data,input.data,size);
+			if (input.priv.mem)
+				input.priv.mem->exif_mem_alloc(&data,input.size);
+			else
+				data=new unsigned char[input.size];
+			if (data)
+			{
+				size=input.size;
+				memcpy(data,input.data,size);
+			}
 		}
 		priv=input.priv;
 		tag=input.tag;
@@ -80,6 +170,13 @@ public:
 		parent=input.parent;
 		tag=input.tag;
 	} 
+	ExifEntry& operator=(const ExifEntry &input)
+	{
+		ExifEntry copy (input);
+
+		exif_entry_swap (copy);
+		return *this;
+	}
 
 	~ExifEntry()
 	{
@@ -97,11 +194,11 @@ public:
 private:
 	void inline data_free()
 	{
-		if (data)
-		{
-			size>1?delete [] data:delete data;
-			data=NULL;
-		}
+		if (priv.mem)
+			priv.mem->exif_mem_free(&data);
+		else
+			delete [] data;
+		data=NULL;
 		size=0;
 	}
  
@@ -110,6 +207,7 @@ public:
 	unsigned char *exif_entry_alloc (unsigned int i);
 	unsigned char *exif_entry_realloc (unsigned char *d_orig, unsigned int i);
 	void exif_entry_free();
+	void exif_entry_swap (ExifEntry &e);
 	ExifShort exif_get_short_convert (const unsigned char *buf,
 										ExifFormat format,
 										ExifByteOrder order);
@@ -122,6 +220,32 @@ public:
 	int match_repeated_char(const unsigned char *data, unsigned char ch, size_t n);
 	const char *exif_entry_get_value(char *val, unsigned int maxlen);
 	void exif_entry_initialize (ExifTag tag);
+	int exif_entry_set_value (ExifFormat f, unsigned long n,
+				  const unsigned char *value, ExifByteOrder o);
+	ExifByteOrder exif_entry_get_byte_order ();
+	ExifEntryValueResult exif_entry_get_uint (unsigned long index, ExifLong *value);
+	ExifEntryValueResult exif_entry_get_sint (unsigned long index, ExifSLong *value);
+	ExifEntryValueResult exif_entry_get_rational (unsigned long index, ExifRational *value);
+	ExifEntryValueResult exif_entry_get_srational (unsigned long index, ExifSRational *value);
+	ExifEntryValueResult exif_entry_get_double (unsigned long index, double *value);
+
+	/*! Return a view of all components of the entry, which must be
+	 * in format F.
+	 *
+	 * \param[out] span view of the components
+	 * \return #EXIF_ENTRY_VALUE_OK on success
+	 */
+	template <ExifFormat F> ExifEntryValueResult exif_entry_get_span (ExifEntrySpan<F> *span)
+	{
+		if (format != F)
+			return EXIF_ENTRY_VALUE_WRONG_FORMAT;
+		if (!data || (size / ExifFormatTraits<F>::size < components))
+			return EXIF_ENTRY_VALUE_NO_DATA;
+		*span = ExifEntrySpan<F> (data, components, exif_entry_get_byte_order ());
+		return EXIF_ENTRY_VALUE_OK;
+	}
+private:
+	ExifEntryValueResult exif_entry_check_value (unsigned long index);
 public:
 	/*! EXIF tag for this entry */
         ExifTag tag;
@@ -150,4 +274,10 @@ public:
 	ExifEntryPrivate priv;
 };
 
+int                    exif_entry_set_formatter (ExifTag tag,
+						 ExifEntryFormatterFunc func,
+						 void *user_data);
+ExifEntryFormatterFunc exif_entry_get_formatter (ExifTag tag,
+						 void **user_data);
+
 #endif /* __EXIF_ENTRY_H__ */
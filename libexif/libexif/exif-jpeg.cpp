@@ -0,0 +1,478 @@
+/* exif-jpeg.cpp
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include "exif-jpeg.h"
+#include "exif-parser.h"
+#include "exif-tag.h"
+#include "exif-utils.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+# include <io.h>
+#else
+# include <errno.h>
+# include <unistd.h>
+# ifdef __linux__
+#  include <sys/sendfile.h>
+#  include <sys/stat.h>
+# endif
+#endif
+
+#undef JPEG_MARKER_TEM
+#define JPEG_MARKER_TEM  0x01
+#undef JPEG_MARKER_RST0
+#define JPEG_MARKER_RST0 0xd0
+#undef JPEG_MARKER_RST7
+#define JPEG_MARKER_RST7 0xd7
+#undef JPEG_MARKER_SOI
+#define JPEG_MARKER_SOI  0xd8
+#undef JPEG_MARKER_EOI
+#define JPEG_MARKER_EOI  0xd9
+#undef JPEG_MARKER_SOS
+#define JPEG_MARKER_SOS  0xda
+#undef JPEG_MARKER_APP0
+#define JPEG_MARKER_APP0 0xe0
+#undef JPEG_MARKER_APP1
+#define JPEG_MARKER_APP1 0xe1
+
+/* Markers that stand alone, without a length */
+static int
+marker_has_length (unsigned char m)
+{
+	return (m != JPEG_MARKER_TEM) &&
+	       ((m < JPEG_MARKER_RST0) || (m > JPEG_MARKER_RST7));
+}
+
+int exif_jpeg_find_app1 (const unsigned char *d, unsigned int ds,
+			 unsigned int *offset, unsigned int *size)
+{
+	unsigned int o, l;
+	unsigned char m;
+
+	if (!d || !offset || !size)
+		return 0;
+	if ((ds < 2) || (d[0] != 0xff) || (d[1] != JPEG_MARKER_SOI))
+		return 0;
+
+	for (o = 2; o < ds; ) {
+		if (d[o] != 0xff)
+			return 0;
+
+		/* Skip fill bytes */
+		while ((o < ds) && (d[o] == 0xff))
+			o++;
+		if (o >= ds)
+			return 0;
+		m = d[o++];
+		if ((m == JPEG_MARKER_SOS) || (m == JPEG_MARKER_EOI))
+			return 0;
+		if (!marker_has_length (m))
+			continue;
+
+		/* The length counts itself but not the marker */
+		if (ds - o < 2)
+			return 0;
+		l = (d[o] << 8) | d[o + 1];
+		if ((l < 2) || (l > ds - o))
+			return 0;
+		if ((m == JPEG_MARKER_APP1) && (l >= 2 + sizeof (ExifParserHeader)) &&
+		    !memcmp (d + o + 2, ExifParserHeader, sizeof (ExifParserHeader))) {
+			*offset = o + 2;
+			*size = l - 2;
+			return 1;
+		}
+		o += l;
+	}
+	return 0;
+}
+
+int exif_jpeg_find_app1_file (FILE *f, long *offset, unsigned int *size)
+{
+	unsigned char b[sizeof (ExifParserHeader)];
+	int c;
+	unsigned int l;
+	long o;
+
+	if (!f || !offset || !size)
+		return 0;
+	if (fseek (f, 0, SEEK_SET) ||
+	    (getc (f) != 0xff) || (getc (f) != JPEG_MARKER_SOI))
+		return 0;
+
+	while (1) {
+		if (getc (f) != 0xff)
+			return 0;
+
+		/* Skip fill bytes */
+		while ((c = getc (f)) == 0xff)
+			;
+		if ((c == EOF) || (c == JPEG_MARKER_SOS) || (c == JPEG_MARKER_EOI))
+			return 0;
+		if (!marker_has_length ((unsigned char) c))
+			continue;
+
+		if (fread (b, 1, 2, f) != 2)
+			return 0;
+		l = (b[0] << 8) | b[1];
+		if (l < 2)
+			return 0;
+		o = ftell (f);
+		if (o < 0)
+			return 0;
+		if ((c == JPEG_MARKER_APP1) && (l >= 2 + sizeof (ExifParserHeader))) {
+			if (fread (b, 1, sizeof (b), f) != sizeof (b))
+				return 0;
+			if (!memcmp (b, ExifParserHeader, sizeof (ExifParserHeader))) {
+				*offset = o;
+				*size = l - 2;
+				return 1;
+			}
+		}
+		if (fseek (f, o + (long) l - 2, SEEK_SET))
+			return 0;
+	}
+}
+
+/* Find where to insert an APP1 segment: after the SOI marker and any
+ * APP0 segments, which have to come first */
+static int
+find_insert_position (FILE *f, long *pos)
+{
+	unsigned char b[2];
+	int c;
+
+	if (fseek (f, 0, SEEK_SET) ||
+	    (getc (f) != 0xff) || (getc (f) != JPEG_MARKER_SOI))
+		return 0;
+	*pos = 2;
+
+	while (getc (f) == 0xff) {
+		while ((c = getc (f)) == 0xff)
+			;
+		if (c != JPEG_MARKER_APP0)
+			break;
+		if ((fread (b, 1, 2, f) != 2) || (((b[0] << 8) | b[1]) < 2) ||
+		    fseek (f, (long) ((b[0] << 8) | b[1]) - 2, SEEK_CUR))
+			return 0;
+		*pos = ftell (f);
+		if (*pos < 0)
+			return 0;
+	}
+	return 1;
+}
+
+int exif_jpeg_find_app1_range_file (FILE *f, long *start, long *end)
+{
+	unsigned int size;
+	long offset;
+
+	if (!f || !start || !end)
+		return 0;
+
+	/* The segment starts with its marker and length */
+	if (exif_jpeg_find_app1_file (f, &offset, &size)) {
+		*start = offset - 4;
+		*end = offset + (long) size;
+		return 1;
+	}
+	if (!find_insert_position (f, start))
+		return 0;
+	*end = *start;
+	return 1;
+}
+
+/* Copy n bytes, or everything up to the end of the file if n < 0 */
+static int
+copy_range (FILE *src, FILE *dst, long n)
+{
+	unsigned char b[4096];
+	size_t l;
+
+	while (n) {
+		l = sizeof (b);
+		if ((n > 0) && ((unsigned long) n < l))
+			l = (size_t) n;
+		l = fread (b, 1, l, src);
+		if (!l)
+			return (n < 0) && !ferror (src);
+		if (fwrite (b, 1, l, dst) != l)
+			return 0;
+		if (n > 0)
+			n -= (long) l;
+	}
+	return 1;
+}
+
+/* Copy everything from offset start to the end of the file. On Linux the
+ * kernel copies it from file to file, so the image data does not pass
+ * through a buffer of ours; elsewhere, or if the kernel cannot, it is
+ * copied with copy_range. */
+static int
+copy_tail (FILE *src, FILE *dst, long start)
+{
+#ifdef __linux__
+	struct stat st;
+	off_t o = start;
+	ssize_t r = 0;
+	long pos;
+
+	if (!fflush (dst) && ((pos = ftell (dst)) >= 0) &&
+	    !fstat (fileno (src), &st) && S_ISREG (st.st_mode) &&
+	    (st.st_size >= start)) {
+		while (o < st.st_size) {
+			r = sendfile (fileno (dst), fileno (src), &o,
+				      (size_t) (st.st_size - o));
+			if (r <= 0)
+				break;
+		}
+		if (o != start) {
+			if (o < st.st_size)
+				return 0;
+			/* The stream does not know what has been written
+			 * to its descriptor */
+			return !fseek (dst, pos + (long) (o - start), SEEK_SET);
+		}
+		if ((r < 0) && (errno != EINVAL) && (errno != ENOSYS))
+			return 0;
+	}
+#endif
+	return !fseek (src, start, SEEK_SET) && copy_range (src, dst, -1);
+}
+
+int exif_jpeg_replace_app1_file (FILE *src, FILE *dst,
+				 const unsigned char *d, unsigned int ds)
+{
+	unsigned char m[4];
+	long start, end;
+
+	if (!src || !dst)
+		return 0;
+	if (d && ((ds < sizeof (ExifParserHeader)) || (ds > 0xffff - 2) ||
+		  memcmp (d, ExifParserHeader, sizeof (ExifParserHeader))))
+		return 0;
+	if (!exif_jpeg_find_app1_range_file (src, &start, &end))
+		return 0;
+
+	if (fseek (src, 0, SEEK_SET) || !copy_range (src, dst, start))
+		return 0;
+	if (d) {
+		m[0] = 0xff;
+		m[1] = JPEG_MARKER_APP1;
+		m[2] = (unsigned char) ((ds + 2) >> 8);
+		m[3] = (unsigned char) (ds + 2);
+		if ((fwrite (m, 1, sizeof (m), dst) != sizeof (m)) ||
+		    (fwrite (d, 1, ds, dst) != ds))
+			return 0;
+	}
+	return copy_tail (src, dst, end);
+}
+
+/* TIFF data of a given size, in memory or in a file */
+typedef struct {
+	const unsigned char *d;
+	FILE *f;
+	long base;
+	unsigned int size;
+} TiffSource;
+
+static int
+source_read (const TiffSource *s, unsigned int o, unsigned char *b,
+	     unsigned int n)
+{
+	if ((o > s->size) || (n > s->size - o))
+		return 0;
+	if (s->d) {
+		memcpy (b, s->d + o, n);
+		return 1;
+	}
+	return !fseek (s->f, s->base + (long) o, SEEK_SET) &&
+	       (fread (b, 1, n, s->f) == n);
+}
+
+/* Find the thumbnail through the pointer to IFD 1 and its
+ * JPEGInterchangeFormat tags, reading nothing but the TIFF header and
+ * the directories on the way. Offsets are relative to the TIFF header. */
+static int
+tiff_find_thumbnail (const TiffSource *s, unsigned int *offset,
+		     unsigned int *size)
+{
+	unsigned char b[12];
+	ExifByteOrder order;
+	unsigned int o, n, i, v, t_offset = 0, t_size = 0;
+	ExifShort tag, format;
+
+	if (!source_read (s, 0, b, 8))
+		return 0;
+	if (!memcmp (b, "II", 2))
+		order = EXIF_BYTE_ORDER_INTEL;
+	else if (!memcmp (b, "MM", 2))
+		order = EXIF_BYTE_ORDER_MOTOROLA;
+	else
+		return 0;
+	if (exif_get_short (b + 2, order) != 0x002a)
+		return 0;
+
+	/* Skip IFD 0 to the pointer to IFD 1 */
+	o = exif_get_long (b + 4, order);
+	if (!source_read (s, o, b, 2))
+		return 0;
+	n = exif_get_short (b, order);
+	if ((o > s->size - 2) || ((s->size - o - 2) / 12 < n) ||
+	    !source_read (s, o + 2 + 12 * n, b, 4))
+		return 0;
+	o = exif_get_long (b, order);
+	if (!o || !source_read (s, o, b, 2))
+		return 0;
+	n = exif_get_short (b, order);
+
+	for (i = 0; i < n; i++) {
+		if (!source_read (s, o + 2 + 12 * i, b, 12))
+			return 0;
+		tag = exif_get_short (b, order);
+		format = exif_get_short (b + 2, order);
+		if ((tag != EXIF_TAG_JPEG_INTERCHANGE_FORMAT) &&
+		    (tag != EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH))
+			continue;
+		if (format == EXIF_FORMAT_LONG)
+			v = exif_get_long (b + 8, order);
+		else if (format == EXIF_FORMAT_SHORT)
+			v = exif_get_short (b + 8, order);
+		else
+			continue;
+		if (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT)
+			t_offset = v;
+		else
+			t_size = v;
+	}
+
+	if (!t_offset || !t_size || (t_offset > s->size) ||
+	    (t_size > s->size - t_offset))
+		return 0;
+	*offset = t_offset;
+	*size = t_size;
+	return 1;
+}
+
+int exif_jpeg_find_thumbnail (const unsigned char *d, unsigned int ds,
+			      unsigned int *offset, unsigned int *size)
+{
+	TiffSource s;
+	unsigned int o, l;
+
+	if (!offset || !size || !exif_jpeg_find_app1 (d, ds, &o, &l) ||
+	    (l < sizeof (ExifParserHeader) + 8))
+		return 0;
+	s.d = d + o + sizeof (ExifParserHeader);
+	s.f = NULL;
+	s.base = 0;
+	s.size = l - sizeof (ExifParserHeader);
+	if (!tiff_find_thumbnail (&s, offset, size))
+		return 0;
+	*offset += o + sizeof (ExifParserHeader);
+	return 1;
+}
+
+int exif_jpeg_find_thumbnail_file (FILE *f, long *offset, unsigned int *size)
+{
+	TiffSource s;
+	unsigned int o, l;
+	long a;
+
+	if (!offset || !size || !exif_jpeg_find_app1_file (f, &a, &l) ||
+	    (l < sizeof (ExifParserHeader) + 8))
+		return 0;
+	s.d = NULL;
+	s.f = f;
+	s.base = a + (long) sizeof (ExifParserHeader);
+	s.size = l - sizeof (ExifParserHeader);
+	if (!tiff_find_thumbnail (&s, &o, size))
+		return 0;
+	*offset = s.base + (long) o;
+	return 1;
+}
+
+int exif_jpeg_write_thumbnail_file (FILE *f, ExifJpegWriteFunc func,
+				    void *user_data)
+{
+	unsigned char b[4096];
+	unsigned int size, l;
+	long offset;
+
+	if (!func || !exif_jpeg_find_thumbnail_file (f, &offset, &size) ||
+	    fseek (f, offset, SEEK_SET))
+		return 0;
+	while (size) {
+		l = (size < sizeof (b)) ? size : (unsigned int) sizeof (b);
+		if ((fread (b, 1, l, f) != l) || !func (b, l, user_data))
+			return 0;
+		size -= l;
+	}
+	return 1;
+}
+
+#ifdef _WIN32
+# define fd_write _write
+#else
+# define fd_write write
+#endif
+
+static int
+write_fd (const unsigned char *d, unsigned int ds, void *user_data)
+{
+	int fd = *(int *) user_data, r;
+
+	while (ds) {
+		r = (int) fd_write (fd, d, ds);
+		if (r <= 0)
+			return 0;
+		d += r;
+		ds -= (unsigned int) r;
+	}
+	return 1;
+}
+
+int exif_jpeg_write_thumbnail_fd (FILE *f, int fd)
+{
+#ifdef __linux__
+	unsigned int size;
+	long offset;
+	off_t o;
+	ssize_t r = 0;
+
+	/* Let the kernel copy the thumbnail, if it can */
+	if (!exif_jpeg_find_thumbnail_file (f, &offset, &size))
+		return 0;
+	o = offset;
+	while (size) {
+		r = sendfile (fd, fileno (f), &o, size);
+		if (r <= 0)
+			break;
+		size -= (unsigned int) r;
+	}
+	if (!size)
+		return 1;
+	if ((r < 0) && (errno != EINVAL) && (errno != ENOSYS))
+		return 0;
+	if (o != offset)
+		return 0;
+#endif
+	return exif_jpeg_write_thumbnail_file (f, write_fd, &fd);
+}
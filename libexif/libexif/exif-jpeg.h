@@ -0,0 +1,133 @@
+/*! \file exif-jpeg.h
+ * \brief Locating the EXIF data and the thumbnail in JPEG files
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __EXIF_JPEG_H__
+#define __EXIF_JPEG_H__
+
+#include <stdio.h>
+
+/*! Find the APP1 segment holding the EXIF data in a JPEG file in memory.
+ * Only the segments before the image data are searched.
+ *
+ * \param[in] d JPEG data, starting with the SOI marker
+ * \param[in] ds number of bytes at d
+ * \param[out] offset offset of the "Exif\0\0" header of the segment in d
+ * \param[out] size number of bytes in the segment from that header on
+ * \return 1 if the segment has been found, 0 otherwise
+ */
+int exif_jpeg_find_app1 (const unsigned char *d, unsigned int ds,
+			 unsigned int *offset, unsigned int *size);
+
+/*! Find the APP1 segment holding the EXIF data in a JPEG file. The file
+ * is read from its start; its position afterwards is unspecified.
+ *
+ * \param[in] f JPEG file opened for reading
+ * \param[out] offset offset of the "Exif\0\0" header of the segment in f
+ * \param[out] size number of bytes in the segment from that header on
+ * \return 1 if the segment has been found, 0 otherwise
+ */
+int exif_jpeg_find_app1_file (FILE *f, long *offset, unsigned int *size);
+
+/*! Find the bytes of a JPEG file that #exif_jpeg_replace_app1_file
+ * replaces: the APP1 segment holding the EXIF data, from its marker on,
+ * or the empty range after the SOI marker and any APP0 segments where
+ * such a segment would be inserted. The position of the file afterwards
+ * is unspecified.
+ *
+ * \param[in] f JPEG file opened for reading
+ * \param[out] start offset of the segment in f
+ * \param[out] end offset of the first byte after the segment, or start if
+ *   the file has no EXIF data
+ * \return 1 on success, 0 if f is no JPEG file
+ */
+int exif_jpeg_find_app1_range_file (FILE *f, long *start, long *end);
+
+/*! Copy a JPEG file, replacing the APP1 segment holding the EXIF data
+ * by new EXIF data. The segments before it and everything after it are
+ * copied as they are. If the source has no EXIF data, the new segment
+ * is inserted after the SOI marker and any APP0 segments.
+ *
+ * \param[in] src JPEG file opened for reading; it is read from its start
+ * \param[in] dst file opened for writing, written at its current position
+ * \param[in] d new EXIF data, starting with the "Exif\0\0" header as
+ *   produced by #exif_data_save_data, or NULL to drop the EXIF data
+ * \param[in] ds number of bytes at d, at most 65533
+ * \return 1 on success, 0 otherwise
+ */
+int exif_jpeg_replace_app1_file (FILE *src, FILE *dst,
+				 const unsigned char *d, unsigned int ds);
+
+/*! Function receiving a thumbnail in chunks from
+ * #exif_jpeg_write_thumbnail_file.
+ *
+ * \param[in] d next chunk of the thumbnail
+ * \param[in] ds number of bytes at d
+ * \param[in] user_data data passed to exif_jpeg_write_thumbnail_file
+ * \return 1 to continue, 0 to stop
+ */
+typedef int (* ExifJpegWriteFunc) (const unsigned char *d, unsigned int ds,
+				   void *user_data);
+
+/*! Find the thumbnail in the EXIF data of a JPEG file in memory, for
+ * example a mapped file. Only the TIFF header and the directories up to
+ * IFD 1 are read; no #ExifData is built.
+ *
+ * \param[in] d JPEG data, starting with the SOI marker
+ * \param[in] ds number of bytes at d
+ * \param[out] offset offset of the thumbnail in d
+ * \param[out] size number of bytes of the thumbnail
+ * \return 1 if a thumbnail has been found, 0 otherwise
+ */
+int exif_jpeg_find_thumbnail (const unsigned char *d, unsigned int ds,
+			      unsigned int *offset, unsigned int *size);
+
+/*! Find the thumbnail in the EXIF data of a JPEG file, reading only the
+ * headers and directories on the way. The position of the file
+ * afterwards is unspecified.
+ *
+ * \param[in] f JPEG file opened for reading
+ * \param[out] offset offset of the thumbnail in f
+ * \param[out] size number of bytes of the thumbnail
+ * \return 1 if a thumbnail has been found, 0 otherwise
+ */
+int exif_jpeg_find_thumbnail_file (FILE *f, long *offset, unsigned int *size);
+
+/*! Pass the thumbnail of a JPEG file to a function, in chunks of at most
+ * 4 KiB read straight from the file.
+ *
+ * \param[in] f JPEG file opened for reading
+ * \param[in] func function receiving the chunks
+ * \param[in] user_data data to pass to func
+ * \return 1 if the whole thumbnail has been passed, 0 otherwise
+ */
+int exif_jpeg_write_thumbnail_file (FILE *f, ExifJpegWriteFunc func,
+				    void *user_data);
+
+/*! Write the thumbnail of a JPEG file to a file descriptor. On Linux
+ * the kernel copies the data with sendfile(); elsewhere, or if the
+ * descriptor does not support it, the data is copied in chunks.
+ *
+ * \param[in] f JPEG file opened for reading
+ * \param[in] fd file descriptor opened for writing
+ * \return 1 if the whole thumbnail has been written, 0 otherwise
+ */
+int exif_jpeg_write_thumbnail_fd (FILE *f, int fd);
+
+#endif /* __EXIF_JPEG_H__ */
@@ -279,6 +279,9 @@ unsigned char ExifLoader::exif_loader_write (unsigned char *buf, unsigned int le
 
 /*! Allocate a new #ExifLoader.
  *
+ *  \param[in] mem0 memory the loader allocates its buffer with; give it
+ *    its own allocator to have the loader allocate elsewhere than the
+ *    #ExifData it loads
  *  \return allocated ExifLoader
  */
 void ExifLoader::exif_loader_new (ExifMem *mem0)
@@ -316,7 +319,10 @@ void ExifLoader::exif_loader_free ()
  */
 void ExifLoader::exif_loader_reset ()
 {
-	size>1?delete [] buf:delete buf;
+	if (mem)
+		mem->exif_mem_free (&buf);
+	else
+		delete [] buf;
 	buf=NULL;
 	size = 0;
 	bytes_read = 0;
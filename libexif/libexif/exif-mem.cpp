@@ -1,3 +1,197 @@
 #include "exif-mem.h"
 
-#include <stdlib.h>
\ No newline at end of file
+#include <stdlib.h>
+#include <algorithm>
+
+/* Header in front of each counted allocation, large enough to keep the
+ * memory behind it aligned for any type */
+typedef union {
+	unsigned int size;
+	double d;
+	void *p;
+	long l;
+} CountHeader;
+
+static void *
+count_alloc (unsigned int ds, void *user_data)
+{
+	ExifMemStats *stats = (ExifMemStats *) user_data;
+	unsigned int n = ds + sizeof (CountHeader);
+	CountHeader *h;
+
+	if (n < ds)
+		return NULL;
+	if (stats->alloc_func)
+		h = (CountHeader *) stats->alloc_func (n, stats->user_data);
+	else
+		h = (CountHeader *) new unsigned char[n];
+	if (!h)
+		return NULL;
+	h->size = ds;
+
+	stats->allocations++;
+	stats->bytes += ds;
+	stats->current += ds;
+	if (stats->current > stats->peak)
+		stats->peak = stats->current;
+	return h + 1;
+}
+
+static void
+count_free (void *p, void *user_data)
+{
+	ExifMemStats *stats = (ExifMemStats *) user_data;
+	CountHeader *h = (CountHeader *) p - 1;
+
+	stats->frees++;
+	stats->current -= h->size;
+	if (stats->free_func)
+		stats->free_func (h, stats->user_data);
+	else
+		delete [] (unsigned char *) h;
+}
+
+/*! Start counting anew, for example before each parse: the counts are
+ * zeroed, and the peak starts at the number of bytes held now. */
+void ExifMemStats::exif_mem_stats_restart ()
+{
+	allocations = 0;
+	frees = 0;
+	bytes = 0;
+	peak = current;
+}
+
+/*! Allocate ds bytes with the allocator.
+ *
+ * \param[in] ds number of bytes
+ * \return the memory, or NULL if ds is 0 or there is no memory
+ */
+void *ExifMem::exif_mem_alloc_bytes (unsigned int ds)
+{
+	if (!ds)
+		return NULL;
+	if (alloc_func)
+		return alloc_func (ds, user_data);
+	return new unsigned char[ds];
+}
+
+/*! Free memory of #exif_mem_alloc_bytes.
+ *
+ * \param[in] p memory to free, or NULL
+ */
+void ExifMem::exif_mem_free_bytes (void *p)
+{
+	if (!p)
+		return;
+	if (free_func)
+		free_func (p, user_data);
+	else
+		delete [] (unsigned char *) p;
+}
+
+/*! Set the functions that allocate and free memory from now on. All
+ * memory of the previous allocator has to be freed before, apart from
+ * the kept buffers, which are freed here.
+ *
+ * \param[in] alloc0 allocating function, or NULL for new[]
+ * \param[in] free0 freeing function, or NULL for delete[]
+ * \param[in] user_data0 data to pass to both functions
+ */
+void ExifMem::exif_mem_set_allocator (ExifMemAllocFunc alloc0,
+				      ExifMemFreeFunc free0, void *user_data0)
+{
+	exif_mem_free_kept ();
+	if (!alloc0 || !free0) {
+		alloc0 = NULL;
+		free0 = NULL;
+	}
+	alloc_func = alloc0;
+	free_func = free0;
+	user_data = user_data0;
+}
+
+/*! Count the allocations from now on in stats, passing them on to the
+ * allocator set so far. The stats have to live as long as anything
+ * allocated through them, and must not be used for another #ExifMem
+ * at the same time.
+ *
+ * \param[in,out] stats counts; they are started with
+ *   #exif_mem_stats_restart
+ */
+void ExifMem::exif_mem_set_counting (ExifMemStats *stats)
+{
+	if (!stats)
+		return;
+	exif_mem_free_kept ();
+	if (alloc_func == count_alloc) {
+		/* Counting already: count for the same allocator */
+		ExifMemStats *old = (ExifMemStats *) user_data;
+
+		stats->alloc_func = old->alloc_func;
+		stats->free_func = old->free_func;
+		stats->user_data = old->user_data;
+	} else {
+		stats->alloc_func = alloc_func;
+		stats->free_func = free_func;
+		stats->user_data = user_data;
+	}
+	stats->exif_mem_stats_restart ();
+	exif_mem_set_allocator (count_alloc, count_free, stats);
+}
+
+typedef ExifMemberLess<ExifMemBlock, unsigned int, &ExifMemBlock::size> BlockSizeLess;
+
+/*! Allocate a buffer of ds bytes, handing out a kept buffer of exactly
+ * that size if there is one.
+ *
+ * \param[in] ds number of bytes
+ * \return the buffer, or NULL if ds is 0
+ */
+unsigned char *ExifMem::exif_mem_alloc_buffer (unsigned int ds)
+{
+	std::vector<ExifMemBlock>::iterator it;
+	unsigned char *d = NULL;
+
+	if (!ds)
+		return NULL;
+	it = std::lower_bound (kept.begin (), kept.end (), ds, BlockSizeLess ());
+	if ((it != kept.end ()) && (it->size == ds)) {
+		d = it->data;
+		kept.erase (it);
+		return d;
+	}
+	return (unsigned char *) exif_mem_alloc_bytes (ds);
+}
+
+/*! Keep a buffer of #exif_mem_alloc_buffer to be handed out again
+ * instead of freeing it.
+ *
+ * \param[in,out] d buffer; set to NULL
+ * \param[in] ds number of bytes at *d
+ */
+void ExifMem::exif_mem_keep_buffer (unsigned char **d, unsigned int ds)
+{
+	ExifMemBlock b;
+
+	if (!*d)
+		return;
+	if (!ds) {
+		exif_mem_free (d);
+		return;
+	}
+	b.data = *d;
+	b.size = ds;
+	kept.insert (std::lower_bound (kept.begin (), kept.end (), ds,
+				       BlockSizeLess ()), b);
+	*d = NULL;
+}
+
+/*! Free all kept buffers. The list keeps its capacity. */
+void ExifMem::exif_mem_free_kept ()
+{
+	std::vector<ExifMemBlock>::iterator it;
+
+	for (it = kept.begin (); it != kept.end (); ++it)
+		exif_mem_free_bytes (it->data);
+	kept.clear ();
+}
@@ -27,8 +27,81 @@
 
 #include "exif-utils.h"
 #include <stdio.h>
+#include <string.h>
 
+#include <vector>
 
+/*! Function allocating memory for #ExifMem, set with
+ * #exif_mem_set_allocator. The memory has to be suitably aligned for
+ * any type, like the memory of malloc.
+ *
+ * \param[in] ds number of bytes, never 0
+ * \param[in] user_data data passed to exif_mem_set_allocator
+ * \return the memory, or NULL if there is none
+ */
+typedef void *(* ExifMemAllocFunc) (unsigned int ds, void *user_data);
+
+/*! Function freeing memory of the matching #ExifMemAllocFunc.
+ *
+ * \param[in] p memory to free, never NULL
+ * \param[in] user_data data passed to exif_mem_set_allocator
+ */
+typedef void (* ExifMemFreeFunc) (void *p, void *user_data);
+
+/*! A buffer kept by #ExifMem to be handed out again */
+typedef struct {
+	unsigned char *data;
+	unsigned int size;
+} ExifMemBlock;
+
+/*! Allocations counted by the allocator of #exif_mem_set_counting. It
+ * is not locked, so it must only count for memory used by one thread
+ * at a time. */
+class ExifMemStats
+{
+public:
+	ExifMemStats()
+	{
+		Init();
+	}
+
+	void inline Init()
+	{
+		allocations=0;
+		frees=0;
+		bytes=0;
+		current=0;
+		peak=0;
+		alloc_func=NULL;
+		free_func=NULL;
+		user_data=NULL;
+	}
+public:
+	void exif_mem_stats_restart ();
+public:
+	/*! Number of allocations and frees */
+	unsigned long allocations;
+	unsigned long frees;
+
+	/*! Number of bytes allocated in all */
+	unsigned long bytes;
+
+	/*! Number of bytes held now, and the most held at once */
+	unsigned long current;
+	unsigned long peak;
+
+	/*! Allocator doing the allocations that are counted, or NULL for
+	 * the default one */
+	ExifMemAllocFunc alloc_func;
+	ExifMemFreeFunc free_func;
+	void *user_data;
+};
+
+/*! Memory management of libexif. Values, thumbnails and the buffers
+ * of the loader and the MakerNotes are allocated through an #ExifMem;
+ * with no allocator set, new[] and delete[] are used. The templates are
+ * meant for plain types only, as no constructors are run.
+ */
 class ExifMem 
 {
 public:
@@ -36,13 +109,9 @@ public:
 	{
 		exif_mem_free(ReturnData);
 
-		if (ds == 1)
+		if (ds)
 		{
-			*ReturnData=new T;
-		}
-		if (ds > 1)
-		{
-			*ReturnData=new T[ds];
+			*ReturnData=(T *) exif_mem_alloc_bytes(ds*sizeof(T));
 		}
 	}
 
@@ -50,60 +119,61 @@ public:
 	{
 		if (*InputData)
 		{
-			delete [] *InputData;
+			exif_mem_free_bytes(*InputData);
 		}
 		*InputData=NULL;
 	}
 
-	template<typename T> inline T *exif_mem_realloc(T **InputData,unsigned int ds)
+	/* Grow the ds_old elements at *InputData to ds elements. The
+	 * contents are kept and the new elements are zeroed. */
+	template<typename T> inline T *exif_mem_realloc(T **InputData,unsigned int ds_old,unsigned int ds)
 	{
-		if (*InputData)
-		{
-			unsigned int length=sizeof(*InputData)/sizeof((*InputData)[0]);
-
-			if (length < ds)
-			{
-				T *pData=new T[ds];
-				memset(pData,0,ds*sizeof(T));
-				memcpy(pData,*InputData, (ds-1)*sizeof(T));
-				if (ds==2 || (length==1 && sizeof(T) ==1))
-				{
-					delete *InputData;
-				}
-				else
-				{
-					delete [] *InputData;
-				}
-				
-				*InputData = pData;
-			}
-				
-			return *InputData;
+		T *pData=NULL;
 
-		}
-		else
-		{
-			if (ds == 1)
-			{
-				*InputData=new T;
-			}
-			if (ds > 1)
-			{
-				*InputData=new T[ds];
-			}
+		if (*InputData && (ds_old >= ds))
 			return *InputData;
-		}
-
-		return NULL;
+		if (!ds)
+			return NULL;
 
+		pData=(T *) exif_mem_alloc_bytes(ds*sizeof(T));
+		if (!pData)
+			return NULL;
+		memset(pData,0,ds*sizeof(T));
+		if (*InputData)
+			memcpy(pData,*InputData,ds_old*sizeof(T));
+		exif_mem_free(InputData);
+		*InputData=pData;
+		return *InputData;
 	}
+
+	void *exif_mem_alloc_bytes (unsigned int ds);
+	void exif_mem_free_bytes (void *p);
+	void exif_mem_set_allocator (ExifMemAllocFunc alloc0, ExifMemFreeFunc free0,
+				     void *user_data0);
+	void exif_mem_set_counting (ExifMemStats *stats);
+
+	unsigned char *exif_mem_alloc_buffer (unsigned int ds);
+	void exif_mem_keep_buffer (unsigned char **d, unsigned int ds);
+	void exif_mem_free_kept ();
 public:
 	ExifMem()
 	{
+		alloc_func=NULL;
+		free_func=NULL;
+		user_data=NULL;
 	}
 	~ExifMem()
 	{
+		exif_mem_free_kept ();
 	}
+public:
+	/*! Allocator, or NULL for new[] and delete[] */
+	ExifMemAllocFunc alloc_func;
+	ExifMemFreeFunc free_func;
+	void *user_data;
+
+	/*! Buffers given back with #exif_mem_keep_buffer, sorted by size */
+	std::vector<ExifMemBlock> kept;
 };
 
 
@@ -21,6 +21,8 @@
 #include "config.h"
 
 #include "exif-mnote-data.h"
+#include "exif-format.h"
+#include "exif-utils.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -74,9 +76,15 @@ void ExifMnoteData::exif_mnote_data_save (unsigned char **buf,
 	save (buf, buf_size);
 }
 
+/*! Set the byte order the MakerNote is saved in. The entries keep the
+ * byte order they have been loaded in and are converted on saving.
+ *
+ * \param[in] o byte order
+ */
 void ExifMnoteData::exif_mnote_data_set_byte_order (ExifByteOrder o)
 {
 	set_byte_order (o);
+	dirty = 1;
 }
 
 void ExifMnoteData::exif_mnote_data_set_offset (unsigned int o)
@@ -84,6 +92,88 @@ void ExifMnoteData::exif_mnote_data_set_offset (unsigned int o)
 	set_offset (o);
 }
 
+/*! Make the raw MakerNote data this MakerNote was loaded from valid at
+ * another offset in the EXIF data, so that it can be saved as it is
+ * instead of being serialised again from its entries.
+ *
+ * \param[in,out] buf raw MakerNote data, as loaded
+ * \param[in] buf_size number of bytes of data at buf
+ * \param[in] o offset at which the MakerNote will be saved
+ * \return 1 if buf is valid at offset o, 0 if it has to be saved with
+ *   #exif_mnote_data_save
+ */
+int ExifMnoteData::exif_mnote_data_relocate (unsigned char *buf,
+		      unsigned int buf_size, unsigned int o)
+{
+	if (dirty || !buf || !buf_size)
+		return 0;
+	return relocate (buf, buf_size, o);
+}
+
+/*! Pass the entries of the raw MakerNote data to a function, with their
+ * values pointing into the data, without loading them. The byte order
+ * and offset have to be set as for #exif_mnote_data_load; the entries
+ * that have been loaded are left alone.
+ *
+ * \param[in] buf raw MakerNote data, as passed to exif_mnote_data_load
+ * \param[in] buf_size number of bytes of data at buf
+ * \param[in] func function receiving the entries
+ * \param[in] user_data data to pass to func
+ * \return 0 if func has stopped the walk, 1 otherwise
+ */
+int ExifMnoteData::exif_mnote_data_walk (const unsigned char *buf,
+		      unsigned int buf_size, ExifMnoteWalkFunc func, void *user_data)
+{
+	if (!buf || !buf_size || !func)
+		return 1;
+	return walk (buf, buf_size, func, user_data);
+}
+
+/*! Move the offsets of the directory at o2 in the raw MakerNote data
+ * at buf, which use byte order \c order and are relative to the EXIF
+ * data, from a MakerNote at o_old to one at o_new. Nothing is changed
+ * unless all values outside the directory lie within the MakerNote,
+ * because values elsewhere in the EXIF data do not move with it.
+ *
+ * \return 1 on success, 0 otherwise
+ */
+int exif_mnote_data_relocate_ifd (unsigned char *buf, unsigned int buf_size,
+				  unsigned int o2, ExifByteOrder order,
+				  unsigned int o_old, unsigned int o_new)
+{
+	size_t c, i, n, s, o;
+	int pass;
+
+	if ((o2 > buf_size) || (buf_size - o2 < 2))
+		return 0;
+	c = exif_get_short (buf + o2, order);
+	if ((buf_size - o2 - 2) / 12 < c)
+		return 0;
+
+	/* Check every offset first, then move them */
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < c; i++) {
+			unsigned char *e = buf + o2 + 2 + 12 * i;
+
+			s = exif_format_get_size ((ExifFormat) exif_get_short (e + 2, order));
+			n = exif_get_long (e + 4, order);
+			if (!s || (n <= 4 / s))
+				continue;
+			if (n > buf_size)
+				return 0;
+			s *= n;
+			o = exif_get_long (e + 8, order);
+			if (!pass) {
+				if ((o < o_old) || (o - o_old > buf_size) ||
+				    (s > buf_size - (o - o_old)))
+					return 0;
+			} else
+				exif_set_long (e + 8, order, (ExifLong) (o - o_old + o_new));
+		}
+	}
+	return 1;
+}
+
 /*! Return the number of tags in the MakerNote.
  * \return number of tags, or 0 if no MakerNote or the type is not supported
  */
@@ -151,6 +241,26 @@ char *ExifMnoteData::exif_mnote_data_get_value (unsigned int n, char *val, unsig
 	return get_value (n, val, maxlen);
 }
 
+/*! Return the vendor whose MakerNote has been interpreted.
+ *
+ * \return vendor, #EXIF_MNOTE_VENDOR_UNKNOWN if it is not known
+ */
+ExifMnoteVendor ExifMnoteData::exif_mnote_data_get_vendor ()
+{
+	return get_vendor ();
+}
+
+/*! Return the number of bytes held by the interpreted MakerNote: the
+ * object, its entries and their values. The raw MakerNote is held by its
+ * #ExifEntry and is not included.
+ *
+ * \return number of bytes
+ */
+unsigned long ExifMnoteData::exif_mnote_data_memory_usage ()
+{
+	return memory_usage ();
+}
+
 void ExifMnoteData::exif_mnote_data_log (ExifLog *log0)
 {
 
@@ -26,9 +26,44 @@
 #include "exif-mnote-data.h"
 #include "exif-byte-order.h"
 #include "exif-log.h"
+#include "exif-format.h"
 #include <stdio.h>
 
+/*! One entry of a MakerNote as it is stored, found by
+ * #exif_mnote_data_walk */
+typedef struct {
+	/*! Tag, with the base of the MakerNote variant added as in the
+	 * tag lists of the vendors */
+	unsigned int tag;
+	ExifFormat format;
+	unsigned long components;
+	ExifByteOrder order;
 
+	/*! Value in the walked data, or NULL if the entry has none */
+	const unsigned char *data;
+	unsigned int size;
+} ExifMnoteRawEntry;
+
+/*! Function receiving the entries of a MakerNote from
+ * #exif_mnote_data_walk.
+ *
+ * \param[in] e entry; its value is only valid during the call
+ * \param[in] user_data data passed to exif_mnote_data_walk
+ * \return 1 to continue, 0 to stop
+ */
+typedef int (* ExifMnoteWalkFunc) (const ExifMnoteRawEntry *e, void *user_data);
+
+/*! Vendors of the MakerNotes that are interpreted */
+typedef enum {
+	EXIF_MNOTE_VENDOR_UNKNOWN = 0,
+	EXIF_MNOTE_VENDOR_CANON,
+	/*! Olympus, and the Nikon, Sanyo and Epson MakerNotes read alike */
+	EXIF_MNOTE_VENDOR_OLYMPUS,
+	EXIF_MNOTE_VENDOR_FUJI,
+	/*! Pentax, and the Casio MakerNotes read alike */
+	EXIF_MNOTE_VENDOR_PENTAX,
+	EXIF_MNOTE_VENDOR_COUNT
+} ExifMnoteVendor;
 
 /*! \internal */
 class ExifMnoteData 
@@ -43,6 +78,7 @@ public:
 	{
 		log=NULL;
 		mem=NULL;
+		dirty=0;
 	}
 	virtual ~ExifMnoteData ()
 	{
@@ -55,12 +91,18 @@ public:
 	void exif_mnote_data_save (unsigned char **buf,unsigned int *buf_size);
 	void exif_mnote_data_set_byte_order (ExifByteOrder o);
 	void exif_mnote_data_set_offset (unsigned int o);
+	int exif_mnote_data_relocate (unsigned char *buf, unsigned int buf_size,
+				      unsigned int o);
+	int exif_mnote_data_walk (const unsigned char *buf, unsigned int buf_size,
+				  ExifMnoteWalkFunc func, void *user_data);
 	unsigned int exif_mnote_data_count ();
 	unsigned int exif_mnote_data_get_id (unsigned int n);
 	const char *exif_mnote_data_get_name (unsigned int n);
 	const char *exif_mnote_data_get_title (unsigned int n);;
 	const char *exif_mnote_data_get_description (unsigned int n);
 	char *exif_mnote_data_get_value (unsigned int n, char *val, unsigned int maxlen);
+	ExifMnoteVendor exif_mnote_data_get_vendor ();
+	unsigned long exif_mnote_data_memory_usage ();
 	void exif_mnote_data_log (ExifLog *log);
 
 public:
@@ -72,6 +114,8 @@ public:
 	virtual void load(const unsigned char *, unsigned int)=0;
 	virtual void set_offset(unsigned int)=0;
 	virtual void set_byte_order(ExifByteOrder)=0;
+	virtual int relocate(unsigned char *, unsigned int, unsigned int) { return 0; }
+	virtual int walk(const unsigned char *, unsigned int, ExifMnoteWalkFunc, void *) { return 1; }
 
 	/* Query */
 	virtual unsigned int get_count()=0;
@@ -80,12 +124,53 @@ public:
 	virtual const char * get_title(unsigned int)=0;
 	virtual const char * get_description(unsigned int)=0;
 	virtual char * get_value(unsigned int, char *val, unsigned int maxlen)=0;
+	virtual ExifMnoteVendor get_vendor() { return EXIF_MNOTE_VENDOR_UNKNOWN; }
+	virtual unsigned long memory_usage() { return sizeof (*this); }
 public:
 	/* Logging */
 	ExifLog *log;
 
 	/* Memory management */
 	ExifMem *mem;
+
+	/* Set once the MakerNote has been changed after loading */
+	int dirty;
 };
 
+/*! \internal Number of bytes the values of the given MakerNote entries
+ * take after their directory when saved, each padded to an even size if
+ * \c pad is set. Values that fit into their entry, and values larger
+ * than a JPEG segment, which are not saved, take none. */
+template <class E> size_t
+exif_mnote_data_values_size (const E *entries, size_t count, int pad)
+{
+	size_t i, s, n = 0;
+
+	for (i = 0; i < count; i++) {
+		s = exif_format_get_size (entries[i].format) *
+						entries[i].components;
+		if ((s > 4) && (s <= 65536))
+			n += (pad && (s & 1)) ? s + 1 : s;
+	}
+	return n;
+}
+
+/*! \internal Number of bytes held by the given loaded MakerNote
+ * entries: the entries themselves and their values. */
+template <class E> unsigned long
+exif_mnote_data_entries_memory (const E *entries, size_t count)
+{
+	unsigned long n = 0;
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		n += sizeof (E) + entries[i].size;
+	return n;
+}
+
+/*! \internal */
+int exif_mnote_data_relocate_ifd (unsigned char *buf, unsigned int buf_size,
+				  unsigned int o2, ExifByteOrder order,
+				  unsigned int o_old, unsigned int o_new);
+
 #endif /* __EXIF_MNOTE_PRIV_H__ */
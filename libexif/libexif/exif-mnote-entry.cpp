@@ -6,7 +6,10 @@ void ExifMnoteEntry::data_free()
 {
 	if (data)
 	{
-		size>1?delete [] data:delete data;
+		if (mem)
+			mem->exif_mem_free(&data);
+		else
+			delete [] data;
 		data=NULL;
 		size=0;
 	}
@@ -15,5 +18,8 @@ void ExifMnoteEntry::data_new(unsigned int s)
 {
 	data_free();
 	size=s;
-	data=new unsigned char[s];
+	if (mem)
+		mem->exif_mem_alloc(&data,s);
+	else
+		data=new unsigned char[s];
 }
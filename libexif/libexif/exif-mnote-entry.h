@@ -41,6 +41,7 @@ public:
 	{
 		data=NULL;
 		size=0;
+		mem=NULL;
 	}
 	~ExifMnoteEntry()
 	{
@@ -52,6 +53,8 @@ public:
 	unsigned char *data;
 	unsigned int size;
 
+	/* Memory of the data, or NULL if it is allocated with new[] */
+	ExifMem *mem;
 };
 
 #endif /* __EXIF_MNOTEENTRY_H__ */
@@ -0,0 +1,300 @@
+/* exif-parser.cpp
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include "exif-parser.h"
+#include "exif-jpeg.h"
+#include "exif-utils.h"
+
+#include "canon/exif-mnote-data-canon.h"
+#include "fuji/exif-mnote-data-fuji.h"
+#include "olympus/exif-mnote-data-olympus.h"
+#include "pentax/exif-mnote-data-pentax.h"
+
+#include <string.h>
+
+const unsigned char ExifParserHeader[6] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00};
+
+const ExifIfd ExifParserFindOrder[5] = {
+	EXIF_IFD_0, EXIF_IFD_1, EXIF_IFD_EXIF, EXIF_IFD_GPS,
+	EXIF_IFD_INTEROPERABILITY
+};
+
+/* Passes what the walk of the directories finds to the callbacks of a
+ * parser, and keeps the Make, the MakerNote and the thumbnail */
+class ExifParserVisitor
+{
+public:
+	ExifParserVisitor (ExifParser *p0, unsigned int ts0)
+	{
+		p = p0;
+		ts = ts0;
+	}
+
+	int enter (ExifIfd)
+	{
+		return 1;
+	}
+
+	int begin (ExifIfd ifd, unsigned int n)
+	{
+		return !p->callbacks.on_ifd_begin ||
+		       p->callbacks.on_ifd_begin (ifd, n, p->user_data);
+	}
+
+	int entry (ExifIfd ifd, const ExifParserEntry *e)
+	{
+		if ((e->tag == EXIF_TAG_MAKE) && !p->priv.make[ifd].size)
+			p->priv.make[ifd] = *e;
+		else if ((e->tag == EXIF_TAG_MAKER_NOTE) && !p->priv.mnote[ifd].size)
+			p->priv.mnote[ifd] = *e;
+		return !p->callbacks.on_entry ||
+		       p->callbacks.on_entry (ifd, e, p->user_data);
+	}
+
+	void thumbnail (ExifLong o, ExifLong s)
+	{
+		if ((o > ts) || (s > ts - o))
+			return;
+		p->priv.thumbnail_offset = o;
+		p->priv.thumbnail_size = s;
+	}
+
+	int end (ExifIfd ifd)
+	{
+		return !p->callbacks.on_ifd_end ||
+		       p->callbacks.on_ifd_end (ifd, p->user_data);
+	}
+public:
+	ExifParser *p;
+
+	/* Number of bytes of the TIFF data */
+	unsigned int ts;
+};
+
+/* The first entry of the given kind in the order of exif_data_get_entry */
+static const ExifParserEntry *
+parser_find (const ExifParserEntry *entries)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof (ExifParserFindOrder) / sizeof (ExifParserFindOrder[0]); i++)
+		if (entries[ExifParserFindOrder[i]].size)
+			return &entries[ExifParserFindOrder[i]];
+	return NULL;
+}
+
+/* The Make as exif_entry_get_value returns it with the given maxlen */
+static const char *
+parser_get_make (const ExifParserEntry *e, char *val, unsigned int maxlen)
+{
+	memset (val, 0, maxlen);
+	if (e && (e->format == EXIF_FORMAT_ASCII))
+		strncpy (val, (const char *) e->data, MIN (maxlen - 2, e->size));
+	return val;
+}
+
+int exif_parser_makernote_variant (ExifMnoteVendor vendor,
+				   const ExifParserEntry *m,
+				   const ExifParserEntry *make)
+{
+	char value[8];
+	int variant;
+
+	if (!m || !m->data)
+		return 0;
+	switch (vendor) {
+	case EXIF_MNOTE_VENDOR_OLYMPUS:
+		variant = exif_mnote_data_olympus_identify_variant (m->data, m->size);
+
+		/* This variant needs some extra checking with the Make. When
+		 * saved, it will be written out like nikonV2 instead. */
+		if (variant == nikonV0) {
+			parser_get_make (make, value, 5);
+			if (strncmp (value, "Nikon", 5) && strncmp (value, "NIKON", 5))
+				variant = unrecognized;
+		}
+		return variant;
+	case EXIF_MNOTE_VENDOR_CANON:
+		return make && !strcmp (parser_get_make (make, value, sizeof (value)),
+					"Canon");
+	case EXIF_MNOTE_VENDOR_FUJI:
+		return (m->size >= 12) && !memcmp (m->data, "FUJIFILM", 8);
+	case EXIF_MNOTE_VENDOR_PENTAX:
+		if ((m->size >= 8) && !memcmp (m->data, "AOC", 4)) {
+			if (((m->data[4] == 'I') && (m->data[5] == 'I')) ||
+			    ((m->data[4] == 'M') && (m->data[5] == 'M')))
+				return pentaxV3;
+
+			/* Uses Casio v2 tags */
+			return pentaxV2;
+		}
+		if ((m->size >= 8) && !memcmp (m->data, "QVC", 4))
+			return casioV2;
+
+		/* This isn't a very robust test, so make sure it's done last */
+		if ((m->size >= 2) && (m->data[0] == 0x00) && (m->data[1] == 0x1b))
+			return pentaxV1;
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+ExifMnoteVendor exif_parser_identify_makernote (const ExifParserEntry *m,
+						const ExifParserEntry *make,
+						int *variant)
+{
+	/* NOTE: Pentax detection must come last because some of the
+	 * heuristics are pretty general. */
+	static const ExifMnoteVendor order[] = {
+		EXIF_MNOTE_VENDOR_OLYMPUS, EXIF_MNOTE_VENDOR_CANON,
+		EXIF_MNOTE_VENDOR_FUJI, EXIF_MNOTE_VENDOR_PENTAX
+	};
+	unsigned int i;
+	int v;
+
+	for (i = 0; i < sizeof (order) / sizeof (order[0]); i++)
+		if ((v = exif_parser_makernote_variant (order[i], m, make)) != 0) {
+			if (variant)
+				*variant = v;
+			return order[i];
+		}
+	if (variant)
+		*variant = 0;
+	return EXIF_MNOTE_VENDOR_UNKNOWN;
+}
+
+/* Walk the MakerNote with the given vendor module, as interpret_maker_note
+ * would load it */
+static int
+parser_walk_mnote (ExifParser *p, ExifMnoteData *md, const ExifParserEntry *m)
+{
+	md->exif_mnote_data_log (&p->log);
+	md->set_byte_order (p->order);
+	md->set_offset (m->offset);
+	return md->exif_mnote_data_walk (p->priv.header, p->priv.header_size,
+					 p->callbacks.on_makernote_entry, p->user_data);
+}
+
+/* Identify the MakerNote like interpret_maker_note and walk it. Returns
+ * 0 if the callback has stopped the walk. */
+static int
+parser_walk_makernote (ExifParser *p)
+{
+	const ExifParserEntry *m = parser_find (p->priv.mnote);
+
+	switch (exif_parser_identify_makernote (m, parser_find (p->priv.make), NULL)) {
+	case EXIF_MNOTE_VENDOR_OLYMPUS: {
+		ExifMnoteDataOlympus md;
+		return parser_walk_mnote (p, &md, m);
+	}
+	case EXIF_MNOTE_VENDOR_CANON: {
+		ExifMnoteDataCanon md;
+		return parser_walk_mnote (p, &md, m);
+	}
+	case EXIF_MNOTE_VENDOR_FUJI: {
+		ExifMnoteDataFuji md;
+		return parser_walk_mnote (p, &md, m);
+	}
+	case EXIF_MNOTE_VENDOR_PENTAX: {
+		ExifMnoteDataPentax md;
+		return parser_walk_mnote (p, &md, m);
+	}
+	default:
+		return 1;
+	}
+}
+
+/*! Walk the EXIF data in the given buffer and pass what is found to the
+ * callbacks. The buffer has to stay valid during the call only.
+ *
+ * \param[in] d JPEG data starting with the SOI marker, or EXIF data
+ *   starting with the "Exif\0\0" header
+ * \param[in] ds number of bytes at d
+ * \return #EXIF_PARSER_RESULT_OK if all of the data has been walked
+ */
+ExifParserResult ExifParser::exif_parser_parse (const unsigned char *d,
+						unsigned int ds)
+{
+	unsigned int o = 0, l = ds, ts;
+	const unsigned char *t;
+	ExifByteOrder bo;
+	ExifLong offset;
+	int r;
+
+	priv.Init ();
+	if (!d)
+		return EXIF_PARSER_RESULT_NO_DATA;
+	if (((ds < sizeof (ExifParserHeader)) || memcmp (d, ExifParserHeader, sizeof (ExifParserHeader))) &&
+	    !exif_jpeg_find_app1 (d, ds, &o, &l))
+		return EXIF_PARSER_RESULT_NO_DATA;
+	if (l < 14)
+		return EXIF_PARSER_RESULT_NO_DATA;
+
+	/* The same limit as in exif_data_load_data */
+	ts = MIN (l, 0xfffe) - sizeof (ExifParserHeader);
+	t = d + o + sizeof (ExifParserHeader);
+
+	if (!memcmp (t, "II", 2))
+		bo = EXIF_BYTE_ORDER_INTEL;
+	else if (!memcmp (t, "MM", 2))
+		bo = EXIF_BYTE_ORDER_MOTOROLA;
+	else
+		return EXIF_PARSER_RESULT_NO_DATA;
+	if (exif_get_short (t + 2, bo) != 0x002a)
+		return EXIF_PARSER_RESULT_NO_DATA;
+	offset = exif_get_long (t + 4, bo);
+	if ((offset > ts) || (ts - offset < 2))
+		return EXIF_PARSER_RESULT_NO_DATA;
+
+	order = bo;
+	priv.header = d + o;
+	priv.header_size = l;
+	priv.offset_tiff = o + sizeof (ExifParserHeader);
+	priv.tiff_size = ts;
+
+	ExifParserVisitor v (this, ts);
+	if (order == EXIF_BYTE_ORDER_INTEL)
+		r = exif_parser_walk_ifds (&v, ExifBufferReader<EXIF_BYTE_ORDER_INTEL> (t, ts),
+					   offset, priv.count, &log);
+	else
+		r = exif_parser_walk_ifds (&v, ExifBufferReader<EXIF_BYTE_ORDER_MOTOROLA> (t, ts),
+					   offset, priv.count, &log);
+	if (!r)
+		return EXIF_PARSER_RESULT_STOPPED;
+
+	if (callbacks.on_makernote_entry && !parser_walk_makernote (this))
+		return EXIF_PARSER_RESULT_STOPPED;
+	return EXIF_PARSER_RESULT_OK;
+}
+
+/*! Return the thumbnail found by the last walk, in the walked buffer.
+ *
+ * \param[out] ds number of bytes of the thumbnail, or NULL
+ * \return the thumbnail, or NULL if none has been found
+ */
+const unsigned char *ExifParser::exif_parser_get_thumbnail (unsigned int *ds) const
+{
+	if (ds)
+		*ds = priv.thumbnail_size;
+	if (!priv.thumbnail_size)
+		return NULL;
+	return priv.header + sizeof (ExifParserHeader) + priv.thumbnail_offset;
+}
@@ -0,0 +1,467 @@
+/*! \file exif-parser.h
+ * \brief Walking EXIF data with callbacks, without building #ExifData
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __EXIF_PARSER_H__
+#define __EXIF_PARSER_H__
+
+#include "exif-byte-order.h"
+#include "exif-entry.h"
+#include "exif-format.h"
+#include "exif-ifd.h"
+#include "exif-log.h"
+#include "exif-mnote-data.h"
+#include "exif-tag.h"
+#include "exif-utils.h"
+
+#include <string.h>
+
+/*! One entry of an IFD as it is stored. The value is not copied; it
+ * points into the parsed buffer. */
+typedef struct {
+	ExifTag tag;
+	ExifFormat format;
+	unsigned long components;
+
+	/*! Value, in the byte order of the data */
+	const unsigned char *data;
+	unsigned int size;
+
+	/*! Offset of the value from the TIFF header */
+	unsigned int offset;
+} ExifParserEntry;
+
+/*! The "Exif\0\0" header that precedes the TIFF header in an APP1
+ * segment */
+extern const unsigned char ExifParserHeader[6];
+
+/*! Order in which #exif_data_get_entry searches the IFDs */
+extern const ExifIfd ExifParserFindOrder[5];
+
+/*! Return the entry with the given tag from any IFD of t, searching them
+ * in the same order as #exif_data_get_entry.
+ *
+ * \param[in] t entries to search
+ * \param[in] get member of T returning the entry of an IFD with a tag
+ * \param[in] tag tag to look up
+ * \param[out] ifd IFD of the entry, or NULL
+ * \return the entry, or NULL if there is none
+ */
+template <class T> const ExifParserEntry *
+exif_parser_find_entry (const T *t,
+			const ExifParserEntry *(T::*get) (ExifIfd, ExifTag) const,
+			ExifTag tag, ExifIfd *ifd)
+{
+	const ExifParserEntry *e;
+	unsigned int i;
+
+	for (i = 0; i < sizeof (ExifParserFindOrder) / sizeof (ExifParserFindOrder[0]); i++)
+		if ((e = (t->*get) (ExifParserFindOrder[i], tag)) != NULL) {
+			if (ifd)
+				*ifd = ExifParserFindOrder[i];
+			return e;
+		}
+	return NULL;
+}
+
+/*! Return a view of all components of an entry, which must be in
+ * format F.
+ *
+ * \param[in] e entry pointing into the parsed data
+ * \param[in] o byte order of the parsed data
+ * \param[out] span view of the components
+ * \return #EXIF_ENTRY_VALUE_OK on success
+ */
+template <ExifFormat F> ExifEntryValueResult
+exif_parser_entry_get_span (const ExifParserEntry *e, ExifByteOrder o,
+			    ExifEntrySpan<F> *span)
+{
+	if (!e || (e->format != F))
+		return EXIF_ENTRY_VALUE_WRONG_FORMAT;
+	if (!e->data || (e->size / ExifFormatTraits<F>::size < e->components))
+		return EXIF_ENTRY_VALUE_NO_DATA;
+	*span = ExifEntrySpan<F> (e->data, e->components, o);
+	return EXIF_ENTRY_VALUE_OK;
+}
+
+/*! Read the directory entry at offset o of the TIFF data in r. The 12
+ * bytes at o have to lie within the data.
+ *
+ * \param[in] r TIFF data, stored in byte order O
+ * \param[in] o offset of the entry
+ * \param[out] e the entry, pointing into the data
+ * \param[in] log log for corrupt entries
+ * \return 1 if the value of the entry lies within the data, 0 otherwise
+ */
+template <ExifByteOrder O> int
+exif_parser_read_entry (const ExifBufferReader<O> &r, unsigned int o,
+			ExifParserEntry *e, ExifLog *log)
+{
+	unsigned int s;
+
+	e->tag = static_cast<ExifTag> (r.get_short (o));
+	e->format = static_cast<ExifFormat> (r.get_short (o + 2));
+	e->components = r.get_long (o + 4);
+
+	/* {0,1,2,4,8} x { 0x00000000 .. 0xffffffff }
+	 *   -> { 0x000000000 .. 0x7fffffff8 } */
+	s = exif_format_get_size (e->format) * e->components;
+	if ((s < e->components) || (s == 0))
+		return 0;
+
+	/* Values of more than 4 bytes are stored elsewhere */
+	e->offset = (s > 4) ? r.get_long (o + 8) : o + 8;
+	if (!r.contains (e->offset, s)) {
+		log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+			"Tag data past end of buffer (%u > %u)", e->offset + s,
+			(unsigned int) r.size);
+		return 0;
+	}
+	e->data = r.ptr (e->offset);
+	e->size = s;
+	return 1;
+}
+
+/*! Walk the IFD at offset in the TIFF data r, and the IFDs it points to.
+ * This is the walk of both #exif_data_load_data and #ExifParser, which
+ * pass what is found to a visitor v of class V with these members, each
+ * returning 1 to continue or 0 to stop the walk:
+ *
+ * - int enter (ExifIfd ifd): an IFD other than IFD 0 is about to be read
+ * - int begin (ExifIfd ifd, unsigned int n): the IFD has n entries that
+ *   lie within the data
+ * - int entry (ExifIfd ifd, const ExifParserEntry *e): an entry whose
+ *   value lies within the data, except for the pointers to other IFDs
+ *   and to the thumbnail, and for empty entries with an unknown tag
+ * - void thumbnail (ExifLong offset, ExifLong size): the offset and size
+ *   of the thumbnail, as far as they are known, if neither is 0
+ * - int end (ExifIfd ifd): the end of the IFD
+ *
+ * An IFD that has entries in count already is not walked again, and no
+ * IFD is walked from within itself.
+ *
+ * \param[in] v visitor
+ * \param[in] ifd0 IFD at offset
+ * \param[in] r TIFF data, stored in byte order O
+ * \param[in] offset offset of the IFD
+ * \param[in] recursion_depth number of IFDs pointing to this one
+ * \param[in,out] count number of entries passed to v per IFD
+ * \param[in] log log for the walk
+ * \return 0 if v has stopped the walk, 1 otherwise
+ */
+template <ExifByteOrder O, class V> int
+exif_parser_walk_ifd (V *v, ExifIfd ifd0, const ExifBufferReader<O> &r,
+		      unsigned int offset, unsigned int recursion_depth,
+		      unsigned int *count, ExifLog *log)
+{
+	ExifLong o, thumbnail_offset = 0, thumbnail_length = 0;
+	ExifParserEntry e;
+	ExifShort n;
+	unsigned int i;
+	ExifIfd sub;
+	ExifTag tag;
+
+	if ((((int) ifd0) < 0) || (((int) ifd0) >= EXIF_IFD_COUNT))
+		return 1;
+	if (recursion_depth > 30) {
+		log->exif_log (EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+			"Deep recursion detected!");
+		return 1;
+	}
+	if ((ifd0 != EXIF_IFD_0) && !v->enter (ifd0))
+		return 0;
+
+	/* Read the number of entries */
+	if (!r.contains (offset, 2)) {
+		log->exif_log (EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+			"Tag data past end of buffer (%u > %u)", offset + 2,
+			(unsigned int) r.size);
+		return 1;
+	}
+	n = r.get_short (offset);
+	log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+		"Loading %hu entries...", n);
+	offset += 2;
+
+	/* From here on all n entries are known to lie within the data */
+	if (!r.contains (offset, 12 * n)) {
+		n = (ExifShort) r.count (offset, 12);
+		log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+			"Short data; only loading %hu entries...", n);
+	}
+	if (!v->begin (ifd0, n))
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		tag = static_cast<ExifTag> (r.get_short (offset + 12 * i));
+		switch (tag) {
+		case EXIF_TAG_EXIF_IFD_POINTER:
+		case EXIF_TAG_GPS_INFO_IFD_POINTER:
+		case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
+		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH:
+		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT:
+			o = r.get_long (offset + 12 * i + 8);
+			log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+				"Sub-IFD entry 0x%x ('%s') at %u.", tag,
+				exif_tag_get_name (tag), o);
+			if (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT)
+				thumbnail_offset = o;
+			else if (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH)
+				thumbnail_length = o;
+			if ((tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT) ||
+			    (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH)) {
+				if (thumbnail_offset && thumbnail_length)
+					v->thumbnail (thumbnail_offset, thumbnail_length);
+				break;
+			}
+
+			if (tag == EXIF_TAG_EXIF_IFD_POINTER)
+				sub = EXIF_IFD_EXIF;
+			else if (tag == EXIF_TAG_GPS_INFO_IFD_POINTER)
+				sub = EXIF_IFD_GPS;
+			else
+				sub = EXIF_IFD_INTEROPERABILITY;
+			if (sub == ifd0)
+				log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+					"Recursive entry in IFD '%s' detected. "
+					"Skipping...", exif_ifd_get_name (sub));
+			else if (count[sub])
+				log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+					"Attempt to load IFD '%s' multiple times "
+					"detected. Skipping...", exif_ifd_get_name (sub));
+			else if (!exif_parser_walk_ifd (v, sub, r, o, recursion_depth + 1,
+							count, log))
+				return 0;
+			break;
+		default:
+
+			/*
+			 * If we don't know the tag, don't fail. It could be that new
+			 * versions of the standard have defined additional tags. Note that
+			 * 0 is a valid tag in the GPS IFD.
+			 */
+			if (!exif_tag_get_name_in_ifd (tag, ifd0)) {
+
+				/*
+				 * Special case: Tag and format 0. That's against specification
+				 * (at least up to 2.2). But Photoshop writes it anyways.
+				 */
+				if (!memcmp (r.ptr (offset + 12 * i), "\0\0\0\0", 4)) {
+					log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+						"Skipping empty entry at position %u in '%s'.", i,
+						exif_ifd_get_name (ifd0));
+					break;
+				}
+				log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifData",
+					"Unknown tag 0x%04x (entry %u in '%s'). Please report this tag "
+					"to <libexif-devel@lists.sourceforge.net>.", tag, i,
+					exif_ifd_get_name (ifd0));
+			}
+			if (!exif_parser_read_entry (r, offset + 12 * i, &e, log))
+				break;
+			count[ifd0]++;
+			if (!v->entry (ifd0, &e))
+				return 0;
+			break;
+		}
+	}
+	return v->end (ifd0);
+}
+
+/*! Walk IFD 0 at offset in the TIFF data r, and the IFD 1 it links to,
+ * with #exif_parser_walk_ifd.
+ *
+ * \param[in] v visitor
+ * \param[in] r TIFF data, stored in byte order O
+ * \param[in] offset offset of IFD 0
+ * \param[in,out] count number of entries passed to v per IFD
+ * \param[in] log log for the walk
+ * \return 0 if v has stopped the walk, 1 otherwise
+ */
+template <ExifByteOrder O, class V> int
+exif_parser_walk_ifds (V *v, const ExifBufferReader<O> &r, unsigned int offset,
+		       unsigned int *count, ExifLog *log)
+{
+	ExifShort n;
+
+	if (!exif_parser_walk_ifd (v, EXIF_IFD_0, r, offset, 0, count, log))
+		return 0;
+
+	/* IFD 1 offset */
+	if (!r.contains (offset, 2))
+		return 1;
+	n = r.get_short (offset);
+	if (!r.contains (offset, 2 + 12 * n + 4))
+		return 1;
+	offset = r.get_long (offset + 2 + 12 * n);
+	if (!offset)
+		return 1;
+	log->exif_log (EXIF_LOG_CODE_DEBUG, "ExifData", "IFD 1 at %i.", (int) offset);
+	if (!r.contains (offset, 0)) {
+		log->exif_log (EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+			"Bogus offset of IFD1.");
+		return 1;
+	}
+	return exif_parser_walk_ifd (v, EXIF_IFD_1, r, offset, 0, count, log);
+}
+
+/*! Identify the vendor module that interprets a MakerNote, as
+ * #exif_data_load_data does.
+ *
+ * \param[in] m the MakerNote
+ * \param[in] make the Make, or NULL if there is none
+ * \param[out] variant variant within the module, or NULL
+ * \return the vendor, or #EXIF_MNOTE_VENDOR_UNKNOWN
+ */
+ExifMnoteVendor exif_parser_identify_makernote (const ExifParserEntry *m,
+						const ExifParserEntry *make,
+						int *variant);
+
+/*! Check whether a MakerNote is one the module of a vendor interprets,
+ * regardless of the other modules.
+ *
+ * \param[in] vendor vendor of the module
+ * \param[in] m the MakerNote
+ * \param[in] make the Make, or NULL if there is none
+ * \return 0 if not recognized; otherwise the variant within the module
+ */
+int exif_parser_makernote_variant (ExifMnoteVendor vendor,
+				   const ExifParserEntry *m,
+				   const ExifParserEntry *make);
+
+/*! Functions called by #ExifParser while it walks the data. Any of them
+ * may be NULL. Each returns 1 to continue, or 0 to stop the walk; no
+ * function is called after that.
+ *
+ * An IFD pointed to by another IFD is reported between the entries of
+ * that IFD, where its pointer is. The entries of the MakerNote are
+ * reported last, once the Make is known.
+ */
+typedef struct {
+	/*! Start of an IFD with count entries, as given by its directory */
+	int (* on_ifd_begin) (ExifIfd ifd, unsigned int count, void *user_data);
+
+	/*! An entry of the IFD being walked */
+	int (* on_entry) (ExifIfd ifd, const ExifParserEntry *e, void *user_data);
+
+	/*! End of the IFD */
+	int (* on_ifd_end) (ExifIfd ifd, void *user_data);
+
+	/*! An entry of a MakerNote of one of the supported vendors */
+	int (* on_makernote_entry) (const ExifMnoteRawEntry *e, void *user_data);
+} ExifParserCallbacks;
+
+/*! Outcome of #exif_parser_parse */
+typedef enum {
+	/*! All of the data has been walked */
+	EXIF_PARSER_RESULT_OK = 0,
+	/*! No valid EXIF data has been found */
+	EXIF_PARSER_RESULT_NO_DATA,
+	/*! A callback has stopped the walk */
+	EXIF_PARSER_RESULT_STOPPED
+} ExifParserResult;
+
+class ExifParserPrivate
+{
+public:
+	ExifParserPrivate()
+	{
+		Init();
+	}
+
+	void inline Init()
+	{
+		header=NULL;
+		header_size=0;
+		offset_tiff=0;
+		tiff_size=0;
+		thumbnail_offset=0;
+		thumbnail_size=0;
+		for (unsigned int i = 0; i < EXIF_IFD_COUNT; i++) {
+			count[i]=0;
+			make[i].size=0;
+			mnote[i].size=0;
+		}
+	}
+public:
+	/* The "Exif\0\0" header in the parsed buffer, the number of bytes
+	 * from there on, and the offset of the TIFF header in the buffer */
+	const unsigned char *header;
+	unsigned int header_size;
+	unsigned int offset_tiff;
+
+	/* Number of bytes of the TIFF data that the directories may
+	 * refer to, following the 64 KiB limit of the loader */
+	unsigned int tiff_size;
+
+	/* The thumbnail, relative to the TIFF header; 0 if there is none */
+	unsigned int thumbnail_offset;
+	unsigned int thumbnail_size;
+
+	/* Number of entries reported per IFD, and the first Make and
+	 * MakerNote of each IFD, with a size of 0 if there is none */
+	unsigned int count[EXIF_IFD_COUNT];
+	ExifParserEntry make[EXIF_IFD_COUNT];
+	ExifParserEntry mnote[EXIF_IFD_COUNT];
+};
+
+/*! Push parser for EXIF data. It walks the directories with
+ * #exif_parser_walk_ifds, as #exif_data_load_data does, identifies the
+ * MakerNote the same way, and passes each entry to the callbacks, with
+ * the value pointing into the parsed buffer. Nothing is allocated per
+ * entry. The same entries are reported as are loaded into #ExifData,
+ * including the unknown ones; a tag may be reported twice if it is
+ * stored twice in an IFD.
+ */
+class ExifParser
+{
+public:
+	ExifParser()
+	{
+		Init();
+	}
+
+	void inline Init()
+	{
+		callbacks.on_ifd_begin=NULL;
+		callbacks.on_entry=NULL;
+		callbacks.on_ifd_end=NULL;
+		callbacks.on_makernote_entry=NULL;
+		user_data=NULL;
+		order=EXIF_BYTE_ORDER_MOTOROLA;
+		priv.Init();
+	}
+public:
+	ExifParserResult exif_parser_parse (const unsigned char *d, unsigned int ds);
+	const unsigned char *exif_parser_get_thumbnail (unsigned int *ds) const;
+public:
+	/*! Functions to call and the data to pass to them */
+	ExifParserCallbacks callbacks;
+	void *user_data;
+
+	/*! Byte order of the data last parsed */
+	ExifByteOrder order;
+
+	/*! Log of the MakerNote walkers */
+	ExifLog log;
+
+	ExifParserPrivate priv;
+};
+
+#endif /* __EXIF_PARSER_H__ */
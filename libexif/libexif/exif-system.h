@@ -29,4 +29,14 @@
 # define UNUSED(param) param
 #endif
 
+/* Storage of a static variable that is separate for each thread. It is
+ * left undefined where there is none, with EXIF_NO_THREAD_LOCAL set. */
+#if defined(__GNUC__)
+# define EXIF_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+# define EXIF_THREAD_LOCAL __declspec(thread)
+#else
+# define EXIF_NO_THREAD_LOCAL
+#endif
+
 #endif /* !defined(EXIF_SYSTEM_H) */
@@ -1178,3 +1178,100 @@ exif_tag_get_support_level_in_ifd (ExifTag tag, ExifIfd ifd, ExifDataType t)
 
 	return get_support_level_in_ifd (tag, ifd, t);
 }
+
+/*
+ * The tags that are mandatory, and the tags that may be recorded at all,
+ * in each IFD for each data type (the last one being
+ * EXIF_DATA_TYPE_UNKNOWN), in ascending order. They are derived from
+ * ExifTagTable once, so that fixing an IFD does not need to look up every
+ * tag of the table.
+ */
+#define TAG_TABLE_SIZE (sizeof (ExifTagTable) / sizeof (ExifTagTable[0]))
+
+static ExifTag mandatory_tags[EXIF_IFD_COUNT][EXIF_DATA_TYPE_COUNT + 1][TAG_TABLE_SIZE];
+static unsigned int mandatory_count[EXIF_IFD_COUNT][EXIF_DATA_TYPE_COUNT + 1];
+static ExifTag recorded_tags[EXIF_IFD_COUNT][EXIF_DATA_TYPE_COUNT + 1][TAG_TABLE_SIZE];
+static unsigned int recorded_count[EXIF_IFD_COUNT][EXIF_DATA_TYPE_COUNT + 1];
+
+static void exif_tag_lists_init (void)
+{
+	static int initialized = 0;
+	unsigned int i, ifd, t, n;
+	ExifSupportLevel supp;
+
+	if (initialized)
+		return;
+	initialized = 1;
+
+	for (ifd = 0; ifd < EXIF_IFD_COUNT; ifd++)
+		for (t = 0; t <= EXIF_DATA_TYPE_COUNT; t++)
+			for (i = 0; ExifTagTable[i].name; i++) {
+				/* Duplicate tags are next to each other */
+				if (i && (ExifTagTable[i].tag == ExifTagTable[i - 1].tag))
+					continue;
+				supp = exif_tag_get_support_level_in_ifd (ExifTagTable[i].tag,
+					(ExifIfd) ifd, (ExifDataType) t);
+				if (supp == EXIF_SUPPORT_LEVEL_MANDATORY) {
+					n = mandatory_count[ifd][t]++;
+					mandatory_tags[ifd][t][n] = ExifTagTable[i].tag;
+				}
+				if (supp != EXIF_SUPPORT_LEVEL_NOT_RECORDED) {
+					n = recorded_count[ifd][t]++;
+					recorded_tags[ifd][t][n] = ExifTagTable[i].tag;
+				}
+			}
+}
+
+/* Build the lists while the library is loaded, before any thread of the
+ * application can fix an IFD. */
+static class ExifTagListsInit
+{
+public:
+	ExifTagListsInit ()
+	{
+		exif_tag_lists_init ();
+	}
+} exif_tag_lists_init_instance;
+
+const ExifTag *
+exif_tag_get_mandatory_in_ifd (ExifIfd ifd, ExifDataType t, unsigned int *count)
+{
+	exif_tag_lists_init ();
+	if (ifd >= EXIF_IFD_COUNT) {
+		if (count)
+			*count = 0;
+		return NULL;
+	}
+	if (t > EXIF_DATA_TYPE_COUNT)
+		t = EXIF_DATA_TYPE_UNKNOWN;
+	if (count)
+		*count = mandatory_count[ifd][t];
+	return mandatory_tags[ifd][t];
+}
+
+int
+exif_tag_is_recorded_in_ifd (ExifTag tag, ExifIfd ifd, ExifDataType t)
+{
+	const ExifTag *tags;
+	unsigned int lo = 0, hi, mid;
+
+	if (ifd >= EXIF_IFD_COUNT)
+		return 1;
+	if (t >= EXIF_DATA_TYPE_COUNT)
+		/* The support level is never "not recorded" without a data type */
+		return 1;
+
+	exif_tag_lists_init ();
+	tags = recorded_tags[ifd][t];
+	hi = recorded_count[ifd][t];
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (tags[mid] == tag)
+			return 1;
+		if (tags[mid] < tag)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return 0;
+}
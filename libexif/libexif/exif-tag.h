@@ -249,6 +249,31 @@ const char      *exif_tag_get_description_in_ifd   (ExifTag tag, ExifIfd ifd);
 ExifSupportLevel exif_tag_get_support_level_in_ifd (ExifTag tag, ExifIfd ifd,
                                                     ExifDataType t);
 
+/*! Return the tags that are mandatory in the given IFD and data type
+ * according to the EXIF specification, in ascending order. This gives the
+ * same result as calling #exif_tag_get_support_level_in_ifd on each tag of
+ * the table, without the cost.
+ *
+ * \param[in] ifd IFD
+ * \param[in] t data type or EXIF_DATA_TYPE_UNKNOWN
+ * \param[out] count number of tags returned
+ * \return array of tags, or NULL if the IFD is not valid
+ */
+const ExifTag   *exif_tag_get_mandatory_in_ifd     (ExifIfd ifd, ExifDataType t,
+                                                    unsigned int *count);
+
+/*! Return whether the given tag may be recorded in the given IFD and data
+ * type, i.e. whether #exif_tag_get_support_level_in_ifd would return
+ * anything but EXIF_SUPPORT_LEVEL_NOT_RECORDED.
+ *
+ * \param[in] tag EXIF tag
+ * \param[in] ifd IFD or EXIF_IFD_COUNT
+ * \param[in] t data type or EXIF_DATA_TYPE_UNKNOWN
+ * \return 0 if the tag is not recorded, nonzero otherwise
+ */
+int              exif_tag_is_recorded_in_ifd       (ExifTag tag, ExifIfd ifd,
+                                                    ExifDataType t);
+
 /* Don't use these functions. They are here for compatibility only. */
 
 /*! \deprecated Use #exif_tag_get_name_in_ifd instead */
@@ -28,6 +28,8 @@
 #include "exif-format.h"
 #include "_stdint.h"
 
+#include <stddef.h>
+
 
 /* If these definitions don't work for you, please let us fix the 
  * macro generating _stdint.h */
@@ -164,6 +166,169 @@ void exif_set_rational  (unsigned char *b, ExifByteOrder order,
 void exif_set_srational (unsigned char *b, ExifByteOrder order,
 			 ExifSRational value);
 
+/*! Compile-time description of a numeric EXIF data format: the type of
+ * one component, its raw size in bytes, and how to read it from memory.
+ * Only the formats that libexif can decode are described.
+ */
+template <ExifFormat F> struct ExifFormatTraits;
+
+template <> struct ExifFormatTraits<EXIF_FORMAT_BYTE> {
+	typedef ExifByte type;
+	enum { size = 1 };
+	static inline type get (const unsigned char *b, ExifByteOrder)
+		{ return b[0]; }
+};
+
+template <> struct ExifFormatTraits<EXIF_FORMAT_SBYTE> {
+	typedef ExifSByte type;
+	enum { size = 1 };
+	static inline type get (const unsigned char *b, ExifByteOrder)
+		{ return (ExifSByte) b[0]; }
+};
+
+template <> struct ExifFormatTraits<EXIF_FORMAT_SHORT> {
+	typedef ExifShort type;
+	enum { size = 2 };
+	static inline type get (const unsigned char *b, ExifByteOrder order)
+		{ return exif_get_short (b, order); }
+};
+
+template <> struct ExifFormatTraits<EXIF_FORMAT_SSHORT> {
+	typedef ExifSShort type;
+	enum { size = 2 };
+	static inline type get (const unsigned char *b, ExifByteOrder order)
+		{ return exif_get_sshort (b, order); }
+};
+
+template <> struct ExifFormatTraits<EXIF_FORMAT_LONG> {
+	typedef ExifLong type;
+	enum { size = 4 };
+	static inline type get (const unsigned char *b, ExifByteOrder order)
+		{ return exif_get_long (b, order); }
+};
+
+template <> struct ExifFormatTraits<EXIF_FORMAT_SLONG> {
+	typedef ExifSLong type;
+	enum { size = 4 };
+	static inline type get (const unsigned char *b, ExifByteOrder order)
+		{ return exif_get_slong (b, order); }
+};
+
+template <> struct ExifFormatTraits<EXIF_FORMAT_RATIONAL> {
+	typedef ExifRational type;
+	enum { size = 8 };
+	static inline type get (const unsigned char *b, ExifByteOrder order)
+		{ return exif_get_rational (b, order); }
+};
+
+template <> struct ExifFormatTraits<EXIF_FORMAT_SRATIONAL> {
+	typedef ExifSRational type;
+	enum { size = 8 };
+	static inline type get (const unsigned char *b, ExifByteOrder order)
+		{ return exif_get_srational (b, order); }
+};
+
+/*! Compile-time byte order. The loaders check the byte order of a
+ * directory once and then read all its entries through these, so that
+ * each read is a plain load, or a load and a byte swap, rather than a
+ * call that tests the order again.
+ */
+template <ExifByteOrder O> struct ExifByteOrderTraits;
+
+template <> struct ExifByteOrderTraits<EXIF_BYTE_ORDER_MOTOROLA> {
+	static inline ExifShort get_short (const unsigned char *b)
+		{ return (ExifShort) ((b[0] << 8) | b[1]); }
+	static inline ExifLong get_long (const unsigned char *b)
+		{ return ((ExifLong) b[0] << 24) | ((ExifLong) b[1] << 16) |
+			 ((ExifLong) b[2] << 8) | (ExifLong) b[3]; }
+};
+
+template <> struct ExifByteOrderTraits<EXIF_BYTE_ORDER_INTEL> {
+	static inline ExifShort get_short (const unsigned char *b)
+		{ return (ExifShort) ((b[1] << 8) | b[0]); }
+	static inline ExifLong get_long (const unsigned char *b)
+		{ return ((ExifLong) b[3] << 24) | ((ExifLong) b[2] << 16) |
+			 ((ExifLong) b[1] << 8) | (ExifLong) b[0]; }
+};
+
+/*! Cursor over raw EXIF data stored in byte order O.
+ *
+ * The loaders check a whole range (a directory, or the data of one
+ * entry) once with #contains, and then read at fixed offsets inside it
+ * without checking each read again. Offsets are relative to the start
+ * of the reader.
+ */
+template <ExifByteOrder O> class ExifBufferReader
+{
+public:
+	ExifBufferReader (const unsigned char *d, size_t s)
+	{
+		data = d;
+		size = s;
+	}
+
+	/*! Check that the n bytes at offset o lie within the buffer. This
+	 * cannot overflow, whatever the values of o and n.
+	 *
+	 * \return 1 if they do, 0 otherwise
+	 */
+	int contains (size_t o, size_t n) const
+	{
+		return (o <= size) && (n <= size - o);
+	}
+
+	/*! Number of whole records of n bytes that fit from offset o on */
+	size_t count (size_t o, size_t n) const
+	{
+		return (o <= size) ? (size - o) / n : 0;
+	}
+
+	/*! Return a reader over the n bytes at offset o, which must have
+	 * been checked with #contains */
+	ExifBufferReader range (size_t o, size_t n) const
+	{
+		return ExifBufferReader (data + o, n);
+	}
+
+	/* Unchecked reads: the caller has checked the range with #contains */
+	const unsigned char *ptr (size_t o) const
+	{
+		return data + o;
+	}
+	ExifShort get_short (size_t o) const
+	{
+		return ExifByteOrderTraits<O>::get_short (data + o);
+	}
+	ExifLong get_long (size_t o) const
+	{
+		return ExifByteOrderTraits<O>::get_long (data + o);
+	}
+
+public:
+	const unsigned char *data;
+	size_t size;
+};
+
+/*! \internal Orders elements of type T by their member M for
+ * std::lower_bound. Checked builds of the standard library also call the
+ * predicate with the arguments swapped and with two elements, so it
+ * takes an element and a key in either order, or two elements. */
+template <class T, class K, K T::*M> struct ExifMemberLess
+{
+	bool operator() (const T &a, K k) const
+	{
+		return a.*M < k;
+	}
+	bool operator() (K k, const T &a) const
+	{
+		return k < a.*M;
+	}
+	bool operator() (const T &a, const T &b) const
+	{
+		return a.*M < b.*M;
+	}
+};
+
 /*! \internal */
 void exif_convert_utf16_to_utf8 (char *out, const unsigned short *in, int maxlen);
 
@@ -47,7 +47,7 @@ void ExifMnoteDataFuji::exif_mnote_data_fuji_clear ()
 
 	if (entries) 
 	{
-		count>1?delete [] entries:delete entries;
+		delete [] entries;
 		entries=NULL;
 		count = 0;
 	}
@@ -72,22 +72,23 @@ char *ExifMnoteDataFuji::get_value (unsigned int i, char *val, unsigned int maxl
 
 void ExifMnoteDataFuji::save (unsigned char **buf, unsigned int *buf_size)
 {
-	size_t i, o, s, doff;
-	unsigned char *t;
-	size_t ts;
+	size_t i, o, s, doff, dnext;
 
 	if (!buf || !buf_size) return;
 
 	/*
-	 * Allocate enough memory for all entries and the number
-	 * of entries.
+	 * Allocate enough memory for all entries, the number of entries
+	 * and all values at once. The values follow the directory.
 	 */
-	*buf_size = 8 + 4 + 2 + count * 12 + 4;
+	dnext = 8 + 4 + 2 + count * 12 + 4;
+	*buf_size = (unsigned int) (dnext +
+		exif_mnote_data_values_size (entries, count, 1));
 	mem->exif_mem_alloc (buf, (*buf_size)/sizeof(unsigned char));
 	if (!*buf) {
 		*buf_size = 0;
 		return;
 	}
+	memset (*buf, 0, *buf_size);
 
 	/*
 	 * Header: "FUJIFILM" and 4 bytes offset to the first entry.
@@ -115,18 +116,9 @@ void ExifMnoteDataFuji::save (unsigned char **buf, unsigned int *buf_size)
 			continue;
 		}
 		if (s > 4) {
-			ts = *buf_size + s;
-
-			/* Ensure even offsets. Set padding bytes to 0. */
-			if (s & 1) ts += 1;
-			t =mem->exif_mem_realloc (buf,ts/sizeof(unsigned char));
-			if (!t) {
-				return;
-			}
-			*buf = t;
-			*buf_size = ts;
-			doff = *buf_size - s;
-			if (s & 1) { doff--; *(*buf + *buf_size - 1) = '\0'; }
+			/* Ensure even offsets. The padding bytes are 0. */
+			doff = dnext;
+			dnext += s + (s & 1);
 			exif_set_long (*buf + o, order, doff);
 		} else
 			doff = o;
@@ -136,101 +128,179 @@ void ExifMnoteDataFuji::save (unsigned char **buf, unsigned int *buf_size)
 		 * crash if data is NULL.
 		 */
 		if (!entries[i].data) memset (*buf + doff, 0, s);
-		else memcpy (*buf + doff, entries[i].data, s);
+		else {
+			memcpy (*buf + doff, entries[i].data, s);
+			exif_array_set_byte_order (entries[i].format, *buf + doff,
+				(unsigned int) entries[i].components, entries[i].order, order);
+		}
 	}
 }
 
-void ExifMnoteDataFuji::load (const unsigned char *buf, unsigned int buf_size)
+/*! Pass the \c c entries starting at \c start, which are stored in
+ * byte order O, to func.
+ */
+template <ExifByteOrder O>
+int ExifMnoteDataFuji::walk_entries (const unsigned char *buf, unsigned int buf_size,
+				size_t start, ExifShort c, ExifMnoteWalkFunc func, void *user_data)
+{
+	ExifBufferReader<O> r (buf, buf_size);
+	ExifMnoteRawEntry e;
+	size_t i, n, o, s;
+
+	/* Only parse the entries that lie within the buffer */
+	n = r.contains (start, 12 * (size_t) c) ? c : r.count (start, 12);
+
+	for (i = n, o = start; i; --i, o += 12) {
+		e.tag        = r.get_short (o);
+		e.format     = static_cast<ExifFormat>(r.get_short (o + 2));
+		e.components = r.get_long (o + 4);
+		e.order      = O;
+		e.data       = NULL;
+		e.size       = 0;
+
+		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteDataFuji",
+			  "Loading entry 0x%x ('%s')...", e.tag,
+			  mnote_fuji_tag_get_name (static_cast<MnoteFujiTag>(e.tag)));
+
+		/*
+		 * Size? If bigger than 4 bytes, the actual data is not
+		 * in the entry but somewhere else (offset).
+		 */
+		s = exif_format_get_size (e.format) * e.components;
+		if (s) {
+			size_t dataofs = o + 8;
+			if (s > 4)
+				/* The data in this case is merely a pointer */
+				dataofs = r.get_long (dataofs) + 6 + offset;
+			/* The data may not run up to the very end of the buffer */
+			if (!r.contains (dataofs, s) || (dataofs + s == buf_size)) {
+				log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
+						  "ExifMnoteDataFuji", "Tag data past end of "
+					  "buffer (%u >= %u)", dataofs + s, buf_size);
+				continue;
+			}
+			e.data = r.ptr (dataofs);
+			e.size = (unsigned int) s;
+		}
+		if (!func (&e, user_data))
+			return 0;
+	}
+	if (n < c)
+		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
+			  "ExifMnoteDataFuji", "Short MakerNote");
+	return 1;
+}
+
+/* Find the directory: its first entry and the number of entries. The
+ * byte order is set in o once the header has been found. */
+int ExifMnoteDataFuji::find_directory (const unsigned char *buf,
+				unsigned int buf_size, size_t *start, ExifShort *c,
+				ExifByteOrder *o)
 {
-	ExifLong c;
-	size_t i, tcount, o, datao;
+	size_t datao;
 
 	if (!buf || !buf_size) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteDataFuji", "Short MakerNote");
-		return;
+		return 0;
 	}
 	datao = 6 + offset;
 	if ((datao + 12 < datao) || (datao + 12 < 12) || (datao + 12 > buf_size)) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteDataFuji", "Short MakerNote");
-		return;
+		return 0;
 	}
 
-	order = EXIF_BYTE_ORDER_INTEL;
+	*o = EXIF_BYTE_ORDER_INTEL;
 	datao += exif_get_long (buf + datao + 8, EXIF_BYTE_ORDER_INTEL);
 	if ((datao + 2 < datao) || (datao + 2 < 2) ||
 	    (datao + 2 > buf_size)) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteDataFuji", "Short MakerNote");
-		return;
+		return 0;
 	}
 
 	/* Read the number of tags */
-	c = exif_get_short (buf + datao, EXIF_BYTE_ORDER_INTEL);
-	datao += 2;
+	*c = exif_get_short (buf + datao, EXIF_BYTE_ORDER_INTEL);
+	*start = datao + 2;
+	return 1;
+}
+
+/* Store a walked entry as the next loaded entry */
+static int
+fuji_load_entry (const ExifMnoteRawEntry *e, void *user_data)
+{
+	ExifMnoteDataFuji *n = (ExifMnoteDataFuji *) user_data;
+	MnoteFujiEntry *entry = &n->entries[n->count];
+
+	entry->mem        = n->mem;
+	entry->tag        = static_cast<MnoteFujiTag>(e->tag);
+	entry->format     = e->format;
+	entry->components = e->components;
+	entry->order      = e->order;
+	entry->size       = e->size;
+	if (e->size) {
+		n->mem->exif_mem_alloc (&entry->data, e->size/sizeof(unsigned char));
+		if (!entry->data) {
+			EXIF_LOG_NO_MEMORY_PTR(n->log, "ExifMnoteDataFuji", e->size);
+			return 1;
+		}
+		memcpy (entry->data, e->data, e->size);
+	}
+
+	/* Tag was successfully parsed */
+	n->count++;
+	return 1;
+}
+
+void ExifMnoteDataFuji::load (const unsigned char *buf, unsigned int buf_size)
+{
+	ExifShort c;
+	size_t datao;
+	ExifByteOrder o = order;
+	int found = find_directory (buf, buf_size, &datao, &c, &o);
+
+	order = o;
+	if (!found)
+		return;
 
 	/* Remove any old entries */
 	exif_mnote_data_fuji_clear ();
 
 	/* Reserve enough space for all the possible MakerNote tags */
-	mem->exif_mem_alloc (&entries, c);
+	entries = new MnoteFujiEntry[c];
 	if (!entries) {
 		EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataFuji", sizeof (MnoteFujiEntry) * c);
 		return;
 	}
 
 	/* Parse all c entries, storing ones that are successfully parsed */
-	tcount = 0;
-	for (i = c, o = datao; i; --i, o += 12) {
-		size_t s;
-		if ((o + 12 < o) || (o + 12 < 12) || (o + 12 > buf_size)) {
-			log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
-				  "ExifMnoteDataFuji", "Short MakerNote");
-			break;
-		}
-
-		entries[tcount].tag        = static_cast<MnoteFujiTag>(exif_get_short (buf + o, order));
-		entries[tcount].format     = static_cast<ExifFormat>(exif_get_short (buf + o + 2, order));
-		entries[tcount].components = exif_get_long (buf + o + 4, order);
-		entries[tcount].order      = order;
-
-		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteDataFuji",
-			  "Loading entry 0x%x ('%s')...", entries[tcount].tag,
-			  mnote_fuji_tag_get_name (entries[tcount].tag));
+	count = 0;
+	walk_entries<EXIF_BYTE_ORDER_INTEL> (buf, buf_size, datao, c,
+					     fuji_load_entry, this);
+}
 
-		/*
-		 * Size? If bigger than 4 bytes, the actual data is not
-		 * in the entry but somewhere else (offset).
-		 */
-		s = exif_format_get_size (entries[tcount].format) * entries[tcount].components;
-		entries[tcount].size = s;
-		if (s) {
-			size_t dataofs = o + 8;
-			if (s > 4)
-				/* The data in this case is merely a pointer */
-				dataofs = exif_get_long (buf + dataofs, order) + 6 + offset;
-			if ((dataofs + s < dataofs) || (dataofs + s < s) ||
-				(dataofs + s >= buf_size)) {
-				log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
-						  "ExifMnoteDataFuji", "Tag data past end of "
-					  "buffer (%u >= %u)", dataofs + s, buf_size);
-				continue;
-			}
+int ExifMnoteDataFuji::walk (const unsigned char *buf, unsigned int buf_size,
+			     ExifMnoteWalkFunc func, void *user_data)
+{
+	ExifShort c;
+	size_t datao;
+	ExifByteOrder o = order;
+
+	if (!find_directory (buf, buf_size, &datao, &c, &o))
+		return 1;
+	return walk_entries<EXIF_BYTE_ORDER_INTEL> (buf, buf_size, datao, c,
+						    func, user_data);
+}
 
-			mem->exif_mem_alloc (&entries[tcount].data, s/sizeof(unsigned char));
-			if (!entries[tcount].data) {
-				EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataFuji", s);
-				continue;
-			}
-			memcpy (entries[tcount].data, buf + dataofs, s);
-		}
+ExifMnoteVendor ExifMnoteDataFuji::get_vendor ()
+{
+	return EXIF_MNOTE_VENDOR_FUJI;
+}
 
-		/* Tag was successfully parsed */
-		++tcount;
-	}
-	/* Store the count of successfully parsed tags */
-	count = tcount;
+unsigned long ExifMnoteDataFuji::memory_usage ()
+{
+	return sizeof (*this) + exif_mnote_data_entries_memory (entries, count);
 }
 
 unsigned int ExifMnoteDataFuji::get_count ()
@@ -264,19 +334,16 @@ const char *ExifMnoteDataFuji::get_description (unsigned int i)
 
 void ExifMnoteDataFuji::set_byte_order (ExifByteOrder o)
 {
-	ExifByteOrder o_orig;
-	unsigned int i;
-
-	o_orig = order;
 	order = o;
-	for (i = 0; i < count; i++) {
-		entries[i].order = o;
-		exif_array_set_byte_order (entries[i].format, entries[i].data,
-				entries[i].components, o_orig, o);
-	}
 }
 
 void ExifMnoteDataFuji::set_offset (unsigned int o)
 {
 	offset = o;
+}
+
+/* Fuji offsets are relative to the MakerNote, so it can go anywhere */
+int ExifMnoteDataFuji::relocate (unsigned char *, unsigned int, unsigned int)
+{
+	return 1;
 }
\ No newline at end of file
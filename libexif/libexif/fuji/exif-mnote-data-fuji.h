@@ -30,6 +30,17 @@ class MnoteFujiEntry;
 class ExifMnoteDataFuji:public ExifMnoteData 
 {
 public:
+	ExifMnoteDataFuji()
+	{
+		Init();
+	}
+	void inline Init()
+	{
+		count=0;
+		entries=NULL;
+		offset=0;
+		order=EXIF_BYTE_ORDER_INTEL;
+	}
 	~ExifMnoteDataFuji()
 	{
 		exif_mnote_data_fuji_clear ();
@@ -37,8 +48,17 @@ public:
 	void exif_mnote_data_fuji_clear ();
 	void free ();
 	char *get_value (unsigned int i, char *val, unsigned int maxlen);
+	ExifMnoteVendor get_vendor ();
+	unsigned long memory_usage ();
 	void save (unsigned char **buf, unsigned int *buf_size);
 	void load (const unsigned char *buf, unsigned int buf_size);
+	int walk (const unsigned char *buf, unsigned int buf_size,
+		  ExifMnoteWalkFunc func, void *user_data);
+	int find_directory (const unsigned char *buf, unsigned int buf_size,
+		size_t *start, ExifShort *c, ExifByteOrder *o);
+	template <ExifByteOrder O> int walk_entries (const unsigned char *buf,
+		unsigned int buf_size, size_t start, ExifShort c,
+		ExifMnoteWalkFunc func, void *user_data);
 	unsigned int get_count ();
 	unsigned int get_id (unsigned int n);
 	const char *get_name (unsigned int i);
@@ -46,6 +66,7 @@ public:
 	const char *get_description (unsigned int i);
 	void set_byte_order (ExifByteOrder o);
 	void set_offset (unsigned int o);
+	int relocate (unsigned char *buf, unsigned int buf_size, unsigned int o);
 public:
 	MnoteFujiEntry *entries;
 	unsigned int count;
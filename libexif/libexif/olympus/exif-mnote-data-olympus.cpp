@@ -44,7 +44,7 @@ void ExifMnoteDataOlympus::exif_mnote_data_olympus_clear ()
 
 	if (entries) 
 	{
-		count>1?delete [] entries:delete entries;
+		delete [] entries;
 		entries=NULL;
 	}
 
@@ -79,28 +79,22 @@ char *ExifMnoteDataOlympus::get_value (unsigned int i, char *val, unsigned int m
  */
 void ExifMnoteDataOlympus::save (unsigned char **buf, unsigned int *buf_size)
 {
-	size_t i, o, s, doff, base = 0, o2 = 6 + 2;
+	size_t i, o, s, doff, dnext, dsize, base = 0, o2 = 6 + 2;
 	size_t datao = 0;
-	unsigned char *t;
-	size_t ts;
 
 	if (!buf || !buf_size) return;
 
 	/*
-	 * Allocate enough memory for all entries and the number of entries.
+	 * Allocate enough memory for all entries, the number of entries
+	 * and all values at once. The values follow the directory.
 	 */
 	*buf_size = 6 + 2 + 2 + count * 12;
+	dsize = exif_mnote_data_values_size (entries, count, 0);
 	switch (version) {
 	case olympusV1:
 	case sanyoV1:
 	case epsonV1:
-		if (*buf)
-		{
-			(*buf_size)>1?delete [] *buf:delete *buf;
-			*buf=NULL;
-		}
-		
-		mem->exif_mem_alloc (buf,(*buf_size)/sizeof(unsigned char));
+		mem->exif_mem_alloc (buf,(*buf_size + dsize)/sizeof(unsigned char));
 		if (!*buf) {
 			EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataOlympus", *buf_size);
 			return;
@@ -114,13 +108,8 @@ void ExifMnoteDataOlympus::save (unsigned char **buf, unsigned int *buf_size)
 		break;
 
 	case olympusV2:
-		if (*buf)
-		{
-			(*buf_size)>1?delete [] *buf:delete *buf;
-			*buf=NULL;
-		}
 		*buf_size += 8-6 + 4;
-		mem->exif_mem_alloc (buf,(*buf_size)/sizeof(unsigned char));
+		mem->exif_mem_alloc (buf,(*buf_size + dsize)/sizeof(unsigned char));
 		if (!*buf) {
 			EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataOlympus", *buf_size);
 			return;
@@ -147,14 +136,9 @@ void ExifMnoteDataOlympus::save (unsigned char **buf, unsigned int *buf_size)
 	case nikonV2: 
 	/* Write out V0 files in V2 format */
 	case nikonV0:
-		if (*buf)
-		{
-			(*buf_size)>1?delete [] *buf:delete *buf;
-			*buf=NULL;
-		}
 		*buf_size += 8 + 2;
 		*buf_size += 4; /* Next IFD pointer */
-		mem->exif_mem_alloc (buf,(*buf_size)/sizeof(unsigned char));
+		mem->exif_mem_alloc (buf,(*buf_size + dsize)/sizeof(unsigned char));
 		if (!*buf) {
 			EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataOlympus", *buf_size);
 			return;
@@ -182,6 +166,9 @@ void ExifMnoteDataOlympus::save (unsigned char **buf, unsigned int *buf_size)
 		return;
 	}
 
+	dnext = *buf_size;
+	*buf_size += dsize;
+
 	exif_set_short (*buf + o2, order, (ExifShort) count);
 	o2 += 2;
 
@@ -204,15 +191,8 @@ void ExifMnoteDataOlympus::save (unsigned char **buf, unsigned int *buf_size)
 			continue;
 		}
 		if (s > 4) {
-			doff = *buf_size;
-			ts = *buf_size + s;
-			t =mem->exif_mem_realloc (buf,ts/sizeof(unsigned char));
-			if (!t) {
-				EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataOlympus", ts);
-				return;
-			}
-			*buf = t;
-			*buf_size = ts;
+			doff = dnext;
+			dnext += s;
 			exif_set_long (*buf + o, order, datao + doff);
 		} else
 			doff = o;
@@ -220,6 +200,8 @@ void ExifMnoteDataOlympus::save (unsigned char **buf, unsigned int *buf_size)
 		/* Write the data. */
 		if (entries[i].data) {
 			memcpy (*buf + doff, entries[i].data, s);
+			exif_array_set_byte_order (entries[i].format, *buf + doff,
+				(unsigned int) entries[i].components, entries[i].order, order);
 		} else {
 			/* Most certainly damaged input file */
 			memset (*buf + doff, 0, s);
@@ -227,21 +209,137 @@ void ExifMnoteDataOlympus::save (unsigned char **buf, unsigned int *buf_size)
 	}
 }
 
-void ExifMnoteDataOlympus::load (const unsigned char *buf, unsigned int buf_size)
+/*! Pass the entries of the directory found by find_directory, which
+ * are stored in byte order O, to func.
+ */
+template <ExifByteOrder O>
+int ExifMnoteDataOlympus::walk_entries (const unsigned char *buf, unsigned int buf_size,
+				const MnoteOlympusDirectory *dir,
+				ExifMnoteWalkFunc func, void *user_data)
+{
+	ExifBufferReader<O> r (buf, buf_size);
+	ExifMnoteRawEntry e;
+	size_t i, n, o, s;
+
+	/* Only parse the entries that lie within the buffer */
+	n = r.contains (dir->start, 12 * (size_t) dir->count) ?
+		dir->count : r.count (dir->start, 12);
+
+	for (i = n, o = dir->start; i; --i, o += 12) {
+	    e.tag        = (unsigned int) (r.get_short (o) + dir->base);
+	    e.format     = static_cast<ExifFormat>(r.get_short (o + 2));
+	    e.components = r.get_long (o + 4);
+	    e.order      = O;
+	    e.data       = NULL;
+	    e.size       = 0;
+
+	    log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteOlympus",
+		      "Loading entry 0x%x ('%s')...", e.tag,
+		      mnote_olympus_tag_get_name (static_cast<MnoteOlympusTag>(e.tag)));
+/*	    log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteOlympus",
+			    "0x%x %d %ld*(%d)",
+		    e.tag,
+		    e.format,
+		    e.components,
+		    (int)exif_format_get_size(e.format)); */
+
+	    /*
+	     * Size? If bigger than 4 bytes, the actual data is not
+	     * in the entry but somewhere else (offset).
+	     */
+	    s = exif_format_get_size (e.format) * e.components;
+		if (s) {
+			size_t dataofs = o + 8;
+			if (s > 4) {
+				/* The data in this case is merely a pointer */
+				dataofs = r.get_long (dataofs) + dir->datao;
+#ifdef EXIF_OVERCOME_SANYO_OFFSET_BUG
+				/* Some Sanyo models (e.g. VPC-C5, C40) suffer from a bug when
+				 * writing the offset for the MNOTE_OLYMPUS_TAG_THUMBNAILIMAGE
+				 * tag in its MakerNote. The offset is actually the absolute
+				 * position in the file instead of the position within the IFD.
+				 */
+			    if (!r.contains (dataofs, s) && dir->version == sanyoV1) {
+					/* fix pointer */
+					dataofs -= dir->datao + 6;
+					log->exif_log(EXIF_LOG_CODE_DEBUG,
+						  "ExifMnoteOlympus",
+						  "Inconsistent thumbnail tag offset; attempting to recover");
+			    }
+#endif
+			}
+			if (!r.contains (dataofs, s)) {
+				log->exif_log(EXIF_LOG_CODE_DEBUG,
+					  "ExifMnoteOlympus",
+					  "Tag data past end of buffer (%u > %u)",
+					  dataofs + s, buf_size);
+				continue;
+			}
+			e.data = r.ptr (dataofs);
+			e.size = (unsigned int) s;
+		}
+		if (!func (&e, user_data))
+			return 0;
+	}
+	if (n < dir->count)
+		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
+			  "ExifMnoteOlympus", "Short MakerNote");
+	return 1;
+}
+
+/* Store a walked entry as the next loaded entry */
+static int
+olympus_load_entry (const ExifMnoteRawEntry *e, void *user_data)
+{
+	ExifMnoteDataOlympus *n = (ExifMnoteDataOlympus *) user_data;
+	MnoteOlympusEntry *entry = &n->entries[n->count];
+
+	entry->mem        = n->mem;
+	entry->tag        = static_cast<MnoteOlympusTag>(e->tag);
+	entry->format     = e->format;
+	entry->components = e->components;
+	entry->order      = e->order;
+	entry->size       = e->size;
+	if (e->size) {
+		entry->data_free();
+		n->mem->exif_mem_alloc (&entry->data, e->size/sizeof(unsigned char));
+		if (!entry->data) 
+		{
+			EXIF_LOG_NO_MEMORY_PTR(n->log, "ExifMnoteOlympus", e->size);
+			return 1;
+		}
+		memcpy (entry->data, e->data, e->size);
+	}
+
+	/* Tag was successfully parsed */
+	n->count++;
+	return 1;
+}
+
+/* Find the directory of the MakerNote and its variant. The byte order
+ * and variant are set in dir even if no directory is found, as they
+ * are known by then. */
+int ExifMnoteDataOlympus::find_directory (const unsigned char *buf,
+				unsigned int buf_size, MnoteOlympusDirectory *dir)
 {
 	ExifShort c;
-	size_t i, tcount, o, o2, datao = 6, base = 0;
+	size_t o2;
+
+	dir->order = order;
+	dir->version = version;
+	dir->datao = 6;
+	dir->base = 0;
 
 	if (!buf || !buf_size) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteDataOlympus", "Short MakerNote");
-		return;
+		return 0;
 	}
 	o2 = 6 + offset; /* Start of interesting data */
 	if ((o2 + 10 < o2) || (o2 + 10 < 10) || (o2 + 10 > buf_size)) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteDataOlympus", "Short MakerNote");
-		return;
+		return 0;
 	}
 
 	/*
@@ -265,8 +363,8 @@ void ExifMnoteDataOlympus::load (const unsigned char *buf, unsigned int buf_size
 	 * two unknown bytes (0), "MM" or "II", another byte 0 and 
 	 * lastly 0x2A.
 	 */
-	version = exif_mnote_data_olympus_identify_variant(buf+o2, buf_size-o2);
-	switch (version) {
+	dir->version = exif_mnote_data_olympus_identify_variant(buf+o2, buf_size-o2);
+	switch (dir->version) {
 	case olympusV1:
 	case sanyoV1:
 	case epsonV1:
@@ -275,33 +373,33 @@ void ExifMnoteDataOlympus::load (const unsigned char *buf, unsigned int buf_size
 
 		/* The number of entries is at position 8. */
 		if (buf[o2 + 6] == 1)
-			order = EXIF_BYTE_ORDER_INTEL;
+			dir->order = EXIF_BYTE_ORDER_INTEL;
 		else if (buf[o2 + 6 + 1] == 1)
-			order = EXIF_BYTE_ORDER_MOTOROLA;
+			dir->order = EXIF_BYTE_ORDER_MOTOROLA;
 		o2 += 8;
-		if (o2 + 2 > buf_size) return;
-		c = exif_get_short (buf + o2, order);
+		if (o2 + 2 > buf_size) return 0;
+		c = exif_get_short (buf + o2, dir->order);
 		if ((!(c & 0xFF)) && (c > 0x500)) {
-			if (order == EXIF_BYTE_ORDER_INTEL) {
-				order = EXIF_BYTE_ORDER_MOTOROLA;
+			if (dir->order == EXIF_BYTE_ORDER_INTEL) {
+				dir->order = EXIF_BYTE_ORDER_MOTOROLA;
 			} else {
-				order = EXIF_BYTE_ORDER_INTEL;
+				dir->order = EXIF_BYTE_ORDER_INTEL;
 			}
 		}
 		break;
 
 	case olympusV2:
 		/* Olympus S760, S770 */
-		datao = o2;
+		dir->datao = o2;
 		o2 += 8;
 		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteDataOlympus",
 			"Parsing Olympus maker note v2 (0x%02x, %02x, %02x, %02x)...",
 			buf[o2], buf[o2 + 1], buf[o2 + 2], buf[o2 + 3]);
 
 		if ((buf[o2] == 'I') && (buf[o2 + 1] == 'I'))
-			order = EXIF_BYTE_ORDER_INTEL;
+			dir->order = EXIF_BYTE_ORDER_INTEL;
 		else if ((buf[o2] == 'M') && (buf[o2 + 1] == 'M'))
-			order = EXIF_BYTE_ORDER_MOTOROLA;
+			dir->order = EXIF_BYTE_ORDER_MOTOROLA;
 
 		/* The number of entries is at position 8+4. */
 		o2 += 4;
@@ -309,7 +407,7 @@ void ExifMnoteDataOlympus::load (const unsigned char *buf, unsigned int buf_size
 
 	case nikonV1:
 		o2 += 6;
-		if (o2 >= buf_size) return;
+		if (o2 >= buf_size) return 0;
 		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteDataOlympus",
 			"Parsing Nikon maker note v1 (0x%02x, %02x, %02x, "
 			"%02x, %02x, %02x, %02x, %02x)...",
@@ -322,22 +420,22 @@ void ExifMnoteDataOlympus::load (const unsigned char *buf, unsigned int buf_size
 		/* Skip an unknown byte (00 or 0A). */
 		o2 += 1;
 
-		base = MNOTE_NIKON1_TAG_BASE;
+		dir->base = MNOTE_NIKON1_TAG_BASE;
 		/* Fix endianness, if needed */
-		if (o2 + 2 > buf_size) return;
-		c = exif_get_short (buf + o2, order);
+		if (o2 + 2 > buf_size) return 0;
+		c = exif_get_short (buf + o2, dir->order);
 		if ((!(c & 0xFF)) && (c > 0x500)) {
-			if (order == EXIF_BYTE_ORDER_INTEL) {
-				order = EXIF_BYTE_ORDER_MOTOROLA;
+			if (dir->order == EXIF_BYTE_ORDER_INTEL) {
+				dir->order = EXIF_BYTE_ORDER_MOTOROLA;
 			} else {
-				order = EXIF_BYTE_ORDER_INTEL;
+				dir->order = EXIF_BYTE_ORDER_INTEL;
 			}
 		}
 		break;
 
 	case nikonV2:
 		o2 += 6;
-		if (o2 >= buf_size) return;
+		if (o2 >= buf_size) return 0;
 		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteDataOlympus",
 			"Parsing Nikon maker note v2 (0x%02x, %02x, %02x, "
 			"%02x, %02x, %02x, %02x, %02x)...",
@@ -357,18 +455,18 @@ void ExifMnoteDataOlympus::load (const unsigned char *buf, unsigned int buf_size
 		 * Byte order. From here the data offset
 		 * gets calculated.
 		 */
-		datao = o2;
-		if (o2 >= buf_size) return;
+		dir->datao = o2;
+		if (o2 >= buf_size) return 0;
 		if (!strncmp ((char *)&buf[o2], "II", 2))
-			order = EXIF_BYTE_ORDER_INTEL;
+			dir->order = EXIF_BYTE_ORDER_INTEL;
 		else if (!strncmp ((char *)&buf[o2], "MM", 2))
-			order = EXIF_BYTE_ORDER_MOTOROLA;
+			dir->order = EXIF_BYTE_ORDER_MOTOROLA;
 		else {
 			log->exif_log(EXIF_LOG_CODE_DEBUG,
 				"ExifMnoteDataOlympus", "Unknown "
 				"byte order '%c%c'", buf[o2],
 				buf[o2 + 1]);
-			return;
+			return 0;
 		}
 		o2 += 2;
 
@@ -376,8 +474,8 @@ void ExifMnoteDataOlympus::load (const unsigned char *buf, unsigned int buf_size
 		o2 += 2;
 
 		/* Go to where the number of entries is. */
-		if (o2 + 4 > buf_size) return;
-		o2 = datao + exif_get_long (buf + o2, order);
+		if (o2 + 4 > buf_size) return 0;
+		o2 = dir->datao + exif_get_long (buf + o2, dir->order);
 		break;
 
 	case nikonV0:
@@ -387,111 +485,79 @@ void ExifMnoteDataOlympus::load (const unsigned char *buf, unsigned int buf_size
 			buf[o2 + 0], buf[o2 + 1], buf[o2 + 2], buf[o2 + 3], 
 			buf[o2 + 4], buf[o2 + 5], buf[o2 + 6], buf[o2 + 7]);
 		/* 00 1b is # of entries in Motorola order - the rest should also be in MM order */
-		order = EXIF_BYTE_ORDER_MOTOROLA;
+		dir->order = EXIF_BYTE_ORDER_MOTOROLA;
 		break;
 	
 	default:
 		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteDataOlympus",
-			"Unknown Olympus variant %i.", version);
-		return;
+			"Unknown Olympus variant %i.", dir->version);
+		return 0;
 	}
 
 	/* Sanity check the offset */
 	if ((o2 + 2 < o2) || (o2 + 2 < 2) || (o2 + 2 > buf_size)) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteOlympus", "Short MakerNote");
-		return;
+		return 0;
 	}
 
 	/* Read the number of tags */
-	c = exif_get_short (buf + o2, order);
-	o2 += 2;
+	dir->count = exif_get_short (buf + o2, dir->order);
+	dir->start = o2 + 2;
+	return 1;
+}
+
+void ExifMnoteDataOlympus::load (const unsigned char *buf, unsigned int buf_size)
+{
+	MnoteOlympusDirectory dir;
+	int found = find_directory (buf, buf_size, &dir);
+
+	order = dir.order;
+	version = dir.version;
+	if (!found)
+		return;
 
 	/* Remove any old entries */
 	exif_mnote_data_olympus_clear ();
 
-	mem->exif_mem_alloc (&entries,c);
+	entries = new MnoteOlympusEntry[dir.count];
 	if (!entries) {
-		EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteOlympus", sizeof (MnoteOlympusEntry) * c);
+		EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteOlympus", sizeof (MnoteOlympusEntry) * dir.count);
 		return;
 	}
 
 	/* Parse all c entries, storing ones that are successfully parsed */
-	tcount = 0;
-	for (i = c, o = o2; i; --i, o += 12) {
-		size_t s;
-		if ((o + 12 < o) || (o + 12 < 12) || (o + 12 > buf_size)) {
-			log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
-				  "ExifMnoteOlympus", "Short MakerNote");
-			break;
-		}
-
-	    entries[tcount].tag        = static_cast<MnoteOlympusTag>(exif_get_short (buf + o, order) + base);
-	    entries[tcount].format     = static_cast<ExifFormat>(exif_get_short (buf + o + 2, order));
-	    entries[tcount].components = exif_get_long (buf + o + 4, order);
-	    entries[tcount].order      = order;
-
-	    log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteOlympus",
-		      "Loading entry 0x%x ('%s')...", entries[tcount].tag,
-		      mnote_olympus_tag_get_name (entries[tcount].tag));
-/*	    log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteOlympus",
-			    "0x%x %d %ld*(%d)",
-		    entries[tcount].tag,
-		    entries[tcount].format,
-		    entries[tcount].components,
-		    (int)exif_format_get_size(entries[tcount].format)); */
+	count = 0;
+	if (order == EXIF_BYTE_ORDER_INTEL)
+		walk_entries<EXIF_BYTE_ORDER_INTEL> (buf, buf_size, &dir,
+						     olympus_load_entry, this);
+	else
+		walk_entries<EXIF_BYTE_ORDER_MOTOROLA> (buf, buf_size, &dir,
+							olympus_load_entry, this);
+}
 
-	    /*
-	     * Size? If bigger than 4 bytes, the actual data is not
-	     * in the entry but somewhere else (offset).
-	     */
-	    s = exif_format_get_size (entries[tcount].format) *
-		   			 entries[tcount].components;
-		entries[tcount].size = s;
-		if (s) {
-			size_t dataofs = o + 8;
-			if (s > 4) {
-				/* The data in this case is merely a pointer */
-				dataofs = exif_get_long (buf + dataofs, order) + datao;
-#ifdef EXIF_OVERCOME_SANYO_OFFSET_BUG
-				/* Some Sanyo models (e.g. VPC-C5, C40) suffer from a bug when
-				 * writing the offset for the MNOTE_OLYMPUS_TAG_THUMBNAILIMAGE
-				 * tag in its MakerNote. The offset is actually the absolute
-				 * position in the file instead of the position within the IFD.
-				 */
-			    if (dataofs + s > buf_size && version == sanyoV1) {
-					/* fix pointer */
-					dataofs -= datao + 6;
-					log->exif_log(EXIF_LOG_CODE_DEBUG,
-						  "ExifMnoteOlympus",
-						  "Inconsistent thumbnail tag offset; attempting to recover");
-			    }
-#endif
-			}
-			if ((dataofs + s < dataofs) || (dataofs + s < s) || 
-			    (dataofs + s > buf_size)) {
-				log->exif_log(EXIF_LOG_CODE_DEBUG,
-					  "ExifMnoteOlympus",
-					  "Tag data past end of buffer (%u > %u)",
-					  dataofs + s, buf_size);
-				continue;
-			}
+int ExifMnoteDataOlympus::walk (const unsigned char *buf, unsigned int buf_size,
+				ExifMnoteWalkFunc func, void *user_data)
+{
+	MnoteOlympusDirectory dir;
+
+	if (!find_directory (buf, buf_size, &dir))
+		return 1;
+	if (dir.order == EXIF_BYTE_ORDER_INTEL)
+		return walk_entries<EXIF_BYTE_ORDER_INTEL> (buf, buf_size, &dir,
+							    func, user_data);
+	return walk_entries<EXIF_BYTE_ORDER_MOTOROLA> (buf, buf_size, &dir,
+						       func, user_data);
+}
 
-			entries[tcount].data_free();
-			mem->exif_mem_alloc (&entries[tcount].data,s/sizeof(unsigned char));
-			if (!entries[tcount].data) 
-			{
-				EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteOlympus", s);
-				continue;
-			}
-			memcpy (entries[tcount].data, buf + dataofs, s);
-		}
+ExifMnoteVendor ExifMnoteDataOlympus::get_vendor ()
+{
+	return EXIF_MNOTE_VENDOR_OLYMPUS;
+}
 
-		/* Tag was successfully parsed */
-		++tcount;
-	}
-	/* Store the count of successfully parsed tags */
-	count = tcount;
+unsigned long ExifMnoteDataOlympus::memory_usage ()
+{
+	return sizeof (*this) + exif_mnote_data_entries_memory (entries, count);
 }
 
 unsigned int ExifMnoteDataOlympus::get_count ()
@@ -525,18 +591,7 @@ const char *ExifMnoteDataOlympus::get_description (unsigned int i)
 
 void ExifMnoteDataOlympus::set_byte_order (ExifByteOrder o)
 {
-	ExifByteOrder o_orig;
-	unsigned int i;
-
-	
-
-	o_orig = order;
 	order = o;
-	for (i = 0; i < count; i++) {
-		entries[i].order = o;
-		exif_array_set_byte_order (entries[i].format, entries[i].data,
-				entries[i].components, o_orig, o);
-	}
 }
 
 void ExifMnoteDataOlympus::set_offset (unsigned int o)
@@ -544,6 +599,26 @@ void ExifMnoteDataOlympus::set_offset (unsigned int o)
 	offset = o;
 }
 
+int ExifMnoteDataOlympus::relocate (unsigned char *buf, unsigned int buf_size,
+				    unsigned int o)
+{
+	switch (version) {
+	case olympusV1:
+	case sanyoV1:
+	case epsonV1:
+		/* 8-byte header, offsets relative to the EXIF data */
+		return exif_mnote_data_relocate_ifd (buf, buf_size, 6 + 2, order,
+						     offset, o);
+	case olympusV2:
+	case nikonV2:
+		/* Offsets relative to the MakerNote or to its own TIFF header */
+		return 1;
+	default:
+		/* Nikon v0 is saved as v2, and v1 needs more care */
+		return 0;
+	}
+}
+
 enum OlympusVersion exif_mnote_data_olympus_identify_variant (const unsigned char *buf,unsigned int buf_size)
 {
 	/* Olympus, Nikon, Sanyo, Epson */
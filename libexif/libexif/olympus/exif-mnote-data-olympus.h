@@ -39,6 +39,20 @@ enum OlympusVersion {
 };
 class ExifMnoteData;
 
+/* Where the directory of a MakerNote is and how to read it */
+typedef struct {
+	/* First entry and number of entries */
+	size_t start;
+	ExifShort count;
+
+	/* Offsets of values are relative to datao; base is added to tags */
+	size_t datao;
+	size_t base;
+
+	ExifByteOrder order;
+	enum OlympusVersion version;
+} MnoteOlympusDirectory;
+
 class ExifMnoteDataOlympus:public ExifMnoteData 
 {
 
@@ -62,8 +76,17 @@ public:
 	void exif_mnote_data_olympus_clear ();
 	void free ();
 	char *get_value (unsigned int i, char *val, unsigned int maxlen);
+	ExifMnoteVendor get_vendor ();
+	unsigned long memory_usage ();
 	void save (unsigned char **buf, unsigned int *buf_size);
 	void load (const unsigned char *buf, unsigned int buf_size);
+	int walk (const unsigned char *buf, unsigned int buf_size,
+		  ExifMnoteWalkFunc func, void *user_data);
+	int find_directory (const unsigned char *buf, unsigned int buf_size,
+		MnoteOlympusDirectory *dir);
+	template <ExifByteOrder O> int walk_entries (const unsigned char *buf,
+		unsigned int buf_size, const MnoteOlympusDirectory *dir,
+		ExifMnoteWalkFunc func, void *user_data);
 	unsigned int get_count ();
 	unsigned int get_id (unsigned int n);
 	const char * get_name (unsigned int i);
@@ -71,6 +94,7 @@ public:
 	const char *get_description (unsigned int i);
 	void set_byte_order (ExifByteOrder o);
 	void set_offset (unsigned int o);
+	int relocate (unsigned char *buf, unsigned int buf_size, unsigned int o);
 public:
 	MnoteOlympusEntry *entries;
 	unsigned int count;
@@ -34,7 +34,7 @@ void ExifMnoteDataPentax::exif_mnote_data_pentax_clear ()
 
 	if (entries) 
 	{
-			count>1?delete [] entries:delete entries;
+			delete [] entries;
 			entries=NULL;
 			count = 0;
 	}
@@ -65,18 +65,21 @@ void ExifMnoteDataPentax::save (unsigned char **buf, unsigned int *buf_size)
 	   o2 = 4 + 2;  	/* offset to first tag entry, past header */
         size_t datao = offset; /* this MakerNote style uses offsets
         			  based on main IFD, not makernote IFD */
+	size_t dnext, dsize;	/* offset of the next value, size of all values */
 
 	if (!buf || !buf_size) return;
 
 	/*
 	 * Allocate enough memory for header, the number of entries, entries,
-	 * and next IFD pointer
+	 * next IFD pointer and all values at once. The values follow the
+	 * directory.
 	 */
 	*buf_size = o2 + 2 + count * 12 + 4;
+	dsize = exif_mnote_data_values_size (entries, count, 0);
 	switch (version) {
 	case casioV2:
 		base = MNOTE_PENTAX2_TAG_BASE;
-		mem->exif_mem_alloc (buf,(*buf_size)/sizeof(unsigned char));
+		mem->exif_mem_alloc (buf,(*buf_size + dsize)/sizeof(unsigned char));
 		if (!*buf) {
 			EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataPentax", *buf_size);
 			return;
@@ -89,7 +92,7 @@ void ExifMnoteDataPentax::save (unsigned char **buf, unsigned int *buf_size)
 
 	case pentaxV3:
 		base = MNOTE_PENTAX2_TAG_BASE;
-		mem->exif_mem_alloc (buf,(*buf_size)/sizeof(unsigned char));
+		mem->exif_mem_alloc (buf,(*buf_size + dsize)/sizeof(unsigned char));
 		if (!*buf) {
 			EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataPentax", *buf_size);
 			return;
@@ -105,7 +108,7 @@ void ExifMnoteDataPentax::save (unsigned char **buf, unsigned int *buf_size)
 
 	case pentaxV2:
 		base = MNOTE_PENTAX2_TAG_BASE;
-		mem->exif_mem_alloc (buf, (*buf_size)/sizeof(unsigned char));
+		mem->exif_mem_alloc (buf, (*buf_size + dsize)/sizeof(unsigned char));
 		if (!*buf) {
 			EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataPentax", *buf_size);
 			return;
@@ -121,7 +124,7 @@ void ExifMnoteDataPentax::save (unsigned char **buf, unsigned int *buf_size)
 		 * such, just has a fixed number of entries equal to 0x001b */
 		*buf_size -= 6;
 		o2 -= 6;
-		mem->exif_mem_alloc (buf, (*buf_size)/sizeof(unsigned char));
+		mem->exif_mem_alloc (buf, (*buf_size + dsize)/sizeof(unsigned char));
 		if (!*buf) {
 			EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataPentax", *buf_size);
 			return;
@@ -133,6 +136,9 @@ void ExifMnoteDataPentax::save (unsigned char **buf, unsigned int *buf_size)
 		return;
 	}
 
+	dnext = *buf_size;
+	*buf_size += dsize;
+
 	/* Write the number of entries. */
 	exif_set_short (*buf + o2, order, (ExifShort) count);
 	o2 += 2;
@@ -141,7 +147,6 @@ void ExifMnoteDataPentax::save (unsigned char **buf, unsigned int *buf_size)
 	for (i = 0; i < count; i++) {
 		size_t doff;	/* offset to current data portion of tag */
 		size_t s;
-		unsigned char *t;
 		size_t o = o2 + i * 12;   /* current offset into output buffer */
 		exif_set_short (*buf + o + 0, order,
 				(ExifShort) (entries[i].tag - base));
@@ -159,15 +164,8 @@ void ExifMnoteDataPentax::save (unsigned char **buf, unsigned int *buf_size)
 			continue;
 		}
 		if (s > 4) {
-			size_t ts = *buf_size + s;
-			doff = *buf_size;
-			t = mem->exif_mem_realloc (buf,(unsigned int)ts);
-			if (!t) {
-				EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataPentax", ts);
-				return;
-			}
-			*buf = t;
-			*buf_size = ts;
+			doff = dnext;
+			dnext += s;
 			exif_set_long (*buf + o, order, datao + doff);
 		} else
 			doff = o;
@@ -175,6 +173,8 @@ void ExifMnoteDataPentax::save (unsigned char **buf, unsigned int *buf_size)
 		/* Write the data. */
 		if (entries[i].data) {
 			memcpy (*buf + doff, entries[i].data, s);
+			exif_array_set_byte_order (entries[i].format, *buf + doff,
+				(unsigned int) entries[i].components, entries[i].order, order);
 		} else {
 			/* Most certainly damaged input file */
 			memset (*buf + doff, 0, s);
@@ -191,118 +191,200 @@ void ExifMnoteDataPentax::save (unsigned char **buf, unsigned int *buf_size)
 	exif_set_long (*buf + o2 + count * 12, order, 0);
 }
 
-void ExifMnoteDataPentax::load (const unsigned char *buf, unsigned int buf_size)
+/*! Pass the entries of the directory found by find_directory, which
+ * are stored in byte order O, to func.
+ */
+template <ExifByteOrder O>
+int ExifMnoteDataPentax::walk_entries (const unsigned char *buf, unsigned int buf_size,
+				const MnotePentaxDirectory *dir,
+				ExifMnoteWalkFunc func, void *user_data)
 {
-	size_t i, tcount, o, datao, base = 0;
-	ExifShort c;
+	ExifBufferReader<O> r (buf, buf_size);
+	ExifMnoteRawEntry e;
+	size_t i, n, o, s;
+
+	/* Only parse the entries that lie within the buffer */
+	n = r.contains (dir->start, 12 * (size_t) dir->count) ?
+		dir->count : r.count (dir->start, 12);
+
+	for (i = n, o = dir->start; i; --i, o += 12) {
+		e.tag        = (unsigned int) (r.get_short (o + 0) + dir->base);
+		e.format     = static_cast<ExifFormat>(r.get_short (o + 2));
+		e.components = r.get_long (o + 4);
+		e.order      = O;
+		e.data       = NULL;
+		e.size       = 0;
+
+		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnotePentax",
+			  "Loading entry 0x%x ('%s')...", e.tag,
+			  mnote_pentax_tag_get_name (static_cast<MnotePentaxTag>(e.tag)));
+
+		/*
+		 * Size? If bigger than 4 bytes, the actual data is not
+		 * in the entry but somewhere else (offset).
+		 */
+		s = exif_format_get_size (e.format) * e.components;
+		if (s) {
+			size_t dataofs = o + 8;
+			if (s > 4)
+				/* The data in this case is merely a pointer */
+			   	dataofs = r.get_long (dataofs) + 6;
+			if (!r.contains (dataofs, s)) {
+				log->exif_log(EXIF_LOG_CODE_DEBUG,
+						  "ExifMnoteDataPentax", "Tag data past end "
+					  "of buffer (%u > %u)", dataofs + s, buf_size);
+				continue;
+			}
+			e.data = r.ptr (dataofs);
+			e.size = (unsigned int) s;
+		}
+		if (!func (&e, user_data))
+			return 0;
+	}
+	if (n < dir->count)
+		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
+			  "ExifMnoteDataPentax", "Short MakerNote");
+	return 1;
+}
+
+/* Find the directory of the MakerNote and its variant. The byte order
+ * and variant are set in dir even if no directory is found, as they
+ * are known by then. */
+int ExifMnoteDataPentax::find_directory (const unsigned char *buf,
+				unsigned int buf_size, MnotePentaxDirectory *dir)
+{
+	size_t datao;
+
+	dir->order = order;
+	dir->version = version;
+	dir->base = 0;
 
 	if (!buf || !buf_size) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteDataPentax", "Short MakerNote");
-		return;
+		return 0;
 	}
 	datao = 6 + offset;
 	if ((datao + 8 < datao) || (datao + 8 < 8) || (datao + 8 > buf_size)) {
 		log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifMnoteDataPentax", "Short MakerNote");
-		return;
+		return 0;
 	}
 
 	/* Detect variant of Pentax/Casio MakerNote found */
 	if (!memcmp(buf + datao, "AOC", 4)) {
 		if ((buf[datao + 4] == 'I') && (buf[datao + 5] == 'I')) {
-			version = pentaxV3;
-			order = EXIF_BYTE_ORDER_INTEL;
+			dir->version = pentaxV3;
+			dir->order = EXIF_BYTE_ORDER_INTEL;
 		} else if ((buf[datao + 4] == 'M') && (buf[datao + 5] == 'M')) {
-			version = pentaxV3;
-			order = EXIF_BYTE_ORDER_MOTOROLA;
+			dir->version = pentaxV3;
+			dir->order = EXIF_BYTE_ORDER_MOTOROLA;
 		} else {
 			/* Uses Casio v2 tags */
-			version = pentaxV2;
+			dir->version = pentaxV2;
 		}
 		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteDataPentax",
-			"Parsing Pentax maker note v%d...", (int)version);
+			"Parsing Pentax maker note v%d...", (int)dir->version);
 		datao += 4 + 2;
-		base = MNOTE_PENTAX2_TAG_BASE;
+		dir->base = MNOTE_PENTAX2_TAG_BASE;
 	} else if (!memcmp(buf + datao, "QVC", 4)) {
 		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteDataPentax",
 			"Parsing Casio maker note v2...");
-		version = casioV2;
-		base = MNOTE_CASIO2_TAG_BASE;
+		dir->version = casioV2;
+		dir->base = MNOTE_CASIO2_TAG_BASE;
 		datao += 4 + 2;
 	} else {
 		/* probably assert(!memcmp(buf + datao, "\x00\x1b", 2)) */
 		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnoteDataPentax",
 			"Parsing Pentax maker note v1...");
-		version = pentaxV1;
+		dir->version = pentaxV1;
 	}
 
 	/* Read the number of tags */
-	c = exif_get_short (buf + datao, order);
-	datao += 2;
+	dir->count = exif_get_short (buf + datao, dir->order);
+	dir->start = datao + 2;
+	return 1;
+}
+
+/* Store a walked entry as the next loaded entry */
+static int
+pentax_load_entry (const ExifMnoteRawEntry *e, void *user_data)
+{
+	ExifMnoteDataPentax *n = (ExifMnoteDataPentax *) user_data;
+	MnotePentaxEntry *entry = &n->entries[n->count];
+
+	entry->mem        = n->mem;
+	entry->tag        = static_cast<MnotePentaxTag>(e->tag);
+	entry->format     = e->format;
+	entry->components = e->components;
+	entry->order      = e->order;
+	entry->size       = e->size;
+	if (e->size) {
+		n->mem->exif_mem_alloc (&entry->data, e->size/sizeof(unsigned char));
+		if (!entry->data) {
+			EXIF_LOG_NO_MEMORY_PTR(n->log, "ExifMnoteDataPentax", e->size);
+			return 1;
+		}
+		memcpy (entry->data, e->data, e->size);
+	}
+
+	/* Tag was successfully parsed */
+	n->count++;
+	return 1;
+}
+
+void ExifMnoteDataPentax::load (const unsigned char *buf, unsigned int buf_size)
+{
+	MnotePentaxDirectory dir;
+	int found = find_directory (buf, buf_size, &dir);
+
+	order = dir.order;
+	version = dir.version;
+	if (!found)
+		return;
 
 	/* Remove any old entries */
 	exif_mnote_data_pentax_clear ();
 
 	/* Reserve enough space for all the possible MakerNote tags */
-	mem->exif_mem_alloc (&entries, c);
+	entries = new MnotePentaxEntry[dir.count];
 	if (!entries) {
-		EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataPentax", sizeof (MnotePentaxEntry) * c);
+		EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataPentax", sizeof (MnotePentaxEntry) * dir.count);
 		return;
 	}
 
 	/* Parse all c entries, storing ones that are successfully parsed */
-	tcount = 0;
-	for (i = c, o = datao; i; --i, o += 12) {
-		size_t s;
-		if ((o + 12 < o) || (o + 12 < 12) || (o + 12 > buf_size)) {
-			log->exif_log(EXIF_LOG_CODE_CORRUPT_DATA,
-				  "ExifMnoteDataPentax", "Short MakerNote");
-			break;
-		}
-
-		entries[tcount].tag        =static_cast<MnotePentaxTag> (exif_get_short (buf + o + 0, order) + base);
-		entries[tcount].format     = static_cast<ExifFormat>(exif_get_short (buf + o + 2, order));
-		entries[tcount].components = exif_get_long  (buf + o + 4, order);
-		entries[tcount].order      = order;
-
-		log->exif_log(EXIF_LOG_CODE_DEBUG, "ExifMnotePentax",
-			  "Loading entry 0x%x ('%s')...", entries[tcount].tag,
-			  mnote_pentax_tag_get_name (entries[tcount].tag));
+	count = 0;
+	if (order == EXIF_BYTE_ORDER_INTEL)
+		walk_entries<EXIF_BYTE_ORDER_INTEL> (buf, buf_size, &dir,
+						     pentax_load_entry, this);
+	else
+		walk_entries<EXIF_BYTE_ORDER_MOTOROLA> (buf, buf_size, &dir,
+							pentax_load_entry, this);
+}
 
-		/*
-		 * Size? If bigger than 4 bytes, the actual data is not
-		 * in the entry but somewhere else (offset).
-		 */
-		s = exif_format_get_size (entries[tcount].format) *
-                                      entries[tcount].components;
-		entries[tcount].size = s;
-		if (s) {
-			size_t dataofs = o + 8;
-			if (s > 4)
-				/* The data in this case is merely a pointer */
-			   	dataofs = exif_get_long (buf + dataofs, order) + 6;
-			if ((dataofs + s < dataofs) || (dataofs + s < s) ||
-				(dataofs + s > buf_size)) {
-				log->exif_log(EXIF_LOG_CODE_DEBUG,
-						  "ExifMnoteDataPentax", "Tag data past end "
-					  "of buffer (%u > %u)", dataofs + s, buf_size);
-				continue;
-			}
+int ExifMnoteDataPentax::walk (const unsigned char *buf, unsigned int buf_size,
+			       ExifMnoteWalkFunc func, void *user_data)
+{
+	MnotePentaxDirectory dir;
+
+	if (!find_directory (buf, buf_size, &dir))
+		return 1;
+	if (dir.order == EXIF_BYTE_ORDER_INTEL)
+		return walk_entries<EXIF_BYTE_ORDER_INTEL> (buf, buf_size, &dir,
+							    func, user_data);
+	return walk_entries<EXIF_BYTE_ORDER_MOTOROLA> (buf, buf_size, &dir,
+						       func, user_data);
+}
 
-			mem->exif_mem_alloc (&entries[tcount].data, s/sizeof(unsigned char));
-			if (!entries[tcount].data) {
-				EXIF_LOG_NO_MEMORY_PTR(log, "ExifMnoteDataPentax", s);
-				continue;
-			}
-			memcpy (entries[tcount].data, buf + dataofs, s);
-		}
+ExifMnoteVendor ExifMnoteDataPentax::get_vendor ()
+{
+	return EXIF_MNOTE_VENDOR_PENTAX;
+}
 
-		/* Tag was successfully parsed */
-		++tcount;
-	}
-	/* Store the count of successfully parsed tags */
-	count = tcount;
+unsigned long ExifMnoteDataPentax::memory_usage ()
+{
+	return sizeof (*this) + exif_mnote_data_entries_memory (entries, count);
 }
 
 unsigned int ExifMnoteDataPentax::get_count ()
@@ -339,17 +421,16 @@ void ExifMnoteDataPentax::set_offset (unsigned int o)
 	offset = o;
 }
 
-void ExifMnoteDataPentax::set_byte_order (ExifByteOrder o)
+/* All variants use offsets relative to the EXIF data. The directory
+ * follows a 6-byte header, except in v1 which has none. */
+int ExifMnoteDataPentax::relocate (unsigned char *buf, unsigned int buf_size,
+				   unsigned int o)
 {
-	ExifByteOrder o_orig;
-	unsigned int i=0;
+	return exif_mnote_data_relocate_ifd (buf, buf_size,
+		(version == pentaxV1) ? 0 : 4 + 2, order, offset, o);
+}
 
-	o_orig = order;
+void ExifMnoteDataPentax::set_byte_order (ExifByteOrder o)
+{
 	order = o;
-	for (i = 0; i < count; i++) 
-	{
-		entries[i].order = o;
-		exif_array_set_byte_order (entries[i].format, entries[i].data,
-				entries[i].components, o_orig, o);
-	}
 }
@@ -31,6 +31,19 @@
 
 enum PentaxVersion {pentaxV1 = 1, pentaxV2 = 2, pentaxV3 = 3, casioV2 = 4 };
 
+/* Where the directory of a MakerNote is and how to read it */
+typedef struct {
+	/* First entry and number of entries */
+	size_t start;
+	ExifShort count;
+
+	/* Added to the tags */
+	size_t base;
+
+	ExifByteOrder order;
+	enum PentaxVersion version;
+} MnotePentaxDirectory;
+
 class ExifMnoteDataPentax:public ExifMnoteData 
 {
 public:
@@ -45,6 +58,7 @@ public:
 		offset=0;
 		order=EXIF_BYTE_ORDER_MOTOROLA;
 		offset=0;
+		version=pentaxV1;
 	}
 	~ExifMnoteDataPentax()
 	{
@@ -53,8 +67,17 @@ public:
 	void exif_mnote_data_pentax_clear ();
 	void free ();
 	char *get_value (unsigned int i, char *val, unsigned int maxlen);
+	ExifMnoteVendor get_vendor ();
+	unsigned long memory_usage ();
 	void save (unsigned char **buf, unsigned int *buf_size);
 	void load (const unsigned char *buf, unsigned int buf_size);
+	int walk (const unsigned char *buf, unsigned int buf_size,
+		  ExifMnoteWalkFunc func, void *user_data);
+	int find_directory (const unsigned char *buf, unsigned int buf_size,
+		MnotePentaxDirectory *dir);
+	template <ExifByteOrder O> int walk_entries (const unsigned char *buf,
+		unsigned int buf_size, const MnotePentaxDirectory *dir,
+		ExifMnoteWalkFunc func, void *user_data);
 	unsigned int get_count();
 	unsigned int get_id (unsigned int n);
 	const char *get_name (unsigned int n);
@@ -62,6 +85,7 @@ public:
 	const char *get_description (unsigned int n);
 	void set_offset (unsigned int o);
 	void set_byte_order (ExifByteOrder o);
+	int relocate (unsigned char *buf, unsigned int buf_size, unsigned int o);
 public:
 	MnotePentaxEntry *entries;
 	unsigned int count;
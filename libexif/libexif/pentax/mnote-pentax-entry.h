@@ -51,9 +51,6 @@ public:
 	ExifFormat format;
 	unsigned long components;
 
-	unsigned char *data;
-	unsigned int size;
-
 	ExifByteOrder order;
 };
 
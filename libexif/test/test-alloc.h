@@ -0,0 +1,84 @@
+/* test-alloc.h
+ *
+ * A counting operator new, for the tests that check that nothing is
+ * allocated. It replaces the global one, so it is included by one
+ * source file of a test only.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __TEST_ALLOC_H__
+#define __TEST_ALLOC_H__
+
+#include <stdlib.h>
+#include <new>
+
+/* Number of allocations made through operator new */
+static unsigned long test_allocations = 0;
+
+/* Dynamic exception specifications are deprecated in C++11 and gone in
+ * C++17 */
+#if __cplusplus < 201103L
+# define THROW_BAD_ALLOC throw (std::bad_alloc)
+# define THROW_NOTHING throw ()
+#else
+# define THROW_BAD_ALLOC
+# define THROW_NOTHING noexcept
+#endif
+
+void *
+operator new (size_t n) THROW_BAD_ALLOC
+{
+	void *p = malloc (n ? n : 1);
+
+	if (!p)
+		throw std::bad_alloc ();
+	test_allocations++;
+	return p;
+}
+
+void *
+operator new[] (size_t n) THROW_BAD_ALLOC
+{
+	return operator new (n);
+}
+
+void
+operator delete (void *p) THROW_NOTHING
+{
+	free (p);
+}
+
+void
+operator delete[] (void *p) THROW_NOTHING
+{
+	free (p);
+}
+
+/* Used instead of the above by compilers with sized deallocation */
+void
+operator delete (void *p, size_t) THROW_NOTHING
+{
+	free (p);
+}
+
+void
+operator delete[] (void *p, size_t) THROW_NOTHING
+{
+	free (p);
+}
+
+#endif /* __TEST_ALLOC_H__ */
@@ -0,0 +1,305 @@
+/* test-batch.cpp
+ *
+ * Checks that ExifBatch edits JPEG files in place: the EXIF data is
+ * replaced and the rest of the file kept, files whose edits fail or that
+ * are no JPEG files are left untouched, and every job gets its result.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-batch.h>
+#include <libexif/exif-data.h>
+#include <libexif/exif-edit-set.h>
+#include <libexif/exif-jpeg.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifndef _WIN32
+# include <dirent.h>
+# include <sys/stat.h>
+#endif
+
+#define FILE_EXIF "test-batch-exif.jpg"
+#define FILE_PLAIN "test-batch-plain.jpg"
+#define FILE_FAIL "test-batch-fail.jpg"
+#define FILE_TEXT "test-batch-text.jpg"
+#define FILE_MISSING "test-batch-missing.jpg"
+
+static const char artist[] = "Old artist";
+static const char new_artist[] = "A new artist";
+
+/* Image data after the EXIF data: a DQT segment, the SOS marker, some
+ * scan data and the EOI marker */
+static const unsigned char image[] = {
+	0xff, 0xdb, 0x00, 0x06, 0x00, 0x01, 0x02, 0x03,
+	0xff, 0xda, 0x00, 0x02, 0x12, 0x34, 0x56, 0x78, 0x9a,
+	0xff, 0xd9
+};
+
+static int failed = 0;
+
+static void
+read_file (const char *path, std::vector<unsigned char> *b)
+{
+	unsigned char c[256];
+	size_t l;
+	FILE *f;
+
+	b->clear ();
+	f = fopen (path, "rb");
+	if (!f)
+		return;
+	while ((l = fread (c, 1, sizeof (c), f)) > 0)
+		b->insert (b->end (), c, c + l);
+	fclose (f);
+}
+
+static void
+write_file (const char *path, const std::vector<unsigned char> &b)
+{
+	FILE *f = fopen (path, "wb");
+
+	if (!f || (fwrite (&b[0], 1, b.size (), f) != b.size ()) || fclose (f)) {
+		printf ("%s could not be written\n", path);
+		exit (1);
+	}
+}
+
+/* A JPEG file, with EXIF data holding the Artist if with_exif is set */
+static void
+make_jpeg (const char *path, int with_exif)
+{
+	std::vector<unsigned char> b;
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+	ExifData data;
+
+	b.push_back (0xff);
+	b.push_back (0xd8);
+	if (with_exif) {
+		data.exif_data_new ();
+		data.exif_data_set_byte_order (EXIF_BYTE_ORDER_INTEL);
+		test_add_value (&data, EXIF_IFD_0, EXIF_TAG_ARTIST,
+				EXIF_FORMAT_ASCII, artist, sizeof (artist));
+		data.exif_data_save_data (&d, &ds);
+		data.exif_data_free ();
+		b.push_back (0xff);
+		b.push_back (0xe1);
+		b.push_back ((unsigned char) ((ds + 2) >> 8));
+		b.push_back ((unsigned char) (ds + 2));
+		b.insert (b.end (), d, d + ds);
+		delete [] d;
+	}
+	b.insert (b.end (), image, image + sizeof (image));
+	write_file (path, b);
+}
+
+/* Apply the #ExifEditSet at user_data */
+static int
+edit_apply (ExifData *data, void *user_data)
+{
+	return ((ExifEditSet *) user_data)->exif_edit_set_apply (data, NULL, NULL);
+}
+
+static int
+edit_fail (ExifData *, void *)
+{
+	return 0;
+}
+
+/* Check that the file at path holds the Artist and the image data */
+static void
+check_edited (const char *path, const char *v)
+{
+	std::vector<unsigned char> b;
+	unsigned int o, s;
+	ExifData data;
+	ExifEntry *e;
+
+	read_file (path, &b);
+	if (!exif_jpeg_find_app1 (&b[0], b.size (), &o, &s)) {
+		printf ("%s: no EXIF data after the edit\n", path);
+		failed = 1;
+		return;
+	}
+	if ((b.size () != o + s + sizeof (image)) ||
+	    memcmp (&b[o + s], image, sizeof (image))) {
+		printf ("%s: the image data has changed\n", path);
+		failed = 1;
+	}
+	data.exif_data_new ();
+	data.exif_data_load_data (&b[o], s);
+	e = data.ifd[EXIF_IFD_0]->exif_content_get_entry (EXIF_TAG_ARTIST);
+	if (!e || (e->size != strlen (v) + 1) || memcmp (e->data, v, e->size)) {
+		printf ("%s: the Artist has not been set\n", path);
+		failed = 1;
+	}
+	data.exif_data_free ();
+}
+
+static void
+check_result (const ExifBatchJob *job, ExifBatchResult r)
+{
+	if (job->result != r) {
+		printf ("%s: '%s', expected '%s'\n", job->path,
+			exif_batch_result_get_name (job->result),
+			exif_batch_result_get_name (r));
+		failed = 1;
+	}
+}
+
+static void
+check_unchanged (const char *path, const std::vector<unsigned char> &b)
+{
+	std::vector<unsigned char> c;
+
+	read_file (path, &c);
+	if (c != b) {
+		printf ("%s: the file has been changed\n", path);
+		failed = 1;
+	}
+}
+
+#ifndef _WIN32
+/* No temporary file may be left next to the files */
+static void
+check_temp_files ()
+{
+	struct dirent *de;
+	DIR *dir;
+
+	dir = opendir (".");
+	if (!dir)
+		return;
+	while ((de = readdir (dir)) != NULL)
+		if (!strncmp (de->d_name, "test-batch-", 11) &&
+		    strstr (de->d_name, ".jpg.")) {
+			printf ("temporary file '%s' has been left\n",
+				de->d_name);
+			failed = 1;
+		}
+	closedir (dir);
+}
+#endif
+
+int
+main ()
+{
+	std::vector<unsigned char> text, fail;
+	ExifBatchEdit edits[2];
+	ExifBatchJob jobs[6];
+	ExifBatchSummary summary;
+	ExifEditSet s;
+	ExifBatch batch;
+	unsigned int i;
+
+	s.exif_edit_set_set (EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			     sizeof (new_artist), (const unsigned char *) new_artist,
+			     EXIF_BYTE_ORDER_INTEL);
+	edits[0].func = edit_apply;
+	edits[0].user_data = &s;
+	edits[1].func = edit_fail;
+	edits[1].user_data = NULL;
+
+	make_jpeg (FILE_EXIF, 1);
+	make_jpeg (FILE_PLAIN, 0);
+	make_jpeg (FILE_FAIL, 1);
+	read_file (FILE_FAIL, &fail);
+	text.assign (new_artist, new_artist + sizeof (new_artist));
+	write_file (FILE_TEXT, text);
+	remove (FILE_MISSING);
+#ifndef _WIN32
+	chmod (FILE_EXIF, 0640);
+#endif
+
+	memset (jobs, 0, sizeof (jobs));
+	jobs[0].path = FILE_EXIF;
+	jobs[1].path = FILE_PLAIN;
+	jobs[2].path = FILE_FAIL;
+	jobs[3].path = FILE_TEXT;
+	jobs[4].path = FILE_MISSING;
+	/* Edited twice at once; each edit gets its own temporary file */
+	jobs[5].path = FILE_EXIF;
+	for (i = 0; i < 6; i++) {
+		jobs[i].edits = edits;
+		jobs[i].count = 1;
+	}
+	jobs[2].count = 2;
+
+	batch.threads = 2;
+	if (batch.exif_batch_run (jobs, 6, &summary)) {
+		printf ("The run has succeeded although jobs have failed\n");
+		failed = 1;
+	}
+
+	check_result (&jobs[0], EXIF_BATCH_RESULT_OK);
+	check_result (&jobs[1], EXIF_BATCH_RESULT_OK);
+	check_result (&jobs[2], EXIF_BATCH_RESULT_EDIT_FAILED);
+	check_result (&jobs[3], EXIF_BATCH_RESULT_READ_FAILED);
+	check_result (&jobs[4], EXIF_BATCH_RESULT_READ_FAILED);
+	check_result (&jobs[5], EXIF_BATCH_RESULT_OK);
+	if ((summary.count[EXIF_BATCH_RESULT_OK] != 3) ||
+	    (summary.count[EXIF_BATCH_RESULT_EDIT_FAILED] != 1) ||
+	    (summary.count[EXIF_BATCH_RESULT_READ_FAILED] != 2) ||
+	    (summary.count[EXIF_BATCH_RESULT_WRITE_FAILED] != 0) ||
+	    (summary.count[EXIF_BATCH_RESULT_PENDING] != 0)) {
+		printf ("The summary does not count the results\n");
+		failed = 1;
+	}
+	if (summary.dirs_synced != 1) {
+		printf ("%u directories synced, expected 1\n",
+			summary.dirs_synced);
+		failed = 1;
+	}
+
+	check_edited (FILE_EXIF, new_artist);
+	check_edited (FILE_PLAIN, new_artist);
+	check_unchanged (FILE_FAIL, fail);
+	check_unchanged (FILE_TEXT, text);
+#ifndef _WIN32
+	{
+		struct stat st;
+
+		if (stat (FILE_EXIF, &st) || ((st.st_mode & 0777) != 0640)) {
+			printf ("%s: the permissions have not been kept\n",
+				FILE_EXIF);
+			failed = 1;
+		}
+	}
+	check_temp_files ();
+#endif
+
+	for (i = EXIF_BATCH_RESULT_OK; i < EXIF_BATCH_RESULT_COUNT; i++)
+		if (!exif_batch_result_get_name ((ExifBatchResult) i)) {
+			printf ("Result %u has no name\n", i);
+			failed = 1;
+		}
+
+	remove (FILE_EXIF);
+	remove (FILE_PLAIN);
+	remove (FILE_FAIL);
+	remove (FILE_TEXT);
+
+	if (failed)
+		exit (1);
+	printf ("Files edited in batches as expected.\n");
+	return 0;
+}
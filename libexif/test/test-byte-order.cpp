@@ -0,0 +1,153 @@
+/* test-byte-order.cpp
+ *
+ * Checks that values keep their meaning when the byte order of the data
+ * is changed, which only converts them on save: when they are read,
+ * saved, moved to another IFD or added to another #ExifData.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failed = 0;
+
+static void
+check_value (const char *name, ExifData *d, ExifIfd ifd, ExifLong v)
+{
+	ExifEntry *e = d->ifd[ifd]->exif_content_get_entry (EXIF_TAG_ORIENTATION);
+	ExifLong u;
+
+	if (!e || (e->exif_entry_get_uint (0, &u) != EXIF_ENTRY_VALUE_OK)) {
+		printf ("%s: no Orientation in '%s'\n", name, exif_ifd_get_name (ifd));
+		failed = 1;
+	} else if (u != v) {
+		printf ("%s: Orientation is %lu, expected %lu\n", name,
+			(unsigned long) u, (unsigned long) v);
+		failed = 1;
+	}
+}
+
+/* Save d, load it again into l and check the Orientation there */
+static void
+check_saved (const char *name, ExifData *d, ExifIfd ifd, ExifLong v)
+{
+	unsigned char *b = NULL;
+	unsigned int bs = 0;
+	ExifData l;
+
+	d->exif_data_save_data (&b, &bs);
+	l.exif_data_new ();
+	l.exif_data_unset_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	l.exif_data_load_data (b, bs);
+	if (l.exif_data_get_byte_order () != d->exif_data_get_byte_order ()) {
+		printf ("%s: saved in the wrong byte order\n", name);
+		failed = 1;
+	}
+	check_value (name, &l, ifd, v);
+	delete [] b;
+}
+
+/* Data in byte order o with Orientation 6 in IFD 0 */
+static void
+make_data (ExifData *d, ExifByteOrder o)
+{
+	ExifEntry *e;
+
+	d->exif_data_new ();
+	d->exif_data_set_byte_order (o);
+	e = test_add_entry (d, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	exif_set_short (e->data, o, 6);
+}
+
+/* Take the entry of tag out of an IFD */
+static void
+take_entry (ExifContent *c, ExifTag tag, ExifEntry *en)
+{
+	unsigned int i;
+
+	for (i = 0; i < c->entries.size (); i++)
+		if (c->entries[i].tag == tag) {
+			en->exif_entry_swap (c->entries[i]);
+			c->exif_content_remove_entry (i);
+			return;
+		}
+}
+
+static void
+check (ExifByteOrder o)
+{
+	ExifByteOrder o_other = (o == EXIF_BYTE_ORDER_INTEL) ?
+		EXIF_BYTE_ORDER_MOTOROLA : EXIF_BYTE_ORDER_INTEL;
+	ExifData d, other;
+	char name[64];
+
+	/* The byte order changed, nothing moved */
+	sprintf (name, "%s to %s", exif_byte_order_get_name (o),
+		 exif_byte_order_get_name (o_other));
+	make_data (&d, o);
+	d.exif_data_set_byte_order (o_other);
+	check_value (name, &d, EXIF_IFD_0, 6);
+	check_saved (name, &d, EXIF_IFD_0, 6);
+	d.exif_data_free ();
+
+	/* Moved to IFD 1 after the byte order changed */
+	sprintf (name, "%s to %s, moved", exif_byte_order_get_name (o),
+		 exif_byte_order_get_name (o_other));
+	make_data (&d, o);
+	d.exif_data_set_byte_order (o_other);
+	{
+		ExifEntry en;
+
+		take_entry (d.ifd[EXIF_IFD_0], EXIF_TAG_ORIENTATION, &en);
+		d.ifd[EXIF_IFD_1]->exif_content_add_entry (en);
+	}
+	check_value (name, &d, EXIF_IFD_1, 6);
+	check_saved (name, &d, EXIF_IFD_1, 6);
+
+	/* Moved on into other data, still not converted */
+	sprintf (name, "%s, added to %s data", exif_byte_order_get_name (o),
+		 exif_byte_order_get_name (o_other));
+	other.exif_data_new ();
+	other.exif_data_set_byte_order (o_other);
+	{
+		ExifEntry en;
+
+		take_entry (d.ifd[EXIF_IFD_1], EXIF_TAG_ORIENTATION, &en);
+		other.ifd[EXIF_IFD_0]->exif_content_add_entry (en);
+	}
+	check_value (name, &other, EXIF_IFD_0, 6);
+	check_saved (name, &other, EXIF_IFD_0, 6);
+	other.exif_data_free ();
+	d.exif_data_free ();
+}
+
+int
+main ()
+{
+	check (EXIF_BYTE_ORDER_INTEL);
+	check (EXIF_BYTE_ORDER_MOTOROLA);
+
+	if (failed)
+		exit (1);
+	printf ("Values kept across byte order changes.\n");
+	return 0;
+}
@@ -0,0 +1,217 @@
+/* test-data-fixed.cpp
+ *
+ * Checks that ExifDataFixed loads the same entries as
+ * exif_data_load_data without allocating, and that data not fitting its
+ * storage is reported and the entries that fit are kept.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-data-fixed.h>
+
+#include "test-alloc.h"
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THUMBNAIL_SIZE 500
+
+static const char artist[] = "An artist with a long name";
+
+static int failed = 0;
+
+/* The storage is too large for the stack of some systems */
+static ExifDataFixed<32, 4096> fixed;
+static ExifDataFixed<3, 4096> few_entries;
+static ExifDataFixed<256, 256> few_bytes;
+static ExifDataFixed<32, 16> tiny;
+
+/* Build EXIF data with entries in several IFDs, one of them unknown, and
+ * a thumbnail */
+static void
+make_data (ExifByteOrder o, unsigned char **d, unsigned int *ds)
+{
+	unsigned char u[4] = { 1, 2, 3, 4 };
+	ExifData data;
+	unsigned int i;
+
+	data.exif_data_new ();
+	data.exif_data_set_byte_order (o);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			artist, sizeof (artist));
+	test_add_value (&data, EXIF_IFD_0, (ExifTag) 0xfe00, EXIF_FORMAT_UNDEFINED,
+			u, sizeof (u));
+	test_add_entry (&data, EXIF_IFD_EXIF, EXIF_TAG_COLOR_SPACE);
+	test_add_entry (&data, EXIF_IFD_EXIF, EXIF_TAG_EXPOSURE_TIME);
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+
+	data.size = THUMBNAIL_SIZE;
+	data.data = new unsigned char[data.size];
+	for (i = 0; i < data.size; i++)
+		data.data[i] = (unsigned char) i;
+
+	data.exif_data_save_data (d, ds);
+	data.exif_data_free ();
+}
+
+static void
+check_result (const char *name, ExifDataFixedResult r, ExifDataFixedResult e)
+{
+	if (r != e) {
+		printf ("%s: result %i, expected %i\n", name, r, e);
+		failed = 1;
+	}
+}
+
+/* Compare the entries and the thumbnail of f to those of l */
+static void
+check_same (const char *name, ExifData *l, ExifDataFixed<32, 4096> *f)
+{
+	const ExifParserEntry *p;
+	const unsigned char *t;
+	unsigned int i, j, ts;
+
+	if (f->order != l->exif_data_get_byte_order ()) {
+		printf ("%s: the byte order differs\n", name);
+		failed = 1;
+	}
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		std::vector<ExifEntry> &el = l->ifd[i]->entries;
+
+		if (f->exif_data_fixed_count ((ExifIfd) i) != el.size ()) {
+			printf ("%s: %u entries in '%s', expected %u\n", name,
+				f->exif_data_fixed_count ((ExifIfd) i),
+				exif_ifd_get_name ((ExifIfd) i),
+				(unsigned int) el.size ());
+			failed = 1;
+			continue;
+		}
+		for (j = 0; j < el.size (); j++) {
+			p = f->exif_data_fixed_get_entry ((ExifIfd) i, el[j].tag);
+			if (!p || (p->format != el[j].format) ||
+			    (p->components != el[j].components) ||
+			    (p->size != el[j].size) ||
+			    memcmp (p->data, el[j].data, el[j].size)) {
+				printf ("%s: entry '%s' of '%s' differs\n", name,
+					exif_tag_get_name (el[j].tag),
+					exif_ifd_get_name ((ExifIfd) i));
+				failed = 1;
+			}
+		}
+	}
+
+	t = l->exif_data_get_thumbnail (&ts);
+	if ((f->thumbnail_size != ts) || !f->thumbnail ||
+	    memcmp (f->thumbnail, t, ts)) {
+		printf ("%s: the thumbnail differs\n", name);
+		failed = 1;
+	}
+}
+
+static void
+check (ExifByteOrder o)
+{
+	static const unsigned char bad[] = "Exif\0\0XX\0\x2a\0\0\0\x08";
+	const char *name = exif_byte_order_get_name (o);
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+	unsigned long a;
+	ExifData l;
+	ExifDataFixedResult r;
+
+	make_data (o, &d, &ds);
+	l.exif_data_new ();
+	l.exif_data_unset_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	l.exif_data_load_data (d, ds);
+
+	/* Everything fits */
+	a = test_allocations;
+	r = fixed.exif_data_fixed_load (d, ds);
+	if (test_allocations != a) {
+		printf ("%s: %lu allocations while loading\n", name,
+			test_allocations - a);
+		failed = 1;
+	}
+	check_result (name, r, EXIF_DATA_FIXED_RESULT_OK);
+	check_same (name, &l, &fixed);
+
+	/* Too many entries: the first ones are kept */
+	r = few_entries.exif_data_fixed_load (d, ds);
+	check_result (name, r, EXIF_DATA_FIXED_RESULT_TOO_MANY_ENTRIES);
+	if ((few_entries.n_entries != 3) ||
+	    !few_entries.exif_data_fixed_get_entry (EXIF_IFD_0,
+						   EXIF_TAG_X_RESOLUTION)) {
+		printf ("%s: %u entries kept, expected the first 3\n", name,
+			few_entries.n_entries);
+		failed = 1;
+	}
+
+	/* The entries fit, the thumbnail does not unless it is skipped */
+	r = few_bytes.exif_data_fixed_load (d, ds);
+	check_result (name, r, EXIF_DATA_FIXED_RESULT_TOO_MANY_BYTES);
+	if ((few_bytes.n_entries != fixed.n_entries) || few_bytes.thumbnail ||
+	    few_bytes.thumbnail_size) {
+		printf ("%s: the entries have not been kept without the "
+			"thumbnail\n", name);
+		failed = 1;
+	}
+	few_bytes.options = (ExifDataOption) (few_bytes.options |
+					      EXIF_DATA_OPTION_SKIP_THUMBNAIL);
+	r = few_bytes.exif_data_fixed_load (d, ds);
+	few_bytes.options = EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS;
+	check_result (name, r, EXIF_DATA_FIXED_RESULT_OK);
+	if ((few_bytes.n_entries != fixed.n_entries) || few_bytes.thumbnail) {
+		printf ("%s: the thumbnail has not been skipped\n", name);
+		failed = 1;
+	}
+
+	/* A value does not fit */
+	r = tiny.exif_data_fixed_load (d, ds);
+	check_result (name, r, EXIF_DATA_FIXED_RESULT_TOO_MANY_BYTES);
+	if ((tiny.n_entries >= fixed.n_entries) || (tiny.n_bytes > 16)) {
+		printf ("%s: %u entries in %u bytes kept\n", name,
+			tiny.n_entries, tiny.n_bytes);
+		failed = 1;
+	}
+
+	/* Invalid data leaves nothing */
+	r = fixed.exif_data_fixed_load (bad, sizeof (bad) - 1);
+	check_result (name, r, EXIF_DATA_FIXED_RESULT_NO_DATA);
+	if (fixed.n_entries || fixed.thumbnail) {
+		printf ("%s: entries kept from invalid data\n", name);
+		failed = 1;
+	}
+
+	l.exif_data_free ();
+	delete [] d;
+}
+
+int
+main ()
+{
+	check (EXIF_BYTE_ORDER_INTEL);
+	check (EXIF_BYTE_ORDER_MOTOROLA);
+
+	if (failed)
+		exit (1);
+	printf ("Fixed data loaded without allocating.\n");
+	return 0;
+}
@@ -0,0 +1,164 @@
+/* test-data-reuse.cpp
+ *
+ * Loads the same EXIF data over and over into data that is reset with
+ * exif_data_reset, and into data of the thread's pool, and checks with
+ * a counting operator new that nothing is allocated once the first
+ * loads have sized the memory that is reused.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-data-pool.h>
+
+#include "test-alloc.h"
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Loads after which nothing may be allocated any more */
+#define WARMUP 2
+#define LOADS 20
+
+/* Counts the entries it is asked about and never decides */
+static ExifDataFilterResult
+count_filtered (ExifData *, ExifIfd, const ExifEntry *, void *user_data)
+{
+	(*(unsigned int *) user_data)++;
+	return EXIF_DATA_FILTER_UNDECIDED;
+}
+
+/* Build EXIF data with entries in several IFDs and a thumbnail */
+static void
+make_data (unsigned char **d, unsigned int *ds)
+{
+	static const char artist[] = "An artist with a long name";
+	ExifData data;
+	unsigned int i;
+
+	data.exif_data_new ();
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_Y_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_YCBCR_POSITIONING);
+	test_add_entry (&data, EXIF_IFD_EXIF, EXIF_TAG_EXIF_VERSION);
+	test_add_entry (&data, EXIF_IFD_EXIF, EXIF_TAG_COMPONENTS_CONFIGURATION);
+	test_add_entry (&data, EXIF_IFD_EXIF, EXIF_TAG_COLOR_SPACE);
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_Y_RESOLUTION);
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			artist, sizeof (artist));
+
+	data.size = 1000;
+	data.data = new unsigned char[data.size];
+	for (i = 0; i < data.size; i++)
+		data.data[i] = (unsigned char) i;
+
+	data.exif_data_save_data (d, ds);
+}
+
+static unsigned int
+count_entries (ExifData *data)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		n += (unsigned int) data->ifd[i]->entries.size ();
+	return n;
+}
+
+/* Check a loaded copy of the data and the allocations made for it */
+static int
+check (ExifData *data, unsigned int n, unsigned int i, unsigned long a,
+       const char *name)
+{
+	if (!n || (count_entries (data) != n) || (data->size != 1000)) {
+		printf ("%s: load %u gives %u entries and %u bytes of thumbnail, "
+			"expected %u and 1000\n", name, i, count_entries (data),
+			data->size, n);
+		return 1;
+	}
+	if ((i >= WARMUP) && a) {
+		printf ("%s: load %u allocates %lu times\n", name, i, a);
+		return 1;
+	}
+	return 0;
+}
+
+int
+main ()
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0, i, n, filtered = 0;
+	unsigned long a;
+	ExifData reused, *data;
+	int failed = 0;
+
+	make_data (&d, &ds);
+	if (!d) {
+		printf ("Could not save the test data\n");
+		exit (1);
+	}
+
+	reused.exif_data_new ();
+	reused.exif_data_load_data (d, ds);
+	n = count_entries (&reused);
+	for (i = 0; i < LOADS; i++) {
+		a = test_allocations;
+		reused.exif_data_reset ();
+		reused.exif_data_load_data (d, ds);
+		failed |= check (&reused, n, i, test_allocations - a, "exif_data_reset");
+	}
+
+	for (i = 0; i < LOADS; i++) {
+		a = test_allocations;
+		data = exif_data_pool_acquire ();
+		data->exif_data_load_data (d, ds);
+		failed |= check (data, n, i, test_allocations - a, "exif_data_pool");
+		exif_data_pool_release (data);
+	}
+	exif_data_pool_clear ();
+
+	/* The load filter stays through a reset, but not through the pool */
+	reused.exif_data_set_load_filter (count_filtered, &filtered);
+	reused.exif_data_reset ();
+	reused.exif_data_load_data (d, ds);
+	if (!filtered) {
+		printf ("exif_data_reset: the load filter has been dropped\n");
+		failed = 1;
+	}
+	data = exif_data_pool_acquire ();
+	data->exif_data_set_load_filter (count_filtered, &filtered);
+	exif_data_pool_release (data);
+	data = exif_data_pool_acquire ();
+	filtered = 0;
+	data->exif_data_load_data (d, ds);
+	if (filtered) {
+		printf ("exif_data_pool: the load filter has been kept\n");
+		failed = 1;
+	}
+	exif_data_pool_release (data);
+	exif_data_pool_clear ();
+
+	delete [] d;
+	if (failed)
+		exit (1);
+	printf ("Reused data loaded %u times without allocating.\n",
+		LOADS - WARMUP);
+	return 0;
+}
@@ -0,0 +1,243 @@
+/* test-data-view.cpp
+ *
+ * Checks that materializing an ExifDataView gives the same data as
+ * loading the viewed buffer with exif_data_load_data, whatever the data
+ * held before, and that an empty view leaves the data empty.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-data-view.h>
+#include <libexif/exif-utils.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char make[] = "Canon";
+static const char artist[] = "An artist with a long name";
+
+static int failed = 0;
+
+/* Build EXIF data with entries in several IFDs, one of them unknown, a
+ * Canon MakerNote and a thumbnail */
+static void
+make_data (ExifByteOrder o, unsigned char **d, unsigned int *ds)
+{
+	unsigned char m[18], u[4] = { 1, 2, 3, 4 };
+	ExifData data;
+	unsigned int i;
+
+	/* One LONG entry, then no next IFD */
+	exif_set_short (m, o, 1);
+	exif_set_short (m + 2, o, 0x8);
+	exif_set_short (m + 4, o, EXIF_FORMAT_LONG);
+	exif_set_long (m + 6, o, 1);
+	exif_set_long (m + 10, o, 1234);
+	exif_set_long (m + 14, o, 0);
+
+	data.exif_data_new ();
+	data.exif_data_set_byte_order (o);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_MAKE, EXIF_FORMAT_ASCII,
+			make, sizeof (make));
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			artist, sizeof (artist));
+	test_add_value (&data, EXIF_IFD_0, (ExifTag) 0xfe00, EXIF_FORMAT_UNDEFINED,
+			u, sizeof (u));
+	test_add_entry (&data, EXIF_IFD_EXIF, EXIF_TAG_COLOR_SPACE);
+	test_add_value (&data, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE,
+			EXIF_FORMAT_UNDEFINED, m, sizeof (m));
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+
+	data.size = 500;
+	data.data = new unsigned char[data.size];
+	for (i = 0; i < data.size; i++)
+		data.data[i] = (unsigned char) i;
+
+	data.exif_data_save_data (d, ds);
+	data.exif_data_free ();
+}
+
+static unsigned int
+count_entries (ExifData *data)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		n += (unsigned int) data->ifd[i]->entries.size ();
+	return n;
+}
+
+/* Compare the entries, thumbnail and MakerNote of m to those of l */
+static void
+check_same (const char *name, ExifData *l, ExifData *m)
+{
+	ExifMnoteData *ml = l->exif_data_get_mnote_data ();
+	ExifMnoteData *mm = m->exif_data_get_mnote_data ();
+	char vl[64], vm[64];
+	unsigned int i, j, tl, tm;
+	const unsigned char *dl, *dm;
+
+	if (l->exif_data_get_byte_order () != m->exif_data_get_byte_order ()) {
+		printf ("%s: the byte order differs\n", name);
+		failed = 1;
+	}
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		std::vector<ExifEntry> &el = l->ifd[i]->entries;
+		std::vector<ExifEntry> &em = m->ifd[i]->entries;
+
+		if (el.size () != em.size ()) {
+			printf ("%s: %u entries in '%s', loaded %u\n", name,
+				(unsigned int) em.size (),
+				exif_ifd_get_name ((ExifIfd) i),
+				(unsigned int) el.size ());
+			failed = 1;
+			continue;
+		}
+		for (j = 0; j < el.size (); j++)
+			if ((el[j].tag != em[j].tag) ||
+			    (el[j].format != em[j].format) ||
+			    (el[j].components != em[j].components) ||
+			    (el[j].size != em[j].size) ||
+			    memcmp (el[j].data, em[j].data, el[j].size)) {
+				printf ("%s: entry %u of '%s' differs\n", name,
+					j, exif_ifd_get_name ((ExifIfd) i));
+				failed = 1;
+			}
+	}
+
+	dl = l->exif_data_get_thumbnail (&tl);
+	dm = m->exif_data_get_thumbnail (&tm);
+	if ((tl != tm) || (tl && memcmp (dl, dm, tl))) {
+		printf ("%s: the thumbnail differs\n", name);
+		failed = 1;
+	}
+
+	if (!ml || !mm || (ml->exif_mnote_data_count () != mm->exif_mnote_data_count ())) {
+		printf ("%s: the MakerNote differs\n", name);
+		failed = 1;
+		return;
+	}
+	for (i = 0; i < ml->exif_mnote_data_count (); i++) {
+		vl[0] = vm[0] = '\0';
+		ml->exif_mnote_data_get_value (i, vl, sizeof (vl));
+		mm->exif_mnote_data_get_value (i, vm, sizeof (vm));
+		if (strcmp (vl, vm)) {
+			printf ("%s: MakerNote value %u is '%s', loaded '%s'\n",
+				name, i, vm, vl);
+			failed = 1;
+		}
+	}
+}
+
+/* Check that data holds nothing and has kept its options */
+static void
+check_empty (const char *name, ExifData *data, ExifDataOption options)
+{
+	unsigned int ts;
+
+	if (count_entries (data) || data->exif_data_get_thumbnail (&ts) || ts ||
+	    data->exif_data_get_mnote_data ()) {
+		printf ("%s: the previous data has been kept\n", name);
+		failed = 1;
+	}
+	if (data->priv.options != options) {
+		printf ("%s: the options have changed\n", name);
+		failed = 1;
+	}
+}
+
+static void
+check (ExifByteOrder o)
+{
+	static const unsigned char bad[] = "Exif\0\0XX\0\x2a\0\0\0\x08";
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+	ExifDataOption options;
+	ExifData l, m;
+	ExifDataView v;
+	char name[64];
+
+	make_data (o, &d, &ds);
+	l.exif_data_new ();
+	l.exif_data_load_data (d, ds);
+	if (count_entries (&l) < 7) {
+		printf ("%s: the data has not been loaded\n",
+			exif_byte_order_get_name (o));
+		exit (1);
+	}
+	if (!v.exif_data_view_load (d, ds)) {
+		printf ("%s: the data could not be viewed\n",
+			exif_byte_order_get_name (o));
+		exit (1);
+	}
+
+	/* Into new data */
+	sprintf (name, "%s, new data", exif_byte_order_get_name (o));
+	m.exif_data_new ();
+	if (!v.exif_data_view_materialize (&m)) {
+		printf ("%s: not materialized\n", name);
+		failed = 1;
+	}
+	check_same (name, &l, &m);
+
+	/* Again, into the data it has just filled */
+	sprintf (name, "%s, filled data", exif_byte_order_get_name (o));
+	v.exif_data_view_materialize (&m);
+	check_same (name, &l, &m);
+
+	/* An empty view and a view of invalid data empty the data */
+	sprintf (name, "%s, empty view", exif_byte_order_get_name (o));
+	m.exif_data_unset_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	options = m.priv.options;
+	v.Init ();
+	if (!v.exif_data_view_materialize (&m)) {
+		printf ("%s: not materialized\n", name);
+		failed = 1;
+	}
+	check_empty (name, &m, options);
+
+	sprintf (name, "%s, invalid view", exif_byte_order_get_name (o));
+	v.exif_data_view_load (d, ds);
+	v.exif_data_view_materialize (&m);
+	if (v.exif_data_view_load (bad, sizeof (bad) - 1)) {
+		printf ("%s: invalid data has been viewed\n", name);
+		failed = 1;
+	}
+	v.exif_data_view_materialize (&m);
+	check_empty (name, &m, options);
+
+	m.exif_data_free ();
+	l.exif_data_free ();
+	delete [] d;
+}
+
+int
+main ()
+{
+	check (EXIF_BYTE_ORDER_INTEL);
+	check (EXIF_BYTE_ORDER_MOTOROLA);
+
+	if (failed)
+		exit (1);
+	printf ("Views materialized as loaded.\n");
+	return 0;
+}
@@ -0,0 +1,283 @@
+/* test-edit-set.cpp
+ *
+ * Checks that ExifEditSet applies set, remove and initialize edits to an
+ * IFD in place when nothing is added and through a new vector otherwise,
+ * keeping the entries sorted by tag, and that invalid sets are refused
+ * without touching the data.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-edit-set.h>
+#include <libexif/exif-utils.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char artist[] = "Old artist";
+static const char new_artist[] = "A new artist with a longer name";
+static const char make[] = "Test make";
+
+static int failed = 0;
+
+/* IFD 0 with XResolution, YResolution, ResolutionUnit, Artist and
+ * YCbCrPositioning, and the EXIF IFD with ColorSpace */
+static void
+make_data (ExifData *d)
+{
+	d->exif_data_new ();
+	d->exif_data_set_byte_order (EXIF_BYTE_ORDER_INTEL);
+	test_add_entry (d, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (d, EXIF_IFD_0, EXIF_TAG_Y_RESOLUTION);
+	test_add_entry (d, EXIF_IFD_0, EXIF_TAG_RESOLUTION_UNIT);
+	test_add_entry (d, EXIF_IFD_0, EXIF_TAG_YCBCR_POSITIONING);
+	test_add_entry (d, EXIF_IFD_EXIF, EXIF_TAG_COLOR_SPACE);
+	test_add_value (d, EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			artist, sizeof (artist));
+}
+
+/* Check the tags of an IFD, in order */
+static void
+check_tags (const char *name, ExifContent *c, const ExifTag *tags,
+	    unsigned int n)
+{
+	unsigned int i;
+
+	if (c->entries.size () != n) {
+		printf ("%s: %u entries, expected %u\n", name,
+			(unsigned int) c->entries.size (), n);
+		failed = 1;
+		return;
+	}
+	for (i = 0; i < n; i++)
+		if (c->entries[i].tag != tags[i]) {
+			printf ("%s: entry %u is '%s', expected '%s'\n", name, i,
+				exif_tag_get_name (c->entries[i].tag),
+				exif_tag_get_name (tags[i]));
+			failed = 1;
+		}
+}
+
+static void
+check_ascii (const char *name, ExifContent *c, ExifTag tag, const char *v)
+{
+	ExifEntry *e = c->exif_content_get_entry (tag);
+
+	if (!e || (e->format != EXIF_FORMAT_ASCII) ||
+	    (e->size != strlen (v) + 1) || memcmp (e->data, v, e->size)) {
+		printf ("%s: '%s' does not hold '%s'\n", name,
+			exif_tag_get_name (tag), v);
+		failed = 1;
+	}
+}
+
+static void
+check_short (const char *name, ExifContent *c, ExifTag tag, ExifLong v)
+{
+	ExifEntry *e = c->exif_content_get_entry (tag);
+	ExifLong u;
+
+	if (!e || (e->exif_entry_get_uint (0, &u) != EXIF_ENTRY_VALUE_OK) ||
+	    (u != v)) {
+		printf ("%s: '%s' is not %lu\n", name, exif_tag_get_name (tag),
+			(unsigned long) v);
+		failed = 1;
+	}
+}
+
+/* Nothing is added, so IFD 0 is edited in place */
+static void
+check_in_place ()
+{
+	static const ExifTag tags[] = {
+		EXIF_TAG_Y_RESOLUTION, EXIF_TAG_RESOLUTION_UNIT,
+		EXIF_TAG_ARTIST, EXIF_TAG_YCBCR_POSITIONING
+	};
+	ExifData d;
+	ExifEditSet s;
+	const ExifEntry *first;
+	unsigned char v[2];
+
+	make_data (&d);
+	exif_set_short (d.ifd[EXIF_IFD_0]->exif_content_get_entry (
+		EXIF_TAG_RESOLUTION_UNIT)->data, EXIF_BYTE_ORDER_INTEL, 3);
+	first = &d.ifd[EXIF_IFD_0]->entries[0];
+
+	/* Out of order; the set sorts them */
+	s.exif_edit_set_set (EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			     sizeof (new_artist), (const unsigned char *) new_artist,
+			     EXIF_BYTE_ORDER_INTEL);
+	s.exif_edit_set_initialize (EXIF_IFD_0, EXIF_TAG_RESOLUTION_UNIT);
+	s.exif_edit_set_remove (EXIF_IFD_0, EXIF_TAG_COPYRIGHT);
+	s.exif_edit_set_remove (EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	exif_set_short (v, EXIF_BYTE_ORDER_MOTOROLA, 65535);
+	s.exif_edit_set_set (EXIF_IFD_EXIF, EXIF_TAG_COLOR_SPACE,
+			     EXIF_FORMAT_SHORT, 1, v, EXIF_BYTE_ORDER_MOTOROLA);
+
+	if (!s.exif_edit_set_apply (&d, NULL, NULL)) {
+		printf ("in place: the edits have not been applied\n");
+		failed = 1;
+	}
+	check_tags ("in place", d.ifd[EXIF_IFD_0], tags,
+		    sizeof (tags) / sizeof (tags[0]));
+	if (&d.ifd[EXIF_IFD_0]->entries[0] != first) {
+		printf ("in place: the entries have been moved\n");
+		failed = 1;
+	}
+	check_ascii ("in place", d.ifd[EXIF_IFD_0], EXIF_TAG_ARTIST, new_artist);
+	check_short ("in place", d.ifd[EXIF_IFD_0], EXIF_TAG_RESOLUTION_UNIT, 3);
+	check_short ("in place", d.ifd[EXIF_IFD_EXIF], EXIF_TAG_COLOR_SPACE, 65535);
+}
+
+/* Entries are added, so IFD 0 is rebuilt in a new vector */
+static void
+check_added ()
+{
+	static const ExifTag tags[] = {
+		EXIF_TAG_MAKE, EXIF_TAG_ORIENTATION, EXIF_TAG_X_RESOLUTION,
+		EXIF_TAG_RESOLUTION_UNIT, EXIF_TAG_ARTIST,
+		EXIF_TAG_YCBCR_POSITIONING
+	};
+	ExifData d;
+	ExifEditSet s;
+	unsigned char v[2];
+	unsigned char *b = NULL;
+	unsigned int bs = 0;
+
+	make_data (&d);
+	s.exif_edit_set_set (EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			     sizeof (new_artist), (const unsigned char *) new_artist,
+			     EXIF_BYTE_ORDER_INTEL);
+	s.exif_edit_set_initialize (EXIF_IFD_0, EXIF_TAG_YCBCR_POSITIONING);
+	s.exif_edit_set_remove (EXIF_IFD_0, EXIF_TAG_Y_RESOLUTION);
+	s.exif_edit_set_initialize (EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	s.exif_edit_set_set (EXIF_IFD_0, EXIF_TAG_MAKE, EXIF_FORMAT_ASCII,
+			     sizeof (make), (const unsigned char *) make,
+			     EXIF_BYTE_ORDER_INTEL);
+	exif_set_short (v, EXIF_BYTE_ORDER_MOTOROLA, 2);
+	s.exif_edit_set_set (EXIF_IFD_0, EXIF_TAG_RESOLUTION_UNIT,
+			     EXIF_FORMAT_SHORT, 1, v, EXIF_BYTE_ORDER_MOTOROLA);
+
+	if (!s.exif_edit_set_apply (&d, &b, &bs) || !b) {
+		printf ("added: the edits have not been applied and saved\n");
+		failed = 1;
+	}
+	check_tags ("added", d.ifd[EXIF_IFD_0], tags,
+		    sizeof (tags) / sizeof (tags[0]));
+	check_ascii ("added", d.ifd[EXIF_IFD_0], EXIF_TAG_MAKE, make);
+	check_ascii ("added", d.ifd[EXIF_IFD_0], EXIF_TAG_ARTIST, new_artist);
+	check_short ("added", d.ifd[EXIF_IFD_0], EXIF_TAG_ORIENTATION, 1);
+	check_short ("added", d.ifd[EXIF_IFD_0], EXIF_TAG_RESOLUTION_UNIT, 2);
+	check_short ("added", d.ifd[EXIF_IFD_0], EXIF_TAG_YCBCR_POSITIONING, 1);
+
+	/* The saved data holds the same entries */
+	d.exif_data_free ();
+	d.exif_data_new ();
+	d.exif_data_unset_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	d.exif_data_load_data (b, bs);
+	check_tags ("added and saved", d.ifd[EXIF_IFD_0], tags,
+		    sizeof (tags) / sizeof (tags[0]));
+	check_ascii ("added and saved", d.ifd[EXIF_IFD_0], EXIF_TAG_MAKE, make);
+	check_short ("added and saved", d.ifd[EXIF_IFD_0],
+		     EXIF_TAG_RESOLUTION_UNIT, 2);
+	delete [] b;
+}
+
+/* A set that is invalid is refused and the data is left alone */
+static void
+check_refused (const char *name, ExifEditSet *s)
+{
+	static const ExifTag tags[] = {
+		EXIF_TAG_X_RESOLUTION, EXIF_TAG_Y_RESOLUTION,
+		EXIF_TAG_RESOLUTION_UNIT, EXIF_TAG_ARTIST,
+		EXIF_TAG_YCBCR_POSITIONING
+	};
+	ExifData d;
+
+	make_data (&d);
+	if (s->exif_edit_set_validate (NULL)) {
+		printf ("%s: the set has been validated\n", name);
+		failed = 1;
+	}
+	if (s->exif_edit_set_apply (&d, NULL, NULL)) {
+		printf ("%s: the set has been applied\n", name);
+		failed = 1;
+	}
+	check_tags (name, d.ifd[EXIF_IFD_0], tags, sizeof (tags) / sizeof (tags[0]));
+	check_ascii (name, d.ifd[EXIF_IFD_0], EXIF_TAG_ARTIST, artist);
+}
+
+static void
+check_validate ()
+{
+	ExifEditSet s;
+
+	s.exif_edit_set_remove (EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	s.exif_edit_set_set (EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			     sizeof (new_artist), (const unsigned char *) new_artist,
+			     EXIF_BYTE_ORDER_INTEL);
+	s.exif_edit_set_initialize (EXIF_IFD_0, EXIF_TAG_ARTIST);
+	check_refused ("duplicate tag", &s);
+
+	/* The same tag in two IFDs is fine */
+	s.Init ();
+	s.exif_edit_set_initialize (EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	s.exif_edit_set_initialize (EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+	if (!s.exif_edit_set_validate (NULL)) {
+		printf ("same tag in two IFDs: the set has been refused\n");
+		failed = 1;
+	}
+
+	s.Init ();
+	s.exif_edit_set_remove (EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	s.exif_edit_set_remove (EXIF_IFD_0, EXIF_TAG_EXIF_IFD_POINTER);
+	check_refused ("pointer tag", &s);
+
+	s.Init ();
+	s.exif_edit_set_remove (EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	s.exif_edit_set_remove (EXIF_IFD_1, EXIF_TAG_JPEG_INTERCHANGE_FORMAT);
+	check_refused ("thumbnail tag", &s);
+
+	s.Init ();
+	s.exif_edit_set_remove (EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	s.exif_edit_set_remove (EXIF_IFD_COUNT, EXIF_TAG_ARTIST);
+	check_refused ("bad IFD", &s);
+
+	/* A value without bytes is refused when it is added */
+	s.Init ();
+	if (s.exif_edit_set_set (EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+				 4, NULL, EXIF_BYTE_ORDER_INTEL) || !s.edits.empty ()) {
+		printf ("missing value: the edit has been added\n");
+		failed = 1;
+	}
+}
+
+int
+main ()
+{
+	check_in_place ();
+	check_added ();
+	check_validate ();
+
+	if (failed)
+		exit (1);
+	printf ("Edit sets applied as expected.\n");
+	return 0;
+}
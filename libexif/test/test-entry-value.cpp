@@ -0,0 +1,352 @@
+/* test-entry-value.cpp
+ *
+ * Checks the typed value accessors of ExifEntry and the component views
+ * of exif_entry_get_span in both byte orders, including the results for
+ * a wrong format, a missing component and too little data.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A test tag that has no formatter of its own */
+#define TEST_TAG ((ExifTag) 0xfff0)
+
+#define N_COMPONENTS 3
+
+static const ExifByteOrder orders[] = {
+	EXIF_BYTE_ORDER_INTEL, EXIF_BYTE_ORDER_MOTOROLA
+};
+
+/* Values of each format; numerator and denominator for rationals */
+static const long byte_values[] = {0x00, 0x7f, 0xff};
+static const long sbyte_values[] = {-128, 0, 127};
+static const long short_values[] = {0, 0x1234, 65535};
+static const long sshort_values[] = {-32768, -2, 32767};
+static const long long_values[] = {0, 0x12345678L, 4294967295L};
+static const long slong_values[] = {-2147483647L - 1, -70000, 2147483647L};
+static const long rational_values[] = {1, 2, 4294967295L, 1, 72, 10};
+static const long srational_values[] = {-1, 4, 5, -2, -2147483647L - 1, 2};
+
+static int failed = 0;
+
+#define CHECK(cond, what) \
+	do { \
+		if (!(cond)) { \
+			printf ("%s (%s, %s): %s failed\n", what, \
+				exif_format_get_name (e->format), \
+				exif_byte_order_get_name (e->exif_entry_get_byte_order ()), \
+				#cond); \
+			failed = 1; \
+		} \
+	} while (0)
+
+static ExifEntry *
+new_entry (ExifData *d, ExifFormat format, const long *v)
+{
+	ExifEntry en;
+	ExifEntry *e;
+	ExifContent *c = d->ifd[EXIF_IFD_0];
+	ExifByteOrder o = d->exif_data_get_byte_order ();
+	ExifRational r;
+	ExifSRational sr;
+	unsigned int i;
+
+	c->entries.clear ();
+	en.tag = TEST_TAG;
+	c->exif_content_add_entry (en);
+	e = &c->entries.back ();
+	e->format = format;
+	e->components = N_COMPONENTS;
+	e->size = exif_format_get_size (format) * N_COMPONENTS;
+	e->data = e->exif_entry_alloc (e->size);
+
+	for (i = 0; i < N_COMPONENTS; i++)
+		switch (format) {
+		case EXIF_FORMAT_BYTE:
+		case EXIF_FORMAT_SBYTE:
+			e->data[i] = (unsigned char) v[i];
+			break;
+		case EXIF_FORMAT_SHORT:
+			exif_set_short (e->data + 2 * i, o, (ExifShort) v[i]);
+			break;
+		case EXIF_FORMAT_SSHORT:
+			exif_set_sshort (e->data + 2 * i, o, (ExifSShort) v[i]);
+			break;
+		case EXIF_FORMAT_LONG:
+			exif_set_long (e->data + 4 * i, o, (ExifLong) v[i]);
+			break;
+		case EXIF_FORMAT_SLONG:
+			exif_set_slong (e->data + 4 * i, o, (ExifSLong) v[i]);
+			break;
+		case EXIF_FORMAT_RATIONAL:
+			r.numerator = (ExifLong) v[2 * i];
+			r.denominator = (ExifLong) v[2 * i + 1];
+			exif_set_rational (e->data + 8 * i, o, r);
+			break;
+		case EXIF_FORMAT_SRATIONAL:
+			sr.numerator = (ExifSLong) v[2 * i];
+			sr.denominator = (ExifSLong) v[2 * i + 1];
+			exif_set_srational (e->data + 8 * i, o, sr);
+			break;
+		default:
+			break;
+		}
+	return e;
+}
+
+/* Integer formats: the span gives each value */
+template <ExifFormat F> static void
+check_span (ExifEntry *e, const long *v)
+{
+	ExifEntrySpan<F> s;
+	unsigned int i;
+
+	CHECK (e->exif_entry_get_span<F> (&s) == EXIF_ENTRY_VALUE_OK, "span");
+	CHECK (s.size () == N_COMPONENTS, "span");
+	for (i = 0; i < s.size (); i++)
+		CHECK ((long) s[i] == v[i], "span");
+}
+
+/* Rational formats: the span gives each numerator and denominator */
+template <ExifFormat F> static void
+check_span_rational (ExifEntry *e, const long *v)
+{
+	ExifEntrySpan<F> s;
+	unsigned int i;
+
+	CHECK (e->exif_entry_get_span<F> (&s) == EXIF_ENTRY_VALUE_OK, "span");
+	CHECK (s.size () == N_COMPONENTS, "span");
+	for (i = 0; i < s.size (); i++) {
+		CHECK ((long) s[i].numerator == v[2 * i], "span");
+		CHECK ((long) s[i].denominator == v[2 * i + 1], "span");
+	}
+}
+
+/* The span of a format the entry is not in, and of too little data */
+template <ExifFormat F> static void
+check_span_errors (ExifEntry *e, ExifFormat other)
+{
+	ExifEntrySpan<F> s;
+	unsigned int size = e->size;
+
+	CHECK (e->exif_entry_get_span<F> (&s) == EXIF_ENTRY_VALUE_OK, "span");
+	e->format = other;
+	CHECK (e->exif_entry_get_span<F> (&s) == EXIF_ENTRY_VALUE_WRONG_FORMAT,
+	       "span of another format");
+	e->format = F;
+	e->size = size - 1;
+	CHECK (e->exif_entry_get_span<F> (&s) == EXIF_ENTRY_VALUE_NO_DATA,
+	       "span of short data");
+	e->size = size;
+}
+
+/* The accessors that do not fit the format of the entry, reading past
+ * the last component, and reading with too little data */
+static void
+check_errors (ExifEntry *e)
+{
+	ExifLong u = 0;
+	ExifSLong s = 0;
+	ExifRational r;
+	ExifSRational sr;
+	double d = 0;
+	unsigned int size = e->size;
+	unsigned char *data = e->data;
+
+	switch (e->format) {
+	case EXIF_FORMAT_BYTE:
+	case EXIF_FORMAT_SHORT:
+	case EXIF_FORMAT_LONG:
+		CHECK (e->exif_entry_get_sint (0, &s) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "sint");
+		CHECK (e->exif_entry_get_rational (0, &r) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "rational");
+		CHECK (e->exif_entry_get_srational (0, &sr) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "srational");
+		CHECK (e->exif_entry_get_uint (N_COMPONENTS, &u) == EXIF_ENTRY_VALUE_OUT_OF_RANGE, "uint");
+		break;
+	case EXIF_FORMAT_SBYTE:
+	case EXIF_FORMAT_SSHORT:
+	case EXIF_FORMAT_SLONG:
+		CHECK (e->exif_entry_get_uint (0, &u) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "uint");
+		CHECK (e->exif_entry_get_rational (0, &r) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "rational");
+		CHECK (e->exif_entry_get_srational (0, &sr) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "srational");
+		CHECK (e->exif_entry_get_sint (N_COMPONENTS, &s) == EXIF_ENTRY_VALUE_OUT_OF_RANGE, "sint");
+		break;
+	case EXIF_FORMAT_RATIONAL:
+		CHECK (e->exif_entry_get_uint (0, &u) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "uint");
+		CHECK (e->exif_entry_get_sint (0, &s) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "sint");
+		CHECK (e->exif_entry_get_srational (0, &sr) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "srational");
+		CHECK (e->exif_entry_get_rational (N_COMPONENTS, &r) == EXIF_ENTRY_VALUE_OUT_OF_RANGE, "rational");
+		break;
+	case EXIF_FORMAT_SRATIONAL:
+		CHECK (e->exif_entry_get_uint (0, &u) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "uint");
+		CHECK (e->exif_entry_get_sint (0, &s) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "sint");
+		CHECK (e->exif_entry_get_rational (0, &r) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "rational");
+		CHECK (e->exif_entry_get_srational (N_COMPONENTS, &sr) == EXIF_ENTRY_VALUE_OUT_OF_RANGE, "srational");
+		break;
+	default:
+		break;
+	}
+	CHECK (e->exif_entry_get_double (N_COMPONENTS, &d) == EXIF_ENTRY_VALUE_OUT_OF_RANGE, "double");
+
+	/* One byte less than the components need; the first component
+	 * would still fit, but the entry as a whole is refused */
+	e->size = size - 1;
+	CHECK (e->exif_entry_get_double (0, &d) == EXIF_ENTRY_VALUE_NO_DATA, "double of short data");
+	e->size = size;
+	e->data = NULL;
+	CHECK (e->exif_entry_get_double (0, &d) == EXIF_ENTRY_VALUE_NO_DATA, "double without data");
+	e->data = data;
+}
+
+static void
+check_uint (ExifData *d, ExifFormat f, const long *v)
+{
+	ExifEntry *e = new_entry (d, f, v);
+	ExifLong u;
+	double x;
+	unsigned int i;
+
+	for (i = 0; i < N_COMPONENTS; i++) {
+		CHECK (e->exif_entry_get_uint (i, &u) == EXIF_ENTRY_VALUE_OK, "uint");
+		CHECK ((long) u == v[i], "uint");
+		CHECK (e->exif_entry_get_double (i, &x) == EXIF_ENTRY_VALUE_OK, "double");
+		CHECK (x == (double) v[i], "double");
+	}
+	check_errors (e);
+}
+
+static void
+check_sint (ExifData *d, ExifFormat f, const long *v)
+{
+	ExifEntry *e = new_entry (d, f, v);
+	ExifSLong s;
+	double x;
+	unsigned int i;
+
+	for (i = 0; i < N_COMPONENTS; i++) {
+		CHECK (e->exif_entry_get_sint (i, &s) == EXIF_ENTRY_VALUE_OK, "sint");
+		CHECK ((long) s == v[i], "sint");
+		CHECK (e->exif_entry_get_double (i, &x) == EXIF_ENTRY_VALUE_OK, "double");
+		CHECK (x == (double) v[i], "double");
+	}
+	check_errors (e);
+}
+
+static void
+check_order (ExifData *d)
+{
+	ExifEntry *e;
+	ExifRational r;
+	ExifSRational sr;
+	double x;
+	unsigned int i;
+	static const long zero_rational[] = {1, 0, 0, 0, 5, 0};
+
+	check_uint (d, EXIF_FORMAT_BYTE, byte_values);
+	check_uint (d, EXIF_FORMAT_SHORT, short_values);
+	check_uint (d, EXIF_FORMAT_LONG, long_values);
+	check_sint (d, EXIF_FORMAT_SBYTE, sbyte_values);
+	check_sint (d, EXIF_FORMAT_SSHORT, sshort_values);
+	check_sint (d, EXIF_FORMAT_SLONG, slong_values);
+
+	e = new_entry (d, EXIF_FORMAT_RATIONAL, rational_values);
+	for (i = 0; i < N_COMPONENTS; i++) {
+		CHECK (e->exif_entry_get_rational (i, &r) == EXIF_ENTRY_VALUE_OK, "rational");
+		CHECK ((long) r.numerator == rational_values[2 * i], "rational");
+		CHECK ((long) r.denominator == rational_values[2 * i + 1], "rational");
+		CHECK (e->exif_entry_get_double (i, &x) == EXIF_ENTRY_VALUE_OK, "double");
+		CHECK (x == (double) rational_values[2 * i] /
+			    (double) rational_values[2 * i + 1], "double");
+	}
+	check_errors (e);
+
+	e = new_entry (d, EXIF_FORMAT_SRATIONAL, srational_values);
+	for (i = 0; i < N_COMPONENTS; i++) {
+		CHECK (e->exif_entry_get_srational (i, &sr) == EXIF_ENTRY_VALUE_OK, "srational");
+		CHECK ((long) sr.numerator == srational_values[2 * i], "srational");
+		CHECK ((long) sr.denominator == srational_values[2 * i + 1], "srational");
+		CHECK (e->exif_entry_get_double (i, &x) == EXIF_ENTRY_VALUE_OK, "double");
+		CHECK (x == (double) srational_values[2 * i] /
+			    (double) srational_values[2 * i + 1], "double");
+	}
+	check_errors (e);
+
+	/* Rationals with a zero denominator have no value as a number */
+	e = new_entry (d, EXIF_FORMAT_RATIONAL, zero_rational);
+	for (i = 0; i < N_COMPONENTS; i++) {
+		CHECK (e->exif_entry_get_rational (i, &r) == EXIF_ENTRY_VALUE_OK, "rational");
+		CHECK (e->exif_entry_get_double (i, &x) == EXIF_ENTRY_VALUE_ZERO_DENOMINATOR,
+		       "double of x/0");
+	}
+	e = new_entry (d, EXIF_FORMAT_SRATIONAL, zero_rational);
+	CHECK (e->exif_entry_get_double (0, &x) == EXIF_ENTRY_VALUE_ZERO_DENOMINATOR,
+	       "double of x/0");
+
+	/* Formats that are not numbers */
+	e = new_entry (d, EXIF_FORMAT_UNDEFINED, byte_values);
+	CHECK (e->exif_entry_get_double (0, &x) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "double");
+	e = new_entry (d, EXIF_FORMAT_ASCII, byte_values);
+	CHECK (e->exif_entry_get_double (0, &x) == EXIF_ENTRY_VALUE_WRONG_FORMAT, "double");
+
+	/* Spans of each format */
+	e = new_entry (d, EXIF_FORMAT_BYTE, byte_values);
+	check_span<EXIF_FORMAT_BYTE> (e, byte_values);
+	check_span_errors<EXIF_FORMAT_BYTE> (e, EXIF_FORMAT_SBYTE);
+	e = new_entry (d, EXIF_FORMAT_SBYTE, sbyte_values);
+	check_span<EXIF_FORMAT_SBYTE> (e, sbyte_values);
+	check_span_errors<EXIF_FORMAT_SBYTE> (e, EXIF_FORMAT_BYTE);
+	e = new_entry (d, EXIF_FORMAT_SHORT, short_values);
+	check_span<EXIF_FORMAT_SHORT> (e, short_values);
+	check_span_errors<EXIF_FORMAT_SHORT> (e, EXIF_FORMAT_LONG);
+	e = new_entry (d, EXIF_FORMAT_SSHORT, sshort_values);
+	check_span<EXIF_FORMAT_SSHORT> (e, sshort_values);
+	check_span_errors<EXIF_FORMAT_SSHORT> (e, EXIF_FORMAT_SHORT);
+	e = new_entry (d, EXIF_FORMAT_LONG, long_values);
+	check_span<EXIF_FORMAT_LONG> (e, long_values);
+	check_span_errors<EXIF_FORMAT_LONG> (e, EXIF_FORMAT_SHORT);
+	e = new_entry (d, EXIF_FORMAT_SLONG, slong_values);
+	check_span<EXIF_FORMAT_SLONG> (e, slong_values);
+	check_span_errors<EXIF_FORMAT_SLONG> (e, EXIF_FORMAT_LONG);
+	e = new_entry (d, EXIF_FORMAT_RATIONAL, rational_values);
+	check_span_rational<EXIF_FORMAT_RATIONAL> (e, rational_values);
+	check_span_errors<EXIF_FORMAT_RATIONAL> (e, EXIF_FORMAT_SRATIONAL);
+	e = new_entry (d, EXIF_FORMAT_SRATIONAL, srational_values);
+	check_span_rational<EXIF_FORMAT_SRATIONAL> (e, srational_values);
+	check_span_errors<EXIF_FORMAT_SRATIONAL> (e, EXIF_FORMAT_RATIONAL);
+}
+
+int
+main ()
+{
+	ExifData d;
+	unsigned int i;
+
+	d.exif_data_new ();
+	for (i = 0; i < sizeof (orders) / sizeof (orders[0]); i++) {
+		d.exif_data_set_byte_order (orders[i]);
+		check_order (&d);
+	}
+
+	if (failed)
+		exit (1);
+	printf ("All values read as expected.\n");
+	return 0;
+}
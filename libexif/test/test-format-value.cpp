@@ -0,0 +1,202 @@
+/* test-format-value.cpp
+ *
+ * Checks the generic value formatting of exif_entry_format_value against
+ * known output, including output truncated to short buffers.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A test tag that has no formatter of its own */
+#define TEST_TAG ((ExifTag) 0xfff0)
+
+static const struct {
+	ExifByteOrder order;
+	ExifFormat format;
+	unsigned int components;
+	long values[20]; /* numerator and denominator for rationals */
+	const char *golden;
+} cases[] = {
+	{EXIF_BYTE_ORDER_INTEL, EXIF_FORMAT_SHORT, 5,
+	 {0, 1, 65535, 1234, 10},
+	 "0, 1, 65535, 1234, 10"},
+	{EXIF_BYTE_ORDER_MOTOROLA, EXIF_FORMAT_SHORT, 5,
+	 {0, 1, 65535, 1234, 10},
+	 "0, 1, 65535, 1234, 10"},
+	{EXIF_BYTE_ORDER_INTEL, EXIF_FORMAT_SSHORT, 4,
+	 {-1, 32767, -32768, 0},
+	 "-1, 32767, -32768, 0"},
+	{EXIF_BYTE_ORDER_MOTOROLA, EXIF_FORMAT_LONG, 3,
+	 {4294967295L, 0, 70000},
+	 "4294967295, 0, 70000"},
+	{EXIF_BYTE_ORDER_INTEL, EXIF_FORMAT_SLONG, 3,
+	 {-2147483647L - 1, 2147483647L, -5},
+	 "-2147483648, 2147483647, -5"},
+	{EXIF_BYTE_ORDER_INTEL, EXIF_FORMAT_BYTE, 4,
+	 {0x00, 0x0f, 0xff, 0xa0},
+	 "0x00, 0x0f, 0xff, 0xa0"},
+	{EXIF_BYTE_ORDER_MOTOROLA, EXIF_FORMAT_SBYTE, 2,
+	 {0x80, 0x01},
+	 "0x80, 0x01"},
+	{EXIF_BYTE_ORDER_INTEL, EXIF_FORMAT_RATIONAL, 9,
+	 {1, 0, 0, 1, 5, 1, 1, 2, 1, 12, 1, 13, 1, 120, 1, 121, 4294967295L, 1203},
+	 "1/0,  0,  5, 0.5, 0.1, 0.08, 0.01, 0.008, 3570213.8778"},
+	{EXIF_BYTE_ORDER_MOTOROLA, EXIF_FORMAT_RATIONAL, 3,
+	 {72, 1, 28, 10, 1, 3},
+	 "72, 2.8, 0.3"},
+	{EXIF_BYTE_ORDER_MOTOROLA, EXIF_FORMAT_SRATIONAL, 4,
+	 {-1, 3, 1, -3, -7, 0, 5, -2147483647L - 1},
+	 "-0.3, -0.3, -7/0, -0.0000000023"}
+};
+
+static ExifEntry *
+new_entry (ExifData *d, ExifFormat format, unsigned int components)
+{
+	ExifEntry en;
+	ExifEntry *e;
+	ExifContent *c = d->ifd[EXIF_IFD_0];
+
+	c->entries.clear ();
+	en.tag = TEST_TAG;
+	c->exif_content_add_entry (en);
+	e = &c->entries.back ();
+	e->format = format;
+	e->components = components;
+	e->size = exif_format_get_size (format) * components;
+	e->data = e->exif_entry_alloc (e->size);
+	return e;
+}
+
+static void
+set_value (ExifEntry *e, ExifByteOrder o, unsigned int i, const long *v)
+{
+	ExifRational r;
+	ExifSRational sr;
+
+	switch (e->format) {
+	case EXIF_FORMAT_BYTE:
+	case EXIF_FORMAT_SBYTE:
+		e->data[i] = (unsigned char) v[i];
+		break;
+	case EXIF_FORMAT_SHORT:
+		exif_set_short (e->data + 2 * i, o, (ExifShort) v[i]);
+		break;
+	case EXIF_FORMAT_SSHORT:
+		exif_set_sshort (e->data + 2 * i, o, (ExifSShort) v[i]);
+		break;
+	case EXIF_FORMAT_LONG:
+		exif_set_long (e->data + 4 * i, o, (ExifLong) v[i]);
+		break;
+	case EXIF_FORMAT_SLONG:
+		exif_set_slong (e->data + 4 * i, o, (ExifSLong) v[i]);
+		break;
+	case EXIF_FORMAT_RATIONAL:
+		r.numerator = (ExifLong) v[2 * i];
+		r.denominator = (ExifLong) v[2 * i + 1];
+		exif_set_rational (e->data + 8 * i, o, r);
+		break;
+	case EXIF_FORMAT_SRATIONAL:
+		sr.numerator = (ExifSLong) v[2 * i];
+		sr.denominator = (ExifSLong) v[2 * i + 1];
+		exif_set_srational (e->data + 8 * i, o, sr);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Format the entry into buffers of every length up to one more than the
+ * golden output needs, and check that each result is the golden output
+ * truncated to fit.
+ */
+static int
+check (ExifEntry *e, const char *golden, const char *name)
+{
+	char v[8192];
+	size_t len = strlen (golden), n, l;
+
+	for (n = 2; n <= len + 2 && n <= sizeof (v); n++) {
+		memset (v, 'X', sizeof (v));
+		v[0] = '\0';
+		e->exif_entry_format_value (v, n - 1);
+		l = (len < n - 1) ? len : n - 1;
+		if (strlen (v) != l || strncmp (v, golden, l)) {
+			printf ("%s: buffer of %u bytes gives '%s', expected "
+				"'%.*s'\n", name, (unsigned) n, v, (int) l, golden);
+			return 1;
+		}
+		/* ASCII is copied with strncpy, which pads the buffer */
+		if ((e->format != EXIF_FORMAT_ASCII) && (v[l + 1] != 'X')) {
+			printf ("%s: buffer of %u bytes written past the "
+				"terminating NUL\n", name, (unsigned) n);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int
+main ()
+{
+	ExifData d;
+	ExifEntry *e;
+	unsigned int i, j;
+	char name[64], golden[8192];
+	int failed = 0;
+
+	d.exif_data_new ();
+
+	for (i = 0; i < sizeof (cases) / sizeof (cases[0]); i++) {
+		d.exif_data_set_byte_order (cases[i].order);
+		e = new_entry (&d, cases[i].format, cases[i].components);
+		for (j = 0; j < cases[i].components; j++)
+			set_value (e, cases[i].order, j, cases[i].values);
+		sprintf (name, "case %u (%s)", i,
+			 exif_format_get_name (cases[i].format));
+		failed |= check (e, cases[i].golden, name);
+	}
+
+	/* A long SHORT array, as found in TransferFunction */
+	e = new_entry (&d, EXIF_FORMAT_SHORT, 768);
+	golden[0] = '\0';
+	for (j = 0; j < 768; j++) {
+		exif_set_short (e->data + 2 * j, d.exif_data_get_byte_order (),
+				(ExifShort) (j * 85));
+		sprintf (golden + strlen (golden), j ? ", %u" : "%u", j * 85);
+	}
+	failed |= check (e, golden, "TransferFunction");
+
+	/* Formats that are not printed element by element */
+	e = new_entry (&d, EXIF_FORMAT_UNDEFINED, 7);
+	failed |= check (e, "7 bytes undefined data", "UNDEFINED");
+	e = new_entry (&d, EXIF_FORMAT_FLOAT, 1);
+	failed |= check (e, "4 bytes unsupported data type", "FLOAT");
+	e = new_entry (&d, EXIF_FORMAT_ASCII, 10);
+	memcpy (e->data, "Canon EOS", 10);
+	failed |= check (e, "Canon EOS", "ASCII");
+
+	if (failed)
+		exit (1);
+	printf ("All values formatted as expected.\n");
+	return 0;
+}
@@ -0,0 +1,181 @@
+/* test-formatter.cpp
+ *
+ * Checks the registry of exif_entry_set_formatter: an installed formatter
+ * prints the values of its tag in exif_entry_get_value, can wrap the
+ * built-in one, and the built-in behaviour comes back when it is removed.
+ * The registry holds at most 255 formatters.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-entry.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A test tag that has no formatter of its own */
+#define TEST_TAG ((ExifTag) 0xfff0)
+
+/* Tags for filling the registry, on pages without any known tag */
+#define FILL_TAG 0xf100
+#define FILL_COUNT 300
+
+static int failed = 0;
+
+/* The formatter that has been replaced, and its data */
+typedef struct {
+	ExifEntryFormatterFunc func;
+	void *user_data;
+} Wrapped;
+
+/* Print the value of the wrapped formatter in brackets */
+static void
+format_wrapped (ExifEntry *e, char *val, unsigned int maxlen, void *user_data)
+{
+	Wrapped *w = (Wrapped *) user_data;
+	char v[256];
+
+	memset (v, 0, sizeof (v));
+	w->func (e, v, sizeof (v) - 1, w->user_data);
+	snprintf (val, maxlen + 1, "[%s]", v);
+}
+
+static void
+format_fixed (ExifEntry *, char *val, unsigned int maxlen, void *user_data)
+{
+	strncpy (val, (const char *) user_data, maxlen);
+}
+
+static void
+check_value (const char *name, ExifEntry *e, const char *expected)
+{
+	char v[256];
+
+	e->exif_entry_get_value (v, sizeof (v));
+	if (strcmp (v, expected)) {
+		printf ("%s: '%s', expected '%s'\n", name, v, expected);
+		failed = 1;
+	}
+}
+
+static void
+check_formatter (const char *name, ExifTag tag, ExifEntryFormatterFunc func,
+		 void *user_data)
+{
+	void *d;
+
+	if ((exif_entry_get_formatter (tag, &d) != func) || (d != user_data)) {
+		printf ("%s: another formatter is installed\n", name);
+		failed = 1;
+	}
+}
+
+int
+main ()
+{
+	char v[256], generic[256], fixed[] = "A fixed value";
+	ExifEntry *o, *t;
+	unsigned int i, n;
+	ExifData d;
+	Wrapped w;
+
+	d.exif_data_new ();
+	o = test_add_entry (&d, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	t = test_add_value (&d, EXIF_IFD_EXIF, TEST_TAG, EXIF_FORMAT_ASCII,
+			    fixed, 4);
+
+	/* Wrap the built-in formatter of a tag */
+	w.func = exif_entry_get_formatter (EXIF_TAG_ORIENTATION, &w.user_data);
+	if (!w.func) {
+		printf ("The Orientation has no built-in formatter\n");
+		exit (1);
+	}
+	o->exif_entry_get_value (v, sizeof (v));
+	if (!exif_entry_set_formatter (EXIF_TAG_ORIENTATION, format_wrapped, &w)) {
+		printf ("The formatter has not been installed\n");
+		exit (1);
+	}
+	check_formatter ("Installed", EXIF_TAG_ORIENTATION, format_wrapped, &w);
+	sprintf (generic, "[%s]", v);
+	check_value ("Installed", o, generic);
+
+	/* The formatter is held to the buffer */
+	memset (generic, 'X', sizeof (generic));
+	o->exif_entry_get_value (generic, 4);
+	if ((generic[0] != '[') || (strlen (generic) != 3) ||
+	    (generic[4] != 'X')) {
+		printf ("Installed: the buffer has been overrun\n");
+		failed = 1;
+	}
+
+	/* Restored */
+	exif_entry_set_formatter (EXIF_TAG_ORIENTATION, NULL, NULL);
+	check_formatter ("Restored", EXIF_TAG_ORIENTATION, w.func, w.user_data);
+	check_value ("Restored", o, v);
+
+	/* A tag without a built-in formatter */
+	t->exif_entry_format_value (generic, sizeof (generic) - 1);
+	check_formatter ("Unknown tag", TEST_TAG, NULL, NULL);
+	exif_entry_set_formatter (TEST_TAG, format_fixed, fixed);
+	check_value ("Unknown tag, installed", t, fixed);
+	exif_entry_set_formatter (TEST_TAG, NULL, NULL);
+	check_formatter ("Unknown tag, removed", TEST_TAG, NULL, NULL);
+	check_value ("Unknown tag, removed", t, generic);
+
+	/* Fill the registry; the tags that have a slot keep it */
+	for (n = 0; n < FILL_COUNT; n++)
+		if (!exif_entry_set_formatter ((ExifTag) (FILL_TAG + n),
+					       format_fixed, fixed))
+			break;
+	if ((n == FILL_COUNT) || (n > 255)) {
+		printf ("%u formatters installed\n", n);
+		failed = 1;
+	}
+	for (i = n; i < FILL_COUNT; i++)
+		if (exif_entry_set_formatter ((ExifTag) (FILL_TAG + i),
+					      format_fixed, fixed) ||
+		    exif_entry_get_formatter ((ExifTag) (FILL_TAG + i), NULL)) {
+			printf ("Formatter %u installed in a full registry\n",
+				i);
+			failed = 1;
+			break;
+		}
+	for (i = 0; i < n; i++)
+		if (exif_entry_get_formatter ((ExifTag) (FILL_TAG + i), NULL) !=
+		    format_fixed) {
+			printf ("Formatter %u has been lost\n", i);
+			failed = 1;
+			break;
+		}
+	if (!exif_entry_set_formatter (EXIF_TAG_ORIENTATION, format_wrapped, &w) ||
+	    !exif_entry_set_formatter (TEST_TAG, format_fixed, fixed)) {
+		printf ("A formatter has not been replaced in a full "
+			"registry\n");
+		failed = 1;
+	}
+	check_value ("Full registry", t, fixed);
+
+	d.exif_data_free ();
+
+	if (failed)
+		exit (1);
+	printf ("Formatters installed and restored as expected.\n");
+	return 0;
+}
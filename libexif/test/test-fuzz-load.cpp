@@ -0,0 +1,341 @@
+/* test-fuzz-load.cpp
+ *
+ * Loads randomly corrupted copies of synthetic EXIF data, each in a heap
+ * buffer of exactly its own size, and prints every value that was
+ * loaded. Run under a memory checker (e.g. AddressSanitizer or valgrind)
+ * any read outside the buffer is reported.
+ *
+ * Built with -DLIBEXIF_FUZZER, the file instead provides the entry point
+ * for libFuzzer and compatible fuzzers.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of corrupted copies loaded per seed */
+#define ITERATIONS 2000
+
+/* Layout of the synthetic data, as offsets from the TIFF header */
+#define IFD_0       8
+#define IFD_EXIF    64
+#define IFD_INTEROP 128
+#define IFD_GPS     160
+#define IFD_1       208
+#define DATA        256
+
+typedef enum {
+	MNOTE_NONE,
+	MNOTE_CANON,
+	MNOTE_OLYMPUS,
+	MNOTE_PENTAX,
+	MNOTE_FUJI
+} MnoteType;
+
+typedef struct {
+	unsigned char d[2048];
+	unsigned int size;	/* Bytes used, including the "Exif" header */
+	ExifByteOrder order;
+} Blob;
+
+/* Pointer to an offset from the TIFF header */
+#define T(b,o) ((b)->d + 6 + (o))
+
+/* Append n bytes to the data area, keeping values word aligned */
+static unsigned int
+append (Blob *b, const void *v, unsigned int n)
+{
+	unsigned int o = b->size - 6;
+
+	memcpy (T (b, o), v, n);
+	b->size += n + (n & 1);
+	return o;
+}
+
+/* Write entry i of the directory at ifd. Values longer than 4 bytes go
+ * to the data area, and their offset is taken relative to base. */
+static void
+entry (Blob *b, unsigned int ifd, unsigned int i, unsigned int tag,
+       ExifFormat f, unsigned int components, const void *v,
+       unsigned int base)
+{
+	unsigned char *e = T (b, ifd + 2 + 12 * i);
+	unsigned int s = exif_format_get_size (f) * components;
+
+	exif_set_short (e, b->order, (ExifShort) tag);
+	exif_set_short (e + 2, b->order, (ExifShort) f);
+	exif_set_long (e + 4, b->order, components);
+	if (s > 4)
+		exif_set_long (e + 8, b->order, append (b, v, s) - base);
+	else
+		memcpy (e + 8, v, s);
+}
+
+static void
+entry_long (Blob *b, unsigned int ifd, unsigned int i, unsigned int tag,
+	    ExifLong value)
+{
+	unsigned char v[4];
+
+	exif_set_long (v, b->order, value);
+	entry (b, ifd, i, tag, EXIF_FORMAT_LONG, 1, v, 0);
+}
+
+static void
+directory (Blob *b, unsigned int ifd, unsigned int n, unsigned int next)
+{
+	exif_set_short (T (b, ifd), b->order, (ExifShort) n);
+	exif_set_long (T (b, ifd + 2 + 12 * n), b->order, next);
+}
+
+/* A maker note directory at the end of the data area, with values
+ * relative to base */
+static void
+mnote_directory (Blob *b, unsigned int base, unsigned int tag_base)
+{
+	unsigned int ifd = b->size - 6, i;
+	unsigned char s[8];
+
+	b->size += 2 + 3 * 12 + 4;
+	for (i = 0; i < 4; i++)
+		exif_set_short (s + 2 * i, b->order, (ExifShort) (i + 1));
+	directory (b, ifd, 3, 0);
+	entry (b, ifd, 0, tag_base + 0x01, EXIF_FORMAT_SHORT, 4, s, base);
+	entry (b, ifd, 1, tag_base + 0x06, EXIF_FORMAT_ASCII, 10, "IMG:EOS 5", base);
+	exif_set_long (s, b->order, 123456);
+	entry (b, ifd, 2, tag_base + 0x08, EXIF_FORMAT_LONG, 1, s, base);
+}
+
+/* Build the maker note in the data area and return its size */
+static unsigned int
+mnote (Blob *b, MnoteType type)
+{
+	unsigned int start = b->size - 6;
+	ExifByteOrder o = b->order;
+
+	switch (type) {
+	case MNOTE_CANON:
+		mnote_directory (b, 0, 0);
+		break;
+	case MNOTE_OLYMPUS:
+		append (b, b->order == EXIF_BYTE_ORDER_INTEL ?
+			"OLYMP\0\1\0" : "OLYMP\0\0\1", 8);
+		mnote_directory (b, 0, 0);
+		break;
+	case MNOTE_PENTAX:
+		append (b, b->order == EXIF_BYTE_ORDER_INTEL ?
+			"AOC\0II" : "AOC\0MM", 6);
+		mnote_directory (b, 0, 0);
+		break;
+	case MNOTE_FUJI:
+		/* Always Intel, with offsets relative to the maker note */
+		b->order = EXIF_BYTE_ORDER_INTEL;
+		append (b, "FUJIFILM\x0c\0\0\0", 12);
+		mnote_directory (b, start, 0);
+		b->order = o;
+		break;
+	default:
+		append (b, "unknown maker note", 18);
+		break;
+	}
+	return b->size - 6 - start;
+}
+
+static void
+build (Blob *b, ExifByteOrder order, MnoteType type)
+{
+	unsigned char v[32];
+	unsigned int mo, ms;
+	ExifRational r;
+
+	memset (b, 0, sizeof (Blob));
+	b->order = order;
+	b->size = 6 + DATA;
+	memcpy (b->d, "Exif\0\0", 6);
+	memcpy (T (b, 0), (order == EXIF_BYTE_ORDER_INTEL) ? "II" : "MM", 2);
+	exif_set_short (T (b, 2), order, 0x002a);
+	exif_set_long (T (b, 4), order, IFD_0);
+
+	directory (b, IFD_0, 3, IFD_1);
+	entry (b, IFD_0, 0, EXIF_TAG_MAKE, EXIF_FORMAT_ASCII, 6,
+	       (type == MNOTE_CANON) ? "Canon" : "Other", 0);
+	entry_long (b, IFD_0, 1, EXIF_TAG_EXIF_IFD_POINTER, IFD_EXIF);
+	entry_long (b, IFD_0, 2, EXIF_TAG_GPS_INFO_IFD_POINTER, IFD_GPS);
+
+	mo = b->size - 6;
+	ms = mnote (b, type);
+	directory (b, IFD_EXIF, 4, 0);
+	exif_set_short (T (b, IFD_EXIF + 2), order, EXIF_TAG_MAKER_NOTE);
+	exif_set_short (T (b, IFD_EXIF + 4), order, EXIF_FORMAT_UNDEFINED);
+	exif_set_long (T (b, IFD_EXIF + 6), order, ms);
+	exif_set_long (T (b, IFD_EXIF + 10), order, mo);
+	r.numerator = 1;
+	r.denominator = 125;
+	exif_set_rational (v, order, r);
+	entry (b, IFD_EXIF, 1, EXIF_TAG_EXPOSURE_TIME, EXIF_FORMAT_RATIONAL, 1, v, 0);
+	entry (b, IFD_EXIF, 2, EXIF_TAG_USER_COMMENT, EXIF_FORMAT_UNDEFINED, 16,
+	       "ASCII\0\0\0comment\0", 0);
+	entry_long (b, IFD_EXIF, 3, EXIF_TAG_INTEROPERABILITY_IFD_POINTER,
+		    IFD_INTEROP);
+
+	directory (b, IFD_INTEROP, 1, 0);
+	entry (b, IFD_INTEROP, 0, EXIF_TAG_INTEROPERABILITY_INDEX,
+	       EXIF_FORMAT_ASCII, 4, "R98", 0);
+
+	directory (b, IFD_GPS, 3, 0);
+	entry (b, IFD_GPS, 0, EXIF_TAG_GPS_VERSION_ID, EXIF_FORMAT_BYTE, 4,
+	       "\2\2\0\0", 0);
+	entry (b, IFD_GPS, 1, EXIF_TAG_GPS_LATITUDE_REF, EXIF_FORMAT_ASCII, 2,
+	       "N", 0);
+	for (mo = 0; mo < 3; mo++) {
+		r.numerator = 10 * mo + 7;
+		r.denominator = mo + 1;
+		exif_set_rational (v + 8 * mo, order, r);
+	}
+	entry (b, IFD_GPS, 2, EXIF_TAG_GPS_LATITUDE, EXIF_FORMAT_RATIONAL, 3, v, 0);
+
+	directory (b, IFD_1, 2, 0);
+	entry_long (b, IFD_1, 0, EXIF_TAG_JPEG_INTERCHANGE_FORMAT, b->size - 6);
+	append (b, "\xff\xd8 thumbnail \xff\xd9", 15);
+	entry_long (b, IFD_1, 1, EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH, 15);
+}
+
+/* Load the data and format every value found */
+static void
+load (const unsigned char *data, unsigned int size)
+{
+	ExifData d;
+	ExifMnoteData *md;
+	char v[1024];
+	unsigned int i, j;
+
+	d.exif_data_new_from_data (data, size);
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		for (j = 0; j < d.ifd[i]->entries.size (); j++)
+			d.ifd[i]->entries[j].exif_entry_get_value (v, sizeof (v));
+	}
+	md = d.exif_data_get_mnote_data ();
+	if (md) {
+		for (i = 0; i < md->exif_mnote_data_count (); i++) {
+			md->exif_mnote_data_get_name (i);
+			md->exif_mnote_data_get_value (i, v, sizeof (v));
+		}
+	}
+}
+
+#ifdef LIBEXIF_FUZZER
+
+extern "C" int
+LLVMFuzzerTestOneInput (const unsigned char *data, size_t size)
+{
+	if (size <= 0xffff)
+		load (data, (unsigned int) size);
+	return 0;
+}
+
+#else
+
+static unsigned long state = 1;
+
+static unsigned int
+next (unsigned int n)
+{
+	state = state * 1103515245UL + 12345UL;
+	return (unsigned int) ((state >> 16) & 0x7fff) % n;
+}
+
+/* Corrupt a few bytes of the data after the "Exif" header, or cut it
+ * short, and return the new size */
+static unsigned int
+mutate (unsigned char *d, unsigned int size, ExifByteOrder order)
+{
+	static const ExifLong values[] = {
+		0, 1, 2, 4, 5, 0x7f, 0x80, 0xff, 0x100, 0x7fff, 0xfffe,
+		0xffff, 0x10000, 0x7fffffff, 0xfffffff4, 0xffffffff
+	};
+	unsigned int i, n = 1 + next (4), o;
+
+	for (i = 0; i < n; i++) {
+		o = 6 + next (size - 6);
+		switch (next (4)) {
+		case 0:
+			d[o] = (unsigned char) next (0x100);
+			break;
+		case 1:
+			d[o] ^= (unsigned char) (1 << next (8));
+			break;
+		default:
+			if (o + 4 > size)
+				o = size - 4;
+			exif_set_long (d + o, order,
+				values[next (sizeof (values) / sizeof (values[0]))]);
+			break;
+		}
+	}
+	if (!next (8))
+		size = 6 + next (size - 6);
+	return size;
+}
+
+int
+main ()
+{
+	static const ExifByteOrder orders[] = {
+		EXIF_BYTE_ORDER_INTEL, EXIF_BYTE_ORDER_MOTOROLA
+	};
+	Blob b;
+	unsigned char *d;
+	unsigned int i, m, o, size;
+
+	for (m = MNOTE_NONE; m <= MNOTE_FUJI; m++) {
+		for (o = 0; o < 2; o++) {
+			build (&b, orders[o], (MnoteType) m);
+
+			/* The intact data must load */
+			d = new unsigned char[b.size];
+			memcpy (d, b.d, b.size);
+			load (d, b.size);
+			delete [] d;
+
+			for (i = 0; i < ITERATIONS; i++) {
+				d = new unsigned char[b.size];
+				memcpy (d, b.d, b.size);
+				size = mutate (d, b.size, orders[o]);
+
+				/* Copy to a buffer of the new size, so that
+				 * reads past its end are caught */
+				if (size < b.size) {
+					unsigned char *t = new unsigned char[size];
+					memcpy (t, d, size);
+					delete [] d;
+					d = t;
+				}
+				load (d, size);
+				delete [] d;
+			}
+		}
+	}
+	printf ("Loaded %u corrupted copies of the data.\n",
+		(MNOTE_FUJI + 1) * 2 * ITERATIONS);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,59 @@
+/* test-helpers.h
+ *
+ * Building EXIF data entry by entry, for the tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#ifndef __TEST_HELPERS_H__
+#define __TEST_HELPERS_H__
+
+#include <libexif/exif-data.h>
+
+#include <string.h>
+
+/* Add an entry with the default value of tag to an IFD of d */
+inline ExifEntry *
+test_add_entry (ExifData *d, ExifIfd ifd, ExifTag tag)
+{
+	ExifEntry en (d->ifd[ifd]);
+
+	en.priv.mem = &d->priv.mem;
+	en.exif_entry_initialize (tag);
+	d->ifd[ifd]->exif_content_add_entry (en);
+	return d->ifd[ifd]->exif_content_get_entry (tag);
+}
+
+/* Add an entry holding a copy of the size bytes at v to an IFD of d */
+inline ExifEntry *
+test_add_value (ExifData *d, ExifIfd ifd, ExifTag tag, ExifFormat format,
+		const void *v, unsigned int size)
+{
+	ExifEntry en (d->ifd[ifd]);
+
+	en.priv.mem = &d->priv.mem;
+	en.priv.order = d->exif_data_get_byte_order ();
+	en.tag = tag;
+	en.format = format;
+	en.components = size / exif_format_get_size (format);
+	en.size = size;
+	en.data = en.exif_entry_alloc (size);
+	memcpy (en.data, v, size);
+	d->ifd[ifd]->exif_content_add_entry (en);
+	return d->ifd[ifd]->exif_content_get_entry (tag);
+}
+
+#endif /* __TEST_HELPERS_H__ */
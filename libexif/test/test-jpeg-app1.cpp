@@ -0,0 +1,266 @@
+/* test-jpeg-app1.cpp
+ *
+ * Checks that exif_jpeg_replace_app1_file replaces the EXIF data of a
+ * JPEG file, inserts it into a file without one and drops it, copying
+ * everything else byte for byte, and that it refuses files that are no
+ * JPEG files.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-jpeg.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+#define FILE_APPEND "test-jpeg-app1.out"
+
+static const char artist[] = "Old artist";
+static const char new_artist[] = "A new artist";
+
+/* SOI marker and a JFIF APP0 segment, which stay in front of the APP1
+ * segment */
+static const unsigned char head[] = {
+	0xff, 0xd8,
+	0xff, 0xe0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+	0x01, 0x02, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+};
+
+static int failed = 0;
+
+/* Save EXIF data holding the Artist v */
+static void
+make_exif (const char *v, std::vector<unsigned char> *b)
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+	ExifData data;
+
+	data.exif_data_new ();
+	data.exif_data_set_byte_order (EXIF_BYTE_ORDER_INTEL);
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			v, (unsigned int) strlen (v) + 1);
+	data.exif_data_save_data (&d, &ds);
+	data.exif_data_free ();
+	b->assign (d, d + ds);
+	delete [] d;
+}
+
+/* Append an APP1 segment holding the EXIF data e */
+static void
+append_app1 (std::vector<unsigned char> *b, const std::vector<unsigned char> &e)
+{
+	b->push_back (0xff);
+	b->push_back (0xe1);
+	b->push_back ((unsigned char) ((e.size () + 2) >> 8));
+	b->push_back ((unsigned char) (e.size () + 2));
+	b->insert (b->end (), e.begin (), e.end ());
+}
+
+/* Image data after the EXIF data, larger than one buffer of copy_range:
+ * a DQT segment, the SOS marker, scan data and the EOI marker */
+static void
+make_image (std::vector<unsigned char> *b)
+{
+	static const unsigned char dqt[] = {
+		0xff, 0xdb, 0x00, 0x06, 0x00, 0x01, 0x02, 0x03,
+		0xff, 0xda, 0x00, 0x02
+	};
+	unsigned int i;
+
+	b->assign (dqt, dqt + sizeof (dqt));
+	for (i = 0; i < 10000; i++)
+		b->push_back ((unsigned char) (i % 0xff));
+	b->push_back (0xff);
+	b->push_back (0xd9);
+}
+
+static FILE *
+open_with (const std::vector<unsigned char> &b)
+{
+	FILE *f = tmpfile ();
+
+	if (!f || (b.size () && (fwrite (&b[0], 1, b.size (), f) != b.size ()))) {
+		printf ("No temporary file could be written\n");
+		exit (1);
+	}
+	rewind (f);
+	return f;
+}
+
+static void
+read_all (FILE *f, std::vector<unsigned char> *b)
+{
+	unsigned char c[4096];
+	size_t l;
+
+	b->clear ();
+	rewind (f);
+	while ((l = fread (c, 1, sizeof (c), f)) > 0)
+		b->insert (b->end (), c, c + l);
+}
+
+/* Run exif_jpeg_replace_app1_file on src and compare its output to
+ * expected, once into a temporary file and, where the kernel would copy
+ * the image data, once into a file it cannot copy to */
+static void
+check_replace (const char *name, const std::vector<unsigned char> &src,
+	       const std::vector<unsigned char> *e,
+	       const std::vector<unsigned char> &expected)
+{
+	std::vector<unsigned char> r;
+	FILE *s = open_with (src), *dst = tmpfile ();
+	const unsigned char *d = e ? &(*e)[0] : NULL;
+	unsigned int ds = e ? (unsigned int) e->size () : 0;
+
+	if (!dst || !exif_jpeg_replace_app1_file (s, dst, d, ds)) {
+		printf ("%s: the file has not been copied\n", name);
+		failed = 1;
+	} else {
+		read_all (dst, &r);
+		if (r != expected) {
+			printf ("%s: %u bytes copied, not as expected\n", name,
+				(unsigned int) r.size ());
+			failed = 1;
+		}
+	}
+	if (dst)
+		fclose (dst);
+
+#ifndef _WIN32
+	/* sendfile() refuses to write to a file opened for appending */
+	{
+		int fd = open (FILE_APPEND, O_RDWR | O_CREAT | O_TRUNC | O_APPEND,
+			       0600);
+
+		dst = (fd < 0) ? NULL : fdopen (fd, "a+b");
+		if (!dst || !exif_jpeg_replace_app1_file (s, dst, d, ds)) {
+			printf ("%s: the file has not been copied in "
+				"chunks\n", name);
+			failed = 1;
+		} else {
+			read_all (dst, &r);
+			if (r != expected) {
+				printf ("%s: %u bytes copied in chunks, not as "
+					"expected\n", name,
+					(unsigned int) r.size ());
+				failed = 1;
+			}
+		}
+		if (dst)
+			fclose (dst);
+		remove (FILE_APPEND);
+	}
+#endif
+	fclose (s);
+}
+
+/* Check the range exif_jpeg_find_app1_range_file finds in src */
+static void
+check_range (const char *name, const std::vector<unsigned char> &src,
+	     long start, long end)
+{
+	FILE *s = open_with (src);
+	long rs, re;
+
+	if (!exif_jpeg_find_app1_range_file (s, &rs, &re) ||
+	    (rs != start) || (re != end)) {
+		printf ("%s: range not found at %li to %li\n", name, start, end);
+		failed = 1;
+	}
+	fclose (s);
+}
+
+/* Check that exif_jpeg_replace_app1_file refuses to copy src with the
+ * EXIF data e, and that no range is found in src if no_range is set */
+static void
+check_refused (const char *name, const std::vector<unsigned char> &src,
+	       const std::vector<unsigned char> &e, int no_range)
+{
+	FILE *s = open_with (src), *dst = tmpfile ();
+	long start, end;
+
+	if (exif_jpeg_replace_app1_file (s, dst, &e[0],
+					 (unsigned int) e.size ()) ||
+	    (no_range && exif_jpeg_find_app1_range_file (s, &start, &end))) {
+		printf ("%s: the file has not been refused\n", name);
+		failed = 1;
+	}
+	fclose (dst);
+	fclose (s);
+}
+
+int
+main ()
+{
+	std::vector<unsigned char> e, ne, image, with, without, expected, bad;
+
+	make_exif (artist, &e);
+	make_exif (new_artist, &ne);
+	make_image (&image);
+
+	with.assign (head, head + sizeof (head));
+	append_app1 (&with, e);
+	with.insert (with.end (), image.begin (), image.end ());
+
+	without.assign (head, head + sizeof (head));
+	without.insert (without.end (), image.begin (), image.end ());
+
+	check_range ("With EXIF data", with, sizeof (head),
+		     (long) (sizeof (head) + 4 + e.size ()));
+	check_range ("Without EXIF data", without, sizeof (head),
+		     sizeof (head));
+
+	/* Replacing the EXIF data keeps what comes before and after */
+	expected.assign (head, head + sizeof (head));
+	append_app1 (&expected, ne);
+	expected.insert (expected.end (), image.begin (), image.end ());
+	check_replace ("Replaced", with, &ne, expected);
+
+	/* It is inserted after the APP0 segment */
+	check_replace ("Inserted", without, &ne, expected);
+
+	/* And dropped */
+	check_replace ("Dropped", with, NULL, without);
+
+	/* EXIF data without its header is refused */
+	bad.assign (ne.begin () + 6, ne.end ());
+	check_refused ("EXIF data without header", with, bad, 0);
+
+	/* As are files that do not start with the SOI marker */
+	bad = with;
+	bad[1] = 0xd9;
+	check_refused ("Invalid SOI marker", bad, ne, 1);
+	bad.assign (with.begin () + 2, with.end ());
+	check_refused ("Missing SOI marker", bad, ne, 1);
+	bad.clear ();
+	check_refused ("Empty file", bad, ne, 1);
+
+	if (failed)
+		exit (1);
+	printf ("APP1 segments replaced as expected.\n");
+	return 0;
+}
@@ -0,0 +1,237 @@
+/* test-jpeg-thumbnail.cpp
+ *
+ * Checks that the thumbnail found in a JPEG file in memory and in a file
+ * is the one saved with the EXIF data, and that it is written in full
+ * both when the kernel copies it and when it is copied in chunks.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-jpeg.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+#define FILE_APPEND "test-jpeg-thumbnail.out"
+
+/* More than one chunk of exif_jpeg_write_thumbnail_file */
+#define THUMBNAIL_SIZE 10000
+
+static int failed = 0;
+
+/* Chunks received by collect */
+typedef struct {
+	std::vector<unsigned char> d;
+	unsigned int chunks;
+	unsigned int stop_after;
+} Collected;
+
+static int
+collect (const unsigned char *d, unsigned int ds, void *user_data)
+{
+	Collected *c = (Collected *) user_data;
+
+	if (!ds || (ds > 4096)) {
+		printf ("A chunk of %u bytes has been passed\n", ds);
+		failed = 1;
+	}
+	c->d.insert (c->d.end (), d, d + ds);
+	return ++c->chunks != c->stop_after;
+}
+
+/* A JPEG file with EXIF data holding the thumbnail t, if it is not
+ * empty */
+static void
+make_jpeg (ExifByteOrder o, const std::vector<unsigned char> &t,
+	   std::vector<unsigned char> *b)
+{
+	static const unsigned char image[] = {
+		0xff, 0xda, 0x00, 0x02, 0x12, 0x34, 0xff, 0xd9
+	};
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+	ExifData data;
+
+	data.exif_data_new ();
+	data.exif_data_set_byte_order (o);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_EXIF, EXIF_TAG_COLOR_SPACE);
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+	if (t.size ()) {
+		data.size = (unsigned int) t.size ();
+		data.data = new unsigned char[data.size];
+		memcpy (data.data, &t[0], data.size);
+	}
+	data.exif_data_save_data (&d, &ds);
+	data.exif_data_free ();
+
+	b->clear ();
+	b->push_back (0xff);
+	b->push_back (0xd8);
+	b->push_back (0xff);
+	b->push_back (0xe1);
+	b->push_back ((unsigned char) ((ds + 2) >> 8));
+	b->push_back ((unsigned char) (ds + 2));
+	b->insert (b->end (), d, d + ds);
+	b->insert (b->end (), image, image + sizeof (image));
+	delete [] d;
+}
+
+static FILE *
+open_with (const std::vector<unsigned char> &b)
+{
+	FILE *f = tmpfile ();
+
+	if (!f || (fwrite (&b[0], 1, b.size (), f) != b.size ())) {
+		printf ("No temporary file could be written\n");
+		exit (1);
+	}
+	rewind (f);
+	return f;
+}
+
+#ifndef _WIN32
+/* Write the thumbnail of f to the descriptor fd and compare what it has
+ * received to t */
+static void
+check_fd (const char *name, FILE *f, int fd, const std::vector<unsigned char> &t)
+{
+	std::vector<unsigned char> r (t.size () + 1);
+	ssize_t l;
+
+	if ((fd < 0) || !exif_jpeg_write_thumbnail_fd (f, fd)) {
+		printf ("%s: the thumbnail has not been written\n", name);
+		failed = 1;
+		return;
+	}
+	l = pread (fd, &r[0], r.size (), 0);
+	if ((l != (ssize_t) t.size ()) || memcmp (&r[0], &t[0], t.size ())) {
+		printf ("%s: %li bytes written, not the thumbnail\n", name,
+			(long) l);
+		failed = 1;
+	}
+}
+#endif
+
+static void
+check (ExifByteOrder o)
+{
+	const char *name = exif_byte_order_get_name (o);
+	std::vector<unsigned char> t, b;
+	unsigned int offset, size, i;
+	Collected c;
+	long fo;
+	FILE *f;
+
+	for (i = 0; i < THUMBNAIL_SIZE; i++)
+		t.push_back ((unsigned char) (i % 251));
+	make_jpeg (o, t, &b);
+
+	/* In memory */
+	if (!exif_jpeg_find_thumbnail (&b[0], (unsigned int) b.size (),
+				       &offset, &size) ||
+	    (size != t.size ()) || memcmp (&b[offset], &t[0], size)) {
+		printf ("%s: the thumbnail has not been found in memory\n",
+			name);
+		failed = 1;
+	}
+
+	/* In a file */
+	f = open_with (b);
+	if (!exif_jpeg_find_thumbnail_file (f, &fo, &size) ||
+	    (fo != (long) offset) || (size != t.size ())) {
+		printf ("%s: the thumbnail has not been found in the file\n",
+			name);
+		failed = 1;
+	}
+
+	/* Passed in chunks, and stopped when the function asks to */
+	c.chunks = 0;
+	c.stop_after = 0;
+	if (!exif_jpeg_write_thumbnail_file (f, collect, &c) || (c.d != t)) {
+		printf ("%s: the thumbnail has not been passed\n", name);
+		failed = 1;
+	}
+	c.d.clear ();
+	c.chunks = 0;
+	c.stop_after = 1;
+	if (exif_jpeg_write_thumbnail_file (f, collect, &c) || (c.chunks != 1)) {
+		printf ("%s: passing the thumbnail has not stopped\n", name);
+		failed = 1;
+	}
+
+#ifndef _WIN32
+	/* Copied by the kernel into a regular file */
+	{
+		FILE *dst = tmpfile ();
+
+		check_fd (name, f, dst ? fileno (dst) : -1, t);
+		if (dst)
+			fclose (dst);
+	}
+
+	/* sendfile() refuses to write to a file opened for appending, so
+	 * the thumbnail is copied in chunks */
+	{
+		int fd = open (FILE_APPEND, O_RDWR | O_CREAT | O_TRUNC | O_APPEND,
+			       0600);
+
+		check_fd (name, f, fd, t);
+		if (fd >= 0)
+			close (fd);
+		remove (FILE_APPEND);
+	}
+#endif
+	fclose (f);
+
+	/* Without a thumbnail, nothing is found or written */
+	t.clear ();
+	make_jpeg (o, t, &b);
+	f = open_with (b);
+	c.d.clear ();
+	c.chunks = 0;
+	c.stop_after = 0;
+	if (exif_jpeg_find_thumbnail (&b[0], (unsigned int) b.size (),
+				      &offset, &size) ||
+	    exif_jpeg_write_thumbnail_file (f, collect, &c) || c.chunks) {
+		printf ("%s: a thumbnail has been found where there is "
+			"none\n", name);
+		failed = 1;
+	}
+	fclose (f);
+}
+
+int
+main ()
+{
+	check (EXIF_BYTE_ORDER_INTEL);
+	check (EXIF_BYTE_ORDER_MOTOROLA);
+
+	if (failed)
+		exit (1);
+	printf ("Thumbnails found and written as expected.\n");
+	return 0;
+}
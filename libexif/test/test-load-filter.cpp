@@ -0,0 +1,230 @@
+/* test-load-filter.cpp
+ *
+ * Checks the calls to the load filter and what is kept of the data: all
+ * of it when the filter accepts it or never decides, none of it when it
+ * rejects it, in which case the MakerNote is not interpreted either.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static const char make[] = "Canon";
+
+static int failed = 0;
+
+/* Number of MakerNotes identified, from the debug messages */
+static unsigned int identified = 0;
+
+static void
+log_func (ExifLogCode, const char *, const char *format, va_list, void *)
+{
+	if (strstr (format, "MakerNote variant"))
+		identified++;
+}
+
+/* One call to the filter: the IFD and the tag, or -1 before an IFD */
+typedef struct {
+	ExifIfd ifd;
+	int tag;
+} FilterCall;
+
+/* Calls to the filter and the decision it takes at call number at */
+typedef struct {
+	std::vector<FilterCall> calls;
+	unsigned int at;
+	ExifDataFilterResult decision;
+} Filter;
+
+static ExifDataFilterResult
+filter (ExifData *, ExifIfd ifd, const ExifEntry *e, void *user_data)
+{
+	Filter *f = (Filter *) user_data;
+	FilterCall c;
+
+	c.ifd = ifd;
+	c.tag = e ? (int) e->tag : -1;
+	f->calls.push_back (c);
+	return (f->calls.size () == f->at) ? f->decision
+					   : EXIF_DATA_FILTER_UNDECIDED;
+}
+
+/* EXIF data with entries in IFD 0, the EXIF IFD and IFD 1, a Canon
+ * MakerNote and a thumbnail */
+static void
+make_data (ExifByteOrder o, unsigned char **d, unsigned int *ds)
+{
+	unsigned char m[18];
+	ExifData data;
+	unsigned int i;
+
+	/* One LONG entry, then no next IFD */
+	exif_set_short (m, o, 1);
+	exif_set_short (m + 2, o, 0x8);
+	exif_set_short (m + 4, o, EXIF_FORMAT_LONG);
+	exif_set_long (m + 6, o, 1);
+	exif_set_long (m + 10, o, 1234);
+	exif_set_long (m + 14, o, 0);
+
+	data.exif_data_new ();
+	data.exif_data_set_byte_order (o);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_MAKE, EXIF_FORMAT_ASCII,
+			make, sizeof (make));
+	test_add_entry (&data, EXIF_IFD_EXIF, EXIF_TAG_COLOR_SPACE);
+	test_add_value (&data, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE,
+			EXIF_FORMAT_UNDEFINED, m, sizeof (m));
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+
+	data.size = 100;
+	data.data = new unsigned char[data.size];
+	for (i = 0; i < data.size; i++)
+		data.data[i] = (unsigned char) i;
+
+	data.exif_data_save_data (d, ds);
+	data.exif_data_free ();
+}
+
+static unsigned int
+count_entries (ExifData *data)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		n += (unsigned int) data->ifd[i]->entries.size ();
+	return n;
+}
+
+/* Load d with a filter deciding at call number at, and check the result
+ * of the filter, the number of calls to it and whether all the data has
+ * been kept or none of it */
+static void
+check (const char *name, const unsigned char *d, unsigned int ds,
+       unsigned int at, ExifDataFilterResult decision,
+       unsigned int n_calls, ExifDataFilterResult result, unsigned int n)
+{
+	unsigned int ts;
+	ExifData data;
+	Filter f;
+
+	f.at = at;
+	f.decision = decision;
+	identified = 0;
+	data.exif_data_new ();
+	data.exif_data_unset_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	data.exif_data_get_log ()->exif_log_set_func (log_func, NULL);
+	data.exif_data_set_load_filter (filter, &f);
+	data.exif_data_load_data (d, ds);
+
+	if (data.exif_data_get_filter_result () != result) {
+		printf ("%s: result %i, expected %i\n", name,
+			data.exif_data_get_filter_result (), result);
+		failed = 1;
+	}
+	if (f.calls.size () != n_calls) {
+		printf ("%s: %u calls to the filter, expected %u\n", name,
+			(unsigned int) f.calls.size (), n_calls);
+		failed = 1;
+	}
+	if (count_entries (&data) != n) {
+		printf ("%s: %u entries kept, expected %u\n", name,
+			count_entries (&data), n);
+		failed = 1;
+	}
+	if (n && (!data.exif_data_get_thumbnail (&ts) ||
+		  !data.exif_data_get_mnote_data () || (identified != 1))) {
+		printf ("%s: the thumbnail or the MakerNote is missing\n", name);
+		failed = 1;
+	}
+	if (!n && (data.exif_data_get_thumbnail (&ts) ||
+		   data.exif_data_get_mnote_data () || identified)) {
+		printf ("%s: the thumbnail or the MakerNote has been loaded\n",
+			name);
+		failed = 1;
+	}
+	data.exif_data_free ();
+}
+
+int
+main ()
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0, n, i;
+	std::vector<FilterCall> calls;
+	ExifData data;
+	Filter f;
+
+	make_data (EXIF_BYTE_ORDER_INTEL, &d, &ds);
+
+	/* Never decided: called with every entry, and before the EXIF IFD
+	 * and IFD 1, and everything is loaded */
+	f.at = 0;
+	f.decision = EXIF_DATA_FILTER_UNDECIDED;
+	data.exif_data_new ();
+	data.exif_data_unset_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	data.exif_data_set_load_filter (filter, &f);
+	data.exif_data_load_data (d, ds);
+	n = count_entries (&data);
+	calls = f.calls;
+	data.exif_data_free ();
+	if ((n != 5) || (calls.size () != n + 2)) {
+		printf ("%u entries loaded, %u calls to the filter\n", n,
+			(unsigned int) calls.size ());
+		exit (1);
+	}
+	for (i = 0; i < calls.size (); i++)
+		if ((calls[i].tag < 0) && (calls[i].ifd == EXIF_IFD_0)) {
+			printf ("Call %u is before IFD 0\n", i);
+			failed = 1;
+		}
+	check ("Undecided", d, ds, 0, EXIF_DATA_FILTER_UNDECIDED,
+	       n + 2, EXIF_DATA_FILTER_UNDECIDED, n);
+
+	/* Accepted: not called again */
+	check ("Accepted at the first entry", d, ds, 1, EXIF_DATA_FILTER_ACCEPT,
+	       1, EXIF_DATA_FILTER_ACCEPT, n);
+	check ("Accepted at the last call", d, ds, n + 2,
+	       EXIF_DATA_FILTER_ACCEPT, n + 2, EXIF_DATA_FILTER_ACCEPT, n);
+
+	/* Rejected: not called again, and nothing is kept */
+	check ("Rejected at the first entry", d, ds, 1, EXIF_DATA_FILTER_REJECT,
+	       1, EXIF_DATA_FILTER_REJECT, 0);
+	for (i = 0; i < calls.size (); i++)
+		if (calls[i].tag < 0) {
+			check ("Rejected before an IFD", d, ds, i + 1,
+			       EXIF_DATA_FILTER_REJECT, i + 1,
+			       EXIF_DATA_FILTER_REJECT, 0);
+			break;
+		}
+	/* After the MakerNote has been loaded */
+	check ("Rejected at the last call", d, ds, n + 2,
+	       EXIF_DATA_FILTER_REJECT, n + 2, EXIF_DATA_FILTER_REJECT, 0);
+
+	delete [] d;
+
+	if (failed)
+		exit (1);
+	printf ("Load filters applied as expected.\n");
+	return 0;
+}
@@ -0,0 +1,230 @@
+/* test-mem-counting.cpp
+ *
+ * Checks that the counting allocator of exif_data_set_counting sees
+ * every allocation and free of the data, that they balance once the
+ * data is freed, that the peak is tracked, and that the allocator it
+ * counts for is the one that has been set.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-mem.h>
+#include <libexif/exif-utils.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THUMBNAIL_SIZE 500
+
+static const char make[] = "Canon";
+static const char artist[] = "An artist with a long name";
+
+static int failed = 0;
+
+/* Blocks handed out and given back by the allocator below */
+typedef struct {
+	unsigned long allocations;
+	unsigned long frees;
+} Blocks;
+
+static void *
+blocks_alloc (unsigned int ds, void *user_data)
+{
+	((Blocks *) user_data)->allocations++;
+	return malloc (ds);
+}
+
+static void
+blocks_free (void *p, void *user_data)
+{
+	((Blocks *) user_data)->frees++;
+	free (p);
+}
+
+/* EXIF data with a Canon MakerNote and a thumbnail */
+static void
+make_data (unsigned char **d, unsigned int *ds)
+{
+	ExifByteOrder o = EXIF_BYTE_ORDER_INTEL;
+	unsigned char m[18];
+	ExifData data;
+	unsigned int i;
+
+	/* One LONG entry, then no next IFD */
+	exif_set_short (m, o, 1);
+	exif_set_short (m + 2, o, 0x8);
+	exif_set_short (m + 4, o, EXIF_FORMAT_LONG);
+	exif_set_long (m + 6, o, 1);
+	exif_set_long (m + 10, o, 1234);
+	exif_set_long (m + 14, o, 0);
+
+	data.exif_data_new ();
+	data.exif_data_set_byte_order (o);
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_MAKE, EXIF_FORMAT_ASCII,
+			make, sizeof (make));
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			artist, sizeof (artist));
+	test_add_value (&data, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE,
+			EXIF_FORMAT_UNDEFINED, m, sizeof (m));
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+
+	data.size = THUMBNAIL_SIZE;
+	data.data = new unsigned char[data.size];
+	for (i = 0; i < data.size; i++)
+		data.data[i] = (unsigned char) i;
+
+	data.exif_data_save_data (d, ds);
+	data.exif_data_free ();
+}
+
+/* Check that everything counted has been freed again */
+static void
+check_balanced (const char *name, const ExifMemStats *s)
+{
+	if (!s->allocations || (s->allocations != s->frees) || s->current) {
+		printf ("%s: %lu allocations, %lu frees, %lu bytes held\n",
+			name, s->allocations, s->frees, s->current);
+		failed = 1;
+	}
+}
+
+/* Load, save and free the data, counting with the default allocator */
+static void
+check_default (const unsigned char *d, unsigned int ds)
+{
+	const char *name = "Default allocator";
+	unsigned char *s = NULL;
+	unsigned int ss = 0;
+	unsigned long held;
+	ExifMemStats stats;
+	ExifData data;
+
+	data.exif_data_new ();
+	data.exif_data_set_counting (&stats);
+	data.exif_data_load_data (d, ds);
+	if (!data.exif_data_get_mnote_data () ||
+	    (stats.current < THUMBNAIL_SIZE + sizeof (artist)) ||
+	    (stats.bytes < stats.current) || (stats.peak < stats.current)) {
+		printf ("%s: %lu bytes allocated, %lu held, %lu at most\n", name,
+			stats.bytes, stats.current, stats.peak);
+		failed = 1;
+	}
+	held = stats.current;
+
+	/* The saved buffer comes from the allocator as well */
+	data.exif_data_save_data (&s, &ss);
+	if (!s || (stats.current < held + ss)) {
+		printf ("%s: the saved buffer has not been counted\n", name);
+		failed = 1;
+	}
+	data.priv.mem.exif_mem_free (&s);
+	if (stats.current > held + ss) {
+		printf ("%s: %lu bytes held after saving, %lu before\n", name,
+			stats.current, held);
+		failed = 1;
+	}
+
+	/* A restart keeps what is held as the peak */
+	stats.exif_mem_stats_restart ();
+	if (stats.allocations || stats.frees || stats.bytes ||
+	    (stats.peak != stats.current)) {
+		printf ("%s: the stats have not been restarted\n", name);
+		failed = 1;
+	}
+	data.exif_data_reset ();
+	data.exif_data_load_data (d, ds);
+	if (stats.peak < held) {
+		printf ("%s: peak %lu after the restart, %lu held before\n",
+			name, stats.peak, held);
+		failed = 1;
+	}
+
+	data.exif_data_free ();
+	if (stats.current) {
+		printf ("%s: %lu bytes held after freeing\n", name,
+			stats.current);
+		failed = 1;
+	}
+	if (stats.peak < held) {
+		printf ("%s: the peak has been lost\n", name);
+		failed = 1;
+	}
+}
+
+/* Count for an allocator that has been set, also when counting twice */
+static void
+check_allocator (const unsigned char *d, unsigned int ds)
+{
+	const char *name = "Allocator";
+	ExifMemStats stats, again;
+	ExifData data;
+	Blocks b;
+
+	b.allocations = 0;
+	b.frees = 0;
+	data.exif_data_new ();
+	data.exif_data_set_allocator (blocks_alloc, blocks_free, &b);
+	data.exif_data_set_counting (&stats);
+	data.exif_data_load_data (d, ds);
+	data.exif_data_free ();
+	check_balanced (name, &stats);
+	if ((b.allocations != stats.allocations) || (b.frees != stats.frees)) {
+		printf ("%s: %lu allocations and %lu frees, %lu and %lu "
+			"counted\n", name, b.allocations, b.frees,
+			stats.allocations, stats.frees);
+		failed = 1;
+	}
+
+	/* Counting anew counts for the same allocator, not for the
+	 * counting one */
+	b.allocations = 0;
+	b.frees = 0;
+	data.exif_data_new ();
+	data.exif_data_set_allocator (blocks_alloc, blocks_free, &b);
+	data.exif_data_set_counting (&stats);
+	data.exif_data_set_counting (&again);
+	data.exif_data_load_data (d, ds);
+	data.exif_data_free ();
+	check_balanced ("Counting twice", &again);
+	if ((b.allocations != again.allocations) || stats.allocations ||
+	    (again.alloc_func != blocks_alloc)) {
+		printf ("Counting twice: %lu allocations, %lu and %lu "
+			"counted\n", b.allocations, stats.allocations,
+			again.allocations);
+		failed = 1;
+	}
+}
+
+int
+main ()
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+
+	make_data (&d, &ds);
+	check_default (d, ds);
+	check_allocator (d, ds);
+	delete [] d;
+
+	if (failed)
+		exit (1);
+	printf ("Allocations counted as expected.\n");
+	return 0;
+}
@@ -0,0 +1,211 @@
+/* test-memory-usage.cpp
+ *
+ * Checks that exif_data_memory_usage follows the values, the thumbnail
+ * and the MakerNote as they are added, loaded, referenced and freed,
+ * and that its total is the sum of its parts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THUMBNAIL_SIZE 500
+
+static const char make[] = "Canon";
+static const char artist[] = "An artist with a long name";
+static const char comment[] = "ASCII\0\0\0A comment";
+
+static int failed = 0;
+
+/* Get the usage of data and check that the total adds up */
+static void
+usage_get (const char *name, ExifData *data, ExifDataMemoryUsage *u)
+{
+	unsigned long sum;
+	unsigned int i;
+
+	data->exif_data_memory_usage (u);
+	sum = u->thumbnail + u->containers + u->kept;
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		sum += u->entries[i];
+	for (i = 0; i < EXIF_MNOTE_VENDOR_COUNT; i++)
+		sum += u->mnote[i];
+	if (u->total != sum) {
+		printf ("%s: total %lu, the parts add up to %lu\n", name,
+			u->total, sum);
+		failed = 1;
+	}
+}
+
+static void
+check_value (const char *name, const char *what, unsigned long v,
+	     unsigned long expected)
+{
+	if (v != expected) {
+		printf ("%s: %lu bytes of %s, expected %lu\n", name, v, what,
+			expected);
+		failed = 1;
+	}
+}
+
+/* EXIF data with a Canon MakerNote and a thumbnail */
+static void
+make_data (unsigned char **d, unsigned int *ds)
+{
+	ExifByteOrder o = EXIF_BYTE_ORDER_INTEL;
+	unsigned char m[18];
+	ExifData data;
+	unsigned int i;
+
+	/* One LONG entry, then no next IFD */
+	exif_set_short (m, o, 1);
+	exif_set_short (m + 2, o, 0x8);
+	exif_set_short (m + 4, o, EXIF_FORMAT_LONG);
+	exif_set_long (m + 6, o, 1);
+	exif_set_long (m + 10, o, 1234);
+	exif_set_long (m + 14, o, 0);
+
+	data.exif_data_new ();
+	data.exif_data_set_byte_order (o);
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_MAKE, EXIF_FORMAT_ASCII,
+			make, sizeof (make));
+	test_add_value (&data, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE,
+			EXIF_FORMAT_UNDEFINED, m, sizeof (m));
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+
+	data.size = THUMBNAIL_SIZE;
+	data.data = new unsigned char[data.size];
+	for (i = 0; i < data.size; i++)
+		data.data[i] = (unsigned char) i;
+
+	data.exif_data_save_data (d, ds);
+	data.exif_data_free ();
+}
+
+/* Entries added and removed by hand */
+static void
+check_entries ()
+{
+	const char *name = "Entries";
+	ExifDataMemoryUsage u, v;
+	ExifData data;
+	unsigned int i;
+
+	data.exif_data_new ();
+	usage_get (name, &data, &u);
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		check_value (name, exif_ifd_get_name ((ExifIfd) i),
+			     u.entries[i], 0);
+	check_value (name, "the thumbnail", u.thumbnail, 0);
+	if (u.containers < sizeof (ExifData)) {
+		printf ("%s: the containers take %lu bytes\n", name,
+			u.containers);
+		failed = 1;
+	}
+
+	test_add_value (&data, EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			artist, sizeof (artist));
+	test_add_value (&data, EXIF_IFD_EXIF, EXIF_TAG_USER_COMMENT,
+			EXIF_FORMAT_UNDEFINED, comment, sizeof (comment));
+	usage_get (name, &data, &v);
+	check_value (name, "IFD 0", v.entries[EXIF_IFD_0], sizeof (artist));
+	check_value (name, "the EXIF IFD", v.entries[EXIF_IFD_EXIF],
+		     sizeof (comment));
+	if (v.containers < u.containers) {
+		printf ("%s: the containers have shrunk\n", name);
+		failed = 1;
+	}
+
+	data.ifd[EXIF_IFD_0]->exif_content_remove_entry (0);
+	usage_get (name, &data, &u);
+	check_value (name, "IFD 0 after the removal", u.entries[EXIF_IFD_0], 0);
+	check_value (name, "the EXIF IFD after the removal",
+		     u.entries[EXIF_IFD_EXIF], sizeof (comment));
+
+	data.exif_data_free ();
+	usage_get (name, &data, &u);
+	check_value (name, "values after freeing", u.total - u.containers, 0);
+}
+
+/* Loaded data, with the thumbnail copied or referenced */
+static void
+check_loaded (const unsigned char *d, unsigned int ds)
+{
+	const char *name = "Loaded";
+	ExifDataMemoryUsage u;
+	ExifData data;
+	unsigned long n;
+
+	data.exif_data_new ();
+	data.exif_data_unset_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	data.exif_data_load_data (d, ds);
+	usage_get (name, &data, &u);
+	check_value (name, "the thumbnail", u.thumbnail, THUMBNAIL_SIZE);
+	check_value (name, "IFD 0", u.entries[EXIF_IFD_0], sizeof (make));
+	check_value (name, "the EXIF IFD", u.entries[EXIF_IFD_EXIF], 18);
+	check_value (name, "IFD 1", u.entries[EXIF_IFD_1], 8);
+	if (!u.mnote[EXIF_MNOTE_VENDOR_CANON]) {
+		printf ("%s: the Canon MakerNote is not counted\n", name);
+		failed = 1;
+	}
+	n = u.total;
+
+	/* Reset, the values are kept for the next load */
+	data.exif_data_reset ();
+	usage_get (name, &data, &u);
+	check_value (name, "the thumbnail after the reset", u.thumbnail, 0);
+	check_value (name, "the MakerNote after the reset",
+		     u.mnote[EXIF_MNOTE_VENDOR_CANON], 0);
+	if (!u.kept || (u.total > n)) {
+		printf ("%s: %lu bytes kept of %lu\n", name, u.kept, n);
+		failed = 1;
+	}
+
+	/* A referenced thumbnail is counted once it has been copied */
+	data.exif_data_set_option (EXIF_DATA_OPTION_REFERENCE_THUMBNAIL);
+	data.exif_data_load_data (d, ds);
+	usage_get (name, &data, &u);
+	check_value (name, "the referenced thumbnail", u.thumbnail, 0);
+	data.exif_data_get_thumbnail (NULL);
+	usage_get (name, &data, &u);
+	check_value (name, "the copied thumbnail", u.thumbnail, THUMBNAIL_SIZE);
+
+	data.exif_data_free ();
+}
+
+int
+main ()
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+
+	make_data (&d, &ds);
+	check_entries ();
+	check_loaded (d, ds);
+	delete [] d;
+
+	if (failed)
+		exit (1);
+	printf ("Memory usage counted as expected.\n");
+	return 0;
+}
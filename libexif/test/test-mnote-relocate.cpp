@@ -0,0 +1,332 @@
+/* test-mnote-relocate.cpp
+ *
+ * Checks that an unchanged MakerNote is saved as loaded, with its offsets
+ * moved to where it ends up, and that one with a value outside of it is
+ * saved anew. Canon and Pentax MakerNotes are built in both byte orders,
+ * saved at two offsets and loaded again.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_VALUES 16
+#define VALUE_SIZE 256
+
+static const char image_type[] = "Test image type";
+static const char description[] = "A description that moves the MakerNote";
+
+/* Tags of the built MakerNotes, as stored */
+typedef struct {
+	const char *name;
+	const char *make;
+	ExifMnoteVendor vendor;
+	unsigned int ascii, number, shorts, outside;
+} Vendor;
+
+static const Vendor vendors[] = {
+	{"Canon", "Canon", EXIF_MNOTE_VENDOR_CANON, 0x6, 0x8, 0x2, 0x7},
+	{"Pentax", "PENTAX Corporation", EXIF_MNOTE_VENDOR_PENTAX,
+	 0x200, 0x5, 0x201, 0x202}
+};
+
+/* Counts the MakerNotes that have been saved as loaded */
+static unsigned int kept = 0;
+
+static void
+log_func (ExifLogCode, const char *, const char *format, va_list, void *)
+{
+	if (strstr (format, "MakerNote as loaded"))
+		kept++;
+}
+
+static void
+set_ifd_entry (unsigned char *b, ExifByteOrder o, unsigned int tag,
+	       ExifFormat format, unsigned int n, unsigned int value)
+{
+	exif_set_short (b, o, (ExifShort) tag);
+	exif_set_short (b + 2, o, (ExifShort) format);
+	exif_set_long (b + 4, o, n);
+	exif_set_long (b + 8, o, value);
+}
+
+/*
+ * Build a MakerNote that will be saved at offset mo from the TIFF header.
+ * Its values follow the directory, except that of the "outside" tag,
+ * which is at offset outside, if that is not 0.
+ */
+static unsigned int
+build_mnote (unsigned char *m, const Vendor *v, ExifByteOrder o,
+	     unsigned int mo, unsigned int outside, unsigned int outside_size)
+{
+	unsigned int h = 0, n = outside ? 4 : 3, p, i;
+
+	if (v->vendor == EXIF_MNOTE_VENDOR_PENTAX) {
+		memcpy (m, (o == EXIF_BYTE_ORDER_INTEL) ? "AOC\0II" : "AOC\0MM", 6);
+		h = 6;
+	}
+	exif_set_short (m + h, o, (ExifShort) n);
+	p = h + 2 + 12 * n + 4;
+	exif_set_long (m + p - 4, o, 0);
+
+	set_ifd_entry (m + h + 2, o, v->ascii, EXIF_FORMAT_ASCII,
+		       sizeof (image_type), mo + p);
+	memcpy (m + p, image_type, sizeof (image_type));
+	p += sizeof (image_type);
+
+	/* Fits into the entry and has no offset */
+	set_ifd_entry (m + h + 2 + 12, o, v->number, EXIF_FORMAT_LONG, 1, 1234);
+
+	set_ifd_entry (m + h + 2 + 24, o, v->shorts, EXIF_FORMAT_SHORT, 3, mo + p);
+	for (i = 0; i < 3; i++)
+		exif_set_short (m + p + 2 * i, o, (ExifShort) (100 * (i + 1)));
+	p += 6;
+
+	if (outside)
+		set_ifd_entry (m + h + 2 + 36, o, v->outside, EXIF_FORMAT_ASCII,
+			       outside_size, outside);
+	return p;
+}
+
+static void
+new_data (ExifData *d)
+{
+	d->exif_data_new ();
+	d->exif_data_unset_option (EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	d->exif_data_get_log ()->exif_log_set_func (log_func, NULL);
+}
+
+static void
+load (ExifData *d, const unsigned char *b, unsigned int bs)
+{
+	new_data (d);
+	d->exif_data_load_data (b, bs);
+}
+
+/* Offset of the value of a loaded entry from the TIFF header */
+static unsigned int
+value_offset (ExifData *d, ExifIfd ifd, ExifTag tag)
+{
+	ExifEntry *e = d->ifd[ifd]->exif_content_get_entry (tag);
+
+	return e ? d->exif_data_get_entry_offset (e) - d->priv.offset_tiff : 0;
+}
+
+/* Build and save EXIF data whose MakerNote has valid offsets */
+static void
+make_data (const Vendor *v, ExifByteOrder o, int with_outside,
+	   unsigned char **b, unsigned int *bs)
+{
+	unsigned char m[512];
+	unsigned int ms, mo = 0, outside = 0, pass;
+	ExifData d, l;
+
+	/* The first pass finds where the MakerNote and the Make are saved;
+	 * the sizes stay the same, so the second pass saves them there */
+	for (pass = 0; pass < 2; pass++) {
+		new_data (&d);
+		d.exif_data_set_byte_order (o);
+		test_add_value (&d, EXIF_IFD_0, EXIF_TAG_MAKE, EXIF_FORMAT_ASCII,
+				v->make, strlen (v->make) + 1);
+		ms = build_mnote (m, v, o, mo, with_outside ? (outside ? outside : 1) : 0,
+				  strlen (v->make) + 1);
+		test_add_value (&d, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE,
+				EXIF_FORMAT_UNDEFINED, m, ms);
+		if (*b)
+			delete [] *b;
+		*b = NULL;
+		*bs = 0;
+		d.exif_data_save_data (b, bs);
+		d.exif_data_free ();
+
+		load (&l, *b, *bs);
+		mo = value_offset (&l, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE);
+		outside = value_offset (&l, EXIF_IFD_0, EXIF_TAG_MAKE);
+		l.exif_data_free ();
+	}
+}
+
+/* The values of the interpreted MakerNote */
+static unsigned int
+get_values (ExifData *d, char v[MAX_VALUES][VALUE_SIZE])
+{
+	ExifMnoteData *md = d->exif_data_get_mnote_data ();
+	unsigned int i, n;
+
+	if (!md)
+		return 0;
+	n = md->exif_mnote_data_count ();
+	if (n > MAX_VALUES)
+		n = MAX_VALUES;
+	for (i = 0; i < n; i++) {
+		v[i][0] = '\0';
+		md->exif_mnote_data_get_value (i, v[i], VALUE_SIZE);
+	}
+	return n;
+}
+
+/* Load the saved data and compare its MakerNote to the original one */
+static int
+check_reload (const char *name, const unsigned char *b, unsigned int bs,
+	      unsigned int n0, char v0[MAX_VALUES][VALUE_SIZE])
+{
+	char v[MAX_VALUES][VALUE_SIZE];
+	unsigned int n, i;
+	ExifData d;
+	int failed = 0;
+
+	load (&d, b, bs);
+	n = get_values (&d, v);
+	if (n != n0) {
+		printf ("%s: %u MakerNote values after saving, expected %u\n",
+			name, n, n0);
+		failed = 1;
+	}
+	for (i = 0; (i < n) && (i < n0); i++)
+		if (strcmp (v[i], v0[i])) {
+			printf ("%s: MakerNote value %u is '%s' after saving, "
+				"expected '%s'\n", name, i, v[i], v0[i]);
+			failed = 1;
+		}
+	d.exif_data_free ();
+	return failed;
+}
+
+static int
+check (const Vendor *v, ExifByteOrder o)
+{
+	char v0[MAX_VALUES][VALUE_SIZE], name[64];
+	unsigned char *b = NULL, *b2 = NULL, *b3 = NULL, *raw;
+	unsigned int bs = 0, bs2 = 0, bs3 = 0, n0, i, k, mo, mo3;
+	ExifData d;
+	ExifEntry *e;
+	int failed = 0, found;
+
+	sprintf (name, "%s (%s)", v->name, exif_byte_order_get_name (o));
+
+	/* All values within the MakerNote */
+	make_data (v, o, 0, &b, &bs);
+	load (&d, b, bs);
+	n0 = get_values (&d, v0);
+	if (!d.exif_data_get_mnote_data () ||
+	    (d.exif_data_get_mnote_data ()->exif_mnote_data_get_vendor () != v->vendor)) {
+		printf ("%s: the MakerNote has not been interpreted\n", name);
+		exit (1);
+	}
+	for (i = 0, found = 0; i < n0; i++)
+		found |= !strcmp (v0[i], image_type);
+	if (!found) {
+		printf ("%s: the MakerNote values have not been loaded\n", name);
+		failed = 1;
+	}
+
+	/* Saved where it has been loaded from */
+	k = kept;
+	d.exif_data_save_data (&b2, &bs2);
+	if (kept != k + 1) {
+		printf ("%s: the unchanged MakerNote has not been kept\n", name);
+		failed = 1;
+	}
+	failed |= check_reload (name, b2, bs2, n0, v0);
+
+	/* Saved further on */
+	test_add_value (&d, EXIF_IFD_0, EXIF_TAG_IMAGE_DESCRIPTION, EXIF_FORMAT_ASCII,
+			description, sizeof (description));
+	k = kept;
+	d.exif_data_save_data (&b3, &bs3);
+	if (kept != k + 1) {
+		printf ("%s: the moved MakerNote has not been kept\n", name);
+		failed = 1;
+	}
+	d.exif_data_free ();
+	load (&d, b2, bs2);
+	mo = value_offset (&d, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE);
+	d.exif_data_free ();
+	load (&d, b3, bs3);
+	mo3 = value_offset (&d, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE);
+	d.exif_data_free ();
+	if (mo == mo3) {
+		printf ("%s: the MakerNote has not been moved\n", name);
+		failed = 1;
+	}
+	failed |= check_reload (name, b3, bs3, n0, v0);
+	delete [] b;
+	delete [] b2;
+	delete [] b3;
+	b = b2 = b3 = NULL;
+	bs = bs2 = bs3 = 0;
+
+	/* A value outside of the MakerNote, which would not move with it */
+	make_data (v, o, 1, &b, &bs);
+	load (&d, b, bs);
+	n0 = get_values (&d, v0);
+	for (i = 0, found = 0; i < n0; i++)
+		found |= !strcmp (v0[i], v->make);
+	if (!found) {
+		printf ("%s: the MakerNote value outside of it has not been "
+			"loaded\n", name);
+		failed = 1;
+	}
+	e = d.ifd[EXIF_IFD_EXIF]->exif_content_get_entry (EXIF_TAG_MAKER_NOTE);
+	raw = new unsigned char[e->size];
+	memcpy (raw, e->data, e->size);
+	mo = value_offset (&d, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE);
+	if (d.exif_data_get_mnote_data ()->exif_mnote_data_relocate (raw, e->size,
+								     mo + 16) ||
+	    memcmp (raw, e->data, e->size)) {
+		printf ("%s: the MakerNote with a value outside of it has "
+			"been relocated\n", name);
+		failed = 1;
+	}
+	delete [] raw;
+
+	k = kept;
+	d.exif_data_save_data (&b2, &bs2);
+	if (kept != k) {
+		printf ("%s: the MakerNote with a value outside of it has "
+			"been kept\n", name);
+		failed = 1;
+	}
+	d.exif_data_free ();
+	failed |= check_reload (name, b2, bs2, n0, v0);
+	delete [] b;
+	delete [] b2;
+	return failed;
+}
+
+int
+main ()
+{
+	unsigned int i;
+	int failed = 0;
+
+	for (i = 0; i < sizeof (vendors) / sizeof (vendors[0]); i++) {
+		failed |= check (&vendors[i], EXIF_BYTE_ORDER_INTEL);
+		failed |= check (&vendors[i], EXIF_BYTE_ORDER_MOTOROLA);
+	}
+
+	if (failed)
+		exit (1);
+	printf ("MakerNotes saved and loaded again as expected.\n");
+	return 0;
+}
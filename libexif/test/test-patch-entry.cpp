@@ -0,0 +1,234 @@
+/* test-patch-entry.cpp
+ *
+ * Checks that exif_data_patch_entry and exif_data_patch_entry_file write
+ * a changed value over the loaded one, in a buffer and in a JPEG file,
+ * and that they refuse values whose size or byte order has changed and
+ * entries that have not been loaded.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FILE "test-patch-entry.jpg"
+
+/* The scan data of the written JPEG file, which must not change */
+static const unsigned char image[] = {
+	0xff, 0xda, 0x00, 0x02, 0x12, 0x34, 0x56, 0x78, 0xff, 0xd9
+};
+
+static int failed = 0;
+
+/* Build EXIF data in byte order o, starting with the EXIF header */
+static void
+make_data (ExifByteOrder o, unsigned char **d, unsigned int *ds)
+{
+	ExifData data;
+
+	data.exif_data_new ();
+	data.exif_data_set_byte_order (o);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_Y_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	test_add_entry (&data, EXIF_IFD_EXIF, EXIF_TAG_COLOR_SPACE);
+	data.exif_data_save_data (d, ds);
+}
+
+/* Wrap EXIF data into a JPEG file: SOI, APP1 and the scan */
+static int
+write_jpeg (const char *path, const unsigned char *d, unsigned int ds)
+{
+	unsigned char h[6] = {0xff, 0xd8, 0xff, 0xe1, 0, 0};
+	FILE *f = fopen (path, "wb");
+
+	if (!f)
+		return 0;
+	h[4] = (unsigned char) ((ds + 2) >> 8);
+	h[5] = (unsigned char) (ds + 2);
+	fwrite (h, 1, sizeof (h), f);
+	fwrite (d, 1, ds, f);
+	fwrite (image, 1, sizeof (image), f);
+	return !fclose (f);
+}
+
+static unsigned char *
+read_file (const char *path, unsigned int *size)
+{
+	unsigned char *d;
+	long s;
+	FILE *f = fopen (path, "rb");
+
+	if (!f)
+		return NULL;
+	fseek (f, 0, SEEK_END);
+	s = ftell (f);
+	fseek (f, 0, SEEK_SET);
+	d = new unsigned char[s];
+	*size = (unsigned int) fread (d, 1, s, f);
+	fclose (f);
+	return d;
+}
+
+static ExifEntry *
+orientation (ExifData *data)
+{
+	return data->ifd[EXIF_IFD_0]->exif_content_get_entry (EXIF_TAG_ORIENTATION);
+}
+
+/* Load d and check its Orientation */
+static void
+check_orientation (const char *name, const unsigned char *d, unsigned int ds,
+		   ExifShort expected)
+{
+	ExifData data;
+	ExifEntry *e;
+	ExifShort v;
+
+	data.exif_data_new ();
+	data.exif_data_load_data (d, ds);
+	e = orientation (&data);
+	if (!e || !e->data) {
+		printf ("%s: no Orientation after patching\n", name);
+		failed = 1;
+		return;
+	}
+	v = exif_get_short (e->data, data.exif_data_get_byte_order ());
+	if (v != expected) {
+		printf ("%s: Orientation is %u after patching, expected %u\n",
+			name, v, expected);
+		failed = 1;
+	}
+}
+
+static void
+check (ExifByteOrder o)
+{
+	unsigned char *d = NULL, *other = NULL, *orig, *f;
+	unsigned int ds = 0, os = 0, fs;
+	ExifByteOrder o_other = (o == EXIF_BYTE_ORDER_INTEL) ?
+		EXIF_BYTE_ORDER_MOTOROLA : EXIF_BYTE_ORDER_INTEL;
+	ExifData data;
+	ExifEntry *e, *r;
+	char name[64];
+
+	make_data (o, &d, &ds);
+	make_data (o_other, &other, &os);
+	if (!d || !other || (ds != os)) {
+		printf ("Could not save the test data\n");
+		exit (1);
+	}
+	orig = new unsigned char[ds];
+	memcpy (orig, d, ds);
+
+	/* In the loaded buffer */
+	sprintf (name, "buffer (%s)", exif_byte_order_get_name (o));
+	data.exif_data_new ();
+	data.exif_data_load_data (d, ds);
+	e = orientation (&data);
+	exif_set_short (e->data, o, 6);
+	if (!data.exif_data_patch_entry (e, d, ds)) {
+		printf ("%s: Orientation has not been patched\n", name);
+		failed = 1;
+	}
+	check_orientation (name, d, ds, 6);
+
+	/* Data in the other byte order, laid out the same */
+	memcpy (d, other, ds);
+	if (data.exif_data_patch_entry (e, d, ds) || memcmp (d, other, ds)) {
+		printf ("%s: patched data in the other byte order\n", name);
+		failed = 1;
+	}
+
+	/* A value that no longer has its loaded size */
+	memcpy (d, orig, ds);
+	e->components = 2;
+	if (data.exif_data_patch_entry (e, d, ds)) {
+		printf ("%s: patched a value of another size\n", name);
+		failed = 1;
+	}
+	e->components = 1;
+
+	/* An entry that has not been loaded */
+	r = test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_RESOLUTION_UNIT);
+	if (!r || data.exif_data_patch_entry (r, d, ds)) {
+		printf ("%s: patched an entry that has not been loaded\n", name);
+		failed = 1;
+	}
+	data.exif_data_free ();
+
+	/* In a JPEG file; only the bytes of the value change */
+	sprintf (name, "file (%s)", exif_byte_order_get_name (o));
+	if (!write_jpeg (TEST_FILE, orig, ds)) {
+		printf ("Could not write " TEST_FILE "\n");
+		exit (1);
+	}
+	f = read_file (TEST_FILE, &fs);
+	data.exif_data_new ();
+	data.exif_data_load_data (f, fs);
+	delete [] f;
+	e = orientation (&data);
+	exif_set_short (e->data, o, 8);
+	if (!data.exif_data_patch_entry_file (e, TEST_FILE)) {
+		printf ("%s: Orientation has not been patched\n", name);
+		failed = 1;
+	}
+	f = read_file (TEST_FILE, &fs);
+	check_orientation (name, f, fs, 8);
+	if ((fs != 6 + ds + sizeof (image)) ||
+	    memcmp (f + fs - sizeof (image), image, sizeof (image))) {
+		printf ("%s: the image data has changed\n", name);
+		failed = 1;
+	}
+	delete [] f;
+
+	/* A file in the other byte order */
+	write_jpeg (TEST_FILE, other, os);
+	if (data.exif_data_patch_entry_file (e, TEST_FILE)) {
+		printf ("%s: patched a file in the other byte order\n", name);
+		failed = 1;
+	}
+	f = read_file (TEST_FILE, &fs);
+	if ((fs != 6 + os + sizeof (image)) || memcmp (f + 6, other, os)) {
+		printf ("%s: a file in the other byte order has changed\n", name);
+		failed = 1;
+	}
+	delete [] f;
+	data.exif_data_free ();
+	remove (TEST_FILE);
+
+	delete [] d;
+	delete [] orig;
+	delete [] other;
+}
+
+int
+main ()
+{
+	check (EXIF_BYTE_ORDER_INTEL);
+	check (EXIF_BYTE_ORDER_MOTOROLA);
+
+	if (failed)
+		exit (1);
+	printf ("Entries patched as expected.\n");
+	return 0;
+}
@@ -0,0 +1,195 @@
+/* test-save-chunks.cpp
+ *
+ * Checks that the chunks saved by exif_data_save_data_chunks hold the
+ * same EXIF data as exif_data_save_data saves: the same bytes if no
+ * value is referenced, and data that loads the same otherwise.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define THUMBNAIL_SIZE 500
+
+static const char make[] = "Canon";
+/* Odd sizes, so that the referenced values need padding */
+static const char artist[] = "An artist with a long name";
+static const char copyright[] = "Copyright";
+
+static int failed = 0;
+
+/* EXIF data with values of several sizes, a Canon MakerNote and a
+ * thumbnail */
+static void
+make_data (ExifData *data, ExifByteOrder o)
+{
+	unsigned char m[18];
+	unsigned int i;
+
+	/* One LONG entry, then no next IFD */
+	exif_set_short (m, o, 1);
+	exif_set_short (m + 2, o, 0x8);
+	exif_set_short (m + 4, o, EXIF_FORMAT_LONG);
+	exif_set_long (m + 6, o, 1);
+	exif_set_long (m + 10, o, 1234);
+	exif_set_long (m + 14, o, 0);
+
+	data->exif_data_new ();
+	data->exif_data_set_byte_order (o);
+	test_add_entry (data, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (data, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	test_add_value (data, EXIF_IFD_0, EXIF_TAG_MAKE, EXIF_FORMAT_ASCII,
+			make, sizeof (make));
+	test_add_value (data, EXIF_IFD_0, EXIF_TAG_ARTIST, EXIF_FORMAT_ASCII,
+			artist, sizeof (artist));
+	test_add_value (data, EXIF_IFD_0, EXIF_TAG_COPYRIGHT, EXIF_FORMAT_ASCII,
+			copyright, sizeof (copyright));
+	test_add_entry (data, EXIF_IFD_EXIF, EXIF_TAG_EXPOSURE_TIME);
+	test_add_value (data, EXIF_IFD_EXIF, EXIF_TAG_MAKER_NOTE,
+			EXIF_FORMAT_UNDEFINED, m, sizeof (m));
+	test_add_entry (data, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+
+	data->size = THUMBNAIL_SIZE;
+	data->data = new unsigned char[data->size];
+	for (i = 0; i < data->size; i++)
+		data->data[i] = (unsigned char) i;
+}
+
+static void
+concat (const std::vector<ExifDataChunk> &chunks, std::vector<unsigned char> *b)
+{
+	unsigned int i;
+
+	b->clear ();
+	for (i = 0; i < chunks.size (); i++)
+		b->insert (b->end (), chunks[i].data,
+			   chunks[i].data + chunks[i].size);
+}
+
+/* Load b and save it again */
+static void
+resave (const unsigned char *b, unsigned int bs, std::vector<unsigned char> *r)
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+	ExifData data;
+
+	data.exif_data_new ();
+	data.exif_data_load_data (b, bs);
+	data.exif_data_save_data (&d, &ds);
+	data.exif_data_free ();
+	r->assign (d, d + ds);
+	delete [] d;
+}
+
+/* Check that no chunk but the first is part of the MakerNote, that the
+ * thumbnail is referenced and not copied, and that the values are at
+ * even offsets */
+static void
+check_referenced (const char *name, ExifData *data,
+		  const std::vector<ExifDataChunk> &chunks)
+{
+	ExifEntry *m = data->ifd[EXIF_IFD_EXIF]->exif_content_get_entry (
+		EXIF_TAG_MAKER_NOTE);
+	unsigned int i, o = chunks[0].size - 6;
+	int thumbnail = 0;
+
+	for (i = 1; i < chunks.size (); i++) {
+		if (m && (chunks[i].data == m->data)) {
+			printf ("%s: the MakerNote has been referenced\n", name);
+			failed = 1;
+		}
+		if (chunks[i].data == data->data)
+			thumbnail = 1;
+		if ((chunks[i].size > 1) && (o & 1)) {
+			printf ("%s: chunk %u is at an odd offset\n", name, i);
+			failed = 1;
+		}
+		o += chunks[i].size;
+	}
+	if (!thumbnail) {
+		printf ("%s: the thumbnail has not been referenced\n", name);
+		failed = 1;
+	}
+}
+
+static void
+check (ExifByteOrder o)
+{
+	const char *name = exif_byte_order_get_name (o);
+	std::vector<ExifDataChunk> chunks;
+	std::vector<unsigned char> b, l, r;
+	unsigned char *d = NULL, *s = NULL;
+	unsigned int ds = 0, ss = 0;
+	ExifData data;
+
+	make_data (&data, o);
+	data.exif_data_save_data (&s, &ss);
+	resave (s, ss, &l);
+
+	/* Nothing is as large as min: the same bytes in one chunk */
+	data.exif_data_save_data_chunks (&d, &ds, &chunks, 0x10000);
+	concat (chunks, &b);
+	if ((chunks.size () != 1) || (b.size () != ss) || memcmp (&b[0], s, ss)) {
+		printf ("%s: %u chunks saved with a large minimum, not the "
+			"saved data\n", name, (unsigned int) chunks.size ());
+		failed = 1;
+	}
+	delete [] d;
+	d = NULL;
+
+	/* Every value outside its entry is referenced */
+	data.exif_data_save_data_chunks (&d, &ds, &chunks, 5);
+	if (chunks.size () < 5) {
+		printf ("%s: %u chunks saved with a small minimum\n", name,
+			(unsigned int) chunks.size ());
+		failed = 1;
+	} else if ((chunks[0].data != d) || (chunks[0].size != ds)) {
+		printf ("%s: the first chunk is not the buffer\n", name);
+		failed = 1;
+	} else
+		check_referenced (name, &data, chunks);
+	concat (chunks, &b);
+	resave (&b[0], (unsigned int) b.size (), &r);
+	if (r != l) {
+		printf ("%s: the chunks do not load as the saved data\n", name);
+		failed = 1;
+	}
+	delete [] d;
+
+	data.exif_data_free ();
+	delete [] s;
+}
+
+int
+main ()
+{
+	check (EXIF_BYTE_ORDER_INTEL);
+	check (EXIF_BYTE_ORDER_MOTOROLA);
+
+	if (failed)
+		exit (1);
+	printf ("Chunks saved as the data.\n");
+	return 0;
+}
@@ -0,0 +1,186 @@
+/* test-thumbnail-options.cpp
+ *
+ * Checks EXIF_DATA_OPTION_SKIP_THUMBNAIL, which leaves the thumbnail out
+ * of the loaded data and of the data saved from it, and
+ * EXIF_DATA_OPTION_REFERENCE_THUMBNAIL, which only copies the thumbnail
+ * out of the loaded buffer once it is asked for.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ */
+
+#include <libexif/exif-data.h>
+
+#include "test-helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define THUMBNAIL_SIZE 500
+
+static int failed = 0;
+
+/* EXIF data with entries in IFD 0 and IFD 1 and a thumbnail t */
+static void
+make_data (const std::vector<unsigned char> &t, std::vector<unsigned char> *b)
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+	ExifData data;
+
+	data.exif_data_new ();
+	data.exif_data_set_byte_order (EXIF_BYTE_ORDER_INTEL);
+	test_add_entry (&data, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_X_RESOLUTION);
+	test_add_entry (&data, EXIF_IFD_1, EXIF_TAG_Y_RESOLUTION);
+	data.size = (unsigned int) t.size ();
+	data.data = new unsigned char[data.size];
+	memcpy (data.data, &t[0], data.size);
+	data.exif_data_save_data (&d, &ds);
+	data.exif_data_free ();
+	b->assign (d, d + ds);
+	delete [] d;
+}
+
+static void
+load (ExifData *data, const std::vector<unsigned char> &b, ExifDataOption o)
+{
+	data->exif_data_new ();
+	if (o)
+		data->exif_data_set_option (o);
+	data->exif_data_load_data (&b[0], (unsigned int) b.size ());
+}
+
+/* Save data and load it again without options */
+static void
+resave (ExifData *data, ExifData *l)
+{
+	std::vector<unsigned char> b;
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+
+	data->exif_data_save_data (&d, &ds);
+	b.assign (d, d + ds);
+	delete [] d;
+	load (l, b, (ExifDataOption) 0);
+}
+
+static void
+check_thumbnail (const char *name, ExifData *data,
+		 const std::vector<unsigned char> &t)
+{
+	const unsigned char *d;
+	unsigned int ds;
+
+	d = data->exif_data_get_thumbnail (&ds);
+	if ((ds != t.size ()) || !d || memcmp (d, &t[0], ds)) {
+		printf ("%s: the thumbnail differs\n", name);
+		failed = 1;
+	}
+}
+
+static void
+check_skipped (const std::vector<unsigned char> &b)
+{
+	unsigned int ds;
+	ExifData data, l;
+
+	load (&data, b, EXIF_DATA_OPTION_SKIP_THUMBNAIL);
+	if (data.data || data.exif_data_get_thumbnail_size () ||
+	    data.exif_data_get_thumbnail (&ds) || ds) {
+		printf ("Skipped: the thumbnail has been loaded\n");
+		failed = 1;
+	}
+	/* The entries describing it are kept */
+	if (!data.ifd[EXIF_IFD_1]->exif_content_get_entry (EXIF_TAG_X_RESOLUTION) ||
+	    !data.ifd[EXIF_IFD_1]->exif_content_get_entry (EXIF_TAG_Y_RESOLUTION)) {
+		printf ("Skipped: the entries of IFD 1 have been dropped\n");
+		failed = 1;
+	}
+
+	/* And it is dropped from the saved data */
+	resave (&data, &l);
+	if (l.exif_data_get_thumbnail_size ()) {
+		printf ("Skipped: the thumbnail has been saved\n");
+		failed = 1;
+	}
+	l.exif_data_free ();
+	data.exif_data_free ();
+}
+
+static void
+check_referenced (std::vector<unsigned char> b,
+		  const std::vector<unsigned char> &t)
+{
+	const unsigned char *d;
+	ExifData data, l;
+
+	load (&data, b, EXIF_DATA_OPTION_REFERENCE_THUMBNAIL);
+	if (data.data || !data.priv.thumbnail ||
+	    (data.priv.thumbnail < &b[0]) ||
+	    (data.priv.thumbnail >= &b[0] + b.size ()) ||
+	    (data.exif_data_get_thumbnail_size () != t.size ())) {
+		printf ("Referenced: the thumbnail has been copied on "
+			"loading\n");
+		failed = 1;
+	}
+
+	/* Saved from the loaded buffer, still without a copy */
+	resave (&data, &l);
+	check_thumbnail ("Referenced, saved", &l, t);
+	l.exif_data_free ();
+	if (data.data) {
+		printf ("Referenced: the thumbnail has been copied on "
+			"saving\n");
+		failed = 1;
+	}
+
+	/* Copied when asked for; the buffer is no longer needed */
+	check_thumbnail ("Referenced", &data, t);
+	d = data.data;
+	if (!d || ((d >= &b[0]) && (d < &b[0] + b.size ())) ||
+	    data.priv.thumbnail) {
+		printf ("Referenced: the thumbnail has not been copied\n");
+		failed = 1;
+	}
+	memset (&b[0], 0, b.size ());
+	check_thumbnail ("Referenced, buffer cleared", &data, t);
+	if (data.data != d) {
+		printf ("Referenced: the thumbnail has been copied again\n");
+		failed = 1;
+	}
+	data.exif_data_free ();
+}
+
+int
+main ()
+{
+	std::vector<unsigned char> t, b;
+	unsigned int i;
+
+	for (i = 0; i < THUMBNAIL_SIZE; i++)
+		t.push_back ((unsigned char) i);
+	make_data (t, &b);
+
+	check_skipped (b);
+	check_referenced (b, t);
+
+	if (failed)
+		exit (1);
+	printf ("Thumbnails skipped and referenced as expected.\n");
+	return 0;
+}